@@ -8,12 +8,11 @@
 /**
  * @brief Construct a new ServerCallbacks object
  *
- * Initializes the server callbacks with WiFi status reference and
- * obtains the BLE advertising interface.
+ * Obtains the BLE advertising interface.
  *
- * @param wifiStatus Reference to WiFi status tracker
+ * @param settings Reference to global settings (uptime)
  */
-ServerCallbacks::ServerCallbacks(WifiStatus &wifiStatus, GSettings &settings) : wifiStatus(wifiStatus), settings(settings)
+ServerCallbacks::ServerCallbacks(GSettings &settings) : settings(settings)
 {
     pAdvertising = NimBLEDevice::getAdvertising();
 }
@@ -103,13 +102,24 @@ bool ServerCallbacks::isDeviceConnected()
 /**
  * @brief Construct a new CharacteristicCallbacks object
  *
- * Initializes callback handler with references to settings and WiFi connection managers.
+ * Initializes callback handler with a reference to settings and subscribes
+ * to WiFi join results.
  *
  * @param settings Reference to global settings for credential management
- * @param wifiConnection Reference to WiFi connection manager
  */
-CharacteristicCallbacks::CharacteristicCallbacks(GSettings &settings, WifiConnection &wifiConnection) : settings(settings), wifiConnection(wifiConnection)
+CharacteristicCallbacks::CharacteristicCallbacks(GSettings &settings) : settings(settings), notifyCharacteristic(nullptr)
 {
+    inbox.on<WifiStateChanged>([this](const WifiStateChanged &e)
+                               {
+        if (!e.attempt)
+            return;
+        Serial.println(e.staUp ? F("Connected to WiFi!") : F("Failed to connect to WiFi!"));
+        if (notifyCharacteristic == nullptr)
+            return;
+        if (e.staUp)
+            notifyCharacteristic->notify("S:WC,NR,IP:" + IPAddress(e.ip).toString());
+        else
+            notifyCharacteristic->notify(String("S:WF,NR")); });
 }
 
 /**
@@ -161,20 +171,28 @@ void CharacteristicCallbacks::onRead(NimBLECharacteristic *pCharacteristic, NimB
  * - "deviceName": Updates BLE device name
  * - "ssid": WiFi network name
  * - "password": WiFi network password
+ * - "sleepInterval": Deep-sleep wake interval in seconds (0 = always on)
+ * - "apMode": SoftAP policy ("fallback", "always" or "off")
+ * - "apPassword": SoftAP WPA2 password (empty: no SoftAP in any mode)
+ * - "wifiPowerSave": Station power-save policy ("none", "min" or "max")
+ * - "listenInterval": Beacon periods between wakes in "max" power save
  * - "restart": Boolean flag to restart ESP32 after applying changes
  *
  * Operation Flow:
  * 1. Validates and parses incoming JSON data
- * 2. Updates device settings if valid data is provided
- * 3. Saves settings to persistent storage if changes were made
- * 4. Attempts WiFi connection if new credentials were provided
- * 5. Sends status notifications to connected clients
- * 6. Restarts device if requested
+ * 2. Stores new WiFi credentials and requests a join
+ * 3. Posts the device keys and "radio" as one settings merge-patch, which
+ *    poll() validates and applies on the loop task
+ * 4. Sends status notifications to connected clients (patch and WiFi
+ *    results from poll())
+ * 5. Restarts device if requested, after a posted patch is applied
  *
  * Status Notification Codes:
  * - "S:WC,NR,IP:<address>" - WiFi connected successfully
  * - "S:WF,NR" - WiFi connection failed
- * - "S:SI,NR" - Server info updated (restart required)
+ * - "S:ST,OK" / "S:ST,ERR,<reason>" - Settings patch applied / refused
+ *   ("S:RT,..." when the write carried "radio")
+ * - "S:SI,NR" - Settings updated (restart required)
  *
  * @param pCharacteristic Pointer to the characteristic being written
  * @param connInfo Connection information structure
@@ -205,12 +223,6 @@ void CharacteristicCallbacks::onWrite(NimBLECharacteristic *pCharacteristic, Nim
         bool toSavePreferences = false;
         bool tryWifiConnect = false;
         bool newServerInfo = false;
-        if (doc["deviceName"].is<const char *>())
-        {
-            settings.setDeviceName(doc["deviceName"].as<String>());
-            toSavePreferences = true;
-            Serial.printf("Device Name: %s\n", settings.getDeviceName().c_str());
-        }
         if (doc["ssid"].is<const char *>() && doc["password"].is<const char *>())
         {
             settings.setSsid(doc["ssid"].as<String>());
@@ -219,38 +231,57 @@ void CharacteristicCallbacks::onWrite(NimBLECharacteristic *pCharacteristic, Nim
             tryWifiConnect = true;
             Serial.printf("SSID: %s\n", settings.getSsid().c_str());
         }
+        // Device keys and "radio" form one merge-patch with the same sections,
+        // bounds and storage as PATCH /settings, applied and answered from
+        // poll() on the loop task
+        JsonDocument patch;
+        static const char *const deviceKeys[] = {"deviceName", "sleepInterval", "apMode", "apPassword",
+                                                 "wifiPowerSave", "listenInterval"};
+        for (const char *key : deviceKeys)
+        {
+            if (!doc[key].isNull())
+                patch["device"][key] = doc[key];
+        }
+        const bool radio = doc["radio"].is<JsonObject>();
+        if (radio)
+            patch["radio"] = doc["radio"];
+        const bool restart = doc["restart"].is<bool>() && doc["restart"].as<bool>();
+        bool posted = false;
+        if (patch.size() > 0)
+        {
+            size_t len = measureJson(patch);
+            char *body = static_cast<char *>(malloc(len + 1));
+            if (body != nullptr)
+            {
+                serializeJson(patch, body, len + 1);
+                portENTER_CRITICAL(&patchMux);
+                char *dropped = settingsPatch;
+                settingsPatch = body;
+                settingsPatchLen = len;
+                patchRadio = radio;
+                restartAfterPatch = restart;
+                portEXIT_CRITICAL(&patchMux);
+                free(dropped);
+                posted = true;
+            }
+        }
+#if FEATURE_RULES
+        if (doc["rules"].is<JsonObject>())
+        {
+            // Compiled and stored on the loop task
+            String rules;
+            serializeJson(doc["rules"], rules);
+            RuleEngine::instance().submit(rules.c_str(), rules.length());
+        }
+#endif
         if (toSavePreferences)
         {
             settings.save();
         }
         if (tryWifiConnect)
         {
-            if (wifiConnection.getStatus().isWifiConnected())
-            {
-                Serial.println(F("Disconnecting from WiFi..."));
-                wifiConnection.disconnect();
-            }
             Serial.println(F("Connecting to WiFi..."));
-            connect_t result = wifiConnection.connect();
-            if (result.isConnected)
-            {
-                Serial.println(F("Connected to WiFi!"));
-                wifiConnection.getStatus().setWifiConnected(true);
-                wifiConnection.getStatus().setIpAddress(result.ip);
-                if (notifyCharacteristic != nullptr)
-                {
-                    notifyCharacteristic->notify("S:WC,NR,IP:" + wifiConnection.getStatus().getIpAddress());
-                }
-            }
-            else
-            {
-                Serial.println(F("Failed to connect to WiFi!"));
-                wifiConnection.getStatus().setWifiConnected(false);
-                if (notifyCharacteristic != nullptr)
-                {
-                    notifyCharacteristic->notify(String("S:WF,NR"));
-                }
-            }
+            EventBus::instance().publish(WifiConnectRequested{});
         }
         if (newServerInfo)
         {
@@ -260,10 +291,67 @@ void CharacteristicCallbacks::onWrite(NimBLECharacteristic *pCharacteristic, Nim
                 notifyCharacteristic->notify(String("S:SI,NR"));
             }
         }
-        if (doc["restart"].is<bool>() && doc["restart"].as<bool>())
+        if (restart && !posted)
         {
+            // With a pending patch poll() restarts once it is applied
             Serial.println(F("Restarting esp32 to apply new settings..."));
+            FlashWear::instance().save();
             ESP.restart();
         }
     }
 }
+
+void CharacteristicCallbacks::poll()
+{
+    inbox.drain();
+
+    char *body = nullptr;
+    size_t len = 0;
+    bool radio = false;
+    bool restart = false;
+    portENTER_CRITICAL(&patchMux);
+    body = settingsPatch;
+    len = settingsPatchLen;
+    radio = patchRadio;
+    restart = restartAfterPatch;
+    settingsPatch = nullptr;
+    portEXIT_CRITICAL(&patchMux);
+    if (body == nullptr)
+        return;
+    String error;
+    SettingsEffect effect = SettingsEffect::None;
+    bool ok = SettingsApi::instance().patch(body, len, "", error, effect) == PatchStatus::Ok;
+    free(body);
+    if (notifyCharacteristic != nullptr)
+    {
+        String code = radio ? "S:RT," : "S:ST,";
+        notifyCharacteristic->notify(ok ? code + "OK" : code + "ERR," + error);
+        if (ok && effect == SettingsEffect::Restart && !restart)
+            notifyCharacteristic->notify(String("S:SI,NR"));
+    }
+    if (restart)
+    {
+        Serial.println(F("Restarting esp32 to apply new settings..."));
+        FlashWear::instance().save();
+        ESP.restart();
+    }
+}
+
+/**
+ * @brief Handle a provisioning frame write
+ *
+ * Unencrypted writes are dropped like on the configuration characteristic.
+ *
+ * @param pCharacteristic Pointer to the characteristic being written
+ * @param connInfo Connection information structure
+ */
+void ProvisionCallbacks::onWrite(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo)
+{
+    if (!connInfo.isEncrypted())
+    {
+        Serial.println(F("Provisioning write rejected: not encrypted"));
+        return;
+    }
+    std::string frame = pCharacteristic->getValue();
+    Provisioner::instance().handleFrame(reinterpret_cast<const uint8_t *>(frame.data()), frame.size());
+}
@@ -11,18 +11,25 @@
 #define BTLE_H
 
 #include <Arduino.h>
-#include <Preferences.h>
+#include "WearPreferences.hpp"
 #include <NimBLEDevice.h>
 #include <ArduinoJson.h>
+#include <WiFi.h>
 #include "GSettings.hpp"
-#include "WifiConnection.hpp"
+#include "EventBus.hpp"
 #include "ProbeRegistry.hpp"
+#include "Provisioner.hpp"
+#include "Features.hpp"
+#if FEATURE_RULES
+#include "RuleEngine.hpp"
+#endif
 
 // BLE Configuration Parameters
 #define BLE_DEVICE_NAME "ESP32-BLE-Example"                         ///< Default BLE device name for advertising
 #define SERVICE_UUID "9379d945-8ada-41b7-b028-64a8dda4b1f8"         ///< Primary BLE service UUID
 #define CHAR_READ_WRITE_UUID "c62b53d0-1848-424d-9d05-fd91e83f87a8" ///< Characteristic UUID for WiFi credential exchange
 #define CHAR_NOTIFY_UUID "6cd49c0f-0c41-475b-afc5-5d504afca7dc"     ///< Characteristic UUID for status notifications
+#define CHAR_PROVISION_UUID "e5a1c3b2-7f40-4d8e-9b61-2c0f8a7d9e53"  ///< Characteristic UUID for provisioning bundle chunks
 
 /**
  * @brief BLE Server callback handler class
@@ -33,9 +40,8 @@
  *
  * Features:
  * - Client connection/disconnection event handling
- * - Automatic advertising management based on WiFi status
+ * - Advertising resumed after a disconnect during the configuration window
  * - Connection state tracking
- * - Integration with WiFi status monitoring
  */
 class ServerCallbacks : public NimBLEServerCallbacks
 {
@@ -43,10 +49,9 @@ public:
     /**
      * @brief Construct a new ServerCallbacks object
      *
-     * @param wifiStatus Reference to WiFi status tracker for advertising decisions
      * @param settings Reference to global settings for device configuration
      */
-    ServerCallbacks(WifiStatus &wifiStatus, GSettings &settings);
+    ServerCallbacks(GSettings &settings);
 
     /**
      * @brief Handle client connection events
@@ -63,7 +68,7 @@ public:
      * @brief Handle client disconnection events
      *
      * Called when a BLE client disconnects from the server.
-     * Resumes advertising if WiFi is not connected to allow reconfiguration.
+     * Resumes advertising during the first minutes of uptime to allow reconfiguration.
      *
      * @param pServer Pointer to the BLE server instance
      * @param connInfo Connection information structure
@@ -98,7 +103,6 @@ public:
 
 protected:
     bool deviceConnected = false;    ///< Flag indicating if a BLE client is connected
-    WifiStatus &wifiStatus;          ///< Reference to WiFi status for advertising logic
     GSettings &settings;             ///< Reference to global settings manager
     NimBLEAdvertising *pAdvertising; ///< Pointer to BLE advertising interface
 };
@@ -112,10 +116,18 @@ protected:
  *
  * Features:
  * - WiFi credential reception and validation
- * - Device name configuration
- * - Automatic WiFi connection attempts
+ * - Device keys (deviceName, sleepInterval, apMode, apPassword,
+ *   wifiPowerSave, listenInterval) and modem timing ("radio"), posted as
+ *   one SettingsApi merge-patch, validated and applied on the loop task and
+ *   answered from there "S:ST,OK" or "S:ST,ERR,<reason>" ("S:RT,..." when
+ *   the write carried "radio")
+ * - WiFi join requested over the EventBus (WifiConnectRequested); the
+ *   outcome (WifiStateChanged) is notified from poll() on the loop task, so
+ *   the BLE host task never waits for the join
  * - Status notifications to connected clients
  * - Settings persistence using ESP32 Preferences
+ * - Alarm rule sets ("rules"), handed to the RuleEngine and answered from
+ *   the loop task ("R:OK,<rules>" or "R:ERR,<reason>")
  * - Remote device restart capability
  */
 class CharacteristicCallbacks : public NimBLECharacteristicCallbacks
@@ -125,9 +137,13 @@ public:
      * @brief Construct a new CharacteristicCallbacks object
      *
      * @param settings Reference to global settings for credential storage
-     * @param wifiConnection Reference to WiFi connection manager
      */
-    CharacteristicCallbacks(GSettings &settings, WifiConnection &wifiConnection);
+    CharacteristicCallbacks(GSettings &settings);
+
+    /**
+     * @brief Notify WiFi join results and apply a pending settings patch; call from the main loop
+     */
+    void poll();
 
     /**
      * @brief Set the notification characteristic reference
@@ -158,7 +174,7 @@ public:
      * Supports the following operations:
      * - WiFi credential updates (SSID and password)
      * - Device name changes
-     * - Automatic WiFi connection attempts
+     * - WiFi join requests (result notified later from poll())
      * - Device restart commands
      *
      * Expected JSON format:
@@ -175,10 +191,35 @@ public:
     void onWrite(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo) override;
 
 protected:
-    Preferences preferences;                    ///< ESP32 preferences for persistent storage
+    WearPreferences preferences{"ble"};         ///< ESP32 preferences for persistent storage (wear accounted)
     GSettings &settings;                        ///< Reference to global settings manager
-    WifiConnection &wifiConnection;             ///< Reference to WiFi connection manager
     NimBLECharacteristic *notifyCharacteristic; ///< Pointer to notification characteristic
+    EventInbox inbox{"ble"};                    ///< WifiStateChanged (join results)
+    portMUX_TYPE patchMux = portMUX_INITIALIZER_UNLOCKED; ///< Guards the pending patch (BLE task vs loop)
+    char *settingsPatch = nullptr;              ///< Merge-patch from onWrite() (heap), NUL terminated
+    size_t settingsPatchLen = 0;
+    bool patchRadio = false;                    ///< Patch carries "radio": answered "S:RT,..."
+    bool restartAfterPatch = false;             ///< Restart once the patch is applied
+};
+
+/**
+ * @brief Provisioning characteristic callback handler
+ *
+ * Forwards each encrypted write as one transfer frame to the Provisioner.
+ * Verification and the flash commit run later from the main loop, so the
+ * BLE host task is never blocked by them. Results are sent as "P:..."
+ * notifications on the notify characteristic.
+ */
+class ProvisionCallbacks : public NimBLECharacteristicCallbacks
+{
+public:
+    /**
+     * @brief Handle a provisioning frame write
+     *
+     * @param pCharacteristic Pointer to the characteristic being written
+     * @param connInfo Connection information structure
+     */
+    void onWrite(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo) override;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,88 @@
+#include "BuildProfile.hpp"
+#include "ProbeRegistry.hpp"
+#include "RemoteLog.hpp"
+
+// Section bounds of internal RAM, from the ESP32 linker script
+extern "C" char _data_start, _data_end, _bss_start, _bss_end;
+
+BuildProfile &BuildProfile::instance()
+{
+    static BuildProfile inst;
+    return inst;
+}
+
+BuildProfile::BuildProfile()
+{
+    ProbeRegistry::instance().registerProbe("build", [this](JsonObject &dst)
+                                            { toJson(dst); });
+}
+
+/**
+ * @brief Free, low-water mark and largest block, taken once after setup()
+ */
+void BuildProfile::markIdle()
+{
+    if (idle_)
+        return;
+    idle_ = true;
+    idleFree_ = ESP.getFreeHeap();
+    idleMin_ = ESP.getMinFreeHeap();
+    idleLargest_ = ESP.getMaxAllocHeap();
+    idleAtMs_ = millis();
+    LOG_INFO("BUDGET", "profile=%s data=%u bss=%u app=%u heapIdle=%u heapMin=%u largest=%u",
+             BUILD_PROFILE, (unsigned)dataBytes(), (unsigned)bssBytes(), (unsigned)ESP.getSketchSize(),
+             (unsigned)idleFree_, (unsigned)idleMin_, (unsigned)idleLargest_);
+}
+
+void BuildProfile::toJson(JsonObject &dst) const
+{
+    dst["profile"] = BUILD_PROFILE;
+    JsonObject features = dst["features"].to<JsonObject>();
+    features["wifi"] = bool(FEATURE_WIFI);
+    features["ble"] = bool(FEATURE_BLE);
+    features["http"] = bool(FEATURE_HTTP);
+    features["ws"] = bool(FEATURE_WS);
+    features["coap"] = bool(FEATURE_COAP);
+    features["syslog"] = bool(FEATURE_SYSLOG);
+    features["smtp"] = bool(FEATURE_SMTP);
+    features["rules"] = bool(FEATURE_RULES);
+    features["atTrace"] = bool(FEATURE_AT_TRACE);
+    features["history"] = bool(FEATURE_HISTORY);
+    features["serial"] = bool(FEATURE_SERIAL);
+    features["provisioning"] = bool(FEATURE_PROVISIONING);
+    features["supervisor"] = bool(FEATURE_SUPERVISOR);
+    features["flashWear"] = bool(FEATURE_FLASH_WEAR);
+    features["dutyCycle"] = bool(FEATURE_DUTY_CYCLE);
+
+    JsonObject ram = dst["staticRam"].to<JsonObject>();
+    ram["data"] = dataBytes();
+    ram["bss"] = bssBytes();
+
+    JsonObject flash = dst["flash"].to<JsonObject>();
+    flash["app"] = ESP.getSketchSize();
+    flash["free"] = ESP.getFreeSketchSpace();
+
+    if (idle_)
+    {
+        JsonObject idle = dst["idleHeap"].to<JsonObject>();
+        idle["free"] = idleFree_;
+        idle["min"] = idleMin_;
+        idle["largest"] = idleLargest_;
+        idle["atMs"] = idleAtMs_;
+    }
+    JsonObject heap = dst["heap"].to<JsonObject>();
+    heap["free"] = ESP.getFreeHeap();
+    heap["min"] = ESP.getMinFreeHeap();
+    heap["largest"] = ESP.getMaxAllocHeap();
+    dst["psramFree"] = ESP.getFreePsram();
+}
+
+uint32_t BuildProfile::dataBytes()
+{
+    return uint32_t(&_data_end - &_data_start);
+}
+
+uint32_t BuildProfile::bssBytes()
+{
+    return uint32_t(&_bss_end - &_bss_start);
+}
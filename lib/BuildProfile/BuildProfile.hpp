@@ -0,0 +1,54 @@
+/**
+ * @file BuildProfile.hpp
+ * @brief Memory budget of the running build profile (static RAM, idle heap, flash)
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "Features.hpp"
+
+/**
+ * @brief Reports what the selected feature modules cost at runtime
+ *
+ * The static figures come from the linker: .data plus .bss in internal RAM
+ * and the size of the application image. The heap is sampled once by
+ * markIdle(), at the end of setup(), when every enabled module is running
+ * and nothing is being sent. That sample is the RAM left for queues.
+ *
+ * The result is printed once as a "[BUDGET]" line, for profiles without
+ * HTTP. It is also exported as the "build" probe. The ELF-side numbers of
+ * every environment are written at build time by tools/budget_report.py.
+ */
+class BuildProfile
+{
+public:
+    static BuildProfile &instance();
+
+    /**
+     * @brief Sample the heap now and log the budget (first call only)
+     */
+    void markIdle();
+
+    /**
+     * @brief Write {"profile","features":{...},"staticRam":{"data","bss"},
+     * "flash":{"app","free"},"idleHeap":{"free","min","largest","atMs"},
+     * "heap":{"free","min","largest"},"psramFree"}
+     */
+    void toJson(JsonObject &dst) const;
+
+private:
+    BuildProfile();
+    BuildProfile(const BuildProfile &) = delete;
+    BuildProfile &operator=(const BuildProfile &) = delete;
+
+    static uint32_t dataBytes();
+    static uint32_t bssBytes();
+
+    bool idle_ = false;
+    uint32_t idleFree_ = 0;
+    uint32_t idleMin_ = 0;
+    uint32_t idleLargest_ = 0;
+    uint32_t idleAtMs_ = 0;
+};
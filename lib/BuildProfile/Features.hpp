@@ -0,0 +1,181 @@
+/**
+ * @file Features.hpp
+ * @brief Compile-time feature modules selected by the platformio.ini environment
+ *
+ * Every module defaults to on, which is the full build. A build profile
+ * turns modules off with `-DFEATURE_<NAME>=0` in its `build_flags`. The
+ * environments use `lib_ldf_mode = chain+`, so an include guarded by one of
+ * these flags also keeps the library it belongs to out of the link.
+ */
+
+#pragma once
+
+/**
+ * @def FEATURE_WIFI
+ * @brief WiFi station, SoftAP fallback and captive portal (WifiConnection)
+ */
+#ifndef FEATURE_WIFI
+#define FEATURE_WIFI 1
+#endif
+
+/**
+ * @def FEATURE_BLE
+ * @brief NimBLE configuration service (BTLe); configures WiFi, needs FEATURE_WIFI
+ */
+#ifndef FEATURE_BLE
+#define FEATURE_BLE 1
+#endif
+
+/**
+ * @def FEATURE_HTTP
+ * @brief WebServer API (HTTPServer); needs FEATURE_WIFI
+ */
+#ifndef FEATURE_HTTP
+#define FEATURE_HTTP 1
+#endif
+
+/**
+ * @def FEATURE_WS
+ * @brief Binary WebSocket send API on WS_PORT (WsServer); needs FEATURE_WIFI
+ */
+#ifndef FEATURE_WS
+#define FEATURE_WS 1
+#endif
+
+/**
+ * @def FEATURE_COAP
+ * @brief CoAP/UDP send API on COAP_PORT (CoapServer); needs FEATURE_WIFI
+ */
+#ifndef FEATURE_COAP
+#define FEATURE_COAP 1
+#endif
+
+/**
+ * @def FEATURE_SYSLOG
+ * @brief Ship log lines to a UDP syslog collector (RemoteLog); needs FEATURE_WIFI
+ *
+ * With 0 the LOG_* macros only print to Serial.
+ */
+#ifndef FEATURE_SYSLOG
+#define FEATURE_SYSLOG 1
+#endif
+
+/**
+ * @def FEATURE_SMTP
+ * @brief SMTP ingress on SMTP_PORT, mail to <number>@... becomes an SMS (SmtpServer); needs FEATURE_WIFI
+ */
+#ifndef FEATURE_SMTP
+#define FEATURE_SMTP 1
+#endif
+
+/**
+ * @def FEATURE_RULES
+ * @brief Alarm rules over GPIO inputs and probe values that send SMS (RuleEngine)
+ */
+#ifndef FEATURE_RULES
+#define FEATURE_RULES 1
+#endif
+
+/**
+ * @def FEATURE_AT_TRACE
+ * @brief Echo every AT exchange to Serial (StreamDebugger, TINY_GSM_DEBUG)
+ */
+#ifndef FEATURE_AT_TRACE
+#define FEATURE_AT_TRACE 1
+#endif
+
+/**
+ * @def FEATURE_HISTORY
+ * @brief Send history on LittleFS, raw and columnar tiers (History)
+ */
+#ifndef FEATURE_HISTORY
+#define FEATURE_HISTORY 1
+#endif
+
+/**
+ * @def FEATURE_SERIAL
+ * @brief JSON-lines send API on the USB serial console (SerialApi)
+ *
+ * Needs no radio besides the modem, so it is the ingress of builds without WiFi.
+ */
+#ifndef FEATURE_SERIAL
+#define FEATURE_SERIAL 1
+#endif
+
+/**
+ * @def FEATURE_PROVISIONING
+ * @brief Signed provisioning bundles: API keys, carrier overrides, templates (Provisioner)
+ *
+ * Needed by every module that checks API keys or reads templates.
+ */
+#ifndef FEATURE_PROVISIONING
+#define FEATURE_PROVISIONING 1
+#endif
+
+/**
+ * @def FEATURE_SUPERVISOR
+ * @brief Subsystem heartbeats, stall recovery and the task watchdog (Supervisor)
+ *
+ * With 0 the heartbeats and SUPERVISED_STAGE compile to nothing.
+ */
+#ifndef FEATURE_SUPERVISOR
+#define FEATURE_SUPERVISOR 1
+#endif
+
+/**
+ * @def FEATURE_FLASH_WEAR
+ * @brief Flash write accounting, lifetime projection and throttling (FlashWear)
+ *
+ * With 0 WearPreferences writes straight through, unthrottled.
+ */
+#ifndef FEATURE_FLASH_WEAR
+#define FEATURE_FLASH_WEAR 1
+#endif
+
+/**
+ * @def FEATURE_DUTY_CYCLE
+ * @brief Deep-sleep duty cycling and power accounting (DutyCycle)
+ */
+#ifndef FEATURE_DUTY_CYCLE
+#define FEATURE_DUTY_CYCLE 1
+#endif
+
+#if FEATURE_BLE && !FEATURE_WIFI
+#error "FEATURE_BLE provisions WiFi credentials and needs FEATURE_WIFI=1"
+#endif
+
+#if FEATURE_HTTP && !FEATURE_WIFI
+#error "FEATURE_HTTP needs FEATURE_WIFI=1"
+#endif
+
+#if FEATURE_WS && !FEATURE_WIFI
+#error "FEATURE_WS needs FEATURE_WIFI=1"
+#endif
+
+#if FEATURE_COAP && !FEATURE_WIFI
+#error "FEATURE_COAP needs FEATURE_WIFI=1"
+#endif
+
+#if FEATURE_SYSLOG && !FEATURE_WIFI
+#error "FEATURE_SYSLOG needs FEATURE_WIFI=1"
+#endif
+
+#if FEATURE_SMTP && !FEATURE_WIFI
+#error "FEATURE_SMTP needs FEATURE_WIFI=1"
+#endif
+
+#if (FEATURE_BLE || FEATURE_HTTP || FEATURE_WS || FEATURE_COAP || FEATURE_SMTP || FEATURE_RULES) && !FEATURE_PROVISIONING
+#error "BLE, HTTP, WS, CoAP, SMTP and rules need FEATURE_PROVISIONING=1 (API keys, templates)"
+#endif
+
+#if !FEATURE_HTTP && !FEATURE_WS && !FEATURE_COAP && !FEATURE_SMTP && !FEATURE_SERIAL && !FEATURE_RULES
+#error "No ingress enabled: the firmware could not accept an SMS"
+#endif
+
+/**
+ * @def BUILD_PROFILE
+ * @brief Name of the build profile, reported by the "build" probe
+ */
+#ifndef BUILD_PROFILE
+#define BUILD_PROFILE "custom"
+#endif
@@ -0,0 +1,238 @@
+#include "CoapCbor.hpp"
+#include <string.h>
+
+namespace
+{
+    enum Major : uint8_t
+    {
+        UINT = 0,
+        NEGINT = 1,
+        BYTES = 2,
+        TEXT = 3,
+        ARRAY = 4,
+        MAP = 5,
+        TAG = 6,
+        SIMPLE = 7,
+    };
+
+    /**
+     * @brief Bounds-checked reader over one CBOR item sequence
+     */
+    struct Reader
+    {
+        const uint8_t *p;
+        const uint8_t *end;
+
+        /**
+         * @brief Initial byte and argument; false on truncation or indefinite length
+         */
+        bool head(uint8_t &major, uint64_t &arg)
+        {
+            if (p >= end)
+                return false;
+            major = *p >> 5;
+            uint8_t info = *p++ & 0x1F;
+            if (info < 24)
+            {
+                arg = info;
+                return true;
+            }
+            if (info > 27)
+                return false;
+            size_t n = size_t(1) << (info - 24);
+            if (size_t(end - p) < n)
+                return false;
+            arg = 0;
+            for (size_t i = 0; i < n; ++i)
+                arg = arg << 8 | *p++;
+            return true;
+        }
+
+        bool uint(uint64_t &v)
+        {
+            uint8_t major;
+            return head(major, v) && major == UINT;
+        }
+
+        /** @brief Text string in place */
+        bool text(const char *&s, size_t &n)
+        {
+            uint8_t major;
+            uint64_t arg;
+            if (!head(major, arg) || major != TEXT || arg > uint64_t(end - p))
+                return false;
+            s = reinterpret_cast<const char *>(p);
+            n = size_t(arg);
+            p += n;
+            return true;
+        }
+
+        /**
+         * @brief Skip one item; false if it is malformed or nests too deep
+         */
+        bool skip(int depth = 0)
+        {
+            if (depth > SEND_DECODER_MAX_DEPTH)
+                return false;
+            uint8_t major;
+            uint64_t arg;
+            if (!head(major, arg))
+                return false;
+            switch (major)
+            {
+            case BYTES:
+            case TEXT:
+                if (arg > uint64_t(end - p))
+                    return false;
+                p += size_t(arg);
+                return true;
+            case ARRAY:
+            case MAP:
+            {
+                uint64_t items = major == MAP ? arg * 2 : arg;
+                for (uint64_t i = 0; i < items; ++i)
+                    if (!skip(depth + 1))
+                        return false;
+                return true;
+            }
+            case TAG:
+                return skip(depth + 1);
+            default:
+                return true; // integers, simple values and floats have no content
+            }
+        }
+    };
+
+    uint8_t *putHead(uint8_t *p, uint8_t major, uint32_t v)
+    {
+        if (v < 24)
+        {
+            *p++ = uint8_t(major << 5 | v);
+        }
+        else if (v <= 0xFF)
+        {
+            *p++ = uint8_t(major << 5 | 24);
+            *p++ = uint8_t(v);
+        }
+        else if (v <= 0xFFFF)
+        {
+            *p++ = uint8_t(major << 5 | 25);
+            *p++ = uint8_t(v >> 8);
+            *p++ = uint8_t(v);
+        }
+        else
+        {
+            *p++ = uint8_t(major << 5 | 26);
+            for (int shift = 24; shift >= 0; shift -= 8)
+                *p++ = uint8_t(v >> shift);
+        }
+        return p;
+    }
+}
+
+/**
+ * @brief One pass over the map; field errors are ranked once it is read whole
+ */
+DecodeStatus CoapCbor::decodeSend(const uint8_t *cbor, size_t len, SmsJob &job)
+{
+    job.resetRequest();
+    Reader r{cbor, cbor + len};
+    uint8_t major;
+    uint64_t entries;
+    if (!r.head(major, entries) || major != MAP)
+        return DecodeStatus::InvalidJson;
+
+    bool phoneOk = false, messageOk = false, optionOk = true, windowOk = true;
+    for (uint64_t i = 0; i < entries; ++i)
+    {
+        uint64_t key;
+        const uint8_t *keyAt = r.p;
+        if (!r.uint(key))
+        {
+            // Foreign key type: skip the key and its value
+            r.p = keyAt;
+            if (!r.skip() || !r.skip())
+                return DecodeStatus::InvalidJson;
+            continue;
+        }
+        const uint8_t *valueAt = r.p;
+        const char *s;
+        size_t n;
+        uint64_t v;
+        bool read = false; // value consumed as the expected type and valid
+        switch (key)
+        {
+        case KEY_PHONE:
+            read = phoneOk = r.text(s, n) && job.to.parse(s, n);
+            break;
+        case KEY_MESSAGE:
+            read = messageOk = r.text(s, n) && n >= 1 && n <= JOB_BODY_MAX && job.body != nullptr;
+            if (messageOk)
+            {
+                memcpy(job.body, s, n);
+                job.body[n] = '\0';
+                job.bodyLen = uint16_t(n);
+            }
+            break;
+        case KEY_PRIORITY:
+            read = optionOk = r.uint(v) && v <= uint64_t(JobPriority::High);
+            if (optionOk)
+                job.priority = JobPriority(v);
+            break;
+        case KEY_WINDOW:
+        {
+            uint64_t count, start, end;
+            read = windowOk = r.head(major, count) && major == ARRAY && count == 2 && r.uint(start) &&
+                              r.uint(end) && start < 24 * 60 && end < 24 * 60 && start != end;
+            if (windowOk)
+            {
+                job.windowStart = uint16_t(start);
+                job.windowEnd = uint16_t(end);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        // Unknown key, or a value of the wrong type or range: step over it whole
+        if (!read)
+        {
+            r.p = valueAt;
+            if (!r.skip())
+                return DecodeStatus::InvalidJson;
+        }
+    }
+    if (r.p != r.end)
+        return DecodeStatus::InvalidJson;
+
+    if (!phoneOk)
+        return DecodeStatus::InvalidPhone;
+    if (!messageOk)
+        return DecodeStatus::InvalidMessage;
+    if (!optionOk)
+        return DecodeStatus::InvalidOption;
+    if (!windowOk)
+        return DecodeStatus::InvalidWindow;
+    return DecodeStatus::Ok;
+}
+
+size_t CoapCbor::encodeJob(uint8_t *out, uint32_t id, CoapJobState state, uint32_t releaseAt, uint8_t tpStatus)
+{
+    uint8_t entries = 2 + (releaseAt ? 1 : 0) + (tpStatus != 0xFF ? 1 : 0);
+    uint8_t *p = putHead(out, MAP, entries);
+    p = putHead(p, UINT, KEY_ID);
+    p = putHead(p, UINT, id);
+    p = putHead(p, UINT, KEY_STATE);
+    p = putHead(p, UINT, uint8_t(state));
+    if (releaseAt)
+    {
+        p = putHead(p, UINT, KEY_RELEASE_AT);
+        p = putHead(p, UINT, releaseAt);
+    }
+    if (tpStatus != 0xFF)
+    {
+        p = putHead(p, UINT, KEY_TP_STATUS);
+        p = putHead(p, UINT, tpStatus);
+    }
+    return size_t(p - out);
+}
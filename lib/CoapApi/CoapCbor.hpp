@@ -0,0 +1,76 @@
+/**
+ * @file CoapCbor.hpp
+ * @brief CBOR bodies of the CoAP API: send request decoder and job state encoder
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "SmsJob.hpp"
+#include "SendRequestDecoder.hpp"
+
+/**
+ * @brief Job state reported by GET /jobs/{id} and its Observe notifications
+ */
+enum class CoapJobState : uint8_t
+{
+    Queued = 0,      ///< Accepted, not sent yet (queued, parked or sending)
+    Sent = 1,        ///< Network accepted every part
+    Failed = 2,      ///< Abandoned
+    Delivered = 3,   ///< Status report with TP-ST 0
+    Undelivered = 4, ///< Status report with any other TP-ST
+};
+
+/**
+ * @brief CBOR codec of the CoAP bodies (no Arduino dependency)
+ *
+ * Bodies are maps with small integer keys, so a request costs a few bytes
+ * over its phone number and text:
+ *
+ * | Key | Request (POST /send) | Response (job) |
+ * |-----|----------------------|----------------|
+ * | 1 | phone, text "+407..." | job id, uint |
+ * | 2 | message, text | CoapJobState, uint |
+ * | 3 | priority, uint 0 low, 1 normal, 2 high | releaseAt, uint UTC seconds (windowed jobs) |
+ * | 4 | window, [start, end] recipient-local minutes of day | TP-ST of the delivery report, uint |
+ *
+ * Request fields are checked exactly like the `/send` JSON body and report
+ * the same DecodeStatus; unknown keys are skipped. Indefinite lengths are
+ * not accepted.
+ */
+class CoapCbor
+{
+public:
+    enum Key : uint8_t
+    {
+        KEY_PHONE = 1,
+        KEY_MESSAGE = 2,
+        KEY_PRIORITY = 3,
+        KEY_WINDOW = 4,
+        KEY_ID = 1,
+        KEY_STATE = 2,
+        KEY_RELEASE_AT = 3,
+        KEY_TP_STATUS = 4,
+    };
+
+    /** @brief Largest job body written by encodeJob() */
+    static constexpr size_t JOB_MAX = 1 + 4 * (1 + 5);
+
+    /**
+     * @brief Decode a send request into a job record
+     *
+     * @param job Destination record (request fields are reset first)
+     * @return DecodeStatus Ok, InvalidJson for malformed CBOR, otherwise the
+     *         first field error in the precedence of SendRequestDecoder
+     */
+    static DecodeStatus decodeSend(const uint8_t *cbor, size_t len, SmsJob &job);
+
+    /**
+     * @brief Write a job body (at most JOB_MAX bytes)
+     *
+     * @param releaseAt Omitted when 0
+     * @param tpStatus Omitted when 0xFF
+     */
+    static size_t encodeJob(uint8_t *out, uint32_t id, CoapJobState state, uint32_t releaseAt, uint8_t tpStatus);
+};
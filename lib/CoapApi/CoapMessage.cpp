@@ -0,0 +1,206 @@
+#include "CoapMessage.hpp"
+#include <string.h>
+
+namespace
+{
+    /**
+     * @brief Option delta or length nibble with its extended bytes
+     */
+    bool extended(uint8_t nibble, const uint8_t *&p, const uint8_t *end, uint32_t &out)
+    {
+        if (nibble < 13)
+        {
+            out = nibble;
+            return true;
+        }
+        if (nibble == 13)
+        {
+            if (end - p < 1)
+                return false;
+            out = 13u + p[0];
+            p += 1;
+            return true;
+        }
+        if (nibble == 14)
+        {
+            if (end - p < 2)
+                return false;
+            out = 269u + (uint32_t(p[0]) << 8 | p[1]);
+            p += 2;
+            return true;
+        }
+        return false; // 15 is reserved (payload marker only as a whole byte)
+    }
+
+    uint32_t readUint(const uint8_t *v, uint32_t len)
+    {
+        uint32_t out = 0;
+        for (uint32_t i = 0; i < len; ++i)
+            out = out << 8 | v[i];
+        return out;
+    }
+
+    /**
+     * @brief Append one path segment or query option to a joined string
+     */
+    bool append(char *dst, size_t cap, char sep, const uint8_t *v, uint32_t len)
+    {
+        size_t used = strlen(dst);
+        size_t need = (used ? 1 : 0) + len;
+        if (used + need > cap)
+            return false;
+        if (used)
+            dst[used++] = sep;
+        memcpy(dst + used, v, len);
+        dst[used + len] = '\0';
+        return true;
+    }
+}
+
+bool CoapMessage::parse(const uint8_t *data, size_t len, CoapMessage &out)
+{
+    out = CoapMessage();
+    if (len < 4 || (data[0] >> 6) != 1)
+        return false;
+    out.type = CoapType((data[0] >> 4) & 0x03);
+    out.tokenLen = data[0] & 0x0F;
+    out.code = CoapCode(data[1]);
+    out.mid = uint16_t(data[2] << 8 | data[3]);
+    if (out.tokenLen > 8 || len < 4u + out.tokenLen)
+        return false;
+    memcpy(out.token, data + 4, out.tokenLen);
+
+    const uint8_t *p = data + 4 + out.tokenLen;
+    const uint8_t *end = data + len;
+    uint32_t number = 0;
+    while (p < end)
+    {
+        if (*p == 0xFF)
+        {
+            p++;
+            if (p == end)
+                return false; // marker with an empty payload
+            out.payload = p;
+            out.payloadLen = size_t(end - p);
+            return true;
+        }
+        uint8_t head = *p++;
+        uint32_t delta, optLen;
+        if (!extended(head >> 4, p, end, delta) || !extended(head & 0x0F, p, end, optLen))
+            return false;
+        if (uint32_t(end - p) < optLen)
+            return false;
+        number += delta;
+        const uint8_t *v = p;
+        p += optLen;
+
+        switch (CoapOption(number))
+        {
+        case CoapOption::Observe:
+            out.hasObserve = optLen <= 3;
+            out.observe = readUint(v, optLen <= 3 ? optLen : 0);
+            break;
+        case CoapOption::UriPath:
+            if (!append(out.path, COAP_PATH_MAX, '/', v, optLen))
+                out.badCriticalOption = true;
+            break;
+        case CoapOption::UriQuery:
+            if (!append(out.query, COAP_QUERY_MAX, '&', v, optLen))
+                out.badCriticalOption = true;
+            break;
+        case CoapOption::ContentFormat:
+            out.contentFormat = optLen <= 2 ? uint16_t(readUint(v, optLen)) : FORMAT_NONE;
+            break;
+        case CoapOption::Block1:
+            out.hasBlock1 = optLen <= 3;
+            out.block1 = readUint(v, optLen <= 3 ? optLen : 0);
+            if ((out.block1 & 0x07) == 7) // BERT is TCP only
+                out.badCriticalOption = true;
+            break;
+        case CoapOption::UriHost:
+        case CoapOption::UriPort:
+        case CoapOption::Accept:
+        case CoapOption::Block2:
+            break; // addressed to this host; responses are CBOR and fit in one block
+        default:
+            // Odd option numbers are critical (RFC 7252 5.4.1)
+            if (number & 1)
+                out.badCriticalOption = true;
+            break;
+        }
+    }
+    return true;
+}
+
+void CoapWriter::header(CoapType type, CoapCode code, uint16_t mid, const uint8_t *token, uint8_t tokenLen)
+{
+    len = 0;
+    lastOption = 0;
+    overflow = false;
+    uint8_t h[4] = {uint8_t(0x40 | uint8_t(type) << 4 | (tokenLen & 0x0F)), uint8_t(code), uint8_t(mid >> 8), uint8_t(mid)};
+    put(h, sizeof(h));
+    put(token, tokenLen);
+}
+
+bool CoapWriter::put(const void *data, size_t n)
+{
+    if (overflow || len + n > cap)
+    {
+        overflow = true;
+        return false;
+    }
+    memcpy(buf + len, data, n);
+    len += n;
+    return true;
+}
+
+void CoapWriter::putExtended(uint32_t v)
+{
+    if (v >= 269)
+    {
+        uint8_t e[2] = {uint8_t((v - 269) >> 8), uint8_t(v - 269)};
+        put(e, 2);
+    }
+    else if (v >= 13)
+    {
+        uint8_t e = uint8_t(v - 13);
+        put(&e, 1);
+    }
+}
+
+void CoapWriter::option(CoapOption number, const void *value, size_t n)
+{
+    uint32_t delta = uint16_t(number) - lastOption;
+    lastOption = uint16_t(number);
+    auto nibble = [](uint32_t v) -> uint8_t
+    { return v >= 269 ? 14 : v >= 13 ? 13 : uint8_t(v); };
+    uint8_t head = uint8_t(nibble(delta) << 4 | nibble(uint32_t(n)));
+    put(&head, 1);
+    putExtended(delta);
+    putExtended(uint32_t(n));
+    put(value, n);
+}
+
+void CoapWriter::optionUint(CoapOption number, uint32_t value)
+{
+    uint8_t v[4];
+    size_t n = 0;
+    for (int shift = 24; shift >= 0; shift -= 8)
+        if (n || (value >> shift) & 0xFF)
+            v[n++] = uint8_t(value >> shift);
+    option(number, v, n);
+}
+
+void CoapWriter::optionText(CoapOption number, const char *text)
+{
+    option(number, text, strlen(text));
+}
+
+void CoapWriter::payload(const void *data, size_t n)
+{
+    if (n == 0)
+        return;
+    uint8_t marker = 0xFF;
+    put(&marker, 1);
+    put(data, n);
+}
@@ -0,0 +1,165 @@
+/**
+ * @file CoapMessage.hpp
+ * @brief CoAP (RFC 7252) datagram parser and writer with Observe and Block1 options
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @def COAP_PATH_MAX
+ * @brief Longest Uri-Path kept by the parser, segments joined with '/'
+ */
+#ifndef COAP_PATH_MAX
+#define COAP_PATH_MAX 32
+#endif
+
+/**
+ * @def COAP_QUERY_MAX
+ * @brief Longest Uri-Query kept by the parser, options joined with '&'
+ */
+#ifndef COAP_QUERY_MAX
+#define COAP_QUERY_MAX 80
+#endif
+
+/**
+ * @brief Message type (header bits 4-5)
+ */
+enum class CoapType : uint8_t
+{
+    Con = 0, ///< Confirmable: answered with an ACK, retransmitted until then
+    Non = 1, ///< Non-confirmable
+    Ack = 2,
+    Rst = 3,
+};
+
+/**
+ * @brief Method and response codes used by the device (class << 5 | detail)
+ */
+enum class CoapCode : uint8_t
+{
+    Empty = 0x00,
+    Get = 0x01,
+    Post = 0x02,
+    Created = 0x41,                 ///< 2.01
+    Content = 0x45,                 ///< 2.05
+    Continue = 0x5F,                ///< 2.31, next Block1 block
+    BadRequest = 0x80,              ///< 4.00
+    Unauthorized = 0x81,            ///< 4.01
+    BadOption = 0x82,               ///< 4.02
+    NotFound = 0x84,                ///< 4.04
+    MethodNotAllowed = 0x85,        ///< 4.05
+    RequestEntityIncomplete = 0x88, ///< 4.08, Block1 out of sequence
+    RequestEntityTooLarge = 0x8D,   ///< 4.13
+    UnsupportedFormat = 0x8F,       ///< 4.15
+    ServiceUnavailable = 0xA3,      ///< 5.03
+};
+
+/**
+ * @brief Option numbers used by the device
+ */
+enum class CoapOption : uint16_t
+{
+    UriHost = 3,
+    Observe = 6,
+    UriPort = 7,
+    LocationPath = 8,
+    UriPath = 11,
+    ContentFormat = 12,
+    MaxAge = 14,
+    UriQuery = 15,
+    Accept = 17,
+    Block2 = 23,
+    Block1 = 27,
+    Size1 = 60,
+};
+
+/**
+ * @brief A parsed datagram
+ *
+ * Only the options the device acts on are kept; the payload points into
+ * the datagram.
+ */
+struct CoapMessage
+{
+    static constexpr uint16_t FORMAT_CBOR = 60;  ///< Content-Format application/cbor
+    static constexpr uint16_t FORMAT_NONE = 0xFFFF;
+
+    CoapType type = CoapType::Con;
+    CoapCode code = CoapCode::Empty;
+    uint16_t mid = 0;
+    uint8_t tokenLen = 0;
+    uint8_t token[8];
+    char path[COAP_PATH_MAX + 1] = {};   ///< "jobs/12"
+    char query[COAP_QUERY_MAX + 1] = {}; ///< "key=abc"
+    bool hasObserve = false;
+    uint32_t observe = 0;
+    bool hasBlock1 = false;
+    uint32_t block1 = 0; ///< Raw value: num << 4 | more << 3 | szx
+    uint16_t contentFormat = FORMAT_NONE;
+    bool badCriticalOption = false; ///< Unknown critical option, or a path/query too long to keep
+    const uint8_t *payload = nullptr;
+    size_t payloadLen = 0;
+
+    uint32_t blockNum() const { return block1 >> 4; }
+    bool blockMore() const { return (block1 & 0x08) != 0; }
+    size_t blockSize() const { return size_t(16) << (block1 & 0x07); }
+
+    /**
+     * @brief Parse a datagram
+     *
+     * @retval false Not a CoAP 1 message (wrong version, truncated, bad
+     *         option encoding): answer a CON with RST, drop anything else
+     */
+    static bool parse(const uint8_t *data, size_t len, CoapMessage &out);
+};
+
+/**
+ * @brief Writes one datagram into a caller buffer
+ *
+ * Options must be added in ascending number order. ok() turns false once
+ * anything did not fit; length() is then meaningless.
+ */
+class CoapWriter
+{
+public:
+    CoapWriter(uint8_t *buf, size_t cap) : buf(buf), cap(cap) {}
+
+    void header(CoapType type, CoapCode code, uint16_t mid, const uint8_t *token, uint8_t tokenLen);
+
+    /** @brief Set the code of the header already written (decided after the header) */
+    void code(CoapCode code)
+    {
+        if (len >= 2)
+            buf[1] = uint8_t(code);
+    }
+    void option(CoapOption number, const void *value, size_t len);
+
+    /** @brief Option with a minimal-length unsigned value (0 is empty) */
+    void optionUint(CoapOption number, uint32_t value);
+    void optionText(CoapOption number, const char *text);
+    void payload(const void *data, size_t len);
+
+    size_t length() const { return len; }
+    bool ok() const { return !overflow; }
+
+private:
+    bool put(const void *data, size_t n);
+    void putExtended(uint32_t v);
+
+    uint8_t *buf;
+    size_t cap;
+    size_t len = 0;
+    uint16_t lastOption = 0;
+    bool overflow = false;
+};
+
+/**
+ * @brief Block option value
+ */
+inline uint32_t coapBlock(uint32_t num, bool more, uint8_t szx)
+{
+    return num << 4 | (more ? 0x08u : 0u) | (szx & 0x07u);
+}
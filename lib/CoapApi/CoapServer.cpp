@@ -0,0 +1,509 @@
+#include "CoapServer.hpp"
+#include "JobTracer.hpp"
+#include "Provisioner.hpp"
+#include "RemoteLog.hpp"
+#include "SendRequestDecoder.hpp"
+
+namespace
+{
+    const CoapCode ERROR_CODES[] = {
+        CoapCode::BadRequest, CoapCode::Unauthorized, CoapCode::BadOption,
+        CoapCode::NotFound, CoapCode::MethodNotAllowed, CoapCode::RequestEntityIncomplete,
+        CoapCode::RequestEntityTooLarge, CoapCode::UnsupportedFormat, CoapCode::ServiceUnavailable};
+
+    const uint32_t BUSY_MAX_AGE_S = 5; ///< Max-Age of a 5.03: when to try again
+
+    /**
+     * @brief State of a traced job, the latest milestone first
+     */
+    CoapJobState stateOf(const JobTrace &t)
+    {
+        if (t.failed)
+            return CoapJobState::Failed;
+        if (t.has(TraceStage::Delivered))
+            return t.deliveryStatus == 0 ? CoapJobState::Delivered : CoapJobState::Undelivered;
+        if (t.has(TraceStage::MsgRef))
+            return CoapJobState::Sent;
+        return CoapJobState::Queued;
+    }
+}
+
+/**
+ * @brief Bind the job path and the UDP port, register the "coap" probe
+ */
+CoapServer::CoapServer(JobQueue &jobs, PostFunction postFunc, ScheduleFunction scheduleFunc,
+                       CheckModemRegisteredFunction checkModemRegisteredFunc, uint16_t port)
+    : jobs(jobs), post(postFunc), schedule(scheduleFunc), checkModemRegistered(checkModemRegisteredFunc),
+      nextMid(uint16_t(random(0x10000)))
+{
+    udp.begin(port);
+    ProbeRegistry::instance().registerProbe("coap", [this](JsonObject &dst)
+                                            { toJson(dst); });
+    LOG_INFO("COAP", "Listening on UDP port %u", (unsigned)port);
+}
+
+void CoapServer::loop()
+{
+    for (uint8_t i = 0; i < COAP_DATAGRAMS_PER_LOOP; ++i)
+    {
+        int size = udp.parsePacket();
+        if (size <= 0)
+            break;
+        Endpoint from{uint32_t(udp.remoteIP()), udp.remotePort()};
+        int len = udp.read(rx, sizeof(rx));
+        datagramsIn++;
+        bytesIn += uint32_t(size);
+        if (len > 0 && size <= int(sizeof(rx)))
+            handleDatagram(from, size_t(len));
+    }
+    retransmit();
+}
+
+/**
+ * @brief Messaging layer: replies, pings, duplicates, then the resource
+ */
+void CoapServer::handleDatagram(const Endpoint &from, size_t len)
+{
+    CoapMessage m;
+    if (!CoapMessage::parse(rx, len, m))
+    {
+        // Malformed: a confirmable one still gets a reset, anything else is dropped
+        if (len >= 4 && (rx[0] >> 6) == 1 && CoapType((rx[0] >> 4) & 0x03) == CoapType::Con)
+        {
+            uint8_t rst[4] = {0x70, 0x00, rx[2], rx[3]};
+            send(from, rst, sizeof(rst));
+        }
+        return;
+    }
+    if (m.type == CoapType::Ack || m.type == CoapType::Rst)
+    {
+        handleReply(from, m);
+        return;
+    }
+    if (m.code == CoapCode::Empty || uint8_t(m.code) >= 0x20)
+    {
+        // CoAP ping, or a response nobody asked for
+        if (m.type == CoapType::Con)
+        {
+            uint8_t rst[4] = {0x70, 0x00, uint8_t(m.mid >> 8), uint8_t(m.mid)};
+            send(from, rst, sizeof(rst));
+        }
+        return;
+    }
+
+    uint32_t now = millis();
+    for (const Exchange &e : exchanges)
+    {
+        if (e.len && e.from == from && e.mid == m.mid && now - e.atMs < COAP_EXCHANGE_MS)
+        {
+            // Retransmission: answer again, do not execute again
+            duplicates++;
+            send(from, e.response, e.len);
+            return;
+        }
+    }
+
+    CoapWriter w(tx, sizeof(tx));
+    bool con = m.type == CoapType::Con;
+    w.header(con ? CoapType::Ack : CoapType::Non, CoapCode::Empty, con ? m.mid : nextMid++, m.token, m.tokenLen);
+    if (m.badCriticalOption)
+        error(w, CoapCode::BadOption, nullptr);
+    else if (strcmp(m.path, "send") == 0)
+        handleSend(from, m, w, len);
+    else if (strncmp(m.path, "jobs/", 5) == 0)
+        handleJob(from, m, w);
+    else
+        error(w, CoapCode::NotFound, nullptr);
+    if (!w.ok())
+        return;
+
+    Exchange &e = exchanges[exchangeHead];
+    exchangeHead = uint8_t((exchangeHead + 1) % COAP_EXCHANGES);
+    e.from = from;
+    e.mid = m.mid;
+    e.atMs = now;
+    e.len = uint8_t(w.length());
+    memcpy(e.response, tx, w.length());
+    send(from, tx, w.length());
+}
+
+/**
+ * @brief ACK or RST of a confirmable notification
+ */
+void CoapServer::handleReply(const Endpoint &from, const CoapMessage &m)
+{
+    for (Observer &o : observers)
+    {
+        if (!o.used || !o.pending || o.mid != m.mid || !(o.to == from))
+            continue;
+        o.pending = false;
+        // A reset cancels the observation; the final state ends it
+        if (m.type == CoapType::Rst || o.last)
+            o.used = false;
+        return;
+    }
+}
+
+/**
+ * @brief POST /send: reassemble Block1, then decode, check and queue like `POST /send`
+ */
+void CoapServer::handleSend(const Endpoint &from, const CoapMessage &m, CoapWriter &w, size_t requestLen)
+{
+    if (m.code != CoapCode::Post)
+        return error(w, CoapCode::MethodNotAllowed, nullptr);
+    if (!authorized(m))
+        return error(w, CoapCode::Unauthorized, nullptr);
+    if (m.contentFormat != CoapMessage::FORMAT_NONE && m.contentFormat != CoapMessage::FORMAT_CBOR)
+        return error(w, CoapCode::UnsupportedFormat, nullptr);
+
+    const uint8_t *body = m.payload;
+    size_t bodyLen = m.payloadLen;
+    uint32_t wire = uint32_t(requestLen);
+    if (m.hasBlock1)
+    {
+        Transfer *t = transferFor(from, m.blockNum() == 0);
+        if (t == nullptr)
+            return error(w, m.blockNum() == 0 ? CoapCode::ServiceUnavailable : CoapCode::RequestEntityIncomplete, nullptr);
+        if (m.blockNum() == 0)
+        {
+            t->len = 0;
+            t->wire = 0;
+        }
+        if (size_t(m.blockNum()) * m.blockSize() != t->len)
+        {
+            t->used = false;
+            return error(w, CoapCode::RequestEntityIncomplete, nullptr);
+        }
+        if (m.blockMore() && m.payloadLen != m.blockSize())
+        {
+            t->used = false;
+            return error(w, CoapCode::BadRequest, nullptr);
+        }
+        if (t->len + m.payloadLen > COAP_BODY_MAX)
+        {
+            t->used = false;
+            w.code(CoapCode::RequestEntityTooLarge);
+            w.optionUint(CoapOption::Size1, COAP_BODY_MAX);
+            errors[errorIndex(CoapCode::RequestEntityTooLarge)]++;
+            return;
+        }
+        if (m.payloadLen)
+            memcpy(t->body + t->len, m.payload, m.payloadLen);
+        t->len += m.payloadLen;
+        t->lastMs = millis();
+        blocksIn++;
+        if (m.blockMore())
+        {
+            w.code(CoapCode::Continue);
+            w.optionUint(CoapOption::Block1, coapBlock(m.blockNum(), true, uint8_t(m.block1 & 0x07)));
+            t->wire += uint32_t(requestLen + w.length());
+            return;
+        }
+        // Last block: the body stays valid until the next datagram
+        t->used = false;
+        body = t->body;
+        bodyLen = t->len;
+        wire += t->wire;
+    }
+
+    SmsJob *job = jobs.acquire();
+    if (job == nullptr)
+        return error(w, CoapCode::ServiceUnavailable, "{\"error\":\"Busy, try again\"}");
+    JobTracer::instance().begin(job->id);
+    DecodeStatus status = CoapCbor::decodeSend(body, bodyLen, *job);
+    if (status != DecodeStatus::Ok)
+    {
+        jobs.release(job);
+        return error(w, CoapCode::BadRequest, SendRequestDecoder::errorJson(status));
+    }
+
+    uint32_t id = job->id;
+    uint16_t messageLen = job->bodyLen;
+    uint32_t releaseAt = 0;
+    const char *diagnostic = nullptr;
+    CoapCode code = enqueue(*job, releaseAt, diagnostic);
+    if (code != CoapCode::Created)
+    {
+        jobs.release(job);
+        return error(w, code, diagnostic);
+    }
+
+    accepted++;
+    bodyBytes += messageLen;
+    char idText[11];
+    snprintf(idText, sizeof(idText), "%lu", (unsigned long)id);
+    w.code(CoapCode::Created);
+    w.optionText(CoapOption::LocationPath, "jobs");
+    w.optionText(CoapOption::LocationPath, idText);
+    w.optionUint(CoapOption::ContentFormat, CoapMessage::FORMAT_CBOR);
+    if (m.hasBlock1)
+        w.optionUint(CoapOption::Block1, coapBlock(m.blockNum(), false, uint8_t(m.block1 & 0x07)));
+    uint8_t cbor[CoapCbor::JOB_MAX];
+    w.payload(cbor, CoapCbor::encodeJob(cbor, id, CoapJobState::Queued, releaseAt, 0xFF));
+    jobWire += wire + uint32_t(w.length());
+}
+
+/**
+ * @brief Same queue paths and checks as `POST /send`, without waiting for the modem
+ */
+CoapCode CoapServer::enqueue(SmsJob &job, uint32_t &releaseAt, const char *&diagnostic)
+{
+    if (job.hasWindow())
+    {
+        // Campaign traffic: registration is checked when the job is sent
+        ScheduleResult result = schedule(job);
+        if (result == ScheduleResult::ParkFull)
+        {
+            diagnostic = "{\"error\":\"Busy, try again\"}";
+            return CoapCode::ServiceUnavailable;
+        }
+        if (result == ScheduleResult::WindowNever)
+        {
+            diagnostic = "{\"error\":\"Window never open for destination\"}";
+            return CoapCode::BadRequest;
+        }
+        releaseAt = job.releaseAt;
+        return CoapCode::Created;
+    }
+    if (!checkModemRegistered())
+    {
+        diagnostic = "{\"error\":\"Modem not registered on network\"}";
+        return CoapCode::ServiceUnavailable;
+    }
+    post(job);
+    return CoapCode::Created;
+}
+
+/**
+ * @brief GET /jobs/{id}, with Observe registration and deregistration
+ */
+void CoapServer::handleJob(const Endpoint &from, const CoapMessage &m, CoapWriter &w)
+{
+    if (m.code != CoapCode::Get)
+        return error(w, CoapCode::MethodNotAllowed, nullptr);
+    if (!authorized(m))
+        return error(w, CoapCode::Unauthorized, nullptr);
+    const char *idText = m.path + 5;
+    char *end;
+    unsigned long id = strtoul(idText, &end, 10);
+    JobTrace t;
+    if (*idText < '0' || *idText > '9' || *end != '\0' || id == 0 || !JobTracer::instance().find(uint32_t(id), t))
+        return error(w, CoapCode::NotFound, nullptr);
+    CoapJobState state = stateOf(t);
+
+    // Observe 0 registers (again); a GET without it, or with 1, ends a registration
+    bool observe = m.hasObserve && m.observe == 0 && !isFinal(state);
+    Observer *registered = nullptr;
+    Observer *free = nullptr;
+    for (Observer &o : observers)
+    {
+        bool same = o.used && o.to == from && o.tokenLen == m.tokenLen && memcmp(o.token, m.token, m.tokenLen) == 0;
+        if (same && observe)
+            registered = &o;
+        else if (same)
+            o.used = false;
+        else if (!o.used && free == nullptr)
+            free = &o;
+    }
+    if (observe && registered == nullptr && free != nullptr)
+    {
+        // New registration; with every slot taken the answer is a plain response (RFC 7641 4.1)
+        registered = free;
+        *registered = Observer();
+        registered->used = true;
+        registered->to = from;
+        memcpy(registered->token, m.token, m.tokenLen);
+        registered->tokenLen = m.tokenLen;
+    }
+    if (registered)
+        registered->jobId = uint32_t(id);
+
+    w.code(CoapCode::Content);
+    if (registered)
+    {
+        registered->sinceMs = millis();
+        registered->seq = (registered->seq + 1) & 0xFFFFFF;
+        w.optionUint(CoapOption::Observe, registered->seq);
+    }
+    w.optionUint(CoapOption::ContentFormat, CoapMessage::FORMAT_CBOR);
+    uint8_t cbor[CoapCbor::JOB_MAX];
+    w.payload(cbor, CoapCbor::encodeJob(cbor, uint32_t(id), state, 0, t.deliveryStatus));
+}
+
+void CoapServer::jobFinished(const SmsJob &job)
+{
+    CoapJobState state = job.state == JobState::Sent ? CoapJobState::Sent : CoapJobState::Failed;
+    for (Observer &o : observers)
+        if (o.used && o.jobId == job.id)
+            notify(o, state, 0xFF);
+}
+
+void CoapServer::deliveryReport(uint32_t jobId, uint8_t status)
+{
+    for (Observer &o : observers)
+        if (o.used && o.jobId == jobId)
+            notify(o, status == 0 ? CoapJobState::Delivered : CoapJobState::Undelivered, status);
+}
+
+/**
+ * @brief Confirmable notification; replaces one still unacknowledged (newer state wins)
+ */
+void CoapServer::notify(Observer &o, CoapJobState state, uint8_t tpStatus)
+{
+    o.seq = (o.seq + 1) & 0xFFFFFF;
+    o.mid = nextMid++;
+    CoapWriter w(o.message, sizeof(o.message));
+    w.header(CoapType::Con, CoapCode::Content, o.mid, o.token, o.tokenLen);
+    w.optionUint(CoapOption::Observe, o.seq);
+    w.optionUint(CoapOption::ContentFormat, CoapMessage::FORMAT_CBOR);
+    uint8_t cbor[CoapCbor::JOB_MAX];
+    w.payload(cbor, CoapCbor::encodeJob(cbor, o.jobId, state, 0, tpStatus));
+    o.len = uint8_t(w.length());
+    o.pending = true;
+    o.last = isFinal(state);
+    o.tries = 0;
+    o.timeoutMs = COAP_ACK_TIMEOUT_MS + uint32_t(random(COAP_ACK_TIMEOUT_MS / 2));
+    o.retryAtMs = millis() + o.timeoutMs;
+    notifications++;
+    send(o.to, o.message, o.len);
+}
+
+/**
+ * @brief Exponential back-off of unacknowledged notifications, expiry of stale state
+ */
+void CoapServer::retransmit()
+{
+    uint32_t now = millis();
+    for (Observer &o : observers)
+    {
+        if (!o.used)
+            continue;
+        if (!o.pending)
+        {
+            if (now - o.sinceMs >= COAP_OBSERVE_MS)
+                o.used = false;
+            continue;
+        }
+        if (int32_t(now - o.retryAtMs) < 0)
+            continue;
+        if (o.tries >= COAP_MAX_RETRANSMIT)
+        {
+            o.used = false; // observer unreachable
+            continue;
+        }
+        o.tries++;
+        o.timeoutMs *= 2;
+        o.retryAtMs = now + o.timeoutMs;
+        retransmits++;
+        send(o.to, o.message, o.len);
+    }
+    for (Transfer &t : transfers)
+        if (t.used && now - t.lastMs >= COAP_TRANSFER_MS)
+            t.used = false;
+}
+
+/**
+ * @brief The client's upload in progress, or a free slot for a first block
+ */
+CoapServer::Transfer *CoapServer::transferFor(const Endpoint &from, bool create)
+{
+    Transfer *free = nullptr;
+    for (Transfer &t : transfers)
+    {
+        if (t.used && t.from == from)
+            return &t;
+        if (!t.used && free == nullptr)
+            free = &t;
+    }
+    if (!create || free == nullptr)
+        return nullptr;
+    free->used = true;
+    free->from = from;
+    return free;
+}
+
+/**
+ * @brief Error response with an optional diagnostic payload (the `/send` JSON error)
+ */
+void CoapServer::error(CoapWriter &w, CoapCode code, const char *diagnostic)
+{
+    w.code(code);
+    if (code == CoapCode::ServiceUnavailable)
+        w.optionUint(CoapOption::MaxAge, BUSY_MAX_AGE_S);
+    if (diagnostic)
+        w.payload(diagnostic, strlen(diagnostic));
+    int8_t i = errorIndex(code);
+    if (i >= 0)
+        errors[i]++;
+}
+
+/**
+ * @brief Without provisioned keys anyone may send; otherwise `key=<key>` in the query
+ */
+bool CoapServer::authorized(const CoapMessage &m) const
+{
+    if (!Provisioner::instance().hasApiKeys())
+        return true;
+    const char *q = m.query;
+    while (*q)
+    {
+        const char *amp = strchr(q, '&');
+        size_t n = amp ? size_t(amp - q) : strlen(q);
+        char key[65];
+        if (n > 4 && n - 4 < sizeof(key) && strncmp(q, "key=", 4) == 0)
+        {
+            memcpy(key, q + 4, n - 4);
+            key[n - 4] = '\0';
+            return Provisioner::instance().checkApiKey(key);
+        }
+        q += n + (amp ? 1 : 0);
+    }
+    return false;
+}
+
+void CoapServer::send(const Endpoint &to, const uint8_t *data, size_t len)
+{
+    if (!udp.beginPacket(IPAddress(to.ip), to.port))
+        return;
+    udp.write(data, len);
+    if (!udp.endPacket())
+        return;
+    datagramsOut++;
+    bytesOut += uint32_t(len);
+}
+
+int8_t CoapServer::errorIndex(CoapCode code)
+{
+    for (uint8_t i = 0; i < sizeof(ERROR_CODES) / sizeof(ERROR_CODES[0]); ++i)
+        if (ERROR_CODES[i] == code)
+            return int8_t(i);
+    return -1;
+}
+
+void CoapServer::toJson(JsonObject &dst) const
+{
+    uint8_t observing = 0;
+    for (const Observer &o : observers)
+        observing += o.used ? 1 : 0;
+    dst["observers"] = observing;
+    dst["accepted"] = accepted;
+    JsonObject e = dst["errors"].to<JsonObject>();
+    for (uint8_t i = 0; i < sizeof(ERROR_CODES) / sizeof(ERROR_CODES[0]); ++i)
+    {
+        if (!errors[i])
+            continue;
+        char code[5];
+        snprintf(code, sizeof(code), "%u.%02u", unsigned(uint8_t(ERROR_CODES[i]) >> 5), unsigned(uint8_t(ERROR_CODES[i]) & 0x1F));
+        e[code] = errors[i];
+    }
+    dst["duplicates"] = duplicates;
+    dst["blocksIn"] = blocksIn;
+    dst["notifications"] = notifications;
+    dst["retransmits"] = retransmits;
+    dst["datagramsIn"] = datagramsIn;
+    dst["datagramsOut"] = datagramsOut;
+    dst["bytesIn"] = bytesIn;
+    dst["bytesOut"] = bytesOut;
+    dst["bodyBytes"] = bodyBytes;
+    dst["overheadPerMessage"] = accepted ? (jobWire - bodyBytes) / accepted : 0;
+}
@@ -0,0 +1,274 @@
+/**
+ * @file CoapServer.hpp
+ * @brief CoAP over UDP send endpoint for constrained clients, with Observe on jobs
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFiUdp.h>
+#include <functional>
+#include "JobQueue.hpp"
+#include "CoapMessage.hpp"
+#include "CoapCbor.hpp"
+#include "ProbeRegistry.hpp"
+
+// ====== Tuning ======
+/**
+ * @def COAP_PORT
+ * @brief UDP port of the CoAP endpoint
+ */
+#ifndef COAP_PORT
+#define COAP_PORT 5683
+#endif
+
+/**
+ * @def COAP_DATAGRAM_MAX
+ * @brief Largest datagram read (RFC 7252 message size limit without path MTU knowledge)
+ */
+#ifndef COAP_DATAGRAM_MAX
+#define COAP_DATAGRAM_MAX 1152
+#endif
+
+/**
+ * @def COAP_BODY_MAX
+ * @brief Largest POST /send body reassembled from Block1 blocks
+ */
+#ifndef COAP_BODY_MAX
+#define COAP_BODY_MAX (JOB_BODY_MAX + 64)
+#endif
+
+/**
+ * @def COAP_TRANSFERS
+ * @brief Block-wise uploads in progress at once (one per client endpoint)
+ */
+#ifndef COAP_TRANSFERS
+#define COAP_TRANSFERS 2
+#endif
+
+/**
+ * @def COAP_TRANSFER_MS
+ * @brief Idle time after which an unfinished block-wise upload is dropped
+ */
+#ifndef COAP_TRANSFER_MS
+#define COAP_TRANSFER_MS 30000
+#endif
+
+/**
+ * @def COAP_EXCHANGES
+ * @brief Answered requests remembered for duplicate detection
+ */
+#ifndef COAP_EXCHANGES
+#define COAP_EXCHANGES 16
+#endif
+
+/**
+ * @def COAP_EXCHANGE_MS
+ * @brief How long an answered request is remembered (RFC 7252 EXCHANGE_LIFETIME)
+ */
+#ifndef COAP_EXCHANGE_MS
+#define COAP_EXCHANGE_MS 247000
+#endif
+
+/**
+ * @def COAP_RESPONSE_MAX
+ * @brief Largest response kept for a duplicate (Created with its location, or an error)
+ */
+#ifndef COAP_RESPONSE_MAX
+#define COAP_RESPONSE_MAX 96
+#endif
+
+/**
+ * @def COAP_OBSERVERS
+ * @brief Observe registrations on /jobs/{id}
+ */
+#ifndef COAP_OBSERVERS
+#define COAP_OBSERVERS 8
+#endif
+
+/**
+ * @def COAP_OBSERVE_MS
+ * @brief A registration without a final state (no delivery report) is dropped after this
+ */
+#ifndef COAP_OBSERVE_MS
+#define COAP_OBSERVE_MS 600000
+#endif
+
+/**
+ * @def COAP_ACK_TIMEOUT_MS
+ * @brief First retransmission timeout of a confirmable notification (doubles each time)
+ */
+#ifndef COAP_ACK_TIMEOUT_MS
+#define COAP_ACK_TIMEOUT_MS 2000
+#endif
+
+/**
+ * @def COAP_MAX_RETRANSMIT
+ * @brief Retransmissions of a notification before the observer is dropped
+ */
+#ifndef COAP_MAX_RETRANSMIT
+#define COAP_MAX_RETRANSMIT 4
+#endif
+
+/**
+ * @def COAP_DATAGRAMS_PER_LOOP
+ * @brief Datagrams handled per loop() call
+ */
+#ifndef COAP_DATAGRAMS_PER_LOOP
+#define COAP_DATAGRAMS_PER_LOOP 4
+#endif
+
+/**
+ * @brief CoAP (RFC 7252) endpoint on COAP_PORT for clients that cannot afford TCP
+ *
+ * Resources:
+ * - `POST /send`: CBOR body (CoapCbor), answered 2.01 Created with
+ *   Location-Path `jobs/{id}` and the job state. Bodies larger than one
+ *   datagram arrive as Block1 blocks (RFC 7959) and are reassembled
+ * - `GET /jobs/{id}`: job state; with Observe (RFC 7641) every change
+ *   (sent or failed, then the delivery report) is pushed as a confirmable
+ *   notification until the final state
+ *
+ * Sends go through the same job pool, decoder checks (DecodeStatus),
+ * registration check and dispatcher as `POST /send` and the WebSocket API,
+ * and never block the loop while the modem sends. A confirmable request is
+ * answered with a piggybacked ACK; a retransmitted request (same endpoint
+ * and message id) gets the remembered response again and is not executed
+ * twice, so a lost ACK never queues a second SMS. When API keys are
+ * provisioned, requests carry `?key=<key>` (Uri-Query).
+ *
+ * Datagram and byte counts, duplicates, blocks, notifications and the
+ * protocol overhead per accepted message are exported in the "coap" probe.
+ */
+class CoapServer
+{
+public:
+    using PostFunction = std::function<void(SmsJob &job)>;
+    using ScheduleFunction = std::function<ScheduleResult(SmsJob &job)>;
+    using CheckModemRegisteredFunction = std::function<bool()>;
+
+    /**
+     * @brief Bind the UDP port
+     *
+     * @param jobs Job pool send requests are decoded into
+     * @param postFunc Queues jobs without a window
+     * @param scheduleFunc Queues or parks windowed jobs
+     * @param checkModemRegisteredFunc Registration check for jobs without a window
+     * @param port UDP port
+     */
+    CoapServer(JobQueue &jobs, PostFunction postFunc, ScheduleFunction scheduleFunc,
+               CheckModemRegisteredFunction checkModemRegisteredFunc, uint16_t port = COAP_PORT);
+
+    /**
+     * @brief Handle waiting datagrams and due retransmissions; call from the main loop
+     */
+    void loop();
+
+    /**
+     * @brief Notify observers of the job's Sent/Failed state (SmsDispatcher::onFinish())
+     */
+    void jobFinished(const SmsJob &job);
+
+    /**
+     * @brief Notify observers of the delivery report (JobTracer::onDelivery())
+     */
+    void deliveryReport(uint32_t jobId, uint8_t status);
+
+    /**
+     * @brief Write {"observers","accepted","errors":{"<code>":n},"duplicates","blocksIn",
+     * "notifications","retransmits","datagramsIn","datagramsOut","bytesIn","bytesOut",
+     * "bodyBytes","overheadPerMessage"}
+     */
+    void toJson(JsonObject &dst) const;
+
+private:
+    struct Endpoint
+    {
+        uint32_t ip = 0;
+        uint16_t port = 0;
+        bool operator==(const Endpoint &o) const { return ip == o.ip && port == o.port; }
+    };
+
+    /** @brief Answered request, for duplicate detection */
+    struct Exchange
+    {
+        Endpoint from;
+        uint16_t mid = 0;
+        uint32_t atMs = 0;
+        uint8_t len = 0; ///< 0: free
+        uint8_t response[COAP_RESPONSE_MAX];
+    };
+
+    /** @brief Block1 upload being reassembled */
+    struct Transfer
+    {
+        Endpoint from;
+        bool used = false;
+        uint32_t lastMs = 0;
+        size_t len = 0;
+        uint32_t wire = 0; ///< Datagram bytes of the blocks and their 2.31 answers
+        uint8_t body[COAP_BODY_MAX];
+    };
+
+    /** @brief Observe registration with at most one unacknowledged notification */
+    struct Observer
+    {
+        Endpoint to;
+        bool used = false;
+        uint8_t token[8];
+        uint8_t tokenLen = 0;
+        uint32_t jobId = 0;
+        uint32_t seq = 0; ///< Observe sequence number of the last notification
+        uint32_t sinceMs = 0;
+        bool pending = false; ///< Notification not acknowledged yet
+        bool last = false;    ///< Pending notification carries the final state
+        uint16_t mid = 0;
+        uint8_t tries = 0;
+        uint32_t timeoutMs = 0;
+        uint32_t retryAtMs = 0;
+        uint8_t len = 0;
+        uint8_t message[48];
+    };
+
+    WiFiUDP udp;
+    JobQueue &jobs;
+    PostFunction post;
+    ScheduleFunction schedule;
+    CheckModemRegisteredFunction checkModemRegistered;
+    uint16_t nextMid;
+    uint8_t rx[COAP_DATAGRAM_MAX];
+    uint8_t tx[COAP_RESPONSE_MAX];
+    Exchange exchanges[COAP_EXCHANGES];
+    uint8_t exchangeHead = 0;
+    Transfer transfers[COAP_TRANSFERS];
+    Observer observers[COAP_OBSERVERS];
+
+    uint32_t accepted = 0;
+    uint32_t errors[9] = {};
+    uint32_t duplicates = 0;
+    uint32_t blocksIn = 0;
+    uint32_t notifications = 0;
+    uint32_t retransmits = 0;
+    uint32_t datagramsIn = 0;
+    uint32_t datagramsOut = 0;
+    uint32_t bytesIn = 0;
+    uint32_t bytesOut = 0;
+    uint32_t bodyBytes = 0; ///< Message bodies of accepted sends
+    uint32_t jobWire = 0;   ///< Datagram bytes of accepted sends and their answers
+
+    void handleDatagram(const Endpoint &from, size_t len);
+    void handleReply(const Endpoint &from, const CoapMessage &m);
+    void handleSend(const Endpoint &from, const CoapMessage &m, CoapWriter &w, size_t requestLen);
+    void handleJob(const Endpoint &from, const CoapMessage &m, CoapWriter &w);
+    CoapCode enqueue(SmsJob &job, uint32_t &releaseAt, const char *&diagnostic);
+    void error(CoapWriter &w, CoapCode code, const char *diagnostic);
+    bool authorized(const CoapMessage &m) const;
+    Transfer *transferFor(const Endpoint &from, bool create);
+    void notify(Observer &o, CoapJobState state, uint8_t tpStatus);
+    void retransmit();
+    void send(const Endpoint &to, const uint8_t *data, size_t len);
+
+    static bool isFinal(CoapJobState s) { return s == CoapJobState::Failed || s == CoapJobState::Delivered || s == CoapJobState::Undelivered; }
+    static int8_t errorIndex(CoapCode code);
+};
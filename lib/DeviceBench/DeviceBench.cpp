@@ -0,0 +1,358 @@
+#include "DeviceBench.hpp"
+
+#if FEATURE_BENCH
+
+#include <LittleFS.h>
+#include <new>
+#include "WearPreferences.hpp"
+#include "SendRequestDecoder.hpp"
+#include "AtParser.hpp"
+#include "JobTracer.hpp"
+#include "HistoryCodec.hpp"
+
+namespace
+{
+    /// Typical `/send` body, as sent by the web form
+    const char SEND_BODY[] =
+        "{\"phone\":\"+40712345678\",\"message\":\"Salut! Test SMS de pe T-SIM7000G.\",\"priority\":\"normal\"}";
+
+    /// Status report URC in text mode (AT+CSDH=0)
+    const char CDS_LINE[] =
+        "+CDS: 6,42,\"+40712345678\",145,\"25/01/01,10:00:00+08\",\"25/01/01,10:00:05+08\",0";
+
+    volatile uint32_t sink; ///< Keeps benchmarked results observable
+
+    /**
+     * @brief Time a batch of fast operations and report ns per operation
+     */
+    template <typename Fn>
+    void batch(JsonObject &dst, const char *name, uint32_t iterations, Fn fn)
+    {
+        uint32_t t0 = micros();
+        for (uint32_t i = 0; i < iterations; ++i)
+            fn();
+        uint32_t us = micros() - t0;
+        JsonObject o = dst[name].to<JsonObject>();
+        o["iterations"] = iterations;
+        o["nsPerOp"] = uint32_t(uint64_t(us) * 1000u / iterations);
+    }
+
+    /**
+     * @brief Per-operation latency aggregate for slow (flash) operations
+     */
+    struct Latency
+    {
+        uint32_t count = 0;
+        uint32_t minUs = UINT32_MAX;
+        uint32_t maxUs = 0;
+        uint64_t sumUs = 0;
+
+        void add(uint32_t us)
+        {
+            count++;
+            sumUs += us;
+            if (us < minUs)
+                minUs = us;
+            if (us > maxUs)
+                maxUs = us;
+        }
+
+        void toJson(JsonObject &dst, const char *name) const
+        {
+            JsonObject o = dst[name].to<JsonObject>();
+            o["ops"] = count;
+            o["minUs"] = count ? minUs : 0;
+            o["avgUs"] = count ? uint32_t(sumUs / count) : 0;
+            o["maxUs"] = maxUs;
+        }
+    };
+
+    /**
+     * @brief Copy throughput between two buffers in MB/s
+     */
+    float copyRate(uint8_t *dst, const uint8_t *src, size_t len, uint32_t rounds)
+    {
+        uint32_t t0 = micros();
+        for (uint32_t i = 0; i < rounds; ++i)
+        {
+            memcpy(dst, src, len);
+            sink = dst[i % len];
+        }
+        uint32_t us = micros() - t0;
+        return us ? float(uint64_t(len) * rounds) / float(us) : 0.0f; // bytes/µs == MB/s
+    }
+}
+
+/**
+ * @brief Run every benchmark group in a fixed order
+ */
+void DeviceBench::run(JsonObject &root)
+{
+    uint32_t t0 = millis();
+    JsonObject o;
+    o = root["board"].to<JsonObject>();
+    board(o);
+    o = root["json"].to<JsonObject>();
+    json(o);
+    o = root["at"].to<JsonObject>();
+    at(o);
+    o = root["memcpy"].to<JsonObject>();
+    memcpyBench(o);
+    o = root["littlefs"].to<JsonObject>();
+    littleFs(o);
+    o = root["nvs"].to<JsonObject>();
+    nvs(o);
+    o = root["history"].to<JsonObject>();
+    history(o);
+    root["elapsedMs"] = millis() - t0;
+}
+
+/**
+ * @brief Identify hardware and firmware so results can be compared
+ */
+void DeviceBench::board(JsonObject &dst)
+{
+    dst["chip"] = ESP.getChipModel();
+    dst["revision"] = ESP.getChipRevision();
+    dst["cpuMHz"] = ESP.getCpuFreqMHz();
+    dst["flashMHz"] = ESP.getFlashChipSpeed() / 1000000;
+    dst["psram"] = ESP.getPsramSize();
+    dst["sdk"] = ESP.getSdkVersion();
+    dst["build"] = __DATE__ " " __TIME__;
+}
+
+/**
+ * @brief /send decoding (custom decoder vs ArduinoJson) and trace encoding
+ */
+void DeviceBench::json(JsonObject &dst)
+{
+    static char body[JOB_BODY_MAX + 1];
+    SmsJob job;
+    job.body = body;
+    batch(dst, "decodeSend", 1000, [&]()
+          { sink = uint32_t(SendRequestDecoder::decode(SEND_BODY, sizeof(SEND_BODY) - 1, job)); });
+
+    JsonDocument doc;
+    batch(dst, "deserializeSend", 1000, [&]()
+          { sink = uint32_t(deserializeJson(doc, SEND_BODY, sizeof(SEND_BODY) - 1).code()); });
+
+    JobTrace trace;
+    trace.jobId = 12;
+    trace.startMs = 81234;
+    trace.msgRef = 42;
+    for (size_t i = 0; i < size_t(TraceStage::Count); ++i)
+        trace.offsetUs[i] = uint32_t(i) * 150000u;
+    char out[768];
+    batch(dst, "encodeTrace", 500, [&]()
+          {
+        JsonDocument t;
+        JsonObject r = t.to<JsonObject>();
+        JobTracer::toJson(trace, r);
+        sink = serializeJson(t, out, sizeof(out)); });
+}
+
+/**
+ * @brief Allocation-free AT response/URC parsers
+ */
+void DeviceBench::at(JsonObject &dst)
+{
+    batch(dst, "creg", 10000, []()
+          { sink = AtParser::parseRegStat(" 0,1"); });
+    batch(dst, "cmgs", 10000, []()
+          { sink = AtParser::parseCmgsRef(" 42"); });
+    batch(dst, "cds", 10000, []()
+          {
+        int mr, st;
+        sink = AtParser::parseCds(CDS_LINE, mr, st) ? mr + st : 0; });
+}
+
+/**
+ * @brief memcpy throughput between internal RAM and PSRAM
+ */
+void DeviceBench::memcpyBench(JsonObject &dst)
+{
+    const size_t len = BENCH_COPY_BYTES;
+    const uint32_t rounds = 64;
+    uint8_t *a = (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint8_t *b = (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint8_t *p = (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_SPIRAM);
+
+    dst["bytes"] = len;
+    if (a != nullptr && b != nullptr)
+    {
+        memset(a, 0x5A, len);
+        dst["internalToInternalMBps"] = copyRate(b, a, len, rounds);
+    }
+    if (a != nullptr && p != nullptr)
+    {
+        dst["internalToPsramMBps"] = copyRate(p, a, len, rounds);
+        dst["psramToInternalMBps"] = copyRate(a, p, len, rounds);
+    }
+    else
+    {
+        dst["psram"] = false;
+    }
+    heap_caps_free(a);
+    heap_caps_free(b);
+    heap_caps_free(p);
+}
+
+/**
+ * @brief Append latency with and without flush (fsync) on LittleFS
+ */
+void DeviceBench::littleFs(JsonObject &dst)
+{
+    if (!LittleFS.begin(true, "/littlefs", 5, "littlefs"))
+    {
+        dst["error"] = "mount failed";
+        return;
+    }
+    const char *path = "/bench.tmp";
+    File f = LittleFS.open(path, FILE_WRITE);
+    if (!f)
+    {
+        dst["error"] = "open failed";
+        return;
+    }
+
+    uint8_t record[64];
+    memset(record, 'b', sizeof(record));
+    Latency append, appendSync;
+    for (uint32_t i = 0; i < BENCH_FLASH_OPS; ++i)
+    {
+        uint32_t t0 = micros();
+        f.write(record, sizeof(record));
+        append.add(micros() - t0);
+        FlashWear::instance().noteFsWrite("bench", sizeof(record), false);
+    }
+    for (uint32_t i = 0; i < BENCH_FLASH_OPS; ++i)
+    {
+        uint32_t t0 = micros();
+        f.write(record, sizeof(record));
+        f.flush(); // fflush + fsync
+        appendSync.add(micros() - t0);
+        FlashWear::instance().noteFsWrite("bench", sizeof(record), true);
+    }
+    f.close();
+    LittleFS.remove(path);
+
+    append.toJson(dst, "append64");
+    appendSync.toJson(dst, "append64Fsync");
+}
+
+/**
+ * @brief Preferences (NVS) write latency in a scratch namespace
+ */
+void DeviceBench::nvs(JsonObject &dst)
+{
+    WearPreferences prefs("bench"); // explicit operator request: never throttled
+    if (!prefs.begin("bench", false))
+    {
+        dst["error"] = "open failed";
+        return;
+    }
+    Latency put;
+    for (uint32_t i = 0; i < BENCH_FLASH_OPS; ++i)
+    {
+        uint32_t t0 = micros();
+        prefs.putUInt("k", i);
+        put.add(micros() - t0);
+    }
+    prefs.clear();
+    prefs.end();
+    put.toJson(dst, "putUInt");
+}
+
+/**
+ * @brief Archive a synthetic segment and time the same queries on both formats
+ *
+ * Rows mimic campaign traffic: 5..124 s apart, 40 recipients, 10% failures,
+ * 2..9 s latency. Each query runs against the raw rows in RAM and the encoded
+ * segment in RAM, so the times compare decoding cost only (no flash reads).
+ */
+void DeviceBench::history(JsonObject &dst)
+{
+    const size_t n = BENCH_HISTORY_ROWS;
+    size_t cap = HistoryCodec::encodeBound(n);
+    HistoryRecord *rows = new (std::nothrow) HistoryRecord[n];
+    uint8_t *seg = static_cast<uint8_t *>(malloc(cap));
+    if (rows == nullptr || seg == nullptr)
+    {
+        delete[] rows;
+        free(seg);
+        dst["error"] = "out of memory";
+        return;
+    }
+
+    uint32_t lcg = 12345; // fixed seed: identical data on every run
+    auto next = [&lcg](uint32_t mod)
+    {
+        lcg = lcg * 1103515245u + 12345u;
+        return (lcg >> 16) % mod;
+    };
+    uint32_t ts = 1750000000;
+    char phone[PhoneNumber::STRING_MAX];
+    for (size_t i = 0; i < n; ++i)
+    {
+        ts += 5 + next(120);
+        snprintf(phone, sizeof(phone), "+4071234%04u", unsigned(next(40)));
+        rows[i].ts = ts;
+        rows[i].to.parse(phone);
+        rows[i].status = uint8_t(next(10) ? HistoryStatus::Sent : HistoryStatus::Failed);
+        rows[i].segments = 1 + next(2);
+        rows[i].latencyMs = 2000 + next(7000);
+    }
+
+    uint32_t t0 = micros();
+    size_t len = HistoryCodec::encode(rows, n, seg, cap);
+    uint32_t encodeUs = micros() - t0;
+    dst["rows"] = n;
+    dst["rawBytes"] = n * sizeof(HistoryRecord);
+    dst["columnarBytes"] = len;
+    dst["ratio"] = len ? float(n * sizeof(HistoryRecord)) / float(len) : 0.0f;
+    dst["encodeUs"] = encodeUs;
+
+    PhoneNumber known = rows[0].to;
+    PhoneNumber unknown;
+    unknown.parse("+40799999999");
+    struct Case
+    {
+        const char *name;
+        HistoryQuery q;
+    } cases[3];
+    cases[0].name = "lastTenth";
+    cases[0].q.from = rows[n - n / 10].ts;
+    cases[1].name = "destination";
+    cases[1].q.dest = &known;
+    cases[2].name = "absentDestination";
+    cases[2].q.dest = &unknown;
+
+    HistoryMemorySource src(seg, len);
+    auto count = [](const HistoryRecord &row)
+    {
+        sink = row.latencyMs;
+        return true;
+    };
+    for (Case &c : cases)
+    {
+        HistoryQueryStats raw, col;
+        t0 = micros();
+        HistoryCodec::queryRaw(rows, n, c.q, count, raw);
+        uint32_t rawUs = micros() - t0;
+        t0 = micros();
+        HistoryCodec::query(src, c.q, count, col);
+        uint32_t colUs = micros() - t0;
+
+        JsonObject o = dst[c.name].to<JsonObject>();
+        o["matched"] = col.rowsMatched;
+        o["rawUs"] = rawUs;
+        o["columnarUs"] = colUs;
+        o["rawBytesRead"] = raw.bytesRead;
+        o["columnarBytesRead"] = col.bytesRead;
+        o["columns"] = col.columnsRead;
+    }
+    delete[] rows;
+    free(seg);
+}
+
+#endif // FEATURE_BENCH
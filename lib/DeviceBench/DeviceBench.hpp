@@ -0,0 +1,87 @@
+/**
+ * @file DeviceBench.hpp
+ * @brief Fixed on-target micro-benchmark suite (`POST /debug/bench`)
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ====== Tuning ======
+/**
+ * @def FEATURE_BENCH
+ * @brief Build the benchmark suite and its `/debug/bench` endpoint
+ *
+ * Off by default. Enable with `-DFEATURE_BENCH=1` in build_flags.
+ */
+#ifndef FEATURE_BENCH
+#define FEATURE_BENCH 0
+#endif
+
+/**
+ * @def BENCH_COPY_BYTES
+ * @brief Buffer size used by the memcpy benchmarks
+ */
+#ifndef BENCH_COPY_BYTES
+#define BENCH_COPY_BYTES 16384
+#endif
+
+/**
+ * @def BENCH_FLASH_OPS
+ * @brief Number of LittleFS appends and NVS writes measured per run
+ */
+#ifndef BENCH_FLASH_OPS
+#define BENCH_FLASH_OPS 20
+#endif
+
+/**
+ * @def BENCH_HISTORY_ROWS
+ * @brief Synthetic send-history rows encoded by the history benchmark
+ */
+#ifndef BENCH_HISTORY_ROWS
+#define BENCH_HISTORY_ROWS 512
+#endif
+
+#if FEATURE_BENCH
+
+/**
+ * @brief On-device benchmarks that host builds cannot reproduce
+ *
+ * Runs a fixed suite so results are comparable across board revisions and
+ * firmware versions:
+ * - json: /send decode (SendRequestDecoder and ArduinoJson) and trace encode
+ * - at: +CREG, +CMGS and +CDS line parsing
+ * - memcpy: internal→internal, internal→PSRAM, PSRAM→internal (MB/s)
+ * - littlefs: 64 byte append, append + flush (fsync) latency
+ * - nvs: 4 byte Preferences write latency
+ * - history: columnar archive size and query time against raw rows
+ *
+ * CPU-bound cases report "nsPerOp" over a batch; flash cases report per
+ * operation "minUs"/"avgUs"/"maxUs". The suite blocks for about a second
+ * and must only run while no job is in flight.
+ */
+class DeviceBench
+{
+public:
+    /**
+     * @brief Run the whole suite and write the results
+     *
+     * Output: {"board":{...},"json":{...},"at":{...},"memcpy":{...},
+     * "littlefs":{...},"nvs":{...},"history":{...}}
+     *
+     * @param root Destination object
+     */
+    static void run(JsonObject &root);
+
+private:
+    static void board(JsonObject &dst);
+    static void json(JsonObject &dst);
+    static void at(JsonObject &dst);
+    static void memcpyBench(JsonObject &dst);
+    static void littleFs(JsonObject &dst);
+    static void nvs(JsonObject &dst);
+    static void history(JsonObject &dst);
+};
+
+#endif // FEATURE_BENCH
@@ -0,0 +1,213 @@
+#include "DutyCycle.hpp"
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+#include "RemoteLog.hpp"
+
+/**
+ * @def DUTY_RI_PIN
+ * @brief Modem ring indicator pin (MODEM_RI on the T-SIM7000G), RTC capable
+ */
+#ifndef DUTY_RI_PIN
+#define DUTY_RI_PIN 33
+#endif
+
+namespace
+{
+    /**
+     * @brief Accounting kept in RTC slow memory across deep sleep
+     */
+    struct DutyCounters
+    {
+        uint32_t magic;            ///< COUNTERS_MAGIC once initialised
+        uint32_t wakes;            ///< Deep-sleep wakes since power-on
+        uint64_t awakeMs;          ///< Time awake in previous boots
+        uint64_t sleepMs;          ///< Time spent in deep sleep
+        int64_t sleepStartUs;      ///< Wall clock at the last sleep entry
+        uint32_t sendSamples;      ///< Wake-to-send samples taken
+        uint32_t lastWakeToSendMs; ///< Most recent wake-to-send latency
+        uint32_t maxWakeToSendMs;  ///< Worst wake-to-send latency
+        uint64_t sumWakeToSendMs;  ///< Sum of all wake-to-send latencies
+    };
+
+    const uint32_t COUNTERS_MAGIC = 0x44555459; // "DUTY"
+    RTC_DATA_ATTR DutyCounters counters;
+
+    /**
+     * @brief Wall clock in µs; the RTC keeps it running through deep sleep
+     */
+    int64_t wallUs()
+    {
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        return int64_t(tv.tv_sec) * 1000000 + tv.tv_usec;
+    }
+}
+
+/**
+ * @brief Register the "power" probe
+ */
+DutyCycle::DutyCycle(GSettings &settings) : settings(settings)
+{
+    ProbeRegistry::instance().registerProbe("power", [this](JsonObject &dst)
+                                            { this->toJson(dst); });
+}
+
+/**
+ * @brief Map the ESP-IDF wake-up cause and account for the time slept
+ */
+void DutyCycle::begin()
+{
+    switch (esp_sleep_get_wakeup_cause())
+    {
+    case ESP_SLEEP_WAKEUP_TIMER:
+        cause = WakeCause::Timer;
+        break;
+    case ESP_SLEEP_WAKEUP_EXT0:
+        cause = WakeCause::ModemRi;
+        break;
+    case ESP_SLEEP_WAKEUP_EXT1:
+        cause = WakeCause::Gpio;
+        break;
+    default:
+        cause = WakeCause::PowerOn;
+        break;
+    }
+
+    if (cause == WakeCause::PowerOn || counters.magic != COUNTERS_MAGIC)
+    {
+        memset(&counters, 0, sizeof(counters));
+        counters.magic = COUNTERS_MAGIC;
+    }
+    else
+    {
+        counters.wakes++;
+        int64_t slept = wallUs() - counters.sleepStartUs;
+        if (slept > 0)
+            counters.sleepMs += uint64_t(slept) / 1000;
+    }
+    lastActivityMs = millis();
+    LOG_INFO("POWER", "Wake cause: %s (wake #%lu)", causeName(cause), (unsigned long)counters.wakes);
+}
+
+bool DutyCycle::isEnabled()
+{
+    return settings.getSleepInterval() > 0;
+}
+
+bool DutyCycle::isQuickWake()
+{
+    return isEnabled() && (cause == WakeCause::Timer || cause == WakeCause::ModemRi);
+}
+
+void DutyCycle::runWakeHandler()
+{
+    if (wakeFn)
+        wakeFn(cause);
+}
+
+/**
+ * @brief Take the wake-to-send sample and reset the idle timer
+ */
+void DutyCycle::noteSend(bool ok)
+{
+    lastActivityMs = millis();
+    if (!ok || sentSinceWake || cause == WakeCause::PowerOn)
+        return;
+
+    sentSinceWake = true;
+    uint32_t latency = uint32_t(esp_timer_get_time() / 1000); // since leaving deep sleep
+    counters.sendSamples++;
+    counters.lastWakeToSendMs = latency;
+    counters.sumWakeToSendMs += latency;
+    if (latency > counters.maxWakeToSendMs)
+        counters.maxWakeToSendMs = latency;
+    LOG_INFO("POWER", "Wake-to-send: %lu ms", (unsigned long)latency);
+}
+
+/**
+ * @brief Sleep once idle; full wakes also honour the configuration window
+ */
+bool DutyCycle::shouldSleep(bool busy)
+{
+    if (!isEnabled())
+        return false;
+    uint32_t now = millis();
+    if (busy)
+    {
+        lastActivityMs = now;
+        return false;
+    }
+    if (!isQuickWake() && now < DUTY_AWAKE_WINDOW_MS)
+        return false;
+    return now - lastActivityMs >= DUTY_IDLE_MS;
+}
+
+/**
+ * @brief Close the awake period, arm wake sources and enter deep sleep
+ */
+void DutyCycle::sleep(uint32_t wakeAt)
+{
+    uint32_t interval = settings.getSleepInterval();
+    time_t now = time(nullptr);
+    if (wakeAt != 0 && time_t(wakeAt) > now && time_t(wakeAt) - now < time_t(interval))
+        interval = uint32_t(time_t(wakeAt) - now); // a parked job becomes due first
+    counters.awakeMs += uint64_t(esp_timer_get_time() / 1000);
+    counters.sleepStartUs = wallUs();
+
+    esp_sleep_enable_timer_wakeup(uint64_t(interval) * 1000000ULL);
+    esp_sleep_enable_ext0_wakeup((gpio_num_t)DUTY_RI_PIN, 0);
+#if DUTY_WAKE_PIN >= 0
+    esp_sleep_enable_ext1_wakeup(1ULL << DUTY_WAKE_PIN, ESP_EXT1_WAKEUP_ALL_LOW);
+#endif
+
+    LOG_INFO("POWER", "Deep sleep for %lu s", (unsigned long)interval);
+    Serial.flush();
+    esp_deep_sleep_start();
+}
+
+/**
+ * @brief Export counters, latency and the estimated daily energy use
+ */
+void DutyCycle::toJson(JsonObject &root)
+{
+    uint64_t awake = counters.awakeMs + uint64_t(esp_timer_get_time() / 1000);
+    uint64_t asleep = counters.sleepMs;
+
+    root["enabled"] = isEnabled();
+    root["wakeCause"] = causeName(cause);
+    root["wakes"] = counters.wakes;
+    root["awakeMs"] = awake;
+    root["sleepMs"] = asleep;
+
+    JsonObject w = root["wakeToSendMs"].to<JsonObject>();
+    w["count"] = counters.sendSamples;
+    w["last"] = counters.lastWakeToSendMs;
+    w["avg"] = counters.sendSamples ? uint32_t(counters.sumWakeToSendMs / counters.sendSamples) : 0;
+    w["max"] = counters.maxWakeToSendMs;
+
+    // Average current weighted by measured time in each state, scaled to 24 h
+    double total = double(awake + asleep);
+    double avgUa = total > 0 ? (double(awake) * DUTY_ACTIVE_UA + double(asleep) * DUTY_SLEEP_UA) / total : 0;
+    root["mAhPerDay"] = round(avgUa * 24.0 / 100.0) / 10.0;
+    if (DUTY_BUDGET_MAH_DAY > 0)
+        root["budgetMahPerDay"] = DUTY_BUDGET_MAH_DAY;
+}
+
+/**
+ * @brief Lowercase wake cause identifiers used in logs and JSON
+ */
+const char *DutyCycle::causeName(WakeCause c)
+{
+    switch (c)
+    {
+    case WakeCause::Timer:
+        return "timer";
+    case WakeCause::ModemRi:
+        return "modem_ri";
+    case WakeCause::Gpio:
+        return "gpio";
+    default:
+        return "power_on";
+    }
+}
@@ -0,0 +1,186 @@
+/**
+ * @file DutyCycle.hpp
+ * @brief Deep-sleep duty cycling for periodic reporting deployments
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include "GSettings.hpp"
+#include "ProbeRegistry.hpp"
+
+// ====== Tuning ======
+/**
+ * @def DUTY_AWAKE_WINDOW_MS
+ * @brief Minimum time awake after a power-on or full wake (BLE/HTTP configuration)
+ */
+#ifndef DUTY_AWAKE_WINDOW_MS
+#define DUTY_AWAKE_WINDOW_MS (5 * MINUTE)
+#endif
+
+/**
+ * @def DUTY_IDLE_MS
+ * @brief Idle time (no job in flight, no send) before going back to sleep
+ *
+ * Leaves room for late URCs such as +CDS delivery reports.
+ */
+#ifndef DUTY_IDLE_MS
+#define DUTY_IDLE_MS (3 * SECOND)
+#endif
+
+/**
+ * @def DUTY_WAKE_PIN
+ * @brief Optional RTC GPIO (active low) that triggers a full wake; -1 disables
+ */
+#ifndef DUTY_WAKE_PIN
+#define DUTY_WAKE_PIN -1
+#endif
+
+/**
+ * @def DUTY_ACTIVE_UA
+ * @brief Board current while awake on the minimal path (µA), for the energy estimate
+ */
+#ifndef DUTY_ACTIVE_UA
+#define DUTY_ACTIVE_UA 90000
+#endif
+
+/**
+ * @def DUTY_SLEEP_UA
+ * @brief Board current in deep sleep with the modem in PSM (µA), for the energy estimate
+ */
+#ifndef DUTY_SLEEP_UA
+#define DUTY_SLEEP_UA 1200
+#endif
+
+/**
+ * @def DUTY_BUDGET_MAH_DAY
+ * @brief Daily energy budget reported against the estimate (0 = no budget)
+ */
+#ifndef DUTY_BUDGET_MAH_DAY
+#define DUTY_BUDGET_MAH_DAY 0
+#endif
+
+/**
+ * @brief Why the ESP32 is running
+ */
+enum class WakeCause : uint8_t
+{
+    PowerOn = 0, ///< Cold boot, reset or anything but a deep-sleep wake
+    Timer,       ///< RTC timer (scheduled reporting)
+    ModemRi,     ///< Modem ring indicator (incoming SMS or URC)
+    Gpio,        ///< DUTY_WAKE_PIN pressed
+};
+
+/**
+ * @brief Function run on every quick wake
+ *
+ * The firmware's handler parks the jobs carried through deep sleep again
+ * (JobQueue::restore()) and drains the queue; deployments add their
+ * scheduled or threshold-triggered messages there.
+ */
+using WakeFunction = std::function<void(WakeCause cause)>;
+
+/**
+ * @brief Decides when to deep-sleep and keeps wake/sleep accounting
+ *
+ * Active only when GSettings::getSleepInterval() is non-zero. A timer or RI
+ * wake takes the minimal path (no BLE, WiFi or HTTP): the modem is resumed
+ * from PSM, pending work is sent and the device sleeps again after
+ * DUTY_IDLE_MS. Power-on and GPIO wakes run the full setup and stay up for
+ * at least DUTY_AWAKE_WINDOW_MS. Every deep-sleep wake reattaches to the
+ * modem first; it is only power-cycled when it does not answer.
+ *
+ * Counters live in RTC memory and survive deep sleep. The "power" probe
+ * reports them, together with wake-to-send latency and an estimated daily
+ * energy use derived from measured awake/sleep time and the configured
+ * DUTY_ACTIVE_UA / DUTY_SLEEP_UA currents.
+ */
+class DutyCycle
+{
+public:
+    /**
+     * @brief Construct a new DutyCycle object and register the "power" probe
+     *
+     * @param settings Settings providing the sleep interval
+     */
+    DutyCycle(GSettings &settings);
+
+    /**
+     * @brief Classify the wake-up and fold the last sleep into the counters
+     *
+     * Call once, early in setup() and after settings.load().
+     */
+    void begin();
+
+    /** @return Reason for the current boot */
+    WakeCause wakeCause() const { return cause; }
+
+    /** @return true if duty cycling is configured */
+    bool isEnabled();
+
+    /**
+     * @brief Whether this boot should take the minimal wake path
+     *
+     * @retval true Timer or RI wake with duty cycling enabled
+     */
+    bool isQuickWake();
+
+    /**
+     * @brief Set the function run on quick wakes
+     */
+    void onWake(WakeFunction fn) { wakeFn = fn; }
+
+    /**
+     * @brief Run the wake function (if any) for the current wake cause
+     */
+    void runWakeHandler();
+
+    /**
+     * @brief Record the outcome of a send for latency accounting
+     *
+     * The first successful send after a timer/RI wake sets the wake-to-send
+     * latency (time since the ESP32 left deep sleep). Any send counts as
+     * activity for the idle timer.
+     *
+     * @param ok true if the network accepted the message
+     */
+    void noteSend(bool ok);
+
+    /**
+     * @brief Whether it is time to go to sleep
+     *
+     * @param busy true while any job is queued or being sent
+     * @retval true Enabled, not busy, idle long enough and past the awake window
+     */
+    bool shouldSleep(bool busy);
+
+    /**
+     * @brief Arm the wake sources and enter deep sleep (does not return)
+     *
+     * Wake sources: RTC timer (sleep interval, or earlier at wakeAt), modem
+     * RI (ext0, low) and DUTY_WAKE_PIN (ext1, low) when configured. The
+     * caller prepares the modem first.
+     *
+     * @param wakeAt UTC seconds to wake by, e.g. the earliest parked job's
+     *        release time (0 = sleep interval only)
+     */
+    void sleep(uint32_t wakeAt = 0);
+
+    /**
+     * @brief Write counters: {"wakeCause","wakes","awakeMs","sleepMs",
+     * "wakeToSendMs":{"last","avg","max","count"},"mAhPerDay","budgetMahPerDay"}
+     */
+    void toJson(JsonObject &root);
+
+    /** @return Stable lowercase name of a wake cause */
+    static const char *causeName(WakeCause c);
+
+private:
+    GSettings &settings;              ///< Source of the sleep interval
+    WakeCause cause = WakeCause::PowerOn; ///< Reason for this boot
+    WakeFunction wakeFn;              ///< Deployment hook run on quick wakes
+    uint32_t lastActivityMs = 0;      ///< millis() of the last send or busy check
+    bool sentSinceWake = false;       ///< A wake-to-send sample was taken this boot
+};
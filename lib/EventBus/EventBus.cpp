@@ -0,0 +1,196 @@
+#include "EventBus.hpp"
+
+EventInbox::EventInbox(const char *name) : name(name)
+{
+    for (uint32_t i = 0; i < EVENT_INBOX_DEPTH; ++i)
+        cells[i].seq.store(i, std::memory_order_relaxed);
+    index = EventBus::instance().attach(this);
+}
+
+bool EventInbox::subscribe(EventId id, std::function<void(const void *)> fn)
+{
+    if (index == 0xFF || handlerCount >= EVENT_HANDLERS_MAX)
+        return false;
+    handlers[handlerCount++] = Handler{id, fn};
+    EventBus::instance().subscribe(id, index);
+    return true;
+}
+
+/**
+ * @brief Claim the tail cell with a CAS, then publish it by bumping its sequence
+ */
+bool EventInbox::push(uint8_t slot)
+{
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell &cell = cells[pos & (EVENT_INBOX_DEPTH - 1)];
+        int32_t diff = int32_t(cell.seq.load(std::memory_order_acquire) - pos);
+        if (diff == 0)
+        {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                cell.slot = slot;
+                cell.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+            pos = tail.load(std::memory_order_relaxed);
+    }
+}
+
+bool EventInbox::pop(uint8_t &slot)
+{
+    Cell &cell = cells[head & (EVENT_INBOX_DEPTH - 1)];
+    if (int32_t(cell.seq.load(std::memory_order_acquire) - (head + 1)) < 0)
+        return false;
+    slot = cell.slot;
+    cell.seq.store(head + EVENT_INBOX_DEPTH, std::memory_order_release);
+    head++;
+    return true;
+}
+
+size_t EventInbox::drain(size_t max)
+{
+    EventBus &bus = EventBus::instance();
+    uint32_t depth = tail.load(std::memory_order_relaxed) - head;
+    if (depth > maxDepth)
+        maxDepth = uint8_t(depth);
+    size_t n = 0;
+    uint8_t slot;
+    while (n < max && pop(slot))
+    {
+        const EventBus::Slot &s = bus.slots[slot];
+        for (uint8_t i = 0; i < handlerCount; ++i)
+            if (handlers[i].id == s.id)
+                handlers[i].fn(s.payload);
+        bus.release(slot);
+        n++;
+    }
+    handled += n;
+    return n;
+}
+
+void EventInbox::toJson(JsonObject &dst) const
+{
+    dst["depth"] = tail.load(std::memory_order_relaxed) - head;
+    dst["maxDepth"] = maxDepth;
+    dst["handled"] = handled;
+    dst["dropped"] = dropped.load(std::memory_order_relaxed);
+}
+
+EventBus &EventBus::instance()
+{
+    static EventBus inst;
+    return inst;
+}
+
+EventBus::EventBus() : freeMask(EVENT_SLOTS == 32 ? 0xFFFFFFFFu : (1u << EVENT_SLOTS) - 1)
+{
+    for (auto &p : published)
+        p.store(0, std::memory_order_relaxed);
+    ProbeRegistry::instance().registerProbe("events", [this](JsonObject &dst)
+                                            { toJson(dst); });
+}
+
+uint8_t EventBus::attach(EventInbox *inbox)
+{
+    if (inboxCount >= EVENT_INBOXES_MAX)
+    {
+        Serial.printf("[EVENT] Inbox table full, %s gets no events\n", inbox->name);
+        return 0xFF;
+    }
+    inboxes[inboxCount] = inbox;
+    return inboxCount++;
+}
+
+void EventBus::subscribe(EventId id, uint8_t inbox)
+{
+    subscribers[uint8_t(id)] |= uint8_t(1u << inbox);
+}
+
+/**
+ * @brief One copy into a free slot, one slot index per subscribed inbox
+ */
+bool EventBus::publish(EventId id, const void *payload, size_t len)
+{
+    published[uint8_t(id)].fetch_add(1, std::memory_order_relaxed);
+    uint8_t mask = subscribers[uint8_t(id)];
+    if (mask == 0)
+        return true;
+
+    uint8_t slot;
+    if (!claim(slot))
+    {
+        noSlot.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Slot &s = slots[slot];
+    s.id = id;
+    memcpy(s.payload, payload, len);
+    // Hold one extra reference while pushing, so a fast subscriber cannot
+    // free the slot before every inbox has it
+    s.refs.store(uint8_t(__builtin_popcount(mask) + 1), std::memory_order_release);
+
+    bool ok = true;
+    for (uint8_t i = 0; i < inboxCount; ++i)
+    {
+        if (!(mask & (1u << i)))
+            continue;
+        if (!inboxes[i]->push(slot))
+        {
+            release(slot);
+            ok = false;
+        }
+    }
+    release(slot);
+    return ok;
+}
+
+/**
+ * @brief Take the lowest free slot from the mask
+ */
+bool EventBus::claim(uint8_t &slot)
+{
+    uint32_t mask = freeMask.load(std::memory_order_relaxed);
+    do
+    {
+        if (mask == 0)
+            return false;
+        slot = uint8_t(__builtin_ctz(mask));
+    } while (!freeMask.compare_exchange_weak(mask, mask & ~(1u << slot), std::memory_order_acquire));
+
+    uint8_t free = uint8_t(__builtin_popcount(mask) - 1);
+    if (free < slotsLow.load(std::memory_order_relaxed))
+        slotsLow.store(free, std::memory_order_relaxed); // statistic: a lost update is harmless
+    return true;
+}
+
+void EventBus::release(uint8_t slot)
+{
+    if (slots[slot].refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        freeMask.fetch_or(1u << slot, std::memory_order_release);
+}
+
+void EventBus::toJson(JsonObject &dst) const
+{
+    dst["slots"] = EVENT_SLOTS;
+    dst["slotsFree"] = __builtin_popcount(freeMask.load(std::memory_order_relaxed));
+    dst["slotsLow"] = slotsLow.load(std::memory_order_relaxed);
+    dst["noSlot"] = noSlot.load(std::memory_order_relaxed);
+    JsonObject p = dst["published"].to<JsonObject>();
+    for (uint8_t i = 0; i < uint8_t(EventId::Count); ++i)
+        p[eventName(EventId(i))] = published[i].load(std::memory_order_relaxed);
+    JsonObject in = dst["inboxes"].to<JsonObject>();
+    for (uint8_t i = 0; i < inboxCount; ++i)
+    {
+        JsonObject o = in[inboxes[i]->name].to<JsonObject>();
+        inboxes[i]->toJson(o);
+    }
+}
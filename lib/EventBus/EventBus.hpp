@@ -0,0 +1,215 @@
+/**
+ * @file EventBus.hpp
+ * @brief Typed publish/subscribe between modules with preallocated event slots
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include "Events.hpp"
+#include "ProbeRegistry.hpp"
+
+// ====== Tuning ======
+/**
+ * @def EVENT_SLOTS
+ * @brief Events in flight at once (published, not yet handled by every inbox); at most 32
+ */
+#ifndef EVENT_SLOTS
+#define EVENT_SLOTS 16
+#endif
+
+/**
+ * @def EVENT_PAYLOAD_MAX
+ * @brief Largest event struct in bytes
+ */
+#ifndef EVENT_PAYLOAD_MAX
+#define EVENT_PAYLOAD_MAX 16
+#endif
+
+/**
+ * @def EVENT_INBOX_DEPTH
+ * @brief Queued events per inbox; a power of two
+ */
+#ifndef EVENT_INBOX_DEPTH
+#define EVENT_INBOX_DEPTH 8
+#endif
+
+/**
+ * @def EVENT_INBOXES_MAX
+ * @brief Number of inboxes (subscribing modules); at most 8
+ */
+#ifndef EVENT_INBOXES_MAX
+#define EVENT_INBOXES_MAX 8
+#endif
+
+/**
+ * @def EVENT_HANDLERS_MAX
+ * @brief Event types one inbox can subscribe to
+ */
+#ifndef EVENT_HANDLERS_MAX
+#define EVENT_HANDLERS_MAX 4
+#endif
+
+static_assert(EVENT_SLOTS <= 32, "EVENT_SLOTS is a 32-bit free mask");
+static_assert(EVENT_INBOXES_MAX <= 8, "subscriber sets are 8-bit masks");
+static_assert((EVENT_INBOX_DEPTH & (EVENT_INBOX_DEPTH - 1)) == 0, "EVENT_INBOX_DEPTH must be a power of two");
+
+/**
+ * @brief A module's mailbox: the events it subscribed to, handled on its own task
+ *
+ * Any task may publish into an inbox (BLE host task, loop, ...); only the
+ * owning task calls drain(), which runs the handlers. The queue is a
+ * bounded lock-free multi-producer single-consumer ring of slot indices
+ * (per-cell sequence numbers), so publishing never takes a lock and never
+ * waits for the subscriber.
+ *
+ * Inboxes are long-lived members or globals; subscribe with on() during
+ * setup, before events flow.
+ */
+class EventInbox
+{
+public:
+    /**
+     * @brief Attach to the bus
+     *
+     * @param name Key in the "events" probe (static string)
+     */
+    explicit EventInbox(const char *name);
+
+    /**
+     * @brief Handle events of type E on this inbox
+     *
+     * @retval false EVENT_HANDLERS_MAX reached
+     */
+    template <typename E>
+    bool on(std::function<void(const E &)> fn)
+    {
+        return subscribe(E::ID, [fn](const void *payload)
+                         { fn(*static_cast<const E *>(payload)); });
+    }
+
+    /**
+     * @brief Run the handlers of queued events; call from the owning task
+     *
+     * @param max Events handled at most (bounds the time spent)
+     * @return Events handled
+     */
+    size_t drain(size_t max = EVENT_INBOX_DEPTH);
+
+    /**
+     * @brief Write {"depth","maxDepth","handled","dropped"}
+     */
+    void toJson(JsonObject &dst) const;
+
+private:
+    friend class EventBus;
+
+    struct Cell
+    {
+        std::atomic<uint32_t> seq;
+        uint8_t slot;
+    };
+
+    struct Handler
+    {
+        EventId id;
+        std::function<void(const void *)> fn;
+    };
+
+    bool subscribe(EventId id, std::function<void(const void *)> fn);
+
+    /** @brief Producer side; false when the ring is full */
+    bool push(uint8_t slot);
+
+    /** @brief Consumer side; false when empty */
+    bool pop(uint8_t &slot);
+
+    const char *name;
+    uint8_t index = 0xFF; ///< Bit in the bus subscriber masks
+    Cell cells[EVENT_INBOX_DEPTH];
+    std::atomic<uint32_t> tail{0}; ///< Next position producers claim
+    uint32_t head = 0;             ///< Next position the owner reads
+    Handler handlers[EVENT_HANDLERS_MAX];
+    uint8_t handlerCount = 0;
+
+    std::atomic<uint32_t> dropped{0}; ///< Ring full at publish
+    uint32_t handled = 0;
+    uint8_t maxDepth = 0; ///< Deepest queue seen by drain()
+};
+
+/**
+ * @brief Routes published events to the inboxes subscribed to their type
+ *
+ * An event is copied once into a preallocated slot, and the slot index is
+ * queued on every subscribed inbox; the slot is freed when the last inbox
+ * has handled it. No allocation happens after setup. Event types are plain
+ * structs (trivially copyable, at most EVENT_PAYLOAD_MAX bytes) with a
+ * compile-time EventId, see Events.hpp.
+ *
+ * Publishing never blocks: when no slot is free or an inbox ring is full
+ * the event is dropped for that inbox and counted. Handlers run on the task
+ * that drains the inbox, not on the publisher's.
+ *
+ * Registers an "events" probe with per-type publish counts, slot use and
+ * per-inbox depth and drops.
+ */
+class EventBus
+{
+public:
+    static EventBus &instance();
+
+    /**
+     * @brief Publish an event to every inbox subscribed to its type
+     *
+     * Safe from any task.
+     *
+     * @retval false Dropped for at least one subscriber
+     */
+    template <typename E>
+    bool publish(const E &event)
+    {
+        static_assert(std::is_trivially_copyable<E>::value, "events are copied into raw slots");
+        static_assert(sizeof(E) <= EVENT_PAYLOAD_MAX, "event larger than EVENT_PAYLOAD_MAX");
+        return publish(E::ID, &event, sizeof(E));
+    }
+
+    /**
+     * @brief Write {"slots","slotsFree","slotsLow","noSlot","published":{"<event>":n},
+     * "inboxes":{"<name>":{...}}}
+     */
+    void toJson(JsonObject &dst) const;
+
+private:
+    friend class EventInbox;
+
+    struct Slot
+    {
+        EventId id;
+        std::atomic<uint8_t> refs{0}; ///< Inboxes still to handle the event
+        alignas(8) uint8_t payload[EVENT_PAYLOAD_MAX];
+    };
+
+    EventBus();
+    EventBus(const EventBus &) = delete;
+    EventBus &operator=(const EventBus &) = delete;
+
+    bool publish(EventId id, const void *payload, size_t len);
+    uint8_t attach(EventInbox *inbox);
+    void subscribe(EventId id, uint8_t inbox);
+    bool claim(uint8_t &slot);
+    void release(uint8_t slot);
+
+    Slot slots[EVENT_SLOTS];
+    std::atomic<uint32_t> freeMask;
+    EventInbox *inboxes[EVENT_INBOXES_MAX] = {};
+    uint8_t inboxCount = 0;
+    uint8_t subscribers[uint8_t(EventId::Count)] = {}; ///< Inbox bit mask per event type
+
+    std::atomic<uint32_t> published[uint8_t(EventId::Count)];
+    std::atomic<uint32_t> noSlot{0};
+    std::atomic<uint8_t> slotsLow{EVENT_SLOTS}; ///< Fewest free slots seen
+};
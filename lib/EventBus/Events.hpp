@@ -0,0 +1,76 @@
+/**
+ * @file Events.hpp
+ * @brief Event types carried by the EventBus
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Compile-time type id of every event
+ *
+ * One entry per event struct; the struct names its id in a static `ID`
+ * member, so EventBus::publish() and EventInbox::on() resolve it at compile
+ * time. Add new events before Count.
+ */
+enum class EventId : uint8_t
+{
+    WifiStateChanged = 0,
+    WifiConnectRequested,
+    HttpRequestServed,
+    Count
+};
+
+/**
+ * @brief Station or SoftAP state changed, or a connect() attempt finished
+ *
+ * Published by WifiConnection.
+ */
+struct WifiStateChanged
+{
+    static constexpr EventId ID = EventId::WifiStateChanged;
+    bool staUp;    ///< Station associated with an IP
+    bool apActive; ///< SoftAP and captive-portal DNS running
+    bool attempt;  ///< Outcome of a WifiConnectRequested (staUp false = failed)
+    uint32_t ip;   ///< Station address (0 while down)
+};
+
+/**
+ * @brief Join the configured network now (new credentials from BLE)
+ *
+ * Handled by WifiConnection, which answers with WifiStateChanged::attempt.
+ */
+struct WifiConnectRequested
+{
+    static constexpr EventId ID = EventId::WifiConnectRequested;
+};
+
+/**
+ * @brief One API request served, for per-power-save-policy latency
+ *
+ * Published by HTTPServer, accounted by WifiConnection.
+ */
+struct HttpRequestServed
+{
+    static constexpr EventId ID = EventId::HttpRequestServed;
+    uint32_t us; ///< Request read to response sent
+};
+
+/**
+ * @brief Probe key of an event type ("wifiState", ...)
+ */
+inline const char *eventName(EventId id)
+{
+    switch (id)
+    {
+    case EventId::WifiStateChanged:
+        return "wifiState";
+    case EventId::WifiConnectRequested:
+        return "wifiConnect";
+    case EventId::HttpRequestServed:
+        return "httpRequest";
+    default:
+        return "unknown";
+    }
+}
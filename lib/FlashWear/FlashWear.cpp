@@ -0,0 +1,293 @@
+#include "FlashWear.hpp"
+
+#if FEATURE_FLASH_WEAR
+
+#include <Preferences.h>
+#include <LittleFS.h>
+#include <esp_partition.h>
+#include "ProbeRegistry.hpp"
+#include "Supervisor.hpp"
+
+namespace
+{
+    const uint32_t TOTALS_MAGIC = 0x46574541; // "FWEA"
+    const uint32_t SHADOW_MAGIC = 0x46575348; // "FWSH"
+    const size_t NVS_ENTRY = 32;              ///< NVS entry size
+    const size_t NVS_PAGE = 4096;             ///< NVS page (= flash sector)
+    const size_t FS_PROG = 16;                ///< LittleFS program unit on ESP32
+    const size_t FS_BLOCK = 4096;             ///< LittleFS block (= flash sector)
+
+    const char *mediumName(FlashMedium m)
+    {
+        return m == FlashMedium::Nvs ? "nvs" : "littlefs";
+    }
+
+    size_t partitionSize(esp_partition_subtype_t subtype, const char *label)
+    {
+        const esp_partition_t *p = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, subtype, label);
+        return p ? p->size : 0;
+    }
+}
+
+RTC_NOINIT_ATTR FlashWear::Totals FlashWear::shadow_;
+
+/**
+ * @brief Register the "flash" probe; counters are loaded on first use
+ */
+FlashWear::FlashWear()
+{
+    ProbeRegistry::instance().registerProbe("flash", [this](JsonObject &dst)
+                                            { this->toJson(dst); });
+    // A hung flash write has no targeted fix: restart
+    Supervisor::instance().configure(::Subsystem::Storage, SUPERVISOR_PERIOD_MS);
+}
+
+/**
+ * @brief Soft limit check; critical writes always pass
+ */
+bool FlashWear::allowWrite(const char *subsystem, bool critical)
+{
+    if (critical)
+        return true;
+    float days = projectedDays();
+    if (days < 0 || days >= float(FLASH_WEAR_TARGET_DAYS))
+        return true;
+
+    Subsystem *s = find(subsystem);
+    uint32_t now = millis();
+    if (s != nullptr && s->everAllowed && now - s->lastAllowedMs < FLASH_WEAR_THROTTLE_MS)
+    {
+        s->throttled++;
+        return false;
+    }
+    if (s != nullptr)
+    {
+        s->everAllowed = true;
+        s->lastAllowedMs = now;
+    }
+    return true;
+}
+
+/**
+ * @brief Entries used: one for scalars, header + ceil(len / 32) for strings/blobs
+ */
+void FlashWear::noteNvsWrite(const char *subsystem, size_t logical, bool variable, bool unchanged)
+{
+    if (unchanged)
+    {
+        Subsystem *s = find(subsystem);
+        if (s != nullptr)
+            s->unchanged++;
+        account(subsystem, FlashMedium::Nvs, logical, 0);
+        return;
+    }
+    size_t entries = variable ? 1 + (logical + NVS_ENTRY - 1) / NVS_ENTRY : 1;
+    account(subsystem, FlashMedium::Nvs, logical, entries * NVS_ENTRY);
+}
+
+/**
+ * @brief Program-unit rounding plus a metadata commit per sync
+ */
+void FlashWear::noteFsWrite(const char *subsystem, size_t logical, bool synced)
+{
+    size_t physical = (logical + FS_PROG - 1) / FS_PROG * FS_PROG;
+    if (synced)
+        physical += 2 * FS_PROG; // metadata pair commit, compacted (erased) per block fill
+    account(subsystem, FlashMedium::LittleFs, logical, physical);
+}
+
+/**
+ * @brief Save the cumulative counters every FLASH_WEAR_PERSIST_MS
+ */
+void FlashWear::poll()
+{
+    Supervisor::instance().beat(::Subsystem::Storage);
+    if (!loaded_)
+        load();
+    if (millis() - persistedAtMs_ >= FLASH_WEAR_PERSIST_MS)
+        save();
+}
+
+/**
+ * @brief Export totals, estimates, projection and per-subsystem counters
+ */
+void FlashWear::toJson(JsonObject &root)
+{
+    if (!loaded_)
+        load();
+
+    float days = projectedDays();
+    JsonObject soft = root["soft"].to<JsonObject>();
+    soft["targetDays"] = FLASH_WEAR_TARGET_DAYS;
+    soft["projectedDays"] = days < 0 ? 0.0f : days;
+    soft["throttling"] = days >= 0 && days < float(FLASH_WEAR_TARGET_DAYS);
+    root["observedS"] = observedS();
+
+    for (size_t i = 0; i < size_t(FlashMedium::Count); ++i)
+    {
+        FlashMedium m = FlashMedium(i);
+        JsonObject o = root[mediumName(m)].to<JsonObject>();
+        o["logical"] = totals_.logical[i];
+        o["physical"] = totals_.physical[i];
+        o["writeAmp"] = totals_.logical[i] ? float(totals_.physical[i]) / float(totals_.logical[i]) : 0.0f;
+        o["levelBytes"] = mediumBytes(m);
+        o["erasesPerSector"] = cycles(m);
+        float d = lifetimeDays(m);
+        if (d >= 0)
+            o["lifetimeDays"] = d;
+    }
+
+    JsonObject subs = root["subsystems"].to<JsonObject>();
+    for (const Subsystem &s : subsystems_)
+    {
+        if (s.name == nullptr)
+            break;
+        JsonObject o = subs[s.name].to<JsonObject>();
+        o["writes"] = s.writes;
+        o["logical"] = s.logical;
+        o["physical"] = s.physical;
+        o["unchanged"] = s.unchanged;
+        o["throttled"] = s.throttled;
+    }
+}
+
+/**
+ * @brief Smallest projection over the media that have been written
+ */
+float FlashWear::projectedDays()
+{
+    float best = -1;
+    for (size_t i = 0; i < size_t(FlashMedium::Count); ++i)
+    {
+        float d = lifetimeDays(FlashMedium(i));
+        if (d >= 0 && (best < 0 || d < best))
+            best = d;
+    }
+    return best;
+}
+
+/**
+ * @brief Find a subsystem by name, adding it on first use
+ */
+FlashWear::Subsystem *FlashWear::find(const char *name)
+{
+    for (Subsystem &s : subsystems_)
+    {
+        if (s.name == nullptr)
+        {
+            s.name = name;
+            return &s;
+        }
+        if (strcmp(s.name, name) == 0)
+            return &s;
+    }
+    return nullptr;
+}
+
+void FlashWear::account(const char *subsystem, FlashMedium medium, size_t logical, size_t physical)
+{
+    if (!loaded_)
+        load();
+    totals_.logical[size_t(medium)] += logical;
+    totals_.physical[size_t(medium)] += physical;
+    // A panic or watchdog reset gives no chance to save(): load() picks this up
+    shadow_ = totals_;
+    shadow_.magic = SHADOW_MAGIC;
+    shadow_.observedS = observedS();
+    Subsystem *s = find(subsystem);
+    if (s == nullptr)
+        return;
+    s->writes++;
+    s->logical += logical;
+    s->physical += physical;
+}
+
+void FlashWear::load()
+{
+    loaded_ = true;
+    Preferences prefs;
+    if (prefs.begin("flashwear", true))
+    {
+        Totals t;
+        if (prefs.getBytes("totals", &t, sizeof(t)) == sizeof(t) && t.magic == TOTALS_MAGIC)
+            totals_ = t;
+        prefs.end();
+    }
+    persistedAtMs_ = millis();
+    if (shadow_.magic == SHADOW_MAGIC && shadow_.observedS > totals_.observedS)
+    {
+        // The last run ended without a save: keep its counters, persist on the next poll()
+        totals_ = shadow_;
+        persistedAtMs_ -= FLASH_WEAR_PERSIST_MS;
+    }
+    totals_.magic = TOTALS_MAGIC;
+    observedBaseS_ = totals_.observedS;
+}
+
+/**
+ * @brief Store the totals; accounted as a critical write of its own
+ */
+void FlashWear::save()
+{
+    SUPERVISED_STAGE(::Subsystem::Storage, "wear.save", 5000);
+    persistedAtMs_ = millis();
+    totals_.observedS = observedS();
+    Preferences prefs;
+    if (!prefs.begin("flashwear", false))
+        return;
+    size_t n = prefs.putBytes("totals", &totals_, sizeof(totals_));
+    prefs.end();
+    if (n)
+        noteNvsWrite("flashwear", n, true, false);
+}
+
+/**
+ * @brief Awake time covered by the counters (deep sleep excluded, which keeps
+ * the projection on the safe side)
+ */
+uint64_t FlashWear::observedS() const
+{
+    return observedBaseS_ + millis() / 1000;
+}
+
+/**
+ * @brief Bytes the wear-levelling spreads writes over
+ *
+ * NVS rotates through all pages but one spare. LittleFS only relocates
+ * blocks it writes, so the free space is the levelling pool.
+ */
+size_t FlashWear::mediumBytes(FlashMedium m)
+{
+    if (m == FlashMedium::Nvs)
+    {
+        size_t size = partitionSize(ESP_PARTITION_SUBTYPE_DATA_NVS, nullptr);
+        return size > NVS_PAGE ? size - NVS_PAGE : size;
+    }
+    size_t total = LittleFS.totalBytes();
+    if (total == 0) // not mounted: assume empty
+        return partitionSize(ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "littlefs");
+    size_t used = LittleFS.usedBytes();
+    return total > used ? total - used + FS_BLOCK : FS_BLOCK;
+}
+
+float FlashWear::cycles(FlashMedium m)
+{
+    size_t bytes = mediumBytes(m);
+    return bytes ? float(totals_.physical[size_t(m)]) / float(bytes) : 0.0f;
+}
+
+/**
+ * @brief Remaining endurance divided by the observed cycle rate
+ */
+float FlashWear::lifetimeDays(FlashMedium m)
+{
+    uint64_t seconds = observedS();
+    float used = cycles(m);
+    if (seconds < FLASH_WEAR_MIN_PROJECT_S || used <= 0)
+        return -1;
+    float perDay = used * 86400.0f / float(seconds);
+    float left = float(FLASH_ENDURANCE_CYCLES) - used;
+    return left > 0 ? left / perDay : 0.0f;
+}
+
+#endif // FEATURE_FLASH_WEAR
@@ -0,0 +1,231 @@
+/**
+ * @file FlashWear.hpp
+ * @brief Flash write accounting, erase estimation and lifetime projection
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "Features.hpp"
+
+// ====== Tuning ======
+/**
+ * @def FLASH_WEAR_MAX_SUBSYSTEMS
+ * @brief Maximum number of distinct writers tracked (GSettings, bench, ...)
+ */
+#ifndef FLASH_WEAR_MAX_SUBSYSTEMS
+#define FLASH_WEAR_MAX_SUBSYSTEMS 8
+#endif
+
+/**
+ * @def FLASH_ENDURANCE_CYCLES
+ * @brief Rated program/erase cycles per sector of the SPI flash
+ */
+#ifndef FLASH_ENDURANCE_CYCLES
+#define FLASH_ENDURANCE_CYCLES 100000UL
+#endif
+
+/**
+ * @def FLASH_WEAR_TARGET_DAYS
+ * @brief Soft limit: below this projected lifetime non-critical writes are throttled
+ */
+#ifndef FLASH_WEAR_TARGET_DAYS
+#define FLASH_WEAR_TARGET_DAYS 3650UL
+#endif
+
+/**
+ * @def FLASH_WEAR_THROTTLE_MS
+ * @brief Minimum spacing between non-critical writes of one subsystem while throttled
+ */
+#ifndef FLASH_WEAR_THROTTLE_MS
+#define FLASH_WEAR_THROTTLE_MS (10 * 60 * 1000UL)
+#endif
+
+/**
+ * @def FLASH_WEAR_MIN_PROJECT_S
+ * @brief Observation time required before a lifetime is projected (and throttling starts)
+ */
+#ifndef FLASH_WEAR_MIN_PROJECT_S
+#define FLASH_WEAR_MIN_PROJECT_S 3600UL
+#endif
+
+/**
+ * @def FLASH_WEAR_PERSIST_MS
+ * @brief Interval between saves of the cumulative counters to NVS
+ */
+#ifndef FLASH_WEAR_PERSIST_MS
+#define FLASH_WEAR_PERSIST_MS (6 * 3600 * 1000UL)
+#endif
+
+/**
+ * @brief Flash region a write lands in
+ */
+enum class FlashMedium : uint8_t
+{
+    Nvs = 0,  ///< "nvs" partition (Preferences)
+    LittleFs, ///< "littlefs" partition
+    Count
+};
+
+#if FEATURE_FLASH_WEAR
+
+/**
+ * @brief Accounts every flash write and projects the device lifetime
+ *
+ * Writers report logical bytes (what they asked to store) and the layer
+ * estimates physical bytes from the storage format:
+ * - NVS: 32 byte entries; strings/blobs take one header entry plus one entry
+ *   per 32 data bytes; rewriting an unchanged value costs nothing (NVS
+ *   compares before writing)
+ * - LittleFS: data rounded up to the 16 byte program unit; every sync also
+ *   appends a commit to the file's metadata pair (estimated as two program
+ *   units)
+ *
+ * Erase cycles per sector are physical bytes divided by the space the
+ * wear-levelling spreads them over: all NVS pages but the spare one, and the
+ * free LittleFS blocks (static data is not moved by LittleFS). Write
+ * amplification is physical / logical bytes.
+ *
+ * The cycle rate over the observed awake time (persisted across boots; deep
+ * sleep is not counted, which errs on the safe side) gives a projected
+ * lifetime per medium. Once it drops below FLASH_WEAR_TARGET_DAYS,
+ * non-critical writes are throttled to one per subsystem every
+ * FLASH_WEAR_THROTTLE_MS; callers must skip the write when allowWrite() says
+ * no.
+ *
+ * Registers the "flash" probe.
+ */
+class FlashWear
+{
+public:
+    /**
+     * @brief Singleton accessor (same pattern as ProbeRegistry)
+     */
+    static FlashWear &instance()
+    {
+        static FlashWear inst;
+        return inst;
+    }
+
+    /**
+     * @brief Ask whether a write may go ahead under the soft limit
+     *
+     * @param subsystem Writer name (string literal, e.g. "settings")
+     * @param critical Critical writes (configuration, delivery state) are never throttled
+     * @retval true Write allowed
+     * @retval false Soft limit reached: skip this write
+     */
+    bool allowWrite(const char *subsystem, bool critical);
+
+    /**
+     * @brief Record an NVS write
+     *
+     * @param subsystem Writer name (string literal)
+     * @param logical Bytes the caller asked to store (key excluded)
+     * @param variable true for strings/blobs (header + data entries), false for scalars
+     * @param unchanged true if the stored value was already identical (no flash write)
+     */
+    void noteNvsWrite(const char *subsystem, size_t logical, bool variable, bool unchanged);
+
+    /**
+     * @brief Record a LittleFS write
+     *
+     * @param subsystem Writer name (string literal)
+     * @param logical Bytes written
+     * @param synced true if the file was flushed/closed after the write
+     */
+    void noteFsWrite(const char *subsystem, size_t logical, bool synced);
+
+    /**
+     * @brief Persist cumulative counters periodically (call from loop())
+     */
+    void poll();
+
+    /**
+     * @brief Persist the cumulative counters now
+     *
+     * Call before deep sleep and before any deliberate restart; poll() only
+     * saves every FLASH_WEAR_PERSIST_MS of awake time.
+     */
+    void save();
+
+    /**
+     * @brief Write the accounting: {"soft":{...},"nvs":{...},"littlefs":{...},
+     * "subsystems":{"<name>":{"writes","logical","physical","unchanged","throttled"}}}
+     */
+    void toJson(JsonObject &root);
+
+    /**
+     * @brief Projected days until the most worn medium reaches its endurance
+     *
+     * @return float Days, or a negative value while not enough has been observed
+     */
+    float projectedDays();
+
+private:
+    struct Subsystem
+    {
+        const char *name = nullptr;
+        uint32_t writes = 0;
+        uint32_t unchanged = 0;
+        uint32_t throttled = 0;
+        uint64_t logical = 0;
+        uint64_t physical = 0;
+        uint32_t lastAllowedMs = 0;
+        bool everAllowed = false;
+    };
+
+    /**
+     * @brief Cumulative counters persisted in NVS ("flashwear"/"totals")
+     */
+    struct Totals
+    {
+        uint32_t magic;
+        uint64_t logical[size_t(FlashMedium::Count)];
+        uint64_t physical[size_t(FlashMedium::Count)];
+        uint64_t observedS; ///< Awake seconds covered by the counters
+    };
+
+    Subsystem subsystems_[FLASH_WEAR_MAX_SUBSYSTEMS];
+    Totals totals_ = {};
+    static Totals shadow_;       ///< Copy of totals_ in RTC memory, kept through panics and resets
+    uint32_t persistedAtMs_ = 0;
+    uint64_t observedBaseS_ = 0; ///< totals_.observedS at boot
+    bool loaded_ = false;
+
+    Subsystem *find(const char *name);
+    void account(const char *subsystem, FlashMedium medium, size_t logical, size_t physical);
+    void load();
+    uint64_t observedS() const;
+    size_t mediumBytes(FlashMedium m);
+    float cycles(FlashMedium m);
+    float lifetimeDays(FlashMedium m);
+
+    FlashWear();
+    FlashWear(const FlashWear &) = delete;
+    FlashWear &operator=(const FlashWear &) = delete;
+};
+
+#else // !FEATURE_FLASH_WEAR
+
+/**
+ * @brief Stand-in when flash wear accounting is compiled out: every write is allowed
+ */
+class FlashWear
+{
+public:
+    static FlashWear &instance()
+    {
+        static FlashWear inst;
+        return inst;
+    }
+
+    bool allowWrite(const char *, bool) { return true; }
+    void noteNvsWrite(const char *, size_t, bool, bool) {}
+    void noteFsWrite(const char *, size_t, bool) {}
+    void poll() {}
+    void save() {}
+};
+
+#endif // FEATURE_FLASH_WEAR
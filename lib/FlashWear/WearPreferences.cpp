@@ -0,0 +1,83 @@
+#include "WearPreferences.hpp"
+
+/**
+ * @brief Largest blob compared against the stored copy before writing
+ */
+static const size_t COMPARE_MAX = 256;
+
+size_t WearPreferences::note(size_t written, bool variable, bool unchanged)
+{
+    if (written)
+        FlashWear::instance().noteNvsWrite(subsystem, written, variable, unchanged);
+    return written;
+}
+
+size_t WearPreferences::putBool(const char *key, bool value)
+{
+    if (!FlashWear::instance().allowWrite(subsystem, critical))
+        return 0;
+    bool same = isKey(key) && getBool(key, !value) == value;
+    return note(Preferences::putBool(key, value), false, same);
+}
+
+size_t WearPreferences::putUChar(const char *key, uint8_t value)
+{
+    if (!FlashWear::instance().allowWrite(subsystem, critical))
+        return 0;
+    bool same = isKey(key) && getUChar(key, uint8_t(~value)) == value;
+    return note(Preferences::putUChar(key, value), false, same);
+}
+
+size_t WearPreferences::putInt(const char *key, int32_t value)
+{
+    if (!FlashWear::instance().allowWrite(subsystem, critical))
+        return 0;
+    bool same = isKey(key) && getInt(key, ~value) == value;
+    return note(Preferences::putInt(key, value), false, same);
+}
+
+size_t WearPreferences::putUInt(const char *key, uint32_t value)
+{
+    if (!FlashWear::instance().allowWrite(subsystem, critical))
+        return 0;
+    bool same = isKey(key) && getUInt(key, ~value) == value;
+    return note(Preferences::putUInt(key, value), false, same);
+}
+
+size_t WearPreferences::putULong64(const char *key, uint64_t value)
+{
+    if (!FlashWear::instance().allowWrite(subsystem, critical))
+        return 0;
+    bool same = isKey(key) && getULong64(key, ~value) == value;
+    return note(Preferences::putULong64(key, value), false, same);
+}
+
+size_t WearPreferences::putString(const char *key, const char *value)
+{
+    if (!FlashWear::instance().allowWrite(subsystem, critical))
+        return 0;
+    bool same = isKey(key) && getString(key) == value;
+    size_t n = Preferences::putString(key, value);
+    return note(n ? n + 1 : 0, true, same); // NUL is stored too
+}
+
+size_t WearPreferences::putString(const char *key, const String &value)
+{
+    return putString(key, value.c_str());
+}
+
+/**
+ * @brief Blobs up to COMPARE_MAX bytes are compared; larger ones count as changed
+ */
+size_t WearPreferences::putBytes(const char *key, const void *value, size_t len)
+{
+    if (!FlashWear::instance().allowWrite(subsystem, critical))
+        return 0;
+    bool same = false;
+    if (len <= COMPARE_MAX && getBytesLength(key) == len)
+    {
+        uint8_t old[COMPARE_MAX];
+        same = getBytes(key, old, len) == len && memcmp(old, value, len) == 0;
+    }
+    return note(Preferences::putBytes(key, value, len), true, same);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file WearPreferences.hpp
+ * @brief Preferences with flash wear accounting and soft-limit throttling
+ */
+
+#pragma once
+
+#include <Preferences.h>
+#include "FlashWear.hpp"
+
+/**
+ * @brief Drop-in Preferences whose writes are reported to FlashWear
+ *
+ * Each put*() first asks FlashWear::allowWrite() (non-critical writers are
+ * throttled past the soft limit and get 0 back, like a failed write), then
+ * compares with the stored value so that rewrites NVS skips are accounted as
+ * "unchanged" rather than physical writes.
+ *
+ * The put*() methods hide the Preferences ones (they are not virtual), so
+ * the object must be used through this type.
+ */
+class WearPreferences : public Preferences
+{
+public:
+    /**
+     * @brief Construct a new WearPreferences object
+     *
+     * @param subsystem Name reported in the "flash" probe (string literal)
+     * @param critical Critical writers are never throttled
+     */
+    WearPreferences(const char *subsystem, bool critical = true) : subsystem(subsystem), critical(critical) {}
+
+    size_t putBool(const char *key, bool value);
+    size_t putUChar(const char *key, uint8_t value);
+    size_t putInt(const char *key, int32_t value);
+    size_t putUInt(const char *key, uint32_t value);
+    size_t putULong64(const char *key, uint64_t value);
+    size_t putString(const char *key, const char *value);
+    size_t putString(const char *key, const String &value);
+    size_t putBytes(const char *key, const void *value, size_t len);
+
+private:
+    const char *subsystem; ///< Writer name for accounting
+    bool critical;         ///< Exempt from throttling
+
+    /**
+     * @brief Report a completed write to FlashWear
+     *
+     * @return size_t @p written, for chaining
+     */
+    size_t note(size_t written, bool variable, bool unchanged);
+};
@@ -4,6 +4,7 @@
  */
 
 #include "GSettings.hpp"
+#include "ProfileZone.hpp"
 
 /**
  * @brief Static initialization of program start timestamp
@@ -19,10 +20,18 @@ uint64_t GSettings::startTime = millis();
  * Initializes all settings with sensible defaults. The device name
  * defaults to "ESP32-BLE-Example", while WiFi credentials start empty.
  */
-GSettings::GSettings() : deviceName("ESP32-BLE-Example"), ssid(""), password("")
+GSettings::GSettings() : deviceName("ESP32-BLE-Example"), ssid(""), password(""), sleepInterval(0), apMode(ApMode::Off), apPassword(""), wifiPs(WifiPowerSave::Min), listenInterval(3)
 {
     ProbeRegistry::instance().registerProbe("settings", [this](JsonObject &dst)
                                             { this->toJson(dst); });
+    SettingsApi::instance().registerSection(
+        "device",
+        [this](JsonObject &dst, bool secrets)
+        { sectionToJson(dst, secrets); },
+        [this](JsonObjectConst patch, String &error)
+        { return validatePatch(patch, error); },
+        [this](JsonObjectConst patch)
+        { return applyPatch(patch); });
 }
 
 /**
@@ -62,6 +71,8 @@ String GSettings::getSsid()
  */
 void GSettings::setSsid(String ssid)
 {
+    if (ssid != this->ssid)
+        networksRevision++;
     this->ssid = ssid;
 }
 
@@ -82,9 +93,169 @@ String GSettings::getPassword()
  */
 void GSettings::setPassword(String password)
 {
+    if (password != this->password)
+        networksRevision++;
     this->password = password;
 }
 
+/**
+ * @brief Get the deep-sleep wake interval
+ * @return uint32_t Seconds between timer wake-ups (0 = always on)
+ */
+uint32_t GSettings::getSleepInterval()
+{
+    return sleepInterval;
+}
+
+/**
+ * @brief Set the deep-sleep wake interval
+ * @param seconds Seconds between timer wake-ups (0 = never sleep)
+ */
+void GSettings::setSleepInterval(uint32_t seconds)
+{
+    this->sleepInterval = seconds;
+}
+
+/**
+ * @brief Get the SoftAP policy
+ * @return ApMode When the access point is started
+ */
+ApMode GSettings::getApMode()
+{
+    return apMode;
+}
+
+/**
+ * @brief Set the SoftAP policy
+ * @param mode When the access point is started
+ */
+void GSettings::setApMode(ApMode mode)
+{
+    this->apMode = mode;
+}
+
+/**
+ * @brief Get the SoftAP password
+ * @return String WPA2 password (empty = open access point)
+ */
+String GSettings::getApPassword()
+{
+    return apPassword;
+}
+
+/**
+ * @brief Set the SoftAP password
+ * @param password WPA2 password (8..63 characters) or empty
+ */
+void GSettings::setApPassword(String password)
+{
+    this->apPassword = password;
+}
+
+/**
+ * @brief Lowercase AP mode identifiers used in JSON
+ */
+const char *GSettings::apModeName(ApMode mode)
+{
+    switch (mode)
+    {
+    case ApMode::Always:
+        return "always";
+    case ApMode::Off:
+        return "off";
+    default:
+        return "fallback";
+    }
+}
+
+/**
+ * @brief Map an AP mode name back to its value
+ */
+bool GSettings::parseApMode(const char *name, ApMode &out)
+{
+    if (name == nullptr)
+        return false;
+    for (ApMode m : {ApMode::Fallback, ApMode::Always, ApMode::Off})
+    {
+        if (strcmp(name, apModeName(m)) == 0)
+        {
+            out = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Get the station power-save policy
+ * @return WifiPowerSave Configured policy
+ */
+WifiPowerSave GSettings::getWifiPowerSave()
+{
+    return wifiPs;
+}
+
+/**
+ * @brief Set the station power-save policy
+ * @param mode Power-save policy
+ */
+void GSettings::setWifiPowerSave(WifiPowerSave mode)
+{
+    this->wifiPs = mode;
+}
+
+/**
+ * @brief Get the listen interval used by WifiPowerSave::Max
+ * @return uint8_t Interval in beacon periods
+ */
+uint8_t GSettings::getListenInterval()
+{
+    return listenInterval;
+}
+
+/**
+ * @brief Set the listen interval used by WifiPowerSave::Max
+ * @param beacons Interval in beacon periods, clamped to 1..100
+ */
+void GSettings::setListenInterval(uint8_t beacons)
+{
+    this->listenInterval = constrain(beacons, 1, 100);
+}
+
+/**
+ * @brief Lowercase power-save identifiers used in JSON
+ */
+const char *GSettings::powerSaveName(WifiPowerSave mode)
+{
+    switch (mode)
+    {
+    case WifiPowerSave::None:
+        return "none";
+    case WifiPowerSave::Max:
+        return "max";
+    default:
+        return "min";
+    }
+}
+
+/**
+ * @brief Map a power-save name back to its value
+ */
+bool GSettings::parsePowerSave(const char *name, WifiPowerSave &out)
+{
+    if (name == nullptr)
+        return false;
+    for (WifiPowerSave m : {WifiPowerSave::None, WifiPowerSave::Min, WifiPowerSave::Max})
+    {
+        if (strcmp(name, powerSaveName(m)) == 0)
+        {
+            out = m;
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  * @brief Load settings from ESP32 persistent storage
  *
@@ -98,6 +269,20 @@ void GSettings::load()
     deviceName = preferences.getString("deviceName", deviceName);
     ssid = preferences.getString("ssid", ssid);
     password = preferences.getString("password", password);
+    sleepInterval = preferences.getUInt("sleepInterval", sleepInterval);
+    apMode = ApMode(preferences.getUChar("apMode", uint8_t(apMode)));
+    apPassword = preferences.getString("apPassword", apPassword);
+    wifiPs = WifiPowerSave(preferences.getUChar("wifiPs", uint8_t(wifiPs)));
+    listenInterval = preferences.getUChar("listenInt", listenInterval);
+    char key[8];
+    for (uint8_t i = 1; i < WIFI_NETWORKS; ++i)
+    {
+        snprintf(key, sizeof(key), "ssid%u", (unsigned)i);
+        fallbackSsid[i - 1] = preferences.getString(key, "");
+        snprintf(key, sizeof(key), "pass%u", (unsigned)i);
+        fallbackPassword[i - 1] = preferences.getString(key, "");
+    }
+    provisionSerial = preferences.getUInt("provSerial", 0);
     preferences.end();
 }
 
@@ -110,10 +295,25 @@ void GSettings::load()
  */
 void GSettings::save()
 {
+    PROFILE_ZONE("flash.nvs");
     preferences.begin("global-settings", false);
     preferences.putString("deviceName", deviceName);
     preferences.putString("ssid", ssid);
     preferences.putString("password", password);
+    preferences.putUInt("sleepInterval", sleepInterval);
+    preferences.putUChar("apMode", uint8_t(apMode));
+    preferences.putString("apPassword", apPassword);
+    preferences.putUChar("wifiPs", uint8_t(wifiPs));
+    preferences.putUChar("listenInt", listenInterval);
+    char key[8];
+    for (uint8_t i = 1; i < WIFI_NETWORKS; ++i)
+    {
+        snprintf(key, sizeof(key), "ssid%u", (unsigned)i);
+        preferences.putString(key, fallbackSsid[i - 1]);
+        snprintf(key, sizeof(key), "pass%u", (unsigned)i);
+        preferences.putString(key, fallbackPassword[i - 1]);
+    }
+    preferences.putUInt("provSerial", provisionSerial); // last: marks a complete save
     preferences.end();
 }
 
@@ -130,7 +330,14 @@ void GSettings::toJson(JsonObject &root)
 {
     root["deviceName"] = deviceName;
     root["ssid"] = ssid;
-    root["password"] = password.isEmpty() ? "" : password.substring(0, 4) + "****";
+    root["password"] = mask(password);
+    root["sleepInterval"] = sleepInterval;
+    root["apMode"] = apModeName(apMode);
+    root["apPassword"] = mask(apPassword);
+    root["wifiPowerSave"] = powerSaveName(wifiPs);
+    root["listenInterval"] = listenInterval;
+    root["networks"] = getNetworkCount();
+    root["provisionSerial"] = provisionSerial;
 }
 
 /**
@@ -141,4 +348,239 @@ void GSettings::toJson(JsonObject &root)
 uint64_t GSettings::getUptime()
 {
     return (millis() - startTime);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Primary plus the non-empty fallbacks
+ */
+uint8_t GSettings::getNetworkCount()
+{
+    if (ssid.isEmpty())
+        return 0;
+    uint8_t n = 1;
+    for (const String &s : fallbackSsid)
+        if (!s.isEmpty())
+            n++;
+    return n;
+}
+
+/**
+ * @brief Fallbacks are counted in order, skipping cleared slots
+ */
+String GSettings::getNetworkSsid(uint8_t i)
+{
+    if (i == 0)
+        return ssid;
+    for (const String &s : fallbackSsid)
+        if (!s.isEmpty() && --i == 0)
+            return s;
+    return "";
+}
+
+/**
+ * @brief Password matching getNetworkSsid(i)
+ */
+String GSettings::getNetworkPassword(uint8_t i)
+{
+    if (i == 0)
+        return password;
+    for (uint8_t k = 0; k < WIFI_NETWORKS - 1; ++k)
+        if (!fallbackSsid[k].isEmpty() && --i == 0)
+            return fallbackPassword[k];
+    return "";
+}
+
+/**
+ * @brief Slot 0 is the primary network, 1.. the fallback slots
+ */
+void GSettings::setNetwork(uint8_t i, String ssid, String password)
+{
+    if (i == 0)
+    {
+        setSsid(ssid);
+        setPassword(password);
+    }
+    else if (i < WIFI_NETWORKS)
+    {
+        if (ssid.isEmpty())
+            password = "";
+        if (ssid != fallbackSsid[i - 1] || password != fallbackPassword[i - 1])
+            networksRevision++;
+        fallbackSsid[i - 1] = ssid;
+        fallbackPassword[i - 1] = password;
+    }
+}
+
+/**
+ * @brief Serial of the last applied provisioning bundle (0 = never provisioned)
+ */
+uint32_t GSettings::getProvisionSerial()
+{
+    return provisionSerial;
+}
+
+/**
+ * @brief Record the applied bundle serial; persisted by save()
+ */
+void GSettings::setProvisionSerial(uint32_t serial)
+{
+    provisionSerial = serial;
+}
+
+void GSettings::sectionToJson(JsonObject &dst, bool secrets)
+{
+    dst["deviceName"] = deviceName;
+    dst["sleepInterval"] = sleepInterval;
+    dst["apMode"] = apModeName(apMode);
+    dst["apPassword"] = secrets ? apPassword : mask(apPassword);
+    dst["wifiPowerSave"] = powerSaveName(wifiPs);
+    dst["listenInterval"] = listenInterval;
+    JsonArray nets = dst["networks"].to<JsonArray>();
+    for (uint8_t i = 0; i < getNetworkCount(); ++i)
+    {
+        JsonObject n = nets.add<JsonObject>();
+        n["ssid"] = getNetworkSsid(i);
+        String pass = getNetworkPassword(i);
+        n["password"] = secrets ? pass : mask(pass);
+    }
+}
+
+namespace
+{
+    /** @brief Non-null string of length lo..hi */
+    bool stringIn(JsonVariantConst v, size_t lo, size_t hi)
+    {
+        if (!v.is<const char *>())
+            return false;
+        size_t n = strlen(v.as<const char *>());
+        return n >= lo && n <= hi;
+    }
+
+    /** @brief WPA2 passphrase or empty (open) */
+    bool wpaPassword(JsonVariantConst v)
+    {
+        return v.is<const char *>() && (strlen(v.as<const char *>()) == 0 || stringIn(v, AP_PASSWORD_MIN, 63));
+    }
+}
+
+/**
+ * @brief Every key must be known and valid; null clears apPassword only.
+ * A SoftAP mode other than "off" needs an apPassword (patched or stored):
+ * the AP is never open.
+ */
+bool GSettings::validatePatch(JsonObjectConst patch, String &error)
+{
+    ApMode mode = apMode;
+    size_t passLen = apPassword.length();
+    for (JsonPairConst kv : patch)
+    {
+        const char *key = kv.key().c_str();
+        JsonVariantConst v = kv.value();
+        bool ok;
+        if (strcmp(key, "deviceName") == 0)
+            ok = stringIn(v, 1, 32); // also the SoftAP SSID
+        else if (strcmp(key, "sleepInterval") == 0)
+            ok = v.is<uint32_t>() && v.as<uint32_t>() <= 7 * 24 * 3600;
+        else if (strcmp(key, "apMode") == 0)
+            ok = parseApMode(v.as<const char *>(), mode);
+        else if (strcmp(key, "apPassword") == 0)
+        {
+            ok = v.isNull() || wpaPassword(v);
+            passLen = ok && !v.isNull() ? strlen(v.as<const char *>()) : 0;
+        }
+        else if (strcmp(key, "wifiPowerSave") == 0)
+        {
+            WifiPowerSave m;
+            ok = parsePowerSave(v.as<const char *>(), m);
+        }
+        else if (strcmp(key, "listenInterval") == 0)
+            ok = v.is<uint8_t>() && v.as<uint8_t>() >= 1 && v.as<uint8_t>() <= 100;
+        else if (strcmp(key, "networks") == 0)
+        {
+            JsonArrayConst nets = v.as<JsonArrayConst>();
+            ok = v.is<JsonArrayConst>() && nets.size() <= WIFI_NETWORKS;
+            for (JsonVariantConst n : nets)
+            {
+                JsonVariantConst pass = n["password"];
+                ok = ok && n.is<JsonObjectConst>() && stringIn(n["ssid"], 1, 32) && (pass.isNull() || wpaPassword(pass));
+            }
+        }
+        else
+        {
+            error = String(key) + ": unknown setting";
+            return false;
+        }
+        if (!ok)
+        {
+            error = String(key) + ": invalid value";
+            return false;
+        }
+    }
+
+    if (mode != ApMode::Off && passLen < AP_PASSWORD_MIN)
+    {
+        error = String("apMode: needs an apPassword of ") + AP_PASSWORD_MIN + "+ characters";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Networks are replaced as a whole (merge-patch arrays); a network
+ * listed without a password, or with its masked read-back value, keeps the
+ * stored password of the same SSID
+ */
+SettingsEffect GSettings::applyPatch(JsonObjectConst patch)
+{
+    SettingsEffect effect = SettingsEffect::None;
+    for (JsonPairConst kv : patch)
+    {
+        const char *key = kv.key().c_str();
+        JsonVariantConst v = kv.value();
+        if (strcmp(key, "deviceName") == 0)
+        {
+            if (deviceName == v.as<const char *>())
+                continue;
+            setDeviceName(v.as<String>());
+            effect = SettingsEffect::Restart;
+            continue;
+        }
+        if (strcmp(key, "sleepInterval") == 0)
+            setSleepInterval(v.as<uint32_t>());
+        else if (strcmp(key, "apMode") == 0)
+            parseApMode(v.as<const char *>(), apMode);
+        else if (strcmp(key, "apPassword") == 0)
+            setApPassword(v.isNull() ? String("") : v.as<String>());
+        else if (strcmp(key, "wifiPowerSave") == 0)
+            parsePowerSave(v.as<const char *>(), wifiPs);
+        else if (strcmp(key, "listenInterval") == 0)
+            setListenInterval(v.as<uint8_t>());
+        else if (strcmp(key, "networks") == 0)
+        {
+            String oldSsid[WIFI_NETWORKS], oldPass[WIFI_NETWORKS];
+            uint8_t oldCount = getNetworkCount();
+            for (uint8_t i = 0; i < oldCount; ++i)
+            {
+                oldSsid[i] = getNetworkSsid(i);
+                oldPass[i] = getNetworkPassword(i);
+            }
+            uint8_t i = 0;
+            for (JsonVariantConst n : v.as<JsonArrayConst>())
+            {
+                String ssid = n["ssid"].as<String>();
+                String pass = n["password"].isNull() ? String("") : n["password"].as<String>();
+                for (uint8_t k = 0; k < oldCount; ++k)
+                    if (oldSsid[k] == ssid && (n["password"].isNull() || pass == mask(oldPass[k])))
+                        pass = oldPass[k];
+                setNetwork(i++, ssid, pass);
+            }
+            for (; i < WIFI_NETWORKS; ++i)
+                setNetwork(i, "", "");
+        }
+        if (effect == SettingsEffect::None)
+            effect = SettingsEffect::Live;
+    }
+    if (effect != SettingsEffect::None)
+        save();
+    return effect;
+}
@@ -1,12 +1,50 @@
 #pragma once
 
-#include <Preferences.h>
+#include "WearPreferences.hpp"
 #include <ArduinoJson.h>
 #include "ProbeRegistry.hpp"
+#include "SettingsApi.hpp"
 
 #define SECOND 1000l  // 1 second
 #define MINUTE 60000l // 1 minute
 
+// ====== Tuning ======
+/**
+ * @def WIFI_NETWORKS
+ * @brief Stored WiFi networks, primary included (the others are fallbacks)
+ */
+#ifndef WIFI_NETWORKS
+#define WIFI_NETWORKS 3
+#endif
+
+/**
+ * @brief When the device runs its own access point (SoftAP)
+ */
+enum class ApMode : uint8_t
+{
+    Fallback = 0, ///< Only while the station link is down
+    Always = 1,   ///< Alongside the station link at all times
+    Off = 2,      ///< Never (default)
+};
+
+/**
+ * @def AP_PASSWORD_MIN
+ * @brief Shortest apPassword (WPA2); without one the SoftAP never starts
+ */
+#ifndef AP_PASSWORD_MIN
+#define AP_PASSWORD_MIN 8
+#endif
+
+/**
+ * @brief Station power-save policy (maps to wifi_ps_type_t)
+ */
+enum class WifiPowerSave : uint8_t
+{
+    None = 0, ///< Radio always on: lowest request latency
+    Min = 1,  ///< Modem sleep, wake every DTIM (ESP32 default)
+    Max = 2,  ///< Modem sleep, wake every listen interval: lowest power
+};
+
 /**
  * @brief Global settings manager class
  *
@@ -17,7 +55,11 @@
  * Features:
  * - Persistent storage using ESP32 NVS (Non-Volatile Storage)
  * - WiFi credential management with security considerations
+ * - Fallback WiFi networks (WIFI_NETWORKS in total)
  * - Device name configuration for BLE advertising
+ * - Deep-sleep duty cycle interval
+ * - SoftAP policy and password
+ * - WiFi power-save policy and listen interval
  * - JSON serialization for API/BLE communication
  * - Automatic loading of stored settings on initialization
  * - Thread-safe settings persistence
@@ -87,6 +129,150 @@ public:
      */
     void setPassword(String password);
 
+    /**
+     * @brief Get the deep-sleep wake interval
+     *
+     * @return uint32_t Seconds between timer wake-ups; 0 keeps the device always on
+     */
+    uint32_t getSleepInterval();
+
+    /**
+     * @brief Set the deep-sleep wake interval
+     *
+     * Takes effect the next time the device decides whether to sleep.
+     * Call save() to persist the change to non-volatile storage.
+     *
+     * @param seconds Seconds between timer wake-ups (0 = never sleep)
+     */
+    void setSleepInterval(uint32_t seconds);
+
+    /**
+     * @brief Get the SoftAP policy
+     * @return ApMode When the access point is started
+     */
+    ApMode getApMode();
+
+    /**
+     * @brief Set the SoftAP policy
+     *
+     * Applied by WifiConnection::poll(). Call save() to persist the change.
+     *
+     * @param mode When the access point is started
+     */
+    void setApMode(ApMode mode);
+
+    /**
+     * @brief Get the SoftAP password
+     * @return String WPA2 password; empty means an open access point
+     */
+    String getApPassword();
+
+    /**
+     * @brief Set the SoftAP password
+     *
+     * Used the next time the access point starts. Call save() to persist.
+     *
+     * @param password WPA2 password (8..63 characters); empty keeps the SoftAP off
+     */
+    void setApPassword(String password);
+
+    /** @return Stable lowercase name of an AP mode ("fallback", "always", "off") */
+    static const char *apModeName(ApMode mode);
+
+    /**
+     * @brief Parse an AP mode name
+     *
+     * @param name "fallback", "always" or "off"
+     * @param out Parsed mode
+     * @retval true Name recognised
+     */
+    static bool parseApMode(const char *name, ApMode &out);
+
+    /**
+     * @brief Get the station power-save policy
+     * @return WifiPowerSave Configured policy
+     */
+    WifiPowerSave getWifiPowerSave();
+
+    /**
+     * @brief Set the station power-save policy
+     *
+     * Applied at runtime by WifiConnection::poll(). Call save() to persist.
+     *
+     * @param mode Power-save policy
+     */
+    void setWifiPowerSave(WifiPowerSave mode);
+
+    /**
+     * @brief Get the listen interval used by WifiPowerSave::Max
+     * @return uint8_t Interval in beacon periods
+     */
+    uint8_t getListenInterval();
+
+    /**
+     * @brief Set the listen interval used by WifiPowerSave::Max
+     *
+     * Sent to the access point on association, so it takes effect on the
+     * next (re)connect. Call save() to persist.
+     *
+     * @param beacons Interval in beacon periods (1..100)
+     */
+    void setListenInterval(uint8_t beacons);
+
+    /** @return Stable lowercase name of a power-save policy ("none", "min", "max") */
+    static const char *powerSaveName(WifiPowerSave mode);
+
+    /**
+     * @brief Parse a power-save policy name
+     *
+     * @param name "none", "min" or "max"
+     * @param out Parsed policy
+     * @retval true Name recognised
+     */
+    static bool parsePowerSave(const char *name, WifiPowerSave &out);
+
+    /**
+     * @brief Number of configured networks (primary first, 0 when no SSID)
+     */
+    uint8_t getNetworkCount();
+
+    /**
+     * @brief SSID of network @p i (0 = primary, same as getSsid())
+     */
+    String getNetworkSsid(uint8_t i);
+
+    /**
+     * @brief Password of network @p i (0 = primary, same as getPassword())
+     */
+    String getNetworkPassword(uint8_t i);
+
+    /**
+     * @brief Set network @p i; an empty SSID clears it
+     *
+     * Call save() to persist the change.
+     *
+     * @param i 0..WIFI_NETWORKS-1
+     */
+    void setNetwork(uint8_t i, String ssid, String password);
+
+    /**
+     * @brief Serial of the provisioning bundle these settings came from
+     *
+     * Saved last by save(), so a serial behind the stored bundle means an
+     * apply was interrupted (see Provisioner::begin()).
+     */
+    uint32_t getProvisionSerial();
+
+    /**
+     * @brief Counter bumped whenever an SSID or WiFi password changes
+     *
+     * Lets WifiConnection notice new credentials from any path (BLE, HTTP,
+     * provisioning) and reassociate. Not persisted.
+     */
+    uint32_t getNetworksRevision() { return networksRevision; }
+
+    void setProvisionSerial(uint32_t serial);
+
     /**
      * @brief Load settings from persistent storage
      *
@@ -116,7 +302,14 @@ public:
      * {
      *   "deviceName": "ESP32-Device",
      *   "ssid": "WiFi-Network",
-     *   "password": "pass****"
+     *   "password": "pass****",
+     *   "sleepInterval": 0,
+     *   "apMode": "fallback",
+     *   "apPassword": "pass****",
+     *   "wifiPowerSave": "min",
+     *   "listenInterval": 3,
+     *   "networks": 1,
+     *   "provisionSerial": 0
      * }
      *
      * @param root JSON object to populate with settings data
@@ -137,7 +330,16 @@ private:
     String deviceName;       ///< Device name for BLE advertising and identification
     String ssid;             ///< WiFi network SSID for connection attempts
     String password;         ///< WiFi network password for authentication
-    Preferences preferences; ///< ESP32 NVS storage interface for settings persistence
+    uint32_t sleepInterval;  ///< Deep-sleep timer wake interval in seconds (0 = always on)
+    ApMode apMode;           ///< SoftAP policy
+    WifiPowerSave wifiPs;    ///< Station power-save policy
+    uint8_t listenInterval;  ///< Beacon periods between wakes in WifiPowerSave::Max
+    String apPassword;       ///< SoftAP WPA2 password (empty = no SoftAP)
+    String fallbackSsid[WIFI_NETWORKS - 1];     ///< Networks tried after the primary
+    String fallbackPassword[WIFI_NETWORKS - 1]; ///< Their passwords
+    uint32_t provisionSerial = 0;               ///< Bundle serial last applied
+    uint32_t networksRevision = 0;              ///< Bumped on SSID/password changes
+    WearPreferences preferences{"settings"}; ///< ESP32 NVS storage interface for settings persistence (wear accounted)
 
     /**
      * @brief Static timestamp marking when the program started
@@ -146,4 +348,29 @@ private:
      * Initialized once during the first GSettings object construction.
      */
     static uint64_t startTime;
+
+    /**
+     * @brief Write the "device" section of GET /settings
+     *
+     * Same fields as the BLE JSON, with the networks as a list:
+     * {"deviceName","sleepInterval","apMode","apPassword","wifiPowerSave",
+     * "listenInterval","networks":[{"ssid","password"}]}
+     */
+    void sectionToJson(JsonObject &dst, bool secrets);
+
+    /**
+     * @brief Check a "device" merge-patch without changing anything
+     */
+    bool validatePatch(JsonObjectConst patch, String &error);
+
+    /**
+     * @brief Commit a validated "device" patch and save()
+     *
+     * Everything but the device name (BLE name, SoftAP SSID, hostname) is
+     * picked up live by its owner.
+     */
+    SettingsEffect applyPatch(JsonObjectConst patch);
+
+    /** @brief Mask a secret for read-back: first 4 characters then "****" */
+    static String mask(const String &secret) { return secret.isEmpty() ? String("") : secret.substring(0, 4) + "****"; }
 };
\ No newline at end of file
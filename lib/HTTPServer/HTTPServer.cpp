@@ -1,25 +1,57 @@
 #include "HTTPServer.hpp"
+#include "ProfileZone.hpp"
+#include "RemoteLog.hpp"
 
 /**
  * @brief Construct a new HTTPServer object
  *
  * Initializes the HTTP server with the specified port and sets up route handlers.
- * The server will handle GET requests to root ("/") and POST requests to "/send".
+ * The server will handle GET requests to root ("/"), POST requests to "/send",
+ * job traces ("/jobs/{id}/trace"), the probe export ("/metrics"), the
+ * settings document ("/settings"), history queries ("/history", with
+ * FEATURE_HISTORY) and the alarm rule set ("/rules", with FEATURE_RULES).
  * Also sets up CORS preflight handling for OPTIONS requests.
  *
- * @param settings Reference to global settings for configuration access
- * @param wifiConnection Reference to WiFi connection manager
+ * @param jobs Job pool that request bodies are decoded into
  * @param sendSMSFunc Function pointer for SMS sending capability
+ * @param scheduleFunc Function queueing jobs that carry a send window
  * @param checkModemRegisteredFunc Function pointer to check modem network status
  * @param port HTTP server port (default 80)
  */
-HTTPServer::HTTPServer(GSettings &settings, WifiConnection &wifiConnection, SMSFunction sendSMSFunc, CheckModemRegisteredFunction checkModemRegisteredFunc, int port, int ledPin) : settings(settings), wifiConnection(wifiConnection), sendSMS(sendSMSFunc), checkModemRegistered(checkModemRegisteredFunc), led(ledPin)
+HTTPServer::HTTPServer(JobQueue &jobs, SMSFunction sendSMSFunc, ScheduleFunction scheduleFunc, CheckModemRegisteredFunction checkModemRegisteredFunc, int port, int ledPin) : jobs(jobs), sendSMS(sendSMSFunc), scheduleSMS(scheduleFunc), checkModemRegistered(checkModemRegisteredFunc), led(ledPin)
 {
     server = new WebServer(port);
 
-    server->on("/", HTTP_GET, std::bind(&HTTPServer::handleRoot, this));
-    server->on("/send", HTTP_POST, std::bind(&HTTPServer::handleSend, this));
-    server->on("/send", HTTP_OPTIONS, std::bind(&HTTPServer::handleOptions, this));
+    server->on("/", HTTP_GET, timed(&HTTPServer::handleRoot));
+    server->on("/send", HTTP_POST, std::bind(&HTTPServer::handleSend, this)); // waits for the modem: not timed
+    server->on("/send", HTTP_OPTIONS, timed(&HTTPServer::handleOptions));
+    server->on(UriBraces("/jobs/{}/trace"), HTTP_GET, timed(&HTTPServer::handleJobTrace));
+    server->on("/metrics", HTTP_GET, timed(&HTTPServer::handleMetrics));
+    server->on("/settings", HTTP_GET, timed(&HTTPServer::handleSettings));
+    server->on("/settings", HTTP_PATCH, timed(&HTTPServer::handleSettings));
+    server->on("/settings", HTTP_OPTIONS, timed(&HTTPServer::handleOptions));
+#if FEATURE_HISTORY
+    server->on("/history", HTTP_GET, std::bind(&HTTPServer::handleHistory, this)); // flash reads: not timed
+#endif
+#if FEATURE_RULES
+    server->on("/rules", HTTP_GET, timed(&HTTPServer::handleRules));
+    server->on("/rules", HTTP_PUT, std::bind(&HTTPServer::handleRules, this)); // compiles and writes flash: not timed
+    server->on("/rules", HTTP_OPTIONS, timed(&HTTPServer::handleOptions));
+#endif
+#if FEATURE_PROFILER
+    server->on("/debug/profile", HTTP_GET, std::bind(&HTTPServer::handleProfile, this));
+#endif
+#if FEATURE_BENCH
+    server->on("/debug/bench", HTTP_POST, std::bind(&HTTPServer::handleBench, this));
+#endif
+    server->onNotFound(std::bind(&HTTPServer::handleNotFound, this));
+
+    // Authorization is always collected
+    static const char *headers[] = {"If-Match"};
+    server->collectHeaders(headers, 1);
+
+    inbox.on<WifiStateChanged>([this](const WifiStateChanged &e)
+                               { apActive = e.apActive; });
 
     server->begin();
     Serial.println("HTTP server started");
@@ -37,9 +69,35 @@ HTTPServer::~HTTPServer()
     delete server;
 }
 
+/**
+ * @brief Serve pending requests and publish API request latency (HttpRequestServed)
+ *
+ * The measured span covers reading the request, the handler and sending the
+ * response, so it includes the extra beacon waits that modem sleep adds to
+ * multi-segment bodies and to the client's ACKs.
+ */
 void HTTPServer::handleClient()
 {
+    inbox.drain();
+    uint32_t t0 = micros();
     server->handleClient();
+    if (requestServed)
+    {
+        requestServed = false;
+        EventBus::instance().publish(HttpRequestServed{uint32_t(micros() - t0)});
+    }
+}
+
+/**
+ * @brief Wrap an API handler so that the request it serves is measured
+ */
+WebServer::THandlerFunction HTTPServer::timed(void (HTTPServer::*handler)())
+{
+    return [this, handler]()
+    {
+        (this->*handler)();
+        requestServed = true;
+    };
 }
 
 /**
@@ -48,7 +106,7 @@ void HTTPServer::handleClient()
  * Serves a complete HTML page with embedded CSS and JavaScript for SMS sending.
  * The page includes:
  * - A form for entering phone number and message
- * - Client-side validation for message length (160 char limit)
+ * - Client-side validation for message length (480 char limit, sent as up to 4 parts)
  * - JavaScript code to make AJAX calls to the /send endpoint
  * - Responsive styling for better user experience
  *
@@ -64,12 +122,14 @@ void HTTPServer::handleRoot()
 </head><body>
 <h1>T-SIM7000G — Send SMS</h1>
 <p>You can use the form below, or call the API directly with <code>POST /send</code> and JSON <code>{"phone":"+40712345678","message":"Salut!"}</code>.<br>
-Note: Message length is limited to 160 characters (classic SMS).</p>
+Note: Messages over 160 characters are sent as up to 4 concatenated parts (max 480 characters).</p>
 <form id="f">
   <label>Phone (e.g. +40712345678)</label>
   <input id="phone" value="+407">
-  <label>Message (max 160 characters)</label>
-  <textarea id="msg" rows="4" maxlength="160">Salut! Test SMS de pe T-SIM7000G.</textarea>
+  <label>API key (only when provisioned)</label>
+  <input id="key" type="password">
+  <label>Message (max 480 characters)</label>
+  <textarea id="msg" rows="4" maxlength="480">Salut! Test SMS de pe T-SIM7000G.</textarea>
   <button type="button" onclick="send()">Send</button>
 </form>
 <pre id="out"></pre>
@@ -77,11 +137,14 @@ Note: Message length is limited to 160 characters (classic SMS).</p>
 async function send(){
   const phone=document.getElementById('phone').value.trim();
   const message=document.getElementById('msg').value;
-  if(message.length > 160){
-    document.getElementById('out').textContent="Error: Message too long (max 160 characters).";
+  if(message.length > 480){
+    document.getElementById('out').textContent="Error: Message too long (max 480 characters).";
     return;
   }
-  const r=await fetch('/send',{method:'POST',headers:{'Content-Type':'application/json'},body:JSON.stringify({phone,message})});
+  const headers={'Content-Type':'application/json'};
+  const key=document.getElementById('key').value;
+  if(key) headers['Authorization']='Bearer '+key;
+  const r=await fetch('/send',{method:'POST',headers,body:JSON.stringify({phone,message})});
   const t=await r.text();
   document.getElementById('out').textContent=t;
 }
@@ -92,8 +155,27 @@ async function send(){
     digitalWrite(led, 0);
 }
 
+/**
+ * @brief Handle unknown paths
+ *
+ * While the SoftAP runs, requests for foreign hosts (OS connectivity checks
+ * such as /generate_204 or /hotspot-detect.html, resolved to the AP by the
+ * captive-portal DNS) are redirected to the SMS page so the client pops up
+ * its captive-portal browser. Anything else gets a plain 404.
+ */
 void HTTPServer::handleNotFound()
 {
+    if (apActive)
+    {
+        String apIp = WiFi.softAPIP().toString();
+        String host = server->hostHeader();
+        if (host != apIp && host != WiFi.localIP().toString())
+        {
+            server->sendHeader("Location", "http://" + apIp + "/", true);
+            server->send(302, "text/plain", "");
+            return;
+        }
+    }
     digitalWrite(led, 1);
     sendCors();
     String message = "File Not Found\n\n";
@@ -117,26 +199,32 @@ void HTTPServer::handleNotFound()
  *
  * Processes SMS sending requests with JSON payload containing phone number and message.
  *
- * Request format: {"phone": "+40712345678", "message": "Text message"}
+ * Request format: {"phone": "+40712345678", "message": "Text message", "priority": "normal"}
+ *
+ * The body is decoded in a single pass by SendRequestDecoder directly into a
+ * preallocated JobQueue slot (no JsonDocument, no intermediate Strings).
  *
  * Validation performed:
  * - Ensures POST method is used
  * - Validates JSON payload structure
- * - Checks phone number format using looksLikePhone()
- * - Validates message length (1-480 characters)
+ * - Parses the phone number into packed form (PhoneNumber::parse)
+ * - Validates message length (1-480 bytes) and options
  * - Verifies modem network registration
  *
- * Response format: {"status": "ok"} or {"error": "description"}
+ * Response format: {"status": "ok", "id": 12} or {"error": "description"}
+ * The id can be used with GET /jobs/{id}/trace.
  *
  * HTTP Status Codes:
  * - 200: SMS sent successfully
  * - 400: Bad request (invalid JSON, phone format, or message length)
  * - 405: Method not allowed (non-POST request)
  * - 500: Internal server error (SMS sending failed)
- * - 503: Service unavailable (modem not registered)
+ * - 503: Service unavailable (modem not registered, no free job slot, or
+ *   JOB_PARK_MAX windowed jobs already parked)
  */
 void HTTPServer::handleSend()
 {
+    PROFILE_ZONE("http.send");
     digitalWrite(led, 1);
     sendCors();
 
@@ -145,6 +233,8 @@ void HTTPServer::handleSend()
         server->send(405, APPLICATION_JSON, "{\"error\":\"Use POST\"}");
         return;
     }
+    if (!authorized())
+        return;
 
     String body = server->arg("plain");
     if (body.length() == 0)
@@ -153,45 +243,351 @@ void HTTPServer::handleSend()
         return;
     }
 
-    JsonDocument doc;
-    DeserializationError err = deserializeJson(doc, body);
-    if (err)
+    SmsJob *job = jobs.acquire();
+    if (job == nullptr)
     {
-        server->send(400, APPLICATION_JSON, "{\"error\":\"Invalid JSON\"}");
+        server->send(503, APPLICATION_JSON, "{\"error\":\"Busy, try again\"}");
         return;
     }
+    JobTracer::instance().begin(job->id);
 
-    String phone = doc["phone"] | "";
-    String message = doc["message"] | "";
-
-    if (!looksLikePhone(phone))
+    DecodeStatus status = SendRequestDecoder::decode(body.c_str(), body.length(), *job);
+    if (status != DecodeStatus::Ok)
     {
-        server->send(400, APPLICATION_JSON, "{\"error\":\"Invalid phone format. Use +407...\"}");
+        jobs.release(job);
+        server->send(400, APPLICATION_JSON, SendRequestDecoder::errorJson(status));
         return;
     }
-    if (message.length() < 1 || message.length() > 480)
-    { // allow >160; modem will segment
-        server->send(400, APPLICATION_JSON, "{\"error\":\"Message length 1..480 required\"}");
+
+    char reply[64];
+    if (job->hasWindow())
+    {
+        // Campaign traffic: registration is checked when the job is sent
+        uint32_t id = job->id;
+        ScheduleResult result = scheduleSMS(*job);
+        if (result != ScheduleResult::Accepted)
+        {
+            jobs.release(job);
+            if (result == ScheduleResult::ParkFull)
+                server->send(503, APPLICATION_JSON, "{\"error\":\"Busy, try again\"}");
+            else
+                server->send(400, APPLICATION_JSON, "{\"error\":\"Window never open for destination\"}");
+            return;
+        }
+        snprintf(reply, sizeof(reply), "{\"status\":\"scheduled\",\"id\":%lu,\"releaseAt\":%lu}",
+                 (unsigned long)id, (unsigned long)job->releaseAt);
+        server->send(202, APPLICATION_JSON, reply);
+        digitalWrite(led, 0);
         return;
     }
 
     if (!checkModemRegistered())
     {
+        jobs.release(job);
         server->send(503, APPLICATION_JSON, "{\"error\":\"Modem not registered on network\"}");
         return;
     }
 
-    bool ok = sendSMS(phone, message);
-    if (ok)
+    bool ok = sendSMS(*job);
+    uint32_t id = job->id;
+    jobs.release(job);
+
+    snprintf(reply, sizeof(reply), "{\"status\":\"%s\",\"id\":%lu}", ok ? "ok" : "fail", (unsigned long)id);
+    server->send(ok ? 200 : 500, APPLICATION_JSON, reply);
+    digitalWrite(led, 0);
+}
+
+/**
+ * @brief Handle HTTP GET requests to "/jobs/{id}/trace"
+ *
+ * Looks the job up in the JobTracer ring and returns its spans, either as
+ * plain JSON or, with `?format=chrome`, as Chrome Trace Event JSON.
+ */
+void HTTPServer::handleJobTrace()
+{
+    sendCors();
+    uint32_t id = (uint32_t)server->pathArg(0).toInt();
+    JobTrace trace;
+    if (id == 0 || !JobTracer::instance().find(id, trace))
     {
-        server->send(200, APPLICATION_JSON, "{\"status\":\"ok\"}");
+        server->send(404, APPLICATION_JSON, "{\"error\":\"Unknown job\"}");
+        return;
     }
+
+    JsonDocument doc;
+    JsonObject root = doc.to<JsonObject>();
+    if (server->arg("format") == "chrome")
+        JobTracer::toChromeTrace(trace, root);
     else
+        JobTracer::toJson(trace, root);
+    String out;
     {
-        server->send(500, APPLICATION_JSON, "{\"status\":\"fail\"}");
+        PROFILE_ZONE("json.encode");
+        serializeJson(doc, out);
     }
-    digitalWrite(led, 0);
+    server->send(200, APPLICATION_JSON, out);
+}
+
+/**
+ * @brief Handle HTTP GET requests to "/metrics"
+ *
+ * Serializes every registered probe (modem, wifi, settings, jobs, ...).
+ */
+void HTTPServer::handleMetrics()
+{
+    sendCors();
+    server->send(200, APPLICATION_JSON, ProbeRegistry::instance().collectAllAsJson());
+}
+
+/**
+ * @brief Handle HTTP GET and PATCH requests to "/settings"
+ *
+ * Reads need the API key too: the document names the stored networks.
+ * Changes need a provisioned key even on a fresh device; until then
+ * settings are changed over BLE.
+ */
+void HTTPServer::handleSettings()
+{
+    sendCors();
+    if (!authorized(server->method() == HTTP_PATCH))
+        return;
+    SettingsApi &api = SettingsApi::instance();
+    if (server->method() == HTTP_PATCH)
+    {
+        String body = server->arg("plain");
+        String error;
+        SettingsEffect effect;
+        switch (api.patch(body.c_str(), body.length(), server->header("If-Match"), error, effect))
+        {
+        case PatchStatus::BadRequest:
+            sendError(400, error);
+            return;
+        case PatchStatus::Precondition:
+            server->sendHeader("ETag", api.etag());
+            server->send(412, APPLICATION_JSON, "{\"error\":\"Precondition failed\"}");
+            return;
+        case PatchStatus::Invalid:
+            sendError(422, error);
+            return;
+        default:
+            break;
+        }
+        if (effect != SettingsEffect::None)
+            LOG_NOTICE("HTTP", "Settings updated%s", effect == SettingsEffect::Restart ? " (restart required)" : "");
+        if (effect == SettingsEffect::Restart)
+            server->sendHeader("X-Restart-Required", "1");
+    }
+
+    JsonDocument doc;
+    JsonObject root = doc.to<JsonObject>();
+    api.read(root);
+    String out;
+    serializeJson(doc, out);
+    server->sendHeader("ETag", api.etag());
+    server->send(200, APPLICATION_JSON, out);
+}
+
+/**
+ * @brief Send {"error": message} with @p code
+ */
+void HTTPServer::sendError(int code, const String &message)
+{
+    JsonDocument doc;
+    doc["error"] = message;
+    String out;
+    serializeJson(doc, out);
+    server->send(code, APPLICATION_JSON, out);
+}
+
+#if FEATURE_RULES
+/**
+ * @brief Handle HTTP GET and PUT requests to "/rules"
+ *
+ * Rules name destination numbers and input pins, so reads need the API key
+ * too.
+ */
+void HTTPServer::handleRules()
+{
+    sendCors();
+    if (!authorized())
+        return;
+    RuleEngine &rules = RuleEngine::instance();
+    if (server->method() == HTTP_PUT)
+    {
+        String body = server->arg("plain");
+        String error;
+        if (!rules.update(body.c_str(), body.length(), error))
+        {
+            sendError(422, error);
+            return;
+        }
+        JsonDocument doc;
+        JsonObject root = doc.to<JsonObject>();
+        rules.toJson(root);
+        String out;
+        serializeJson(doc, out);
+        server->send(200, APPLICATION_JSON, out);
+        return;
+    }
+    server->send(200, APPLICATION_JSON, rules.source().length() ? rules.source() : String("{\"inputs\":{},\"rules\":[]}"));
+}
+#endif // FEATURE_RULES
+
+#if FEATURE_HISTORY
+/**
+ * @brief Handle HTTP GET requests to "/history"
+ *
+ * Runs the query over the archive, the active file and the buffered rows,
+ * stopping at the row limit.
+ */
+void HTTPServer::handleHistory()
+{
+    sendCors();
+    if (!authorized())
+        return;
+    HistoryQuery q;
+    PhoneNumber phone;
+    if (server->hasArg("from"))
+        q.from = strtoul(server->arg("from").c_str(), nullptr, 10);
+    if (server->hasArg("to"))
+        q.to = strtoul(server->arg("to").c_str(), nullptr, 10);
+    if (server->hasArg("phone"))
+    {
+        String p = server->arg("phone");
+        if (p.startsWith(" ")) // unescaped '+' decodes as a space
+            p.setCharAt(0, '+');
+        if (!phone.parse(p))
+        {
+            server->send(400, APPLICATION_JSON, "{\"error\":\"Invalid phone\"}");
+            return;
+        }
+        q.dest = &phone;
+    }
+    q.countOnly = server->arg("count") == "1";
+    long limit = server->hasArg("limit") ? server->arg("limit").toInt() : HISTORY_QUERY_LIMIT;
+    limit = constrain(limit, 1L, long(HISTORY_QUERY_LIMIT));
+
+    JsonDocument doc;
+    JsonObject root = doc.to<JsonObject>();
+    JsonArray rows = root["rows"].to<JsonArray>();
+    long n = 0;
+    bool truncated = false;
+    HistoryQueryStats stats;
+    uint32_t us = History::instance().query(q, [&](const HistoryRecord &row)
+                                            {
+        if (n == limit)
+        {
+            truncated = true;
+            return false;
+        }
+        JsonObject o = rows.add<JsonObject>();
+        History::rowToJson(row, o);
+        n++;
+        return true; }, stats);
+
+    root["count"] = q.countOnly ? long(stats.rowsMatched) : n;
+    root["truncated"] = truncated;
+    JsonObject s = root["stats"].to<JsonObject>();
+    History::statsToJson(stats, us, s);
+    String out;
+    serializeJson(doc, out);
+    server->send(200, APPLICATION_JSON, out);
 }
+#endif // FEATURE_HISTORY
+
+#if FEATURE_PROFILER
+/**
+ * @brief Handle HTTP GET requests to "/debug/profile"
+ *
+ * Starts, stops or downloads a sampling profile. The download is streamed
+ * in chunks straight from the PSRAM buffer.
+ */
+void HTTPServer::handleProfile()
+{
+    sendCors();
+    if (!authorized())
+        return;
+    Profiler &profiler = Profiler::instance();
+    JsonDocument doc;
+    JsonObject root = doc.to<JsonObject>();
+    String out;
+
+    if (server->hasArg("seconds"))
+    {
+        long seconds = server->arg("seconds").toInt();
+        if (seconds < 1 || seconds > PROFILER_MAX_SECONDS)
+        {
+            server->send(400, APPLICATION_JSON, "{\"error\":\"Invalid seconds\"}");
+            return;
+        }
+        if (!profiler.start(uint32_t(seconds)))
+        {
+            server->send(profiler.isRunning() ? 409 : 500, APPLICATION_JSON,
+                         profiler.isRunning() ? "{\"error\":\"Profile running\"}" : "{\"error\":\"Out of memory\"}");
+            return;
+        }
+        profiler.statusToJson(root);
+        serializeJson(doc, out);
+        server->send(202, APPLICATION_JSON, out);
+        return;
+    }
+
+    if (server->hasArg("stop"))
+    {
+        profiler.stop();
+        profiler.statusToJson(root);
+        serializeJson(doc, out);
+        server->send(200, APPLICATION_JSON, out);
+        return;
+    }
+
+    profiler.poll();
+    if (profiler.isRunning())
+    {
+        server->send(409, APPLICATION_JSON, "{\"error\":\"Profile running\"}");
+        return;
+    }
+    if (!profiler.hasCapture())
+    {
+        server->send(404, APPLICATION_JSON, "{\"error\":\"No profile captured\"}");
+        return;
+    }
+
+    server->sendHeader("Content-Disposition", "attachment; filename=\"profile.sprf\"");
+    server->setContentLength(profiler.exportSize());
+    server->send(200, "application/octet-stream", "");
+    profiler.exportBinary([this](const uint8_t *data, size_t len)
+                          { server->sendContent((const char *)data, len); });
+}
+#endif
+
+#if FEATURE_BENCH
+/**
+ * @brief Handle HTTP POST requests to "/debug/bench"
+ *
+ * Only runs while the job pool is empty so modem traffic does not skew the
+ * numbers (and the benchmarks do not delay sends). Needs an API key, like
+ * PATCH /settings, since the storage benchmarks write flash.
+ */
+void HTTPServer::handleBench()
+{
+    sendCors();
+    if (!authorized(true)) // writes flash: a key is needed even before any is provisioned
+        return;
+    if (jobs.inUse() > 0)
+    {
+        server->send(409, APPLICATION_JSON, "{\"error\":\"Busy, try again\"}");
+        return;
+    }
+
+    JsonDocument doc;
+    JsonObject root = doc.to<JsonObject>();
+    DeviceBench::run(root);
+    String out;
+    serializeJson(doc, out);
+    server->send(200, APPLICATION_JSON, out);
+}
+#endif
 
 /**
  * @brief Send Cross-Origin Resource Sharing (CORS) headers
@@ -201,14 +597,32 @@ void HTTPServer::handleSend()
  *
  * Headers set:
  * - Access-Control-Allow-Origin: * (allows all origins)
- * - Access-Control-Allow-Methods: POST, GET, OPTIONS
- * - Access-Control-Allow-Headers: Content-Type, Authorization
+ * - Access-Control-Allow-Methods: POST, GET, PUT, PATCH, OPTIONS
+ * - Access-Control-Allow-Headers: Content-Type, Authorization, If-Match
+ * - Access-Control-Expose-Headers: ETag, X-Restart-Required
  */
 void HTTPServer::sendCors()
 {
     server->sendHeader("Access-Control-Allow-Origin", "*");
-    server->sendHeader("Access-Control-Allow-Methods", "POST, GET, OPTIONS");
-    server->sendHeader("Access-Control-Allow-Headers", "Content-Type, Authorization");
+    server->sendHeader("Access-Control-Allow-Methods", "POST, GET, PUT, PATCH, OPTIONS");
+    server->sendHeader("Access-Control-Allow-Headers", "Content-Type, Authorization, If-Match");
+    server->sendHeader("Access-Control-Expose-Headers", "ETag, X-Restart-Required");
+}
+
+bool HTTPServer::authorized(bool keyRequired)
+{
+    if (!Provisioner::instance().hasApiKeys())
+    {
+        if (!keyRequired)
+            return true;
+        server->send(403, APPLICATION_JSON, "{\"error\":\"Provision an API key first\"}");
+        return false;
+    }
+    String auth = server->header("Authorization");
+    if (auth.startsWith("Bearer ") && Provisioner::instance().checkApiKey(auth.c_str() + 7))
+        return true;
+    server->send(401, APPLICATION_JSON, "{\"error\":\"Unauthorized\"}");
+    return false;
 }
 
 /**
@@ -225,28 +639,3 @@ void HTTPServer::handleOptions()
     server->send(204);
     digitalWrite(led, 0);
 }
-
-/**
- * @brief Validate if a string appears to be a valid phone number format
- *
- * Performs basic format validation for phone number strings:
- * - Length must be between 7 and 20 characters
- * - Must contain only digits (0-9) and optionally a leading plus sign (+)
- * - Does not validate actual number validity or regional formats
- *
- * @param s String to validate as phone number
- * @return true if string matches basic phone number pattern
- * @return false if string doesn't match expected format
- */
-bool HTTPServer::looksLikePhone(const String &s)
-{
-    if (s.length() < 7 || s.length() > 20)
-        return false;
-    for (size_t i = 0; i < s.length(); ++i)
-    {
-        char c = s[i];
-        if (!(c == '+' || (c >= '0' && c <= '9')))
-            return false;
-    }
-    return true;
-}
@@ -1,19 +1,47 @@
 #pragma once
 
+#include <WiFi.h>
 #include <WebServer.h>
+#include <uri/UriBraces.h>
 #include <ArduinoJson.h>
-#include "GSettings.hpp"
-#include "WifiConnection.hpp"
+#include "EventBus.hpp"
+#include "JobQueue.hpp"
+#include "SendRequestDecoder.hpp"
+#include "JobTracer.hpp"
+#include "Profiler.hpp"
+#include "DeviceBench.hpp"
+#include "Features.hpp"
+#include "Provisioner.hpp"
+#include "SettingsApi.hpp"
+#if FEATURE_HISTORY
+#include "History.hpp"
+#endif
+#if FEATURE_RULES
+#include "RuleEngine.hpp"
+#endif
 
 /**
  * @brief Function pointer type for SMS sending functionality
  *
- * @param to Destination phone number in international format
- * @param text SMS message text content
+ * Runs a decoded job through the queue until it is finished. The caller
+ * keeps ownership of the job slot.
+ *
+ * @param job Decoded and validated job record (destination, body, options)
  * @return true if SMS was sent successfully
  * @return false if SMS sending failed
  */
-using SMSFunction = std::function<bool(const String &to, const String &text)>;
+using SMSFunction = std::function<bool(SmsJob &job)>;
+
+/**
+ * @brief Function type for queueing a job with a send window
+ *
+ * Takes over the slot on success (the job is detached).
+ *
+ * @param job Decoded job with SmsJob::hasWindow()
+ * @return ScheduleResult Accepted if the job was queued or parked
+ *         (job.releaseAt is set), ParkFull or WindowNever otherwise
+ */
+using ScheduleFunction = std::function<ScheduleResult(SmsJob &job)>;
 
 /**
  * @brief Function pointer type for checking modem network registration
@@ -33,9 +61,16 @@ using CheckModemRegisteredFunction = std::function<bool()>;
  * Features:
  * - Web interface with HTML form for SMS sending
  * - REST API endpoint (POST /send) with JSON payload
+ * - Per-job trace retrieval (GET /jobs/{id}/trace)
+ * - Probe/metrics export (GET /metrics)
+ * - Send history queries (GET /history)
+ * - Sampling profiler control and download (GET /debug/profile, FEATURE_PROFILER)
+ * - On-target micro-benchmarks (POST /debug/bench, FEATURE_BENCH)
  * - CORS support for cross-origin requests
  * - Phone number format validation
  * - Modem registration status checking
+ * - No reference to the WiFi module: the SoftAP state arrives as
+ *   WifiStateChanged, request latency leaves as HttpRequestServed
  *
  * REST API
  * - Endpoint: POST /send
@@ -58,14 +93,14 @@ public:
     /**
      * @brief Construct a new HTTP Server object
      *
-     * @param settings Reference to the global settings object for accessing configuration
-     * @param wifiConnection Reference to the WiFi connection object for network status
+     * @param jobs Job pool that request bodies are decoded into
      * @param sendSMSFunc Function pointer for sending SMS messages
+     * @param scheduleFunc Function queueing jobs that carry a send window
      * @param checkModemRegisteredFunc Function pointer for checking if modem is registered to network
      * @param port HTTP server port number (default: 80)
      * @param ledPin GPIO pin number for LED indicator (default: -1, no LED)
      */
-    HTTPServer(GSettings &settings, WifiConnection &wifiConnection, SMSFunction sendSMSFunc, CheckModemRegisteredFunction checkModemRegisteredFunc, int port = 80, int ledPin = -1);
+    HTTPServer(JobQueue &jobs, SMSFunction sendSMSFunc, ScheduleFunction scheduleFunc, CheckModemRegisteredFunction checkModemRegisteredFunc, int port = 80, int ledPin = -1);
     /**
      * @brief Destructor for HTTP Server object
      *
@@ -86,10 +121,25 @@ public:
 private:
     int led;
     WebServer *server;                                 ///< Pointer to the ESP32 WebServer instance
-    GSettings &settings;                               ///< Reference to global settings object
-    WifiConnection &wifiConnection;                    ///< Reference to WiFi connection manager
+    JobQueue &jobs;                                    ///< Preallocated job records for decoded requests
     SMSFunction sendSMS;                               ///< Function pointer for SMS sending
+    ScheduleFunction scheduleSMS;                      ///< Queues windowed (campaign) jobs
     CheckModemRegisteredFunction checkModemRegistered; ///< Function pointer for checking modem registration
+    bool requestServed = false;                        ///< An API handler ran in the current handleClient()
+    bool apActive = false;                             ///< SoftAP running (last WifiStateChanged)
+    EventInbox inbox{"http"};                          ///< WifiStateChanged
+
+    /**
+     * @brief Wrap an API handler for request latency accounting
+     *
+     * POST /send (which waits for the modem) and the debug endpoints are
+     * registered without it so their long runs do not skew the
+     * per-power-save-policy latency.
+     *
+     * @param handler Member handler to call
+     * @return WebServer::THandlerFunction Handler that flags the request as served
+     */
+    WebServer::THandlerFunction timed(void (HTTPServer::*handler)());
 
     /**
      * @brief Handle the root endpoint (GET /)
@@ -111,48 +161,164 @@ private:
      * @brief Handle SMS sending endpoint (POST /send)
      *
      * Input JSON fields:
-     * - to (string, required): phone number in E.164 or local format
-     * - text (string, required): message body (160 GSM-7 chars typical per SMS)
+     * - phone (string, required): phone number in E.164 or local format
+     * - message (string, required): message body (160 GSM-7 chars typical per SMS)
+     * - priority (string, optional): "low" | "normal" | "high"
+     * - window (string, optional): "HH:MM-HH:MM" allowed send window in the
+     *   recipient's local time; ignored for "high" priority
      *
      * Behavior:
      * - Validates JSON and fields
-     * - Validates phone number format via looksLikePhone
+     * - Decodes the body with SendRequestDecoder straight into a JobQueue slot
+     * - Validates the phone number format (packed into a PhoneNumber)
      * - Checks modem registration via checkModemRegistered
-     * - Calls sendSMS on success path
+     * - Calls sendSMS on success path, or scheduleSMS for windowed jobs
      *
      * Responses:
      * - 200, {"ok": true} on success
+     * - 202, {"status":"scheduled","id":N,"releaseAt":T} for windowed jobs
+     *   (releaseAt is UTC seconds, 0 while the clock is not set)
+     * - 400, {"error": "Window never open for destination"} when the window
+     *   cannot fit all time zones of the destination country
      * - 400, {"ok": false, "error": "..."} for bad input
+     * - 401, {"error": "Unauthorized"} without a valid API key (see authorized())
      * - 503, {"ok": false, "error": "modem not registered"} when offline
      */
     void handleSend();
 
+    /**
+     * @brief Handle job trace endpoint (GET /jobs/{id}/trace)
+     *
+     * Returns the recorded spans of a recent job as JSON. With
+     * `?format=chrome` the trace is returned in Chrome Trace Event format
+     * (loadable in chrome://tracing or Perfetto).
+     *
+     * Responses:
+     * - 200 with the trace
+     * - 404, {"error": "Unknown job"} when the trace was overwritten or never existed
+     */
+    void handleJobTrace();
+
+    /**
+     * @brief Handle metrics endpoint (GET /metrics)
+     *
+     * Returns all ProbeRegistry probes as one JSON document, including the
+     * per-stage job latency aggregates of the "jobs" probe.
+     */
+    void handleMetrics();
+
+    /**
+     * @brief Handle settings endpoint (GET/PATCH /settings)
+     *
+     * GET returns every SettingsApi section (secrets masked) with an ETag.
+     * PATCH takes a JSON merge-patch such as
+     * {"device":{"sleepInterval":600}}; send the ETag back in If-Match to
+     * make the update conditional. Either every field is committed or none.
+     *
+     * Responses:
+     * - 200, the new document and ETag; `X-Restart-Required: 1` when a
+     *   changed value only applies after a restart
+     * - 400, {"error": "..."} malformed body or unknown section
+     * - 412, {"error": "Precondition failed"} with the current ETag
+     * - 422, {"error": "<section>.<field>: ..."} rejected value
+     */
+    void handleSettings();
+
+#if FEATURE_RULES
+    /**
+     * @brief Handle alarm rules endpoint (GET/PUT /rules)
+     *
+     * GET returns the stored rule set source. PUT replaces it with the
+     * request body (see RuleProgram for the format); the rule set is
+     * compiled first and only stored if it compiles.
+     *
+     * Responses:
+     * - 200, GET: the rule set; PUT: the "rules" probe of the new set
+     * - 422, {"error": "rules.door.when: unknown input ..."} refused rule set
+     */
+    void handleRules();
+#endif
+
+#if FEATURE_HISTORY
+    /**
+     * @brief Handle send history endpoint (GET /history)
+     *
+     * Query arguments (all optional):
+     * - from, to: inclusive UTC second bounds
+     * - phone: destination filter (send '+' as %2B)
+     * - limit: maximum rows returned (1..HISTORY_QUERY_LIMIT)
+     * - count=1: only count the matches
+     *
+     * Responses:
+     * - 200, {"count":N,"truncated":bool,"rows":[...],"stats":{...}} where
+     *   stats compares the bytes read with a raw-row scan ("rawBytes")
+     * - 400, {"error": "Invalid phone"}
+     */
+    void handleHistory();
+#endif
+
+#if FEATURE_PROFILER
+    /**
+     * @brief Handle profiler endpoint (GET /debug/profile)
+     *
+     * - `?seconds=N`: start an N second capture (202, returns immediately)
+     * - `?stop=1`: stop the running capture early
+     * - no arguments: download the last capture as application/octet-stream
+     *   ("SPRF" format, see Profiler)
+     *
+     * Responses:
+     * - 409, {"error": "Profile running"} when downloading during a capture
+     * - 404, {"error": "No profile captured"} when there is nothing to download
+     */
+    void handleProfile();
+#endif
+
+#if FEATURE_BENCH
+    /**
+     * @brief Handle benchmark endpoint (POST /debug/bench)
+     *
+     * Runs the DeviceBench suite and returns its results as JSON. Blocks the
+     * server for about a second.
+     *
+     * Responses:
+     * - 200 with the results
+     * - 409, {"error": "Busy, try again"} while any job is in flight
+     */
+    void handleBench();
+#endif
+
     /**
      * @brief Send CORS (Cross-Origin Resource Sharing) headers
      *
      * Adds necessary headers to allow cross-origin requests from web browsers.
-     * Enables access from any origin with POST, GET, and OPTIONS methods.
+     * Enables access from any origin with POST, GET, PATCH and OPTIONS methods.
      */
     void sendCors();
 
     /**
-     * @brief Handle preflight OPTIONS requests
+     * @brief Check the API key of the current request
      *
-     * Responds to CORS preflight requests by sending appropriate headers
-     * and returning a 204 No Content status.
+     * Once a provisioning bundle installed API keys, /send and /history need
+     * `Authorization: Bearer <key>`. Without keys the API stays open, except
+     * for requests that change the device (@p keyRequired), which are
+     * refused with 403 until a key is provisioned. Sends 401
+     * {"error":"Unauthorized"} when the check fails.
+     *
+     * @param keyRequired true: refuse the request while no key is provisioned
+     * @retval true Request may proceed
      */
-    void handleOptions();
+    bool authorized(bool keyRequired = false);
 
     /**
-     * @brief Validate if a string looks like a phone number
-     *
-     * Performs basic validation to check if the input string resembles
-     * a phone number format (contains only digits and optional leading '+').
-     * Typical accepted lengths are 8..16 digits depending on region.
+     * @brief Send {"error": message} with the given status code
+     */
+    void sendError(int code, const String &message);
+
+    /**
+     * @brief Handle preflight OPTIONS requests
      *
-     * @param s String to validate as phone number
-     * @retval true If string appears to be a valid phone number format
-     * @retval false If string does not match phone number pattern
+     * Responds to CORS preflight requests by sending appropriate headers
+     * and returning a 204 No Content status.
      */
-    bool looksLikePhone(const String &s);
+    void handleOptions();
 };
\ No newline at end of file
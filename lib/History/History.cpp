@@ -0,0 +1,335 @@
+#include "History.hpp"
+#include <LittleFS.h>
+#include <memory>
+#include <new>
+#include "FlashWear.hpp"
+#include "JobTracer.hpp"
+#include "ProbeRegistry.hpp"
+#include "RemoteLog.hpp"
+#include "Supervisor.hpp"
+
+namespace
+{
+    const char *DIR = "/hist";
+    const char *ACTIVE = "/hist/active.raw";
+    const size_t RAW_CHUNK = 16; ///< Active-file rows read per step during a query
+
+    /**
+     * @brief HistorySource over an open LittleFS file
+     */
+    class FileSource : public HistorySource
+    {
+    public:
+        explicit FileSource(File &f) : f(f) {}
+        bool read(uint32_t offset, void *dst, size_t len) override
+        {
+            return f.seek(offset) && f.read(static_cast<uint8_t *>(dst), len) == len;
+        }
+
+    private:
+        File &f;
+    };
+}
+
+/**
+ * @brief Register the "history" probe
+ */
+History::History()
+{
+    ProbeRegistry::instance().registerProbe("history", [this](JsonObject &dst)
+                                            { this->toJson(dst); });
+}
+
+/**
+ * @brief Mount, find the segment sequence range and size the active file
+ *
+ * A torn last row (power loss during an append) would misalign every later
+ * append, so such a file is sealed right away with its complete rows.
+ */
+bool History::begin()
+{
+    mounted_ = LittleFS.begin(true, "/littlefs", 5, "littlefs");
+    if (!mounted_)
+    {
+        LOG_ERROR("HIST", "LittleFS mount failed, history disabled");
+        return false;
+    }
+    if (!LittleFS.exists(DIR))
+        LittleFS.mkdir(DIR);
+
+    size_t activeSize = 0;
+    bool any = false;
+    File dir = LittleFS.open(DIR);
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+    {
+        const char *name = f.name();
+        const char *slash = strrchr(name, '/');
+        const char *base = slash ? slash + 1 : name;
+        if (strcmp(base, "active.raw") == 0)
+        {
+            activeSize = f.size();
+            continue;
+        }
+        char *end;
+        uint32_t seq = strtoul(base, &end, 10);
+        if (end == base || strcmp(end, ".col") != 0)
+            continue;
+        HistorySegmentHeader h;
+        if (f.read(reinterpret_cast<uint8_t *>(&h), sizeof(h)) == sizeof(h) && h.magic == HistoryCodec::MAGIC)
+            archivedRows_ += h.rows;
+        archivedBytes_ += f.size();
+        if (!any || seq < firstSeq_)
+            firstSeq_ = seq;
+        if (!any || seq >= nextSeq_)
+            nextSeq_ = seq + 1;
+        any = true;
+    }
+
+    activeRows_ = activeSize / sizeof(HistoryRecord);
+    if (activeRows_ == 0 && activeSize > 0)
+        LittleFS.remove(ACTIVE);
+    else if (activeRows_ >= HISTORY_SEGMENT_ROWS || activeSize % sizeof(HistoryRecord) != 0)
+        seal();
+
+    LOG_INFO("HIST", "%lu archived rows in %lu segments, %lu active",
+             (unsigned long)archivedRows_, (unsigned long)(nextSeq_ - firstSeq_), (unsigned long)activeRows_);
+    return true;
+}
+
+/**
+ * @brief Buffer one row; a full buffer is flushed immediately
+ */
+void History::record(const SmsJob &job, bool ok, uint32_t utc)
+{
+    HistoryRecord row;
+    row.ts = utc;
+    row.to = job.to;
+    row.status = uint8_t(ok ? HistoryStatus::Sent : HistoryStatus::Failed);
+    row.segments = job.segmentCount ? job.segmentCount : segmentsFor(job.bodyLen);
+    JobTrace t;
+    if (JobTracer::instance().find(job.id, t))
+    {
+        uint32_t msgRefUs = t.offsetUs[size_t(TraceStage::MsgRef)];
+        row.latencyMs = t.has(TraceStage::MsgRef) && msgRefUs != JobTrace::LATE ? msgRefUs / 1000 : millis() - t.startMs;
+    }
+
+    if (buffered_ == HISTORY_FLUSH_ROWS && !flush())
+    {
+        dropped_++;
+        return;
+    }
+    if (buffered_ == 0)
+        bufferedAtMs_ = millis();
+    buffer_[buffered_++] = row;
+    if (buffered_ == HISTORY_FLUSH_ROWS)
+        flush();
+}
+
+void History::poll()
+{
+    if (buffered_ > 0 && millis() - bufferedAtMs_ >= HISTORY_FLUSH_MS)
+        flush();
+}
+
+/**
+ * @brief Append the buffer in one write + close, sealing a full active file
+ */
+bool History::flush()
+{
+    if (buffered_ == 0)
+        return true;
+    if (!mounted_)
+    {
+        dropped_ += buffered_;
+        buffered_ = 0;
+        return true;
+    }
+    if (!FlashWear::instance().allowWrite("history", false))
+        return false;
+
+    // Append, and sealing a full segment (encode + prune)
+    SUPERVISED_STAGE(Subsystem::Storage, "history.flush", 10000);
+    File f = LittleFS.open(ACTIVE, FILE_APPEND);
+    if (!f)
+        return false;
+    size_t bytes = buffered_ * sizeof(HistoryRecord);
+    size_t n = f.write(reinterpret_cast<const uint8_t *>(buffer_), bytes);
+    f.close();
+    FlashWear::instance().noteFsWrite("history", n, true);
+
+    activeRows_ += n / sizeof(HistoryRecord);
+    if (n != bytes)
+    {
+        // Out of space: keep what made it, seal it (drops the torn row) and move on
+        LOG_ERROR("HIST", "Append short (%u of %u bytes)", (unsigned)n, (unsigned)bytes);
+        dropped_ += buffered_ - n / sizeof(HistoryRecord);
+        buffered_ = 0;
+        seal();
+        return true;
+    }
+    buffered_ = 0;
+    if (activeRows_ >= HISTORY_SEGMENT_ROWS)
+        seal();
+    return true;
+}
+
+/**
+ * @brief Encode the active file into the next segment and remove it
+ */
+bool History::seal()
+{
+    size_t rows = activeRows_;
+    if (rows == 0)
+    {
+        LittleFS.remove(ACTIVE);
+        return true;
+    }
+    size_t rawLen = rows * sizeof(HistoryRecord);
+    size_t cap = HistoryCodec::encodeBound(rows);
+    std::unique_ptr<HistoryRecord[]> raw(new (std::nothrow) HistoryRecord[rows]);
+    std::unique_ptr<uint8_t[]> out(new (std::nothrow) uint8_t[cap]);
+    if (!raw || !out)
+    {
+        sealFailures_++;
+        return false;
+    }
+
+    File in = LittleFS.open(ACTIVE, FILE_READ);
+    bool ok = in && in.read(reinterpret_cast<uint8_t *>(raw.get()), rawLen) == rawLen;
+    in.close();
+    size_t len = ok ? HistoryCodec::encode(raw.get(), rows, out.get(), cap) : 0;
+    if (len == 0)
+    {
+        sealFailures_++;
+        return false;
+    }
+
+    String path = segmentPath(nextSeq_);
+    File f = LittleFS.open(path, FILE_WRITE);
+    size_t n = f ? f.write(out.get(), len) : 0;
+    f.close();
+    FlashWear::instance().noteFsWrite("history", n, true);
+    if (n != len)
+    {
+        LittleFS.remove(path);
+        sealFailures_++;
+        return false;
+    }
+
+    LittleFS.remove(ACTIVE);
+    activeRows_ = 0;
+    archivedRows_ += rows;
+    archivedBytes_ += len;
+    nextSeq_++;
+    while (nextSeq_ - firstSeq_ > HISTORY_MAX_SEGMENTS)
+        pruneOldest();
+    LOG_INFO("HIST", "Sealed %u rows: %u -> %u bytes", (unsigned)rows, (unsigned)rawLen, (unsigned)len);
+    return true;
+}
+
+void History::pruneOldest()
+{
+    String path = segmentPath(firstSeq_++);
+    HistorySegmentHeader h;
+    size_t size;
+    if (!readHeader(path, h, size))
+        return;
+    archivedRows_ -= h.rows < archivedRows_ ? h.rows : archivedRows_;
+    archivedBytes_ -= size < archivedBytes_ ? size : archivedBytes_;
+    LittleFS.remove(path);
+}
+
+/**
+ * @brief Archive segments in sequence order, then the active file, then the buffer
+ */
+uint32_t History::query(const HistoryQuery &q, const HistoryRowFunction &fn, HistoryQueryStats &stats)
+{
+    uint32_t t0 = micros();
+    bool more = true;
+    if (mounted_)
+    {
+        for (uint32_t seq = firstSeq_; more && seq < nextSeq_; ++seq)
+        {
+            File f = LittleFS.open(segmentPath(seq), FILE_READ);
+            if (!f)
+                continue;
+            FileSource src(f);
+            more = HistoryCodec::query(src, q, fn, stats);
+        }
+        File f = more && activeRows_ ? LittleFS.open(ACTIVE, FILE_READ) : File();
+        HistoryRecord chunk[RAW_CHUNK];
+        for (size_t left = activeRows_; more && f && left > 0;)
+        {
+            size_t n = left < RAW_CHUNK ? left : RAW_CHUNK;
+            if (f.read(reinterpret_cast<uint8_t *>(chunk), n * sizeof(HistoryRecord)) != n * sizeof(HistoryRecord))
+                break;
+            more = HistoryCodec::queryRaw(chunk, n, q, fn, stats);
+            left -= n;
+        }
+    }
+    if (more)
+        HistoryCodec::queryRaw(buffer_, buffered_, q, fn, stats);
+
+    lastQueryUs_ = micros() - t0;
+    lastStats_ = stats;
+    return lastQueryUs_;
+}
+
+void History::rowToJson(const HistoryRecord &row, JsonObject &dst)
+{
+    dst["ts"] = row.ts;
+    dst["phone"] = row.to.toString();
+    dst["status"] = row.status == uint8_t(HistoryStatus::Sent) ? "sent" : "failed";
+    dst["segments"] = row.segments;
+    dst["latencyMs"] = row.latencyMs;
+}
+
+void History::statsToJson(const HistoryQueryStats &stats, uint32_t us, JsonObject &dst)
+{
+    dst["segments"] = stats.segments;
+    dst["pruned"] = stats.pruned;
+    dst["corrupt"] = stats.corrupt;
+    dst["rowsScanned"] = stats.rowsScanned;
+    dst["matched"] = stats.rowsMatched;
+    dst["columns"] = stats.columnsRead;
+    dst["bytesRead"] = stats.bytesRead;
+    dst["rawBytes"] = stats.rawBytes;
+    dst["us"] = us;
+}
+
+/**
+ * @brief Tier sizes and the archive ratio against the 24 byte row format
+ */
+void History::toJson(JsonObject &root)
+{
+    root["mounted"] = mounted_;
+    root["rows"] = archivedRows_ + activeRows_ + buffered_;
+    JsonObject archive = root["archive"].to<JsonObject>();
+    archive["segments"] = nextSeq_ - firstSeq_;
+    archive["rows"] = archivedRows_;
+    archive["bytes"] = archivedBytes_;
+    archive["rawBytes"] = archivedRows_ * sizeof(HistoryRecord);
+    archive["ratio"] = archivedBytes_ ? float(archivedRows_ * sizeof(HistoryRecord)) / float(archivedBytes_) : 0.0f;
+    archive["sealFailures"] = sealFailures_;
+    root["activeRows"] = activeRows_;
+    root["buffered"] = buffered_;
+    root["dropped"] = dropped_;
+    JsonObject last = root["lastQuery"].to<JsonObject>();
+    statsToJson(lastStats_, lastQueryUs_, last);
+}
+
+String History::segmentPath(uint32_t seq)
+{
+    char path[24];
+    snprintf(path, sizeof(path), "%s/%08lu.col", DIR, (unsigned long)seq);
+    return String(path);
+}
+
+bool History::readHeader(const String &path, HistorySegmentHeader &h, size_t &size)
+{
+    File f = LittleFS.open(path, FILE_READ);
+    if (!f)
+        return false;
+    size = f.size();
+    return f.read(reinterpret_cast<uint8_t *>(&h), sizeof(h)) == sizeof(h) && h.magic == HistoryCodec::MAGIC;
+}
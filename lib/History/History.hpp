@@ -0,0 +1,179 @@
+/**
+ * @file History.hpp
+ * @brief Send history on LittleFS: active row file plus columnar archive
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "HistoryCodec.hpp"
+#include "SmsJob.hpp"
+
+// ====== Tuning ======
+/**
+ * @def HISTORY_SEGMENT_ROWS
+ * @brief Rows in the active file before it is sealed into an archive segment
+ *
+ * Sealing reads the whole active file into RAM (24 bytes per row) and
+ * encodes it in one go.
+ */
+#ifndef HISTORY_SEGMENT_ROWS
+#define HISTORY_SEGMENT_ROWS 512
+#endif
+
+/**
+ * @def HISTORY_MAX_SEGMENTS
+ * @brief Archive segments kept; the oldest is deleted beyond this
+ */
+#ifndef HISTORY_MAX_SEGMENTS
+#define HISTORY_MAX_SEGMENTS 64
+#endif
+
+/**
+ * @def HISTORY_FLUSH_ROWS
+ * @brief Rows buffered in RAM before they are appended to the active file
+ *
+ * Up to this many rows are lost on a reset; fewer means more metadata
+ * commits (see FlashWear).
+ */
+#ifndef HISTORY_FLUSH_ROWS
+#define HISTORY_FLUSH_ROWS 16
+#endif
+
+/**
+ * @def HISTORY_FLUSH_MS
+ * @brief Maximum age of a buffered row before the buffer is flushed anyway
+ */
+#ifndef HISTORY_FLUSH_MS
+#define HISTORY_FLUSH_MS (10 * 60 * 1000UL)
+#endif
+
+/**
+ * @def HISTORY_QUERY_LIMIT
+ * @brief Maximum rows returned by one `GET /history`
+ */
+#ifndef HISTORY_QUERY_LIMIT
+#define HISTORY_QUERY_LIMIT 200
+#endif
+
+/**
+ * @brief Long-term record of every send attempt
+ *
+ * Three tiers, oldest first:
+ * - archive: sealed segments "/hist/<seq>.col" in the HistoryCodec columnar
+ *   format (about a quarter of the raw size)
+ * - active: "/hist/active.raw", HistoryRecord rows appended in batches
+ * - buffer: the last rows, not yet written
+ *
+ * When the active file reaches HISTORY_SEGMENT_ROWS it is encoded into a new
+ * segment and removed. Writes are non-critical for FlashWear: while throttled
+ * rows stay buffered, and once the buffer is full new rows are dropped
+ * (counted in "dropped").
+ *
+ * Queries by time range and destination skip whole segments from their
+ * header or dictionary and decode only the columns they need; the work done
+ * is reported next to the bytes a raw-row scan would have read.
+ *
+ * Registers the "history" probe.
+ */
+class History
+{
+public:
+    /**
+     * @brief Singleton accessor (same pattern as ProbeRegistry)
+     */
+    static History &instance()
+    {
+        static History inst;
+        return inst;
+    }
+
+    /**
+     * @brief Mount LittleFS and index the archive
+     *
+     * @retval true Ready
+     * @retval false Mount failed; rows are only counted
+     */
+    bool begin();
+
+    /**
+     * @brief Record the outcome of a send attempt
+     *
+     * Latency is taken from the job's trace (accept to +CMGS, or to the
+     * failure).
+     *
+     * @param job Finished job
+     * @param ok true if the network accepted it
+     * @param utc Completion time in UTC seconds (0 if the clock is not set)
+     */
+    void record(const SmsJob &job, bool ok, uint32_t utc);
+
+    /**
+     * @brief Flush aged buffered rows (call from loop())
+     */
+    void poll();
+
+    /**
+     * @brief Append the buffered rows to the active file now (e.g. before deep sleep)
+     *
+     * @retval true Buffer is empty
+     * @retval false Write throttled or failed; rows stay buffered
+     */
+    bool flush();
+
+    /**
+     * @brief Query all tiers, oldest first
+     *
+     * @param q Filter
+     * @param fn Receives matching rows; return false to stop
+     * @param stats Work counters
+     * @return uint32_t Elapsed microseconds
+     */
+    uint32_t query(const HistoryQuery &q, const HistoryRowFunction &fn, HistoryQueryStats &stats);
+
+    /**
+     * @brief Write a row: {"ts","phone","status","segments","latencyMs"}
+     */
+    static void rowToJson(const HistoryRecord &row, JsonObject &dst);
+
+    /**
+     * @brief Write query counters: {"segments","pruned","rowsScanned",
+     * "matched","columns","bytesRead","rawBytes","us"}
+     */
+    static void statsToJson(const HistoryQueryStats &stats, uint32_t us, JsonObject &dst);
+
+    /**
+     * @brief Probe output: tier sizes, compression ratio and the last query
+     */
+    void toJson(JsonObject &root);
+
+    /**
+     * @brief SMS segments needed for a body (GSM-7: 160 single, 153 per part)
+     */
+    static uint8_t segmentsFor(uint16_t bodyLen) { return bodyLen <= 160 ? 1 : uint8_t((bodyLen + 152) / 153); }
+
+private:
+    HistoryRecord buffer_[HISTORY_FLUSH_ROWS];
+    size_t buffered_ = 0;
+    uint32_t bufferedAtMs_ = 0; ///< millis() of the oldest buffered row
+    uint32_t activeRows_ = 0;
+    uint32_t firstSeq_ = 0;      ///< Oldest segment
+    uint32_t nextSeq_ = 0;       ///< Sequence of the next segment
+    uint32_t archivedRows_ = 0;
+    uint32_t archivedBytes_ = 0;
+    uint32_t dropped_ = 0;
+    uint32_t sealFailures_ = 0;
+    bool mounted_ = false;
+    HistoryQueryStats lastStats_;
+    uint32_t lastQueryUs_ = 0;
+
+    bool seal();
+    void pruneOldest();
+    static String segmentPath(uint32_t seq);
+    static bool readHeader(const String &path, HistorySegmentHeader &h, size_t &size);
+
+    History();
+    History(const History &) = delete;
+    History &operator=(const History &) = delete;
+};
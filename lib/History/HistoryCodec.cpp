@@ -0,0 +1,370 @@
+#include "HistoryCodec.hpp"
+#include <string.h>
+#include <memory>
+#include <new>
+
+namespace
+{
+    const uint8_t STATUS_BITS = 4;
+
+    void putVarint(uint8_t *&p, uint32_t v)
+    {
+        while (v >= 0x80)
+        {
+            *p++ = uint8_t(v | 0x80);
+            v >>= 7;
+        }
+        *p++ = uint8_t(v);
+    }
+
+    bool getVarint(const uint8_t *&p, const uint8_t *end, uint32_t &v)
+    {
+        v = 0;
+        for (uint8_t shift = 0; shift < 35 && p < end; shift += 7)
+        {
+            uint8_t b = *p++;
+            v |= uint32_t(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    uint32_t zigzag(int32_t d) { return (uint32_t(d) << 1) ^ uint32_t(d >> 31); }
+    int32_t unzigzag(uint32_t v) { return int32_t(v >> 1) ^ -int32_t(v & 1); }
+
+    /// Bits needed to index @p count entries
+    uint8_t bitsFor(size_t count)
+    {
+        uint8_t bits = 0;
+        while (count > 1 && (size_t(1) << bits) < count)
+            bits++;
+        return bits;
+    }
+
+    /// LSB-first bit packing into a zeroed column
+    void putBits(uint8_t *col, size_t pos, uint32_t v, uint8_t width)
+    {
+        for (uint8_t i = 0; i < width; ++i, ++pos)
+            if (v & (1u << i))
+                col[pos >> 3] |= uint8_t(1u << (pos & 7));
+    }
+
+    uint32_t getBits(const uint8_t *col, size_t pos, uint8_t width)
+    {
+        uint32_t v = 0;
+        for (uint8_t i = 0; i < width; ++i, ++pos)
+            if (col[pos >> 3] & (1u << (pos & 7)))
+                v |= 1u << i;
+        return v;
+    }
+
+    size_t packedBytes(size_t rows, uint8_t width) { return (rows * width + 7) / 8; }
+
+    int indexOf(const HistoryRecord *rows, const uint16_t *dict, size_t dictSize, const PhoneNumber &to)
+    {
+        for (size_t d = 0; d < dictSize; ++d)
+            if (rows[dict[d]].to == to)
+                return int(d);
+        return -1;
+    }
+
+    /**
+     * @brief One column loaded from a segment
+     */
+    struct Column
+    {
+        std::unique_ptr<uint8_t[]> data;
+        uint32_t len = 0;
+        bool loaded = false;
+
+        const uint8_t *begin() const { return data.get(); }
+        const uint8_t *end() const { return data.get() + len; }
+    };
+
+    bool load(HistorySource &src, const HistorySegmentHeader &h, HistoryColumn c, Column &col, HistoryQueryStats &stats)
+    {
+        if (col.loaded)
+            return true;
+        const auto &ref = h.columns[size_t(c)];
+        col.data.reset(new (std::nothrow) uint8_t[ref.length ? ref.length : 1]);
+        if (!col.data || (ref.length && !src.read(ref.offset, col.data.get(), ref.length)))
+            return false;
+        col.len = ref.length;
+        col.loaded = true;
+        stats.columnsRead++;
+        stats.bytesRead += ref.length;
+        return true;
+    }
+}
+
+bool HistoryMemorySource::read(uint32_t offset, void *dst, size_t n)
+{
+    if (offset > len || n > len - offset)
+        return false;
+    memcpy(dst, data + offset, n);
+    return true;
+}
+
+/**
+ * @brief Header plus per row: 5 byte delta, a dictionary entry, 2 byte
+ * index, status nibble and 5 byte latency
+ */
+size_t HistoryCodec::encodeBound(size_t rows)
+{
+    return sizeof(HistorySegmentHeader) + rows * (5 + PhoneNumber::PDU_ADDRESS_MAX + 2 + 1 + 5);
+}
+
+/**
+ * @brief Write the columns in HistoryColumn order, then the header
+ */
+size_t HistoryCodec::encode(const HistoryRecord *rows, size_t n, uint8_t *out, size_t cap)
+{
+    if (n == 0 || n > 0xFFFF || cap < encodeBound(n))
+        return 0;
+    std::unique_ptr<uint16_t[]> dict(new (std::nothrow) uint16_t[n]); // first row of each entry
+    if (!dict)
+        return 0;
+
+    HistorySegmentHeader h = {};
+    h.magic = MAGIC;
+    h.version = VERSION;
+    h.rows = uint32_t(n);
+    h.tsMin = UINT32_MAX;
+    uint8_t *p = out + sizeof(h);
+    auto close = [&](HistoryColumn c, const uint8_t *start)
+    {
+        h.columns[size_t(c)].offset = uint32_t(start - out);
+        h.columns[size_t(c)].length = uint32_t(p - start);
+    };
+
+    uint8_t *col = p;
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint32_t ts = rows[i].ts;
+        if (ts < h.tsMin)
+            h.tsMin = ts;
+        if (ts > h.tsMax)
+            h.tsMax = ts;
+        putVarint(p, i == 0 ? ts : zigzag(int32_t(ts - rows[i - 1].ts)));
+    }
+    close(HistoryColumn::Time, col);
+
+    col = p;
+    size_t dictSize = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (indexOf(rows, dict.get(), dictSize, rows[i].to) >= 0)
+            continue;
+        dict[dictSize++] = uint16_t(i);
+        p += rows[i].to.writePduAddress(p);
+    }
+    close(HistoryColumn::Dict, col);
+    h.dictSize = uint16_t(dictSize);
+    h.destBits = bitsFor(dictSize);
+
+    col = p;
+    memset(p, 0, packedBytes(n, h.destBits));
+    for (size_t i = 0; i < n && h.destBits; ++i)
+        putBits(col, i * h.destBits, uint32_t(indexOf(rows, dict.get(), dictSize, rows[i].to)), h.destBits);
+    p += packedBytes(n, h.destBits);
+    close(HistoryColumn::Dest, col);
+
+    col = p;
+    memset(p, 0, packedBytes(n, STATUS_BITS));
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint8_t segs = rows[i].segments < 1 ? 1 : (rows[i].segments > 4 ? 4 : rows[i].segments);
+        putBits(col, i * STATUS_BITS, (rows[i].status & 0x03) | uint32_t(segs - 1) << 2, STATUS_BITS);
+    }
+    p += packedBytes(n, STATUS_BITS);
+    close(HistoryColumn::Status, col);
+
+    col = p;
+    for (size_t i = 0; i < n; ++i)
+        putVarint(p, rows[i].latencyMs);
+    close(HistoryColumn::Latency, col);
+
+    memcpy(out, &h, sizeof(h));
+    return size_t(p - out);
+}
+
+/**
+ * @brief Prune by header and dictionary, filter on Time/Dest, then decode
+ * the output columns for matching rows only
+ */
+bool HistoryCodec::query(HistorySource &src, const HistoryQuery &q, const HistoryRowFunction &fn, HistoryQueryStats &stats)
+{
+    stats.segments++;
+    HistorySegmentHeader h;
+    if (!src.read(0, &h, sizeof(h)) || h.magic != MAGIC || h.version != VERSION)
+    {
+        stats.corrupt++;
+        return true;
+    }
+    stats.bytesRead += sizeof(h);
+    stats.rawBytes += h.rows * sizeof(HistoryRecord);
+    if (h.rows == 0 || h.tsMax < q.from || h.tsMin > q.to)
+    {
+        stats.pruned++;
+        return true;
+    }
+
+    Column cols[size_t(HistoryColumn::Count)];
+    Column &time = cols[size_t(HistoryColumn::Time)];
+    Column &dict = cols[size_t(HistoryColumn::Dict)];
+    Column &dest = cols[size_t(HistoryColumn::Dest)];
+
+    // Destination filter: find its dictionary index, prune if absent
+    int want = -1;
+    if (q.dest != nullptr)
+    {
+        if (!load(src, h, HistoryColumn::Dict, dict, stats))
+        {
+            stats.corrupt++;
+            return true;
+        }
+        const uint8_t *p = dict.begin();
+        for (int d = 0; d < h.dictSize && want < 0; ++d)
+        {
+            PhoneNumber n;
+            size_t used = n.readPduAddress(p, size_t(dict.end() - p));
+            if (used == 0)
+                break;
+            p += used;
+            if (n == *q.dest)
+                want = d;
+        }
+        if (want < 0)
+        {
+            stats.pruned++;
+            return true;
+        }
+    }
+
+    size_t rows = h.rows;
+    std::unique_ptr<uint8_t[]> match(new (std::nothrow) uint8_t[packedBytes(rows, 1)]);
+    if (!match)
+    {
+        stats.corrupt++;
+        return true;
+    }
+    bool wholeRange = q.from <= h.tsMin && h.tsMax <= q.to;
+    memset(match.get(), wholeRange ? 0xFF : 0, packedBytes(rows, 1));
+    if (!wholeRange)
+    {
+        if (!load(src, h, HistoryColumn::Time, time, stats))
+        {
+            stats.corrupt++;
+            return true;
+        }
+        const uint8_t *p = time.begin();
+        uint32_t ts = 0;
+        for (size_t i = 0; i < rows; ++i)
+        {
+            uint32_t v;
+            if (!getVarint(p, time.end(), v))
+                break;
+            ts = i == 0 ? v : ts + uint32_t(unzigzag(v));
+            if (ts >= q.from && ts <= q.to)
+                match[i >> 3] |= uint8_t(1u << (i & 7));
+        }
+    }
+    if (want >= 0 && h.destBits)
+    {
+        if (!load(src, h, HistoryColumn::Dest, dest, stats) || dest.len < packedBytes(rows, h.destBits))
+        {
+            stats.corrupt++;
+            return true;
+        }
+        for (size_t i = 0; i < rows; ++i)
+            if (getBits(dest.begin(), i * h.destBits, h.destBits) != uint32_t(want))
+                match[i >> 3] &= uint8_t(~(1u << (i & 7)));
+    }
+
+    size_t matched = 0;
+    for (size_t i = 0; i < rows; ++i)
+        matched += (match[i >> 3] >> (i & 7)) & 1;
+    stats.rowsScanned += rows;
+    stats.rowsMatched += matched;
+    if (matched == 0 || q.countOnly)
+        return true;
+
+    // Output columns
+    Column &status = cols[size_t(HistoryColumn::Status)];
+    Column &latency = cols[size_t(HistoryColumn::Latency)];
+    for (size_t c = 0; c < size_t(HistoryColumn::Count); ++c)
+    {
+        if (!load(src, h, HistoryColumn(c), cols[c], stats))
+        {
+            stats.corrupt++;
+            return true;
+        }
+    }
+    if (dest.len < packedBytes(rows, h.destBits) || status.len < packedBytes(rows, STATUS_BITS))
+    {
+        stats.corrupt++;
+        return true;
+    }
+    std::unique_ptr<PhoneNumber[]> numbers(new (std::nothrow) PhoneNumber[h.dictSize ? h.dictSize : 1]);
+    if (!numbers)
+    {
+        stats.corrupt++;
+        return true;
+    }
+    const uint8_t *p = dict.begin();
+    for (size_t d = 0; d < h.dictSize; ++d)
+    {
+        size_t used = numbers[d].readPduAddress(p, size_t(dict.end() - p));
+        if (used == 0)
+        {
+            stats.corrupt++;
+            return true;
+        }
+        p += used;
+    }
+
+    const uint8_t *tp = time.begin();
+    const uint8_t *lp = latency.begin();
+    HistoryRecord row;
+    for (size_t i = 0; i < rows; ++i)
+    {
+        uint32_t dt, ms;
+        if (!getVarint(tp, time.end(), dt) || !getVarint(lp, latency.end(), ms))
+        {
+            stats.corrupt++;
+            return true;
+        }
+        row.ts = i == 0 ? dt : row.ts + uint32_t(unzigzag(dt));
+        if (!((match[i >> 3] >> (i & 7)) & 1))
+            continue;
+        uint32_t idx = h.destBits ? getBits(dest.begin(), i * h.destBits, h.destBits) : 0;
+        uint32_t st = getBits(status.begin(), i * STATUS_BITS, STATUS_BITS);
+        row.to = idx < h.dictSize ? numbers[idx] : PhoneNumber();
+        row.latencyMs = ms;
+        row.status = uint8_t(st & 0x03);
+        row.segments = uint8_t((st >> 2) + 1);
+        if (!fn(row))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Full scan: every row is read whatever the filter
+ */
+bool HistoryCodec::queryRaw(const HistoryRecord *rows, size_t n, const HistoryQuery &q, const HistoryRowFunction &fn, HistoryQueryStats &stats)
+{
+    stats.rowsScanned += n;
+    stats.bytesRead += n * sizeof(HistoryRecord);
+    stats.rawBytes += n * sizeof(HistoryRecord);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (!matches(rows[i], q))
+            continue;
+        stats.rowsMatched++;
+        if (!q.countOnly && !fn(rows[i]))
+            return false;
+    }
+    return true;
+}
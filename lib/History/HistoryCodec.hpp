@@ -0,0 +1,201 @@
+/**
+ * @file HistoryCodec.hpp
+ * @brief Raw send-history rows and the columnar archive segment format
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include "PhoneNumber.hpp"
+
+/**
+ * @brief Outcome stored for a history row (2 bits in the archive)
+ */
+enum class HistoryStatus : uint8_t
+{
+    Failed = 0, ///< Rejected or not sendable
+    Sent = 1,   ///< Accepted by the network
+};
+
+/**
+ * @brief One send attempt in the raw (row) format, 24 bytes
+ *
+ * This is the layout of the active history file and the baseline that the
+ * archive compression ratio and query cost are reported against.
+ */
+struct HistoryRecord
+{
+    uint32_t ts = 0;        ///< UTC seconds at completion (0 = clock not set)
+    PhoneNumber to;         ///< Destination
+    uint32_t latencyMs = 0; ///< Accept to network acceptance (or failure)
+    uint8_t status = 0;     ///< HistoryStatus
+    uint8_t segments = 1;   ///< SMS segments used (1..4 kept in the archive)
+    uint16_t reserved = 0;
+};
+
+static_assert(sizeof(HistoryRecord) == 24, "HistoryRecord is the on-flash row format");
+
+/**
+ * @brief Columns of an archive segment, in file order
+ */
+enum class HistoryColumn : uint8_t
+{
+    Time = 0, ///< First timestamp, then zigzag varint deltas
+    Dict,     ///< Distinct destinations as PDU address fields
+    Dest,     ///< Per-row dictionary index, bit-packed
+    Status,   ///< Per-row status (2 bits) | (segments - 1) (2 bits)
+    Latency,  ///< Per-row latency in ms, varint
+    Count
+};
+
+/**
+ * @brief Fixed header of an archive segment, followed by the columns
+ *
+ * Stored little-endian as-is. The column directory lets a query read only
+ * the byte ranges of the columns it needs.
+ */
+struct HistorySegmentHeader
+{
+    uint32_t magic;    ///< HistoryCodec::MAGIC
+    uint8_t version;   ///< HistoryCodec::VERSION
+    uint8_t destBits;  ///< Width of a Dest entry
+    uint16_t dictSize; ///< Distinct destinations
+    uint32_t rows;     ///< Rows in the segment
+    uint32_t tsMin;    ///< Earliest timestamp (time-range pruning)
+    uint32_t tsMax;    ///< Latest timestamp
+    struct
+    {
+        uint32_t offset; ///< From the start of the segment
+        uint32_t length; ///< Bytes
+    } columns[size_t(HistoryColumn::Count)];
+};
+
+/**
+ * @brief Random-access byte source holding one archive segment
+ */
+class HistorySource
+{
+public:
+    virtual ~HistorySource() = default;
+
+    /**
+     * @brief Read @p len bytes at @p offset
+     *
+     * @retval true All bytes were read
+     * @retval false Out of range or I/O error
+     */
+    virtual bool read(uint32_t offset, void *dst, size_t len) = 0;
+};
+
+/**
+ * @brief HistorySource over a segment held in memory
+ */
+class HistoryMemorySource : public HistorySource
+{
+public:
+    HistoryMemorySource(const uint8_t *data, size_t len) : data(data), len(len) {}
+    bool read(uint32_t offset, void *dst, size_t n) override;
+
+private:
+    const uint8_t *data;
+    size_t len;
+};
+
+/**
+ * @brief Time range / destination filter
+ */
+struct HistoryQuery
+{
+    uint32_t from = 0;                ///< Inclusive lower bound (UTC seconds)
+    uint32_t to = UINT32_MAX;         ///< Inclusive upper bound
+    const PhoneNumber *dest = nullptr; ///< Only this destination (nullptr = all)
+    bool countOnly = false;           ///< Count matches without decoding output columns
+};
+
+/**
+ * @brief Work done by one or more queries (accumulated)
+ */
+struct HistoryQueryStats
+{
+    uint32_t segments = 0;      ///< Archive segments considered
+    uint32_t pruned = 0;        ///< Segments skipped from the header or dictionary alone
+    uint32_t corrupt = 0;       ///< Segments with a bad header or unreadable column
+    uint32_t rowsScanned = 0;   ///< Rows whose filter columns were decoded
+    uint32_t rowsMatched = 0;   ///< Rows passing the filter
+    uint32_t columnsRead = 0;   ///< Columns loaded
+    uint32_t bytesRead = 0;     ///< Bytes loaded (headers and columns)
+    uint32_t rawBytes = 0;      ///< Bytes a row-format scan of the same rows reads
+};
+
+/**
+ * @brief Called per matching row in time order; return false to stop
+ */
+using HistoryRowFunction = std::function<bool(const HistoryRecord &row)>;
+
+/**
+ * @brief Encoder and column-selective reader for archive segments
+ *
+ * A segment rolls a sealed run of raw rows into columns:
+ * - Time: absolute first timestamp, then zigzag varint deltas (1 byte for
+ *   gaps under a minute)
+ * - Dict + Dest: each distinct destination stored once as its PDU address
+ *   (4..12 bytes), rows keep a ceil(log2(dictSize)) bit index
+ * - Status: status and segment count packed in 4 bits
+ * - Latency: varint milliseconds (2 bytes up to 16 s)
+ *
+ * Queries first check the header time range, then the dictionary for a
+ * destination filter (absent destination: nothing else is read), then decode
+ * Time and Dest only as far as needed to filter; the output columns are read
+ * only when a row matched.
+ *
+ * No Arduino dependency.
+ */
+class HistoryCodec
+{
+public:
+    static constexpr uint32_t MAGIC = 0x4C4F4348; ///< "HCOL"
+    static constexpr uint8_t VERSION = 1;
+
+    /**
+     * @brief Worst-case segment size for @p rows rows
+     */
+    static size_t encodeBound(size_t rows);
+
+    /**
+     * @brief Encode raw rows (in time order) into one segment
+     *
+     * @param rows Rows to archive (1..65535)
+     * @param n Row count
+     * @param out Destination (at least encodeBound(n) bytes)
+     * @param cap Capacity of @p out
+     * @return size_t Segment size, or 0 on bad input or out of memory
+     */
+    static size_t encode(const HistoryRecord *rows, size_t n, uint8_t *out, size_t cap);
+
+    /**
+     * @brief Run a query against one segment
+     *
+     * @param src Segment bytes
+     * @param q Filter
+     * @param fn Receives matching rows (unused with HistoryQuery::countOnly)
+     * @param stats Accumulated work counters
+     * @retval true Continue with the next segment
+     * @retval false @p fn asked to stop
+     */
+    static bool query(HistorySource &src, const HistoryQuery &q, const HistoryRowFunction &fn, HistoryQueryStats &stats);
+
+    /**
+     * @brief Run the same query over raw rows (the active file, or a baseline)
+     */
+    static bool queryRaw(const HistoryRecord *rows, size_t n, const HistoryQuery &q, const HistoryRowFunction &fn, HistoryQueryStats &stats);
+
+    /**
+     * @brief Check a row against a filter
+     */
+    static bool matches(const HistoryRecord &row, const HistoryQuery &q)
+    {
+        return row.ts >= q.from && row.ts <= q.to && (q.dest == nullptr || row.to == *q.dest);
+    }
+};
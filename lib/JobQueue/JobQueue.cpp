@@ -0,0 +1,281 @@
+#include "JobQueue.hpp"
+
+namespace
+{
+    /**
+     * @brief Request fields of a parked job, kept through deep sleep
+     */
+    struct CarriedJob
+    {
+        uint32_t id;
+        uint32_t releaseAt;
+        PhoneNumber to;
+        JobPriority priority;
+        uint16_t bodyLen;
+        uint16_t windowStart;
+        uint16_t windowEnd;
+        char body[JOB_BODY_MAX + 1];
+    };
+
+    const uint32_t CARRY_MAGIC = 0x4A4F4253; // "JOBS"
+    RTC_DATA_ATTR uint32_t carryMagic;
+    RTC_DATA_ATTR uint32_t carryNextId;
+    RTC_DATA_ATTR uint8_t carryCount;
+    RTC_DATA_ATTR CarriedJob carried[JOB_CARRY_MAX];
+}
+
+/**
+ * @brief Bind each job record to its payload slab region and register the probe
+ */
+JobQueue::JobQueue()
+{
+    for (size_t i = 0; i < JOB_SLOTS; ++i)
+    {
+        jobs_[i].body = slab_[i];
+        slab_[i][0] = '\0';
+    }
+    ProbeRegistry::instance().registerProbe("jobs", [this](JsonObject &dst)
+                                            {
+        dst["inUse"]   = inUse();
+        dst["pending"] = pending();
+        dst["parked"]  = parked();
+        if (parkedCount_)
+            dst["nextRelease"] = nextRelease();
+        JsonObject stages = dst["stages"].to<JsonObject>();
+        JobTracer::instance().statsToJson(stages); });
+}
+
+/**
+ * @brief Reserve the first free slot and assign it a new id
+ */
+SmsJob *JobQueue::acquire()
+{
+    for (size_t i = 0; i < JOB_SLOTS; ++i)
+    {
+        if (!used_[i])
+        {
+            used_[i] = true;
+            SmsJob &job = jobs_[i];
+            job.resetRequest();
+            job.id = nextId_++;
+            if (nextId_ == 0)
+                nextId_ = 1;
+            return &job;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Mark a slot as free again
+ */
+void JobQueue::release(SmsJob *job)
+{
+    if (job == nullptr || job < jobs_ || job >= jobs_ + JOB_SLOTS)
+        return;
+    size_t i = size_t(job - jobs_);
+    job->id = 0;
+    used_[i] = false;
+}
+
+/**
+ * @brief Mark a job as queued and stamp its FIFO sequence
+ */
+void JobQueue::enqueue(SmsJob *job)
+{
+    if (job == nullptr)
+        return;
+    job->seq = nextSeq_++;
+    job->state = JobState::Queued;
+    JobTracer::instance().mark(job->id, TraceStage::Enqueue);
+}
+
+/**
+ * @brief Select the highest priority, oldest queued job
+ */
+SmsJob *JobQueue::dequeue()
+{
+    SmsJob *best = nullptr;
+    for (size_t i = 0; i < JOB_SLOTS; ++i)
+    {
+        SmsJob &j = jobs_[i];
+        if (!used_[i] || j.state != JobState::Queued)
+            continue;
+        if (best == nullptr || j.priority > best->priority ||
+            (j.priority == best->priority && int32_t(j.seq - best->seq) < 0))
+            best = &j;
+    }
+    if (best != nullptr)
+    {
+        best->state = JobState::Sending;
+        JobTracer::instance().mark(best->id, TraceStage::Dequeue);
+    }
+    return best;
+}
+
+/**
+ * @brief Insert a job into the release-time heap
+ */
+bool JobQueue::park(SmsJob *job, uint32_t releaseAt)
+{
+    if (job == nullptr || parkedCount_ >= JOB_PARK_MAX)
+        return false;
+    job->releaseAt = releaseAt;
+    job->state = JobState::Parked;
+    parked_[parkedCount_] = job;
+    siftUp(parkedCount_++);
+    return true;
+}
+
+/**
+ * @brief Pop the heap root when its release time has come
+ */
+SmsJob *JobQueue::popDue(uint32_t now)
+{
+    if (parkedCount_ == 0 || parked_[0]->releaseAt > now)
+        return nullptr;
+    SmsJob *job = parked_[0];
+    parked_[0] = parked_[--parkedCount_];
+    siftDown(0);
+    return job;
+}
+
+/**
+ * @brief Heap root's release time
+ */
+uint32_t JobQueue::nextRelease() const
+{
+    return parkedCount_ ? parked_[0]->releaseAt : 0;
+}
+
+void JobQueue::siftUp(size_t i)
+{
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (parked_[parent]->releaseAt <= parked_[i]->releaseAt)
+            break;
+        SmsJob *tmp = parked_[parent];
+        parked_[parent] = parked_[i];
+        parked_[i] = tmp;
+        i = parent;
+    }
+}
+
+void JobQueue::siftDown(size_t i)
+{
+    while (true)
+    {
+        size_t l = 2 * i + 1;
+        size_t r = l + 1;
+        size_t m = i;
+        if (l < parkedCount_ && parked_[l]->releaseAt < parked_[m]->releaseAt)
+            m = l;
+        if (r < parkedCount_ && parked_[r]->releaseAt < parked_[m]->releaseAt)
+            m = r;
+        if (m == i)
+            return;
+        SmsJob *tmp = parked_[m];
+        parked_[m] = parked_[i];
+        parked_[i] = tmp;
+        i = m;
+    }
+}
+
+/**
+ * @brief Save every parked job, or none when they do not all fit
+ */
+bool JobQueue::hibernate()
+{
+    carryMagic = 0;
+    if (parkedCount_ > JOB_CARRY_MAX)
+        return false;
+    for (size_t i = 0; i < parkedCount_; ++i)
+    {
+        const SmsJob &job = *parked_[i];
+        CarriedJob &c = carried[i];
+        c.id = job.id;
+        c.releaseAt = job.releaseAt;
+        c.to = job.to;
+        c.priority = job.priority;
+        c.bodyLen = job.bodyLen;
+        c.windowStart = job.windowStart;
+        c.windowEnd = job.windowEnd;
+        memcpy(c.body, job.body, job.bodyLen + 1u);
+    }
+    carryCount = uint8_t(parkedCount_);
+    carryNextId = nextId_;
+    carryMagic = CARRY_MAGIC;
+    return true;
+}
+
+/**
+ * @brief Re-acquire and park the saved jobs; the saved copy is used once
+ */
+size_t JobQueue::restore()
+{
+    if (carryMagic != CARRY_MAGIC)
+        return 0;
+    carryMagic = 0;
+    if (int32_t(carryNextId - nextId_) > 0)
+        nextId_ = carryNextId;
+    size_t n = 0;
+    for (uint8_t i = 0; i < carryCount; ++i)
+    {
+        SmsJob *job = acquire();
+        if (job == nullptr)
+            break;
+        const CarriedJob &c = carried[i];
+        job->id = c.id;
+        job->to = c.to;
+        job->priority = c.priority;
+        job->bodyLen = c.bodyLen;
+        job->windowStart = c.windowStart;
+        job->windowEnd = c.windowEnd;
+        memcpy(job->body, c.body, c.bodyLen + 1u);
+        job->detached = true;
+        JobTracer::instance().begin(job->id);
+        if (!park(job, c.releaseAt))
+        {
+            release(job);
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Find an occupied slot by job id
+ */
+SmsJob *JobQueue::find(uint32_t id)
+{
+    for (size_t i = 0; i < JOB_SLOTS; ++i)
+    {
+        if (used_[i] && jobs_[i].id == id)
+            return &jobs_[i];
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Count queued jobs
+ */
+size_t JobQueue::pending() const
+{
+    size_t n = 0;
+    for (size_t i = 0; i < JOB_SLOTS; ++i)
+        n += (used_[i] && jobs_[i].state == JobState::Queued) ? 1 : 0;
+    return n;
+}
+
+/**
+ * @brief Count occupied slots
+ */
+size_t JobQueue::inUse() const
+{
+    size_t n = 0;
+    for (size_t i = 0; i < JOB_SLOTS; ++i)
+        n += used_[i] ? 1 : 0;
+    return n;
+}
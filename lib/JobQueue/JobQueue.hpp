@@ -0,0 +1,193 @@
+#pragma once
+
+#include "SmsJob.hpp"
+#include "JobTracer.hpp"
+#include "ProbeRegistry.hpp"
+
+// ====== Tuning ======
+/**
+ * @def JOB_SLOTS
+ * @brief Number of preallocated job records (and payload slab regions)
+ */
+#ifndef JOB_SLOTS
+#define JOB_SLOTS 8
+#endif
+
+/**
+ * @def JOB_PARK_MAX
+ * @brief Slots that parked (windowed) jobs may hold at once
+ *
+ * The remaining JOB_SLOTS - JOB_PARK_MAX slots stay free for live traffic,
+ * so a parked campaign never makes /send, WS, CoAP or SMTP report busy.
+ */
+#ifndef JOB_PARK_MAX
+#define JOB_PARK_MAX 4
+#endif
+
+/**
+ * @def JOB_CARRY_MAX
+ * @brief Parked jobs kept in RTC memory through deep sleep
+ *
+ * Each costs about JOB_BODY_MAX + 32 bytes of the 8 KB RTC slow memory.
+ * With more jobs parked the device stays awake.
+ */
+#ifndef JOB_CARRY_MAX
+#define JOB_CARRY_MAX JOB_PARK_MAX
+#endif
+
+static_assert(JOB_PARK_MAX < JOB_SLOTS, "JOB_PARK_MAX must leave slots for live traffic");
+
+/**
+ * @brief Outcome of scheduling a windowed job
+ */
+enum class ScheduleResult : uint8_t
+{
+    Accepted = 0, ///< Queued, or parked until its window opens
+    ParkFull,     ///< Would be parked but JOB_PARK_MAX jobs already are
+    WindowNever,  ///< The window never opens in all of the destination's zones
+};
+
+/**
+ * @brief Fixed-capacity pool and priority queue of SMS job records
+ *
+ * All job storage (records and message bodies) is allocated once, as a
+ * single static slab. Ingress paths acquire a slot, decode directly into it
+ * and enqueue it; the dispatcher dequeues jobs highest priority first, FIFO
+ * within a priority.
+ *
+ * Jobs outside their send window are parked in a binary min-heap keyed by
+ * release time instead of the queue, so they are never rescanned by
+ * dequeue() and the next due job is found in O(1). At most JOB_PARK_MAX
+ * jobs are parked, keeping a reserve of slots for live traffic.
+ *
+ * Design goals:
+ * - Zero dynamic allocations per request
+ * - Message bodies live in one contiguous payload slab
+ * - Job ids are monotonic and never 0
+ *
+ * Parked jobs survive deep sleep: hibernate() copies them to RTC memory
+ * and restore() parks them again after the wake.
+ *
+ * Registers a "jobs" probe with queue occupancy and per-stage latency.
+ */
+class JobQueue
+{
+public:
+    /**
+     * @brief Construct the pool and bind every slot to its slab region
+     */
+    JobQueue();
+
+    /**
+     * @brief Reserve a free job slot
+     *
+     * The returned record has a fresh id and cleared request fields.
+     *
+     * @return SmsJob* Reserved slot, or nullptr when all slots are in use
+     */
+    SmsJob *acquire();
+
+    /**
+     * @brief Return a slot to the pool
+     *
+     * @param job Slot previously returned by acquire()
+     */
+    void release(SmsJob *job);
+
+    /**
+     * @brief Put a decoded job in the queue
+     *
+     * Records TraceStage::Enqueue for the job.
+     *
+     * @param job Slot previously returned by acquire()
+     */
+    void enqueue(SmsJob *job);
+
+    /**
+     * @brief Take the next job to send
+     *
+     * Picks the highest priority queued job, oldest first, marks it as
+     * JobState::Sending and records TraceStage::Dequeue.
+     *
+     * @return SmsJob* Next job, or nullptr when nothing is queued
+     */
+    SmsJob *dequeue();
+
+    /**
+     * @brief Hold a job until a given time
+     *
+     * @param job Slot previously returned by acquire()
+     * @param releaseAt UTC seconds from which the job is due (0 = due as soon
+     *        as the wall clock is known)
+     * @retval true Parked
+     * @retval false JOB_PARK_MAX jobs are already parked; the job is unchanged
+     */
+    bool park(SmsJob *job, uint32_t releaseAt);
+
+    /**
+     * @brief Take the parked job with the earliest release time if it is due
+     *
+     * @param now Current UTC seconds
+     * @return SmsJob* Due job (still JobState::Parked), or nullptr
+     */
+    SmsJob *popDue(uint32_t now);
+
+    /**
+     * @brief Release time of the earliest parked job
+     *
+     * @return uint32_t UTC seconds, or 0 when nothing is parked
+     */
+    uint32_t nextRelease() const;
+
+    /**
+     * @brief Copy the parked jobs to RTC memory before deep sleep
+     *
+     * @retval true Every parked job was saved
+     * @retval false More than JOB_CARRY_MAX jobs are parked; none was saved
+     */
+    bool hibernate();
+
+    /**
+     * @brief Park the jobs saved by hibernate() again, once after a deep-sleep wake
+     *
+     * Restored jobs keep their id and are detached (the dispatcher releases
+     * their slots). Nothing happens after a power-on or a second call.
+     *
+     * @return size_t Jobs restored
+     */
+    size_t restore();
+
+    /**
+     * @brief Look up an in-flight job by id
+     *
+     * @return SmsJob* The job, or nullptr if its slot was already released
+     */
+    SmsJob *find(uint32_t id);
+
+    /**
+     * @brief Number of slots currently in use
+     */
+    size_t inUse() const;
+
+    /**
+     * @brief Number of jobs waiting in the queue
+     */
+    size_t pending() const;
+
+    /**
+     * @brief Number of jobs parked until their send window opens
+     */
+    size_t parked() const { return parkedCount_; }
+
+private:
+    SmsJob jobs_[JOB_SLOTS];                  ///< Job records
+    bool used_[JOB_SLOTS] = {};               ///< Slot occupancy
+    char slab_[JOB_SLOTS][JOB_BODY_MAX + 1];  ///< Payload slab (one body per slot)
+    uint32_t nextId_ = 1;                     ///< Next job id to hand out
+    uint32_t nextSeq_ = 0;                    ///< Enqueue sequence counter
+    SmsJob *parked_[JOB_PARK_MAX] = {};       ///< Min-heap of parked jobs by releaseAt
+    size_t parkedCount_ = 0;                  ///< Entries in parked_
+
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+};
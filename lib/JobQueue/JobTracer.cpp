@@ -0,0 +1,228 @@
+#include "JobTracer.hpp"
+
+/**
+ * @brief Claim the oldest ring entry for a new job and stamp the accept time
+ */
+void JobTracer::begin(uint32_t jobId)
+{
+    JobTrace &t = ring_[head_];
+    head_ = (head_ + 1) % TRACE_RING;
+    t = JobTrace();
+    t.jobId = jobId;
+    t.startMs = millis();
+    t.startUs = micros();
+    for (auto &o : t.offsetUs)
+        o = JobTrace::UNSET;
+    t.offsetUs[size_t(TraceStage::Accept)] = 0;
+}
+
+/**
+ * @brief Record a stage at the current time (offset from accept)
+ */
+void JobTracer::mark(uint32_t jobId, TraceStage stage)
+{
+    JobTrace *t = lookup(jobId);
+    if (t == nullptr)
+        return;
+    // Late stages (delivery) may arrive long after micros() wrapped
+    uint32_t elapsedMs = millis() - t->startMs;
+    uint32_t offset = (elapsedMs > 3600000u) ? JobTrace::LATE : micros() - t->startUs;
+    record(*t, stage, offset);
+}
+
+/**
+ * @brief Store the +CMGS message reference and record TraceStage::MsgRef
+ */
+void JobTracer::setMsgRef(uint32_t jobId, int16_t msgRef)
+{
+    JobTrace *t = lookup(jobId);
+    if (t == nullptr)
+        return;
+    t->msgRef = msgRef;
+    mark(jobId, TraceStage::MsgRef);
+}
+
+/**
+ * @brief Flag a trace as failed
+ */
+void JobTracer::fail(uint32_t jobId)
+{
+    JobTrace *t = lookup(jobId);
+    if (t != nullptr)
+        t->failed = true;
+}
+
+/**
+ * @brief Find the newest trace with this message reference and mark delivery
+ *
+ * TP-MR is only 8 bits wide, so searching newest-first picks the most recent
+ * job that used the reference.
+ */
+bool JobTracer::deliveryReport(int16_t msgRef, uint8_t status)
+{
+    for (size_t k = 1; k <= TRACE_RING; ++k)
+    {
+        JobTrace &t = ring_[(head_ + TRACE_RING - k) % TRACE_RING];
+        if (t.jobId != 0 && t.msgRef == msgRef && !t.has(TraceStage::Delivered))
+        {
+            t.deliveryStatus = status;
+            mark(t.jobId, TraceStage::Delivered);
+            if (delivery_)
+                delivery_(t.jobId, status);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Copy out a trace by job id
+ */
+bool JobTracer::find(uint32_t jobId, JobTrace &out) const
+{
+    for (const auto &t : ring_)
+    {
+        if (t.jobId != 0 && t.jobId == jobId)
+        {
+            out = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Serialize a trace as a flat list of reached stages
+ */
+void JobTracer::toJson(const JobTrace &t, JsonObject &root)
+{
+    root["id"] = t.jobId;
+    root["startMs"] = t.startMs;
+    root["msgRef"] = t.msgRef;
+    root["failed"] = t.failed;
+    if (t.deliveryStatus != 0xFF)
+        root["deliveryStatus"] = t.deliveryStatus;
+    JsonArray spans = root["spans"].to<JsonArray>();
+    for (size_t i = 0; i < size_t(TraceStage::Count); ++i)
+    {
+        if (t.offsetUs[i] == JobTrace::UNSET)
+            continue;
+        JsonObject s = spans.add<JsonObject>();
+        s["stage"] = stageName(TraceStage(i));
+        if (t.offsetUs[i] == JobTrace::LATE)
+            s["late"] = true;
+        else
+            s["atUs"] = t.offsetUs[i];
+    }
+}
+
+/**
+ * @brief Serialize a trace as Chrome Trace Event JSON ("X" events)
+ */
+void JobTracer::toChromeTrace(const JobTrace &t, JsonObject &root)
+{
+    JsonArray events = root["traceEvents"].to<JsonArray>();
+    uint64_t base = uint64_t(t.startMs) * 1000u;
+    uint32_t prev = 0;
+    for (size_t i = 0; i < size_t(TraceStage::Count); ++i)
+    {
+        uint32_t at = t.offsetUs[i];
+        if (at == JobTrace::UNSET || at == JobTrace::LATE)
+            continue;
+        JsonObject e = events.add<JsonObject>();
+        e["name"] = stageName(TraceStage(i));
+        e["cat"] = "sms";
+        e["ph"] = "X";
+        e["ts"] = base + prev;
+        e["dur"] = at - prev;
+        e["pid"] = 1;
+        e["tid"] = t.jobId;
+        prev = at;
+    }
+    root["displayTimeUnit"] = "ms";
+}
+
+/**
+ * @brief Serialize per-stage aggregates for the metrics probe
+ */
+void JobTracer::statsToJson(JsonObject &root) const
+{
+    for (size_t i = 1; i < size_t(TraceStage::Count); ++i)
+    {
+        const StageStats &s = stats_[i];
+        JsonObject o = root[stageName(TraceStage(i))].to<JsonObject>();
+        o["count"] = s.count;
+        o["avgUs"] = s.count ? uint32_t(s.sumUs / s.count) : 0;
+        o["maxUs"] = s.maxUs;
+        o["late"] = s.late;
+    }
+}
+
+/**
+ * @brief Lowercase stage identifiers used in JSON and trace exports
+ */
+const char *JobTracer::stageName(TraceStage s)
+{
+    switch (s)
+    {
+    case TraceStage::Accept:
+        return "accept";
+    case TraceStage::Enqueue:
+        return "enqueue";
+    case TraceStage::Dequeue:
+        return "dequeue";
+    case TraceStage::RegCheck:
+        return "reg_check";
+    case TraceStage::CmgsIssued:
+        return "cmgs";
+    case TraceStage::MsgRef:
+        return "msg_ref";
+    case TraceStage::Delivered:
+        return "delivered";
+    default:
+        return "unknown";
+    }
+}
+
+JobTrace *JobTracer::lookup(uint32_t jobId)
+{
+    if (jobId == 0)
+        return nullptr;
+    for (auto &t : ring_)
+    {
+        if (t.jobId == jobId)
+            return &t;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Store a stage offset once and fold the step latency into the stats
+ */
+void JobTracer::record(JobTrace &t, TraceStage stage, uint32_t offsetUs)
+{
+    size_t idx = size_t(stage);
+    if (t.offsetUs[idx] != JobTrace::UNSET)
+        return; // first occurrence wins
+
+    t.offsetUs[idx] = offsetUs;
+    StageStats &s = stats_[idx];
+    if (offsetUs == JobTrace::LATE)
+    {
+        s.late++; // no step latency to report
+        return;
+    }
+
+    // Step latency: time since the latest earlier stage that was reached
+    uint32_t prev = 0;
+    for (size_t i = 0; i < idx; ++i)
+    {
+        if (t.offsetUs[i] < JobTrace::LATE && t.offsetUs[i] <= offsetUs)
+            prev = t.offsetUs[i];
+    }
+    uint32_t step = offsetUs - prev;
+    s.count++;
+    s.sumUs += step;
+    if (step > s.maxUs)
+        s.maxUs = step;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file JobTracer.hpp
+ * @brief Per-job timestamped spans from HTTP accept to delivery report
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+
+// ====== Tuning ======
+/**
+ * @def TRACE_RING
+ * @brief Number of job traces kept (oldest overwritten first)
+ *
+ * Traces outlive their job slot so that late delivery reports can still be
+ * attached and `GET /jobs/{id}/trace` works after the job finished.
+ */
+#ifndef TRACE_RING
+#define TRACE_RING 32
+#endif
+
+/**
+ * @brief Milestones of a job, in the order they normally happen
+ */
+enum class TraceStage : uint8_t
+{
+    Accept = 0, ///< Request received by an ingress (HTTP)
+    Enqueue,    ///< Job put in the queue
+    Dequeue,    ///< Job taken by the dispatcher
+    RegCheck,   ///< CS registration confirmed
+    CmgsIssued, ///< AT+CMGS sent to the modem
+    MsgRef,     ///< +CMGS: <mr> received (network accepted)
+    Delivered,  ///< +CDS status report received
+    Count
+};
+
+/**
+ * @brief Compact trace of one job (44 bytes)
+ *
+ * Stage times are microsecond offsets from the accept time; UNSET marks a
+ * stage that has not been reached (yet) and LATE one reached more than an
+ * hour after accept, past what micros() can measure.
+ */
+struct JobTrace
+{
+    static constexpr uint32_t UNSET = 0xFFFFFFFFu;
+    static constexpr uint32_t LATE = 0xFFFFFFFEu;
+
+    uint32_t jobId = 0;                                    ///< Owning job id (0 = empty entry)
+    uint32_t startMs = 0;                                  ///< millis() at accept
+    uint32_t startUs = 0;                                  ///< micros() at accept
+    uint32_t offsetUs[size_t(TraceStage::Count)];          ///< Per-stage offset from accept
+    int16_t msgRef = -1;                                   ///< TP-MR used to match delivery reports
+    uint8_t deliveryStatus = 0xFF;                         ///< TP-ST from +CDS (0xFF = none)
+    bool failed = false;                                   ///< Job ended in failure
+
+    /** @return true if the given stage has been recorded */
+    bool has(TraceStage s) const { return offsetUs[size_t(s)] != UNSET; }
+};
+
+/**
+ * @brief Bounded ring of job traces plus aggregated per-stage latency
+ *
+ * Ingress paths, the dispatcher and the modem record milestones by job id.
+ * Each recorded stage also feeds a per-stage aggregate (count/avg/max of the
+ * time since the previous recorded stage), exported via the "jobs" probe.
+ * LATE stages are only counted ("late"), not folded into avg/max.
+ *
+ * Usage:
+ * - JobTracer::instance().begin(job.id) at accept
+ * - JobTracer::instance().mark(job.id, TraceStage::Enqueue) afterwards
+ */
+class JobTracer
+{
+public:
+    /**
+     * @brief Observer of matched delivery reports
+     *
+     * @param jobId Job the report belongs to
+     * @param status TP-ST (0 = delivered)
+     */
+    using DeliveryFunction = std::function<void(uint32_t jobId, uint8_t status)>;
+
+    /**
+     * @brief Singleton accessor (same pattern as ProbeRegistry)
+     */
+    static JobTracer &instance()
+    {
+        static JobTracer inst;
+        return inst;
+    }
+
+    /**
+     * @brief Start a trace for a new job and record TraceStage::Accept
+     *
+     * @param jobId Job id (must be non-zero)
+     */
+    void begin(uint32_t jobId);
+
+    /**
+     * @brief Record a stage for a job
+     *
+     * Ignored if the trace was already overwritten by newer jobs.
+     *
+     * @param jobId Job id
+     * @param stage Stage reached now
+     */
+    void mark(uint32_t jobId, TraceStage stage);
+
+    /**
+     * @brief Attach the message reference returned by +CMGS
+     *
+     * Also records TraceStage::MsgRef.
+     */
+    void setMsgRef(uint32_t jobId, int16_t msgRef);
+
+    /**
+     * @brief Flag a job as failed (terminal, no further stages expected)
+     */
+    void fail(uint32_t jobId);
+
+    /**
+     * @brief Match a +CDS status report to its job and record delivery
+     *
+     * @param msgRef TP-MR from the status report
+     * @param status TP-ST from the status report (0 = delivered)
+     * @retval true A matching trace was found
+     * @retval false No recent job used this reference
+     */
+    bool deliveryReport(int16_t msgRef, uint8_t status);
+
+    /**
+     * @brief Set the observer called for every matched delivery report
+     */
+    void onDelivery(DeliveryFunction fn) { delivery_ = fn; }
+
+    /**
+     * @brief Copy a trace by job id
+     *
+     * @param jobId Job id to look up
+     * @param out Destination copy
+     * @retval true Trace found
+     * @retval false Unknown or already overwritten
+     */
+    bool find(uint32_t jobId, JobTrace &out) const;
+
+    /**
+     * @brief Write a trace as JSON: {"id","msgRef","spans":[{"stage","atUs"}]}
+     */
+    static void toJson(const JobTrace &t, JsonObject &root);
+
+    /**
+     * @brief Write a trace in Chrome Trace Event format
+     *
+     * One complete ("X") event per reached stage spanning from the previous
+     * stage, with the job id as thread id. Loadable in chrome://tracing and
+     * Perfetto.
+     */
+    static void toChromeTrace(const JobTrace &t, JsonObject &root);
+
+    /**
+     * @brief Write per-stage aggregates: {"<stage>":{"count","avgUs","maxUs","late"}}
+     */
+    void statsToJson(JsonObject &root) const;
+
+    /** @return Stable lowercase name of a stage (used in JSON output) */
+    static const char *stageName(TraceStage s);
+
+private:
+    /**
+     * @brief Aggregated latency of one stage relative to the previous one
+     */
+    struct StageStats
+    {
+        uint32_t count = 0;
+        uint64_t sumUs = 0;
+        uint32_t maxUs = 0;
+        uint32_t late = 0; ///< Reached after more than an hour (not in count/sum/max)
+    };
+
+    JobTrace ring_[TRACE_RING];
+    size_t head_ = 0;
+    StageStats stats_[size_t(TraceStage::Count)];
+    DeliveryFunction delivery_;
+
+    JobTrace *lookup(uint32_t jobId);
+    void record(JobTrace &t, TraceStage stage, uint32_t offsetUs);
+
+    JobTracer() = default;
+    JobTracer(const JobTracer &) = delete;
+    JobTracer &operator=(const JobTracer &) = delete;
+};
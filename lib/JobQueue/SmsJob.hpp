@@ -0,0 +1,133 @@
+/**
+ * @file SmsJob.hpp
+ * @brief Preallocated SMS job record shared by ingress paths and the modem
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "PhoneNumber.hpp"
+
+// ====== Tuning ======
+/**
+ * @def JOB_BODY_MAX
+ * @brief Maximum message body size in bytes (UTF-8) held by a job
+ *
+ * Each job slot owns a fixed region of this size (+1 for NUL) in the
+ * JobQueue payload slab. 480 bytes allows up to three concatenated
+ * GSM-7 segments.
+ */
+#ifndef JOB_BODY_MAX
+#define JOB_BODY_MAX 480
+#endif
+
+/**
+ * @def JOB_MAX_SEGMENTS
+ * @brief Most concatenated SMS parts a job may be split into
+ *
+ * JOB_BODY_MAX bytes of GSM-7 text need up to four 153-septet parts once
+ * extension characters (two septets each) are counted.
+ */
+#ifndef JOB_MAX_SEGMENTS
+#define JOB_MAX_SEGMENTS 4
+#endif
+
+/**
+ * @brief Scheduling priority of a job
+ */
+enum class JobPriority : uint8_t
+{
+    Low = 0,    ///< Bulk traffic, may be delayed
+    Normal = 1, ///< Default
+    High = 2,   ///< Alarms/OTPs, never delayed by bulk traffic
+};
+
+/**
+ * @brief Lifecycle state of a job
+ */
+enum class JobState : uint8_t
+{
+    Decoding = 0,   ///< Slot acquired, request being decoded
+    Parked,         ///< Outside its send window, waiting for release
+    Queued,         ///< Waiting in the queue
+    Sending,        ///< Owned by the modem
+    Sent,           ///< Accepted by the network (+CMGS returned)
+    Failed,         ///< Rejected or not sendable
+};
+
+/**
+ * @brief Submit state of one part of a (possibly concatenated) message
+ */
+enum class SegmentState : uint8_t
+{
+    Pending = 0, ///< Not submitted yet
+    Sent,        ///< +CMGS returned a message reference
+    Failed,      ///< Last attempt failed
+};
+
+/**
+ * @brief Per-part submit record (6 bytes)
+ */
+struct SmsSegment
+{
+    int16_t msgRef = -1;                    ///< TP-MR of this part (-1 = none)
+    int16_t lastError = 0;                  ///< +CMS ERROR code of the last failure (-1 = timeout)
+    SegmentState state = SegmentState::Pending; ///< Submit state
+    uint8_t attempts = 0;                   ///< Submits tried
+};
+
+/**
+ * @brief One SMS to send, stored in a preallocated JobQueue slot
+ *
+ * Decoders write straight into this record; the body points into the
+ * queue's payload slab, so no heap allocation happens per request.
+ */
+struct SmsJob
+{
+    uint32_t id = 0;                          ///< Monotonic job id (0 = unused slot)
+    PhoneNumber to;                           ///< Destination number (packed)
+    JobPriority priority = JobPriority::Normal; ///< Scheduling priority
+    uint16_t bodyLen = 0;                     ///< Body length in bytes (excluding NUL)
+    char *body = nullptr;                     ///< NUL-terminated body inside the payload slab
+    JobState state = JobState::Decoding;      ///< Lifecycle state
+    bool detached = false;                    ///< true: dispatcher releases the slot when done
+    int16_t msgRef = -1;                      ///< TP-MR returned by +CMGS (-1 = none yet)
+    uint32_t seq = 0;                         ///< Enqueue order (FIFO within a priority)
+    uint16_t windowStart = 0xFFFF;            ///< Send window start, recipient-local minutes of day (0xFFFF = none)
+    uint16_t windowEnd = 0;                   ///< Send window end (exclusive), minutes of day
+    uint32_t releaseAt = 0;                   ///< UTC seconds at which a parked job is due
+    uint8_t segmentCount = 0;                 ///< Parts the body was split into (0 = not split yet)
+    uint8_t concatRef = 0;                    ///< Concatenation reference shared by all parts
+    SmsSegment segments[JOB_MAX_SEGMENTS];    ///< Per-part submit state
+
+    /**
+     * @brief Reset request fields before decoding into this slot
+     *
+     * Keeps the slot binding (id, body pointer) and clears everything else.
+     */
+    void resetRequest()
+    {
+        to.clear();
+        priority = JobPriority::Normal;
+        bodyLen = 0;
+        state = JobState::Decoding;
+        detached = false;
+        msgRef = -1;
+        windowStart = 0xFFFF;
+        windowEnd = 0;
+        releaseAt = 0;
+        segmentCount = 0;
+        concatRef = 0;
+        for (SmsSegment &s : segments)
+            s = SmsSegment();
+        if (body)
+            body[0] = '\0';
+    }
+
+    /** @return true if the job may only be sent inside its send window */
+    bool hasWindow() const { return windowStart != 0xFFFF && priority != JobPriority::High; }
+
+    /** @return true once the job reached a final state */
+    bool isDone() const { return state == JobState::Sent || state == JobState::Failed; }
+};
@@ -0,0 +1,131 @@
+#include "AtParser.hpp"
+#include "ProfileZone.hpp"
+#include <string.h>
+
+/**
+ * @brief Read an unsigned decimal after optional spaces (-1 if none)
+ */
+int AtParser::parseUint(const char *p, const char **end)
+{
+    while (*p == ' ')
+        ++p;
+    if (*p < '0' || *p > '9')
+    {
+        if (end)
+            *end = p;
+        return -1;
+    }
+    int v = 0;
+    while (*p >= '0' && *p <= '9')
+        v = v * 10 + (*p++ - '0');
+    if (end)
+        *end = p;
+    return v;
+}
+
+/**
+ * @brief Return the field between the first and second comma
+ *
+ * "<n>,<stat>[,...]" is the solicited form; the unsolicited "<stat>[,...]"
+ * form has no leading <n> and is not accepted here, matching the previous
+ * String-based parser.
+ */
+int AtParser::parseRegStat(const char *line)
+{
+    PROFILE_ZONE("at.parse");
+    if (line == nullptr)
+        return -1;
+    const char *c1 = strchr(line, ',');
+    if (c1 == nullptr)
+        return -1;
+    return parseUint(c1 + 1, nullptr);
+}
+
+/**
+ * @brief Return the number following "+CMGS:"
+ */
+int AtParser::parseCmgsRef(const char *line)
+{
+    PROFILE_ZONE("at.parse");
+    if (line == nullptr)
+        return -1;
+    int v = parseUint(line, nullptr);
+    return (v > 255) ? -1 : v;
+}
+
+/**
+ * @brief Quote-aware field walk over a +CDS line (fields 1 and last)
+ */
+bool AtParser::parseCds(const char *line, int &mr, int &st)
+{
+    PROFILE_ZONE("at.parse");
+    if (line == nullptr || strncmp(line, "+CDS:", 5) != 0)
+        return false;
+    const char *p = line + 5;
+    int field = 0;
+    const char *fieldStart = p;
+    const char *lastStart = p;
+    bool quoted = false;
+    mr = -1;
+    for (;; ++p)
+    {
+        char c = *p;
+        if (c == '"')
+            quoted = !quoted;
+        if ((c == ',' && !quoted) || c == '\0' || c == '\r' || c == '\n')
+        {
+            if (field == 1)
+                mr = parseUint(fieldStart, nullptr);
+            lastStart = fieldStart;
+            if (c != ',')
+                break;
+            ++field;
+            fieldStart = p + 1;
+        }
+    }
+    if (field < 2 || mr < 0 || mr > 255)
+        return false;
+    st = parseUint(lastStart, nullptr);
+    return st >= 0;
+}
+
+/**
+ * @brief Return the number after the comma of a +CMTI URC
+ */
+bool AtParser::parseCmti(const char *line, int &index)
+{
+    PROFILE_ZONE("at.parse");
+    if (line == nullptr || strncmp(line, "+CMTI:", 6) != 0)
+        return false;
+    const char *c = strchr(line + 6, ',');
+    if (c == nullptr)
+        return false;
+    index = parseUint(c + 1, nullptr);
+    return index >= 0;
+}
+
+/**
+ * @brief Read the index and copy the third (quoted) field of a +CMGL header
+ */
+int AtParser::parseCmgl(const char *line, char *from, size_t cap)
+{
+    PROFILE_ZONE("at.parse");
+    if (line == nullptr || cap == 0)
+        return -1;
+    from[0] = '\0';
+    const char *p;
+    int index = parseUint(line, &p);
+    if (index < 0 || *p != ',')
+        return -1;
+    // Skip "<stat>" (quoted, no commas inside) to the opening quote of <oa>
+    p = strchr(p + 1, ',');
+    if (p == nullptr || p[1] != '"')
+        return -1;
+    p += 2;
+    const char *end = strchr(p, '"');
+    if (end == nullptr || size_t(end - p) >= cap)
+        return -1;
+    memcpy(from, p, size_t(end - p));
+    from[end - p] = '\0';
+    return index;
+}
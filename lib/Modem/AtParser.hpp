@@ -0,0 +1,75 @@
+/**
+ * @file AtParser.hpp
+ * @brief Allocation-free parsers for modem response and URC lines
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Stateless helpers that parse single AT response lines
+ *
+ * All functions take the text that follows the response prefix (or the
+ * whole URC line where noted) and never allocate, so they can be used from
+ * the modem driver, benchmarks and host builds alike.
+ */
+class AtParser
+{
+public:
+    /**
+     * @brief Parse the <stat> field of a +CREG/+CGREG/+CEREG response
+     *
+     * @param line Text after "+CREG:", e.g. " 2,1,\"D160\",\"BDA8\",0"
+     * @return int Registration status, or -1 if the line has no <stat> field
+     */
+    static int parseRegStat(const char *line);
+
+    /**
+     * @brief Parse the message reference of a +CMGS response
+     *
+     * @param line Text after "+CMGS:", e.g. " 42"
+     * @return int TP-MR (0..255), or -1 if absent
+     */
+    static int parseCmgsRef(const char *line);
+
+    /**
+     * @brief Parse a text-mode +CDS status report URC
+     *
+     * Format: +CDS: <fo>,<mr>,["<ra>"],[<tora>],"<scts>","<dt>",<st>
+     * Quoted fields may contain commas (timestamps), so splitting is
+     * quote-aware.
+     *
+     * @param line Complete URC line starting with "+CDS:"
+     * @param mr Output message reference
+     * @param st Output TP-Status (0 = delivered)
+     * @retval true Line was a well-formed +CDS report
+     * @retval false Line is something else
+     */
+    static bool parseCds(const char *line, int &mr, int &st);
+
+    /**
+     * @brief Parse a +CMTI new-message URC
+     *
+     * @param line Complete URC line, e.g. "+CMTI: \"SM\",3"
+     * @param index Output storage index
+     * @retval true Line was a +CMTI indication
+     */
+    static bool parseCmti(const char *line, int &index);
+
+    /**
+     * @brief Parse a text-mode +CMGL entry header
+     *
+     * Format: +CMGL: <index>,"<stat>","<oa>",[<alpha>],["<scts>"]
+     *
+     * @param line Text after "+CMGL:"
+     * @param from Output originating address (unquoted, NUL-terminated)
+     * @param cap Size of @p from
+     * @return int Storage index, or -1 if the header is malformed
+     */
+    static int parseCmgl(const char *line, char *from, size_t cap);
+
+private:
+    static int parseUint(const char *p, const char **end);
+};
@@ -0,0 +1,120 @@
+#include "BearerSelector.hpp"
+
+namespace
+{
+    SmsDomain other(SmsDomain d) { return d == SmsDomain::Cs ? SmsDomain::Ps : SmsDomain::Cs; }
+}
+
+/**
+ * @brief A new strategy restarts from its preferred domain with fresh stats
+ */
+void BearerSelector::setStrategy(SmsBearer strategy)
+{
+    if (state.strategy == strategy && state.submits > 0)
+        return;
+    state = State();
+    state.strategy = strategy;
+    state.active = preferred();
+}
+
+/**
+ * @brief Active domain, overridden by the measured winner and exploration
+ */
+SmsDomain BearerSelector::choose()
+{
+    if (state.strategy == SmsBearer::CsOnly)
+        return SmsDomain::Cs;
+    state.submits++;
+
+    SmsDomain alt = other(state.active);
+    const DomainStats &a = stats(state.active);
+    const DomainStats &b = stats(alt);
+    if (a.successes >= BEARER_MIN_SAMPLES && b.successes >= BEARER_MIN_SAMPLES &&
+        b.consecutiveFailures < BEARER_SWITCH_FAILURES && cost(alt) < cost(state.active))
+        activate(alt);
+
+    if (state.submits % BEARER_EXPLORE_EVERY == 0)
+        return other(state.active);
+    return state.active;
+}
+
+SmsDomain BearerSelector::fallback(SmsDomain d) const
+{
+    return allows(other(d)) ? other(d) : d;
+}
+
+/**
+ * @brief Update counters; a failure streak on the active domain switches it
+ */
+void BearerSelector::note(SmsDomain d, bool ok, uint32_t latencyMs)
+{
+    DomainStats &s = stats(d);
+    s.attempts++;
+    if (ok)
+    {
+        s.successes++;
+        s.consecutiveFailures = 0;
+        s.lastMs = latencyMs;
+        s.ewmaMs = s.successes == 1 ? latencyMs : s.ewmaMs - (s.ewmaMs >> 3) + (latencyMs >> 3);
+        return;
+    }
+    if (s.consecutiveFailures < 255)
+        s.consecutiveFailures++;
+    if (d == state.active && s.consecutiveFailures >= BEARER_SWITCH_FAILURES && allows(other(d)))
+        activate(other(d));
+}
+
+const char *BearerSelector::strategyName(SmsBearer s)
+{
+    switch (s)
+    {
+    case SmsBearer::PsPreferred:
+        return "ps-preferred";
+    case SmsBearer::CsPreferred:
+        return "cs-preferred";
+    default:
+        return "cs-only";
+    }
+}
+
+const char *BearerSelector::domainName(SmsDomain d)
+{
+    return d == SmsDomain::Ps ? "ps" : "cs";
+}
+
+void BearerSelector::toJson(JsonObject &root) const
+{
+    root["strategy"] = strategyName(state.strategy);
+    root["active"] = domainName(state.strategy == SmsBearer::CsOnly ? SmsDomain::Cs : state.active);
+    root["switches"] = state.switches;
+    for (size_t i = 0; i < size_t(SmsDomain::Count); ++i)
+    {
+        const DomainStats &s = state.domains[i];
+        JsonObject o = root[domainName(SmsDomain(i))].to<JsonObject>();
+        o["attempts"] = s.attempts;
+        o["successes"] = s.successes;
+        o["successRate"] = s.attempts ? float(s.successes) / float(s.attempts) : 0.0f;
+        o["avgMs"] = s.ewmaMs;
+        o["lastMs"] = s.lastMs;
+        o["failStreak"] = s.consecutiveFailures;
+    }
+}
+
+/**
+ * @brief Expected time per accepted message: latency / success rate
+ */
+float BearerSelector::cost(SmsDomain d) const
+{
+    const DomainStats &s = stats(d);
+    if (s.successes == 0)
+        return 1e9f;
+    return float(s.ewmaMs) * float(s.attempts) / float(s.successes);
+}
+
+void BearerSelector::activate(SmsDomain d)
+{
+    if (d == state.active)
+        return;
+    state.active = d;
+    state.switches++;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file BearerSelector.hpp
+ * @brief CS/PS domain choice for SMS submission (AT+CGSMS) with per-bearer stats
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ArduinoJson.h>
+
+// ====== Tuning ======
+/**
+ * @def BEARER_SWITCH_FAILURES
+ * @brief Consecutive failures on the active bearer before switching to the other
+ */
+#ifndef BEARER_SWITCH_FAILURES
+#define BEARER_SWITCH_FAILURES 2
+#endif
+
+/**
+ * @def BEARER_MIN_SAMPLES
+ * @brief Successful submits per bearer before their latencies are compared
+ */
+#ifndef BEARER_MIN_SAMPLES
+#define BEARER_MIN_SAMPLES 5
+#endif
+
+/**
+ * @def BEARER_EXPLORE_EVERY
+ * @brief Every Nth submit goes over the inactive bearer to keep its stats fresh
+ */
+#ifndef BEARER_EXPLORE_EVERY
+#define BEARER_EXPLORE_EVERY 20
+#endif
+
+/**
+ * @brief SMS bearer strategy of a CarrierProfile
+ */
+enum class SmsBearer : uint8_t
+{
+    CsOnly = 0,  ///< Circuit-switched only (modem default on most networks)
+    PsPreferred, ///< Packet domain first, CS as fallback
+    CsPreferred, ///< CS first, packet domain as fallback
+};
+
+/**
+ * @brief Domain a single submit goes over
+ */
+enum class SmsDomain : uint8_t
+{
+    Cs = 0, ///< AT+CGSMS=1
+    Ps = 1, ///< AT+CGSMS=0
+    Count
+};
+
+/**
+ * @brief Picks the domain of each SMS submit and learns which one is faster
+ *
+ * Every submit is pinned to one domain (AT+CGSMS=0 or 1) so that its latency
+ * and outcome can be attributed; the fallback of the "preferred" strategies
+ * is done here instead of by the modem:
+ * - the active domain starts as the strategy's preferred one
+ * - BEARER_SWITCH_FAILURES consecutive failures (or no registration in that
+ *   domain) make the other domain active
+ * - once both domains have BEARER_MIN_SAMPLES successes, the one with the
+ *   lower latency per success (EWMA latency / success rate) becomes active
+ * - every BEARER_EXPLORE_EVERY submits one goes over the inactive domain
+ *
+ * CsOnly never uses the packet domain. The state lives in a caller-provided
+ * struct so it can be kept in RTC memory across deep sleep.
+ *
+ * No Arduino dependency.
+ */
+class BearerSelector
+{
+public:
+    /**
+     * @brief Counters of one domain
+     */
+    struct DomainStats
+    {
+        uint32_t attempts;
+        uint32_t successes;
+        uint32_t ewmaMs;       ///< Submit latency, 1/8 weight per sample (successes only)
+        uint32_t lastMs;       ///< Last successful submit latency
+        uint8_t consecutiveFailures;
+    };
+
+    /**
+     * @brief Persistent selector state (all zero = fresh)
+     */
+    struct State
+    {
+        SmsBearer strategy;
+        SmsDomain active;
+        uint8_t switches;
+        uint32_t submits;
+        DomainStats domains[size_t(SmsDomain::Count)];
+    };
+
+    explicit BearerSelector(State &state) : state(state) {}
+
+    /**
+     * @brief Apply a carrier's strategy; stats are kept unless it changed
+     */
+    void setStrategy(SmsBearer strategy);
+
+    /** @return Current strategy */
+    SmsBearer strategy() const { return state.strategy; }
+
+    /** @return true if the strategy may use @p d */
+    bool allows(SmsDomain d) const { return d == SmsDomain::Cs || state.strategy != SmsBearer::CsOnly; }
+
+    /**
+     * @brief Domain for the next submit
+     */
+    SmsDomain choose();
+
+    /**
+     * @brief The other domain if the strategy allows it, else @p d
+     */
+    SmsDomain fallback(SmsDomain d) const;
+
+    /**
+     * @brief Report a submit (or a domain found unregistered, with ok = false)
+     *
+     * @param d Domain used
+     * @param ok Accepted by the network
+     * @param latencyMs AT+CMGS to +CMGS time (ignored on failure)
+     */
+    void note(SmsDomain d, bool ok, uint32_t latencyMs);
+
+    /** @return AT+CGSMS value pinning the domain */
+    static uint8_t cgsmsValue(SmsDomain d) { return d == SmsDomain::Ps ? 0 : 1; }
+
+    static const char *strategyName(SmsBearer s);
+    static const char *domainName(SmsDomain d);
+
+    /**
+     * @brief Write {"strategy","active","switches","cs":{...},"ps":{...}}
+     */
+    void toJson(JsonObject &root) const;
+
+private:
+    State &state;
+
+    SmsDomain preferred() const { return state.strategy == SmsBearer::PsPreferred ? SmsDomain::Ps : SmsDomain::Cs; }
+    DomainStats &stats(SmsDomain d) { return state.domains[size_t(d)]; }
+    const DomainStats &stats(SmsDomain d) const { return state.domains[size_t(d)]; }
+    float cost(SmsDomain d) const;
+    void activate(SmsDomain d);
+};
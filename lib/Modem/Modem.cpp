@@ -1,4 +1,6 @@
 #include "Modem.hpp"
+#include <sys/time.h>
+#include "RemoteLog.hpp"
 
 /**
  * @brief Default carrier profile used when operator is unknown or unsupported
@@ -9,6 +11,13 @@
  */
 const CarrierProfile *DEFAULT_PROFILE = nullptr; // if unknown operator
 
+/**
+ * @brief SMS bearer selector state, kept in RTC memory through deep sleep
+ *
+ * Zeroed on power-on; the stats a site collected survive the duty cycle.
+ */
+RTC_DATA_ATTR static BearerSelector::State bearerState;
+
 #ifdef DUMP_AT_COMMANDS
 StreamDebugger debugger(SerialAT, SerialMon);
 /**
@@ -17,7 +26,7 @@ StreamDebugger debugger(SerialAT, SerialMon);
  * Initializes TinyGSM modem instance with StreamDebugger wrapper for
  * AT command visibility. Also registers a "modem" probe for status reporting.
  */
-Modem::Modem() : modem(debugger)
+Modem::Modem() : modem(debugger), bearer(bearerState)
 #else
 /**
  * @brief Construct Modem with direct serial communication
@@ -25,14 +34,20 @@ Modem::Modem() : modem(debugger)
  * Initializes TinyGSM modem instance with direct SerialAT communication.
  * Also registers a "modem" probe for status reporting.
  */
-Modem::Modem() : modem(SerialAT)
+Modem::Modem() : modem(SerialAT), bearer(bearerState)
 #endif
 {
     ProbeRegistry::instance().registerProbe("modem", [this](JsonObject &dst)
                                             {
         dst["registered"] = isCsRegistered();
         dst["rssi"]       = modem.getSignalQuality();
-        dst["mode"]       = modem.getNetworkMode(); });
+        dst["mode"]       = modem.getNetworkMode();
+        JsonObject segments = dst["segments"].to<JsonObject>();
+        retry.toJson(segments);
+        JsonObject smsBearer = dst["bearer"].to<JsonObject>();
+        bearer.toJson(smsBearer); });
+    Supervisor::instance().configure(Subsystem::Modem, SUPERVISOR_PERIOD_MS, [this]()
+                                     { recover(); });
 }
 
 /**
@@ -69,10 +84,10 @@ void Modem::initModem()
     pinMode(MODEM_DTR, OUTPUT);
     digitalWrite(MODEM_DTR, LOW); // keep awake
 
-    Serial.println(F("[MODEM] Initializing..."));
+    LOG_INFO("MODEM", "Initializing...");
     if (!modem.init())
     {
-        Serial.println(F("[MODEM] init failed, trying restart()..."));
+        LOG_WARN("MODEM", "init failed, trying restart()...");
         modemRestart();
         delay(2000);
         return;
@@ -186,6 +201,17 @@ void Modem::initModem()
     }
 }
 
+/**
+ * @brief Four preferred modes and the AUTO fallback, each settled and waited
+ * for, plus a minute of bring-up; never below MODEM_INIT_BUDGET_MS
+ */
+uint32_t Modem::initBudgetMs()
+{
+    RadioTiming &timing = RadioTiming::instance();
+    uint32_t needed = 5 * (timing.get(RadioParam::RegisterMs) + timing.get(RadioParam::SettleMs)) + 60000;
+    return needed > MODEM_INIT_BUDGET_MS ? needed : MODEM_INIT_BUDGET_MS;
+}
+
 /**
  * @brief Clean initialization of the GSM modem without carrier-specific configurations
  *
@@ -195,25 +221,34 @@ void Modem::initModem()
  */
 void Modem::initModemClean()
 {
+    SUPERVISED_STAGE(Subsystem::Modem, "modem.init", initBudgetMs());
     String res;
 
-    modemPowerOn();
-
-    SerialAT.begin(115200, SERIAL_8N1, MODEM_RX, MODEM_TX, false);
-    delay(600);
+    // recover() switched it off; while shutting down it may still answer
+    bool running = attach() && !powerCycled;
+    powerCycled = false;
+    if (!running)
+    {
+        modemPowerOn();
+        delay(600);
+    }
+    else
+    {
+        LOG_INFO("MODEM", "Already running, not pulsing PWRKEY");
+    }
 
-    Serial.println(F("[MODEM] Initializing..."));
+    LOG_INFO("MODEM", "Initializing...");
     if (!modem.init())
     {
-        Serial.println(F("[MODEM] init failed, restarting modem..."));
+        LOG_WARN("MODEM", "init failed, restarting modem...");
         modem.restart();
     }
 
     String name = modem.getModemName();
-    Serial.println("[MODEM] Modem Name: " + name);
+    LOG_INFO("MODEM", "Modem Name: %s", name.c_str());
 
     String modemInfo = modem.getModemInfo();
-    Serial.println("[MODEM] Modem Info: " + modemInfo);
+    LOG_INFO("MODEM", "Modem Info: %s", modemInfo.c_str());
 
     // Unlock your SIM card with a PIN if needed
     if (GSM_PIN && modem.getSimStatus() != 3)
@@ -224,8 +259,14 @@ void Modem::initModemClean()
     String imsi = readIMSI();
     String mccmnc = mccmncFromIMSI(imsi);
     const CarrierProfile *prof = selectProfile(mccmnc);
-    Serial.printf("[SIM] IMSI=%s  MCCMNC=%s  Profile=%s\n",
-                  imsi.c_str(), mccmnc.c_str(), prof ? prof->name : "default");
+    LOG_INFO("SIM", "IMSI=%s  MCCMNC=%s  Profile=%s",
+             imsi.c_str(), mccmnc.c_str(), prof ? prof->name : "default");
+    SmsBearer strategy = prof ? prof->bearer : SmsBearer::CsPreferred;
+    if (prof == nullptr && carrierOverride && carrierOverride(mccmnc.c_str(), override_) &&
+        override_.bearer <= uint8_t(SmsBearer::CsPreferred))
+        strategy = SmsBearer(override_.bearer);
+    bearer.setStrategy(strategy);
+    cgsms = -1;
 
     // NOTE: don't spam CBANDCFG; many firmwares disallow it
     // Keep DTR low to avoid sleep
@@ -233,30 +274,125 @@ void Modem::initModemClean()
     digitalWrite(MODEM_DTR, LOW);
 
     modem.sendAT("+CNMP?");
-    if (modem.waitResponse(1000L, res) == 1)
+    if (waitTimed(RadioParam::CommandMs, res) == 1)
     {
         res.replace(GSM_NL "OK" GSM_NL, "");
-        Serial.println("[MODEM][CNMP] Mode=" + res);
+        LOG_INFO("MODEM", "[CNMP] Mode=%s", res.c_str());
     }
 
     if (!setupRadioWithProfile(prof))
     {
-        Serial.println("[MODEM] No CS registration with preferred modes, last resort AUTO...");
+        LOG_WARN("MODEM", "No CS registration with preferred modes, last resort AUTO...");
         modem.sendAT("+CNMP=2");
         modem.waitResponse();
-        waitCsRegistered(30000);
+        waitCsTimed(RadioParam::RegisterMs);
     }
 
+    // Request status reports (SRR in first octet) and route them as +CDS URCs
+    modem.sendAT("+CSMP=49,167,0,0");
+    modem.waitResponse();
+    modem.sendAT("+CNMI=2,1,0,1,0");
+    modem.waitResponse();
+    // Let the network (NITZ) set the modem clock: wall clock for send windows
+    modem.sendAT("+CLTS=1");
+    modem.waitResponse();
+
     if (!isCsRegistered())
     {
-        Serial.println("[MODEM] Still not CS registered — SMS will fail here.");
+        LOG_ERROR("MODEM", "Still not CS registered — SMS will fail here.");
     }
     else
     {
-        Serial.println("[MODEM] CS registered — SMS ready.");
+        LOG_NOTICE("MODEM", "CS registered — SMS ready.");
     }
 }
 
+/**
+ * @brief Open the UART and probe the modem without touching PWRKEY
+ *
+ * DTR may still be held high from deep sleep (prepareSleep()); the hold is
+ * released and DTR pulled low first, so a modem in DTR sleep answers the
+ * probe. A PWRKEY pulse on a running modem would switch it off, so callers
+ * only pulse after this returns false.
+ *
+ * @retval true The modem answered (DTR sleep is switched off again)
+ */
+bool Modem::attach()
+{
+    gpio_hold_dis((gpio_num_t)MODEM_DTR);
+    SerialAT.begin(115200, SERIAL_8N1, MODEM_RX, MODEM_TX, false);
+
+    pinMode(MODEM_DTR, OUTPUT);
+    digitalWrite(MODEM_DTR, LOW); // leave DTR sleep
+    delay(60);
+
+    if (!modem.testAT(MODEM_PROBE_MS))
+        return false;
+    modem.sendAT("+CSCLK=0");
+    modem.waitResponse();
+    return true;
+}
+
+/**
+ * @brief Resume a modem kept in PSM/DTR sleep while the ESP32 slept
+ *
+ * The registration wait is the readyMs budget, as before a send.
+ */
+bool Modem::resumeFromSleep()
+{
+    if (!attach())
+    {
+        LOG_WARN("MODEM", "No answer after wake");
+        return false;
+    }
+    cgsms = -1;
+
+    uint32_t started = millis();
+    bool ok = waitCsRegistered(RadioTiming::instance().get(RadioParam::ReadyMs));
+    RadioTiming::instance().note(RadioParam::ReadyMs, millis() - started, !ok);
+    LOG_INFO("MODEM", "Resumed, %s", ok ? "CS registered" : "not registered");
+    return ok;
+}
+
+/**
+ * @brief Keep registration via PSM and let the modem sleep on DTR high
+ */
+void Modem::prepareSleep()
+{
+    modem.sendAT("+CPSMS=1");
+    modem.waitResponse();
+    modem.sendAT("+CSCLK=1");
+    modem.waitResponse();
+
+    digitalWrite(MODEM_DTR, HIGH);
+    gpio_hold_en((gpio_num_t)MODEM_DTR);
+    gpio_deep_sleep_hold_en();
+}
+
+/**
+ * @brief Convert the modem's local network time to UTC and set the system clock
+ */
+bool Modem::syncClock()
+{
+    int year, month, day, hour, minute, second;
+    float tz;
+    if (!modem.getNetworkTime(&year, &month, &day, &hour, &minute, &second, &tz) || year < 2024)
+        return false;
+
+    struct tm t = {};
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_hour = hour;
+    t.tm_min = minute;
+    t.tm_sec = second;
+    // The system TZ is UTC, so mktime() acts as timegm()
+    struct timeval tv = {mktime(&t) - time_t(tz * 3600), 0};
+    settimeofday(&tv, nullptr);
+    LOG_INFO("MODEM", "Clock set from network time (UTC%+.2f)", tz);
+    return true;
+}
+
 /**
  * @brief Read IMSI from SIM card using AT+CIMI command
  *
@@ -266,7 +402,7 @@ void Modem::initModemClean()
 String Modem::readIMSI()
 {
     modem.sendAT("+CIMI");
-    if (modem.waitResponse(2000L, "+CIMI") == 1)
+    if (waitTimed(RadioParam::QueryMs, "+CIMI") == 1)
     {
         // ditch echo line
         modem.stream.readStringUntil('\n');
@@ -297,12 +433,27 @@ String Modem::mccmncFromIMSI(const String &imsi)
  */
 const CarrierProfile *Modem::selectProfile(const String &mccmnc)
 {
+    const CarrierProfile *prof = DEFAULT_PROFILE;
     for (auto &p : PROFILES)
     {
         if (mccmnc == p.mccmnc)
-            return &p;
+        {
+            prof = &p;
+            break;
+        }
     }
-    return DEFAULT_PROFILE;
+    override_ = CarrierOverride();
+    if (prof == nullptr || !carrierOverride || !carrierOverride(mccmnc.c_str(), override_))
+        return prof;
+
+    profile_ = *prof;
+    profile_.apn = override_.apn.c_str();
+    profile_.user = override_.user.c_str();
+    profile_.pass = override_.pass.c_str();
+    if (override_.bearer <= uint8_t(SmsBearer::CsPreferred))
+        profile_.bearer = SmsBearer(override_.bearer);
+    LOG_INFO("SIM", "Site override for %s", mccmnc.c_str());
+    return &profile_;
 }
 
 /**
@@ -343,7 +494,7 @@ bool Modem::setupRadioWithProfile(const CarrierProfile *prof)
         modem.setNetworkMode(mode);
 
         modem.sendAT("+CMNB?");
-        if (modem.waitResponse(1000L, res) == 1)
+        if (waitTimed(RadioParam::CommandMs, res) == 1)
         {
             res.replace(GSM_NL "OK" GSM_NL, "");
             Serial.println("Preferred CMNB mode: " + res);
@@ -357,12 +508,15 @@ bool Modem::setupRadioWithProfile(const CarrierProfile *prof)
         }
 
         // Give RF a moment
-        delay(1500);
+        delay(RadioTiming::instance().get(RadioParam::SettleMs));
 
-        Serial.printf("[RADIO] Trying mode %u ...\n", mode);
-        if (waitCsRegistered(30000))
+        LOG_INFO("RADIO", "Trying mode %u ...", mode);
+        uint32_t started = millis();
+        bool registered = waitCsTimed(RadioParam::RegisterMs);
+        RadioTiming::instance().note(RadioParam::SettleMs, millis() - started, !registered);
+        if (registered)
         {
-            Serial.println("[RADIO] CS registered.");
+            LOG_INFO("RADIO", "CS registered.");
             return true;
         }
     }
@@ -378,15 +532,10 @@ bool Modem::setupRadioWithProfile(const CarrierProfile *prof)
 bool Modem::isCsRegistered()
 {
     modem.sendAT("+CREG?");
-    if (modem.waitResponse(2000L, "+CREG:") != 1)
+    if (waitTimed(RadioParam::QueryMs, "+CREG:") != 1)
         return false;
     String line = modem.stream.readStringUntil('\n'); // " 2,1,"D160","BDA8",0"
-    int c1 = line.indexOf(','), c2 = line.indexOf(',', c1 + 1);
-    if (c1 < 0)
-        return false;
-    String statStr = (c2 > 0) ? line.substring(c1 + 1, c2) : line.substring(c1 + 1);
-    statStr.trim();
-    int stat = statStr.toInt();
+    int stat = AtParser::parseRegStat(line.c_str());
     return (stat == 1 || stat == 5); // 1=home, 5=roaming
 }
 
@@ -403,7 +552,58 @@ bool Modem::waitCsRegistered(uint32_t ms)
     {
         if (isCsRegistered())
             return true;
-        delay(500);
+        Supervisor::instance().beat(Subsystem::Modem);
+        uint32_t poll = RadioTiming::instance().get(RadioParam::PollMs);
+        RadioTiming::instance().note(RadioParam::PollMs, poll, false);
+        delay(poll);
+    }
+    return false;
+}
+
+bool Modem::waitCsTimed(RadioParam p)
+{
+    uint32_t started = millis();
+    bool ok = waitCsRegistered(RadioTiming::instance().get(p));
+    RadioTiming::instance().note(p, millis() - started, !ok);
+    return ok;
+}
+
+/**
+ * @brief Check Packet-Switched (PS) registration using AT+CGREG?, then AT+CEREG?
+ *
+ * On GSM the GPRS attach is reported by +CGREG; on LTE-M/NB-IoT by +CEREG.
+ */
+bool Modem::isPsRegistered()
+{
+    static const char *const QUERIES[][2] = {{"+CGREG?", "+CGREG:"}, {"+CEREG?", "+CEREG:"}};
+    for (const auto &q : QUERIES)
+    {
+        modem.sendAT(q[0]);
+        if (waitTimed(RadioParam::QueryMs, q[1]) != 1)
+            continue;
+        String line = modem.stream.readStringUntil('\n');
+        modem.waitResponse(); // trailing OK
+        int stat = AtParser::parseRegStat(line.c_str());
+        if (stat == 1 || stat == 5)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Wait for Packet-Switched registration with polling and timeout
+ */
+bool Modem::waitPsRegistered(uint32_t ms)
+{
+    uint32_t deadline = millis() + ms;
+    while (millis() < deadline)
+    {
+        if (isPsRegistered())
+            return true;
+        Supervisor::instance().beat(Subsystem::Modem);
+        uint32_t poll = RadioTiming::instance().get(RadioParam::PollMs);
+        RadioTiming::instance().note(RadioParam::PollMs, poll, false);
+        delay(poll);
     }
     return false;
 }
@@ -422,13 +622,14 @@ bool Modem::checkModemRegistered()
     // Ensure modem is registered (cheap quick check)
     int reg = -1;
     modem.sendAT("+CREG?");
-    if (modem.waitResponse(2000L, "+CREG:") == 1)
+    if (waitTimed(RadioParam::QueryMs, "+CREG:") == 1)
     {
         reg = modem.stream.readStringUntil('\n').toInt();
     }
     // Best effort: if not registered, try wait again (non-fatal)
     if (!modem.isNetworkConnected())
     {
+        SUPERVISED_STAGE(Subsystem::Modem, "modem.register", 60000 + 5000);
         return modem.waitForNetwork(60000L);
     }
     Serial.println("Network registered, status: " + String(reg));
@@ -444,41 +645,339 @@ bool Modem::checkModemRegistered()
  * @param text Message body
  * @return true if TinyGSM accepted the message
  */
-bool Modem::sendSMS(const String &to, const String &text)
+bool Modem::sendSMS(const PhoneNumber &to, const char *text)
 {
-    Serial.printf("[SMS] To: %s  Len: %u\n", to.c_str(), (unsigned)text.length());
-    return modem.sendSMS(to.c_str(), text.c_str());
+    char number[PhoneNumber::STRING_MAX];
+    to.toChars(number, sizeof(number));
+    LOG_INFO("SMS", "To: %s  Len: %u", number, (unsigned)strlen(text));
+    return modem.sendSMS(number, text);
 }
 
 /**
- * @brief Send SMS with additional safety checks and error recovery
+ * @brief Send a job with validation, registration wait and trace marks
  *
- * Enhanced SMS sending with validation, registration checks, and retry logic.
- * Includes phone number validation, length checks, and modem status verification.
+ * Validates the destination, converts and splits the body, waits for CS
+ * registration, then submits the parts in order.
  */
-bool Modem::sendSmsSafe(const String &to, const String &text)
+bool Modem::sendSmsSafe(SmsJob &job)
 {
-    if (text.length() < 1 || text.length() > 160)
+    if (job.bodyLen < 1)
         return false;
-    if (!(to.startsWith("+") && to.substring(1).length() >= 7))
+    if (!(job.to.isInternational() && job.to.digitCount() >= 7))
         return false;
 
+    size_t septets = SmsPdu::toGsm7(job.body, job.bodyLen, septetBuf, sizeof(septetBuf));
+    uint16_t bounds[JOB_MAX_SEGMENTS + 1];
+    uint8_t parts = septets > sizeof(septetBuf) ? 0 : SmsPdu::split(septetBuf, septets, bounds, JOB_MAX_SEGMENTS);
+    if (parts == 0)
+    {
+        LOG_ERROR("SMS", "Body needs more than %u parts; abort.", (unsigned)JOB_MAX_SEGMENTS);
+        return false;
+    }
+    job.segmentCount = parts;
+    job.concatRef = nextConcatRef++;
+    for (SmsSegment &seg : job.segments)
+        seg = SmsSegment();
+
+    char number[PhoneNumber::STRING_MAX];
+    job.to.toChars(number, sizeof(number));
+
     modemBusy = true;
+    // Covers the gaps between the inner stages, so the loop is not blamed
+    uint32_t ready = RadioTiming::instance().get(RadioParam::ReadyMs) + 5000;
+    SUPERVISED_STAGE(Subsystem::Modem, "sms.send",
+                     ready + uint32_t(parts) * SMS_SEGMENT_ATTEMPTS * (MODEM_SUBMIT_BUDGET_MS + SMS_SEGMENT_RETRY_MS + ready));
 
-    if (!waitCsRegistered(15000))
+    SmsDomain domain;
+    if (!readyDomain(domain))
     {
         modemBusy = false;
-        Serial.println("[SMS] Not CS-registered; abort.");
+        LOG_ERROR("SMS", "Not registered for SMS; abort.");
         return false;
     }
+    JobTracer::instance().mark(job.id, TraceStage::RegCheck);
 
-    modem.sendAT("+CMGF=1");
+    modem.sendAT(parts == 1 ? "+CMGF=1" : "+CMGF=0");
     modem.waitResponse();
-    Serial.printf("[SMS] To: %s  Len: %u\n", to.c_str(), (unsigned)text.length());
-    bool ok = modem.sendSMS(to.c_str(), text.c_str());
+    LOG_INFO("SMS", "To: %s  Len: %u  Parts: %u  Bearer: %s", number, (unsigned)job.bodyLen, (unsigned)parts,
+             BearerSelector::domainName(domain));
+    bool ok = true;
+    for (uint8_t i = 0; i < parts && ok; ++i)
+        ok = sendSegment(job, i, bounds, number, domain);
+    if (parts > 1)
+    {
+        modem.sendAT("+CMGF=1"); // TinyGSM helpers expect text mode
+        modem.waitResponse();
+        retry.noteMultipart(ok);
+    }
 
     modemBusy = false;
-    return ok;
+    if (!ok)
+        return false;
+    job.msgRef = job.segments[parts - 1].msgRef;
+    JobTracer::instance().setMsgRef(job.id, job.msgRef);
+    return true;
+}
+
+/**
+ * @brief Attempt loop of one part, driven by the RetryClassifier
+ */
+bool Modem::sendSegment(SmsJob &job, uint8_t part, const uint16_t *bounds, const char *number, SmsDomain &domain)
+{
+    SmsSegment &seg = job.segments[part];
+    while (seg.state != SegmentState::Sent)
+    {
+        if (seg.attempts > 0)
+        {
+            if (!retry.shouldRetry(seg.lastError, seg.attempts))
+            {
+                retry.noteGaveUp();
+                LOG_ERROR("SMS", "Part %u/%u failed (error %d) after %u attempts",
+                          (unsigned)(part + 1), (unsigned)job.segmentCount, seg.lastError, (unsigned)seg.attempts);
+                return false;
+            }
+            delay(SMS_SEGMENT_RETRY_MS);
+            readyDomain(domain);
+        }
+
+        int previous = seg.lastError;
+        int error = RetryClassifier::OK;
+        seg.attempts++;
+        uint32_t started = millis();
+        int ref;
+        {
+            SUPERVISED_STAGE(Subsystem::Modem, "sms.submit", MODEM_SUBMIT_BUDGET_MS);
+            ref = job.segmentCount == 1 ? submitText(number, job.body, job.id, error)
+                                        : submitPart(job, part, bounds, error);
+        }
+        bearer.note(domain, ref >= 0, millis() - started);
+        retry.noteAttempt(seg.attempts, ref >= 0 ? RetryClassifier::OK : error, previous);
+        if (ref >= 0)
+        {
+            seg.msgRef = int16_t(ref);
+            seg.state = SegmentState::Sent;
+        }
+        else
+        {
+            seg.lastError = int16_t(error);
+            seg.state = SegmentState::Failed;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Selector's choice if registered, else the other allowed domain
+ */
+bool Modem::readyDomain(SmsDomain &domain)
+{
+    uint32_t ms = RadioTiming::instance().get(RadioParam::ReadyMs);
+    SUPERVISED_STAGE(Subsystem::Modem, "sms.register", ms + 5000);
+    domain = bearer.choose();
+    uint32_t started = millis();
+    bool ready = domain == SmsDomain::Ps ? waitPsRegistered(ms) : waitCsRegistered(ms);
+    RadioTiming::instance().note(RadioParam::ReadyMs, millis() - started, !ready);
+    if (!ready)
+    {
+        bearer.note(domain, false, 0);
+        SmsDomain alt = bearer.fallback(domain);
+        if (alt == domain)
+            return false;
+        ready = alt == SmsDomain::Ps ? isPsRegistered() : isCsRegistered();
+        if (!ready)
+            return false;
+        LOG_WARN("SMS", "%s not registered, using %s",
+                 BearerSelector::domainName(domain), BearerSelector::domainName(alt));
+        domain = alt;
+    }
+    pinDomain(domain);
+    return true;
+}
+
+/**
+ * @brief AT+CGSMS=0 (packet domain) or 1 (circuit switched)
+ */
+void Modem::pinDomain(SmsDomain domain)
+{
+    uint8_t value = BearerSelector::cgsmsValue(domain);
+    if (cgsms == int8_t(value))
+        return;
+    modem.sendAT("+CGSMS=", (int)value);
+    cgsms = modem.waitResponse() == 1 ? int8_t(value) : -1;
+}
+
+/**
+ * @brief Text-mode AT+CMGS exchange returning the message reference
+ *
+ * Mirrors TinyGSM's sendSMS() sequence but keeps the "+CMGS: <mr>" line.
+ */
+int Modem::submitText(const char *number, const char *text, uint32_t jobId, int &error)
+{
+    modem.sendAT("+CSCS=\"GSM\"");
+    modem.waitResponse();
+    modem.sendAT("+CMGS=\"", number, "\"");
+    JobTracer::instance().mark(jobId, TraceStage::CmgsIssued);
+    if (modem.waitResponse(5000L, ">") != 1)
+    {
+        error = RetryClassifier::TIMEOUT;
+        return -1;
+    }
+    modem.stream.print(text);
+    modem.stream.write((char)0x1A);
+    modem.stream.flush();
+    return awaitCmgs(error);
+}
+
+/**
+ * @brief PDU-mode AT+CMGS=<length> exchange for one part
+ *
+ * The PDU starts with a zero-length SCA so the SIM's SMSC is used.
+ */
+int Modem::submitPart(const SmsJob &job, uint8_t part, const uint16_t *bounds, int &error)
+{
+    static const char HEX[] = "0123456789ABCDEF";
+    uint8_t tpdu[SmsPdu::SUBMIT_MAX];
+    size_t len = SmsPdu::buildPart(job.to, septetBuf + bounds[part], bounds[part + 1] - bounds[part],
+                                   job.concatRef, job.segmentCount, part + 1, tpdu);
+    if (len == 0)
+    {
+        error = RetryClassifier::TIMEOUT;
+        return -1;
+    }
+    modem.sendAT("+CMGS=", (int)len);
+    JobTracer::instance().mark(job.id, TraceStage::CmgsIssued);
+    if (modem.waitResponse(5000L, ">") != 1)
+    {
+        error = RetryClassifier::TIMEOUT;
+        return -1;
+    }
+    modem.stream.print("00");
+    for (size_t i = 0; i < len; ++i)
+    {
+        modem.stream.write(HEX[tpdu[i] >> 4]);
+        modem.stream.write(HEX[tpdu[i] & 0x0F]);
+    }
+    modem.stream.write((char)0x1A);
+    modem.stream.flush();
+    return awaitCmgs(error);
+}
+
+/**
+ * @brief "+CMGS: <mr>" and the trailing OK, or "+CMS ERROR: <code>"
+ */
+int Modem::awaitCmgs(int &error)
+{
+    int8_t r = modem.waitResponse(60000L, "+CMGS:", "+CMS ERROR:");
+    if (r != 1)
+    {
+        error = r == 2 ? int(modem.stream.readStringUntil('\n').toInt()) : RetryClassifier::TIMEOUT;
+        return -1;
+    }
+    String line = modem.stream.readStringUntil('\n');
+    int ref = AtParser::parseCmgsRef(line.c_str());
+    modem.waitResponse(); // trailing OK
+    if (ref < 0)
+        error = RetryClassifier::TIMEOUT;
+    return ref;
+}
+
+/**
+ * @brief Collect URC bytes without blocking and dispatch complete lines
+ */
+void Modem::poll()
+{
+    Supervisor::instance().beat(Subsystem::Modem);
+    if (modemBusy)
+        return;
+    if (reinitPending.exchange(false))
+    {
+        LOG_NOTICE("MODEM", "Re-initialising after supervisor reset");
+        powerCycled = true; // still shutting down: it may answer a probe
+        initModemClean();
+        return;
+    }
+    while (modem.stream.available())
+    {
+        char c = (char)modem.stream.read();
+        if (c == '\r')
+            continue;
+        if (c == '\n')
+        {
+            urcBuf[urcLen] = '\0';
+            if (urcLen > 0)
+                handleUrc(urcBuf);
+            urcLen = 0;
+            continue;
+        }
+        if (urcLen < sizeof(urcBuf) - 1)
+            urcBuf[urcLen++] = c;
+    }
+    if (inbound && (inboundPending || millis() - lastSweepMs >= INBOUND_SWEEP_MS))
+        readInbound();
+}
+
+/**
+ * @brief Route a URC line to its consumer
+ */
+void Modem::handleUrc(const char *line)
+{
+    int mr, st;
+    if (AtParser::parseCds(line, mr, st))
+    {
+        bool known = JobTracer::instance().deliveryReport(int16_t(mr), uint8_t(st));
+        LOG_INFO("SMS", "Status report mr=%d st=%d%s", mr, st, known ? "" : " (unknown job)");
+        return;
+    }
+    int index;
+    if (AtParser::parseCmti(line, index))
+        inboundPending = true;
+}
+
+/**
+ * @brief List unread messages in text mode, then delete the ones handed over
+ *
+ * Deletion is by index: a blanket delete of read messages would also take
+ * entries that did not parse and messages someone else has read.
+ * Only the first body line of each message is passed on; the receiver runs
+ * while the modem is still marked busy and must not issue AT commands.
+ */
+void Modem::readInbound()
+{
+    // 5 s per listed message at worst; SIM storage holds a few dozen
+    SUPERVISED_STAGE(Subsystem::Modem, "sms.inbound", 60000);
+    modemBusy = true;
+    inboundPending = false;
+    lastSweepMs = millis();
+    modem.sendAT("+CMGF=1");
+    modem.waitResponse();
+    modem.sendAT("+CMGL=\"REC UNREAD\"");
+    int handled[INBOUND_DELETE_MAX];
+    unsigned count = 0;
+    char from[PhoneNumber::STRING_MAX + 8];
+    while (modem.waitResponse(5000L, "+CMGL:", "OK", "ERROR") == 1)
+    {
+        String header = modem.stream.readStringUntil('\n');
+        String text = modem.stream.readStringUntil('\n');
+        text.trim();
+        int index = AtParser::parseCmgl(header.c_str(), from, sizeof(from));
+        if (index < 0)
+        {
+            LOG_WARN("SMS", "Unparsed inbound entry left on SIM: %s", header.c_str());
+            continue;
+        }
+        LOG_INFO("SMS", "Inbound from %s (%u chars)", from, (unsigned)text.length());
+        inbound(from, text.c_str());
+        if (count < INBOUND_DELETE_MAX)
+            handled[count++] = index;
+        else
+            LOG_WARN("SMS", "Inbound %d handed over but left on SIM", index);
+    }
+    for (unsigned i = 0; i < count; ++i)
+    {
+        modem.sendAT("+CMGD=", handled[i]);
+        modem.waitResponse();
+    }
+    modemBusy = false;
 }
 
 /**
@@ -511,4 +1010,16 @@ void Modem::modemRestart()
     modemPowerOff();
     delay(1000);
     modemPowerOn();
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Power off from the supervisor task; the stuck command times out
+ *
+ * initModemClean() powers it on again.
+ */
+void Modem::recover()
+{
+    LOG_WARN("MODEM", "Supervisor reset");
+    modemPowerOff();
+    reinitPending = true;
+}
@@ -1,8 +1,20 @@
 #pragma once
 #include "ProbeRegistry.hpp"
+#include "PhoneNumber.hpp"
+#include "SmsJob.hpp"
+#include "JobTracer.hpp"
+#include "AtParser.hpp"
+#include "SmsPdu.hpp"
+#include "RetryClassifier.hpp"
+#include "BearerSelector.hpp"
+#include "Features.hpp"
+#include "Supervisor.hpp"
+#include "RadioTiming.hpp"
 
 #define TINY_GSM_MODEM_SIM7000
-#define TINY_GSM_DEBUG Serial   // comment this to reduce logs
+#if FEATURE_AT_TRACE
+#define TINY_GSM_DEBUG Serial   // -DFEATURE_AT_TRACE=0 to reduce logs
+#endif
 #define TINY_GSM_RX_BUFFER 1024 // Set RX buffer to 1Kb
 
 #define GSM_NL "\r\n" ///< GSM command line terminator (carriage return + line feed)
@@ -11,7 +23,9 @@
 // Set serial for debug console (to the Serial Monitor, default speed 115200)
 #define SerialMon Serial ///< Serial interface for debug output and monitoring
 
+#if FEATURE_AT_TRACE
 #define DUMP_AT_COMMANDS ///< Enable AT command debugging via StreamDebugger
+#endif
 
 // set GSM PIN, if any
 #define GSM_PIN "" ///< SIM card PIN (empty string if no PIN required)
@@ -33,6 +47,50 @@
 
 #define LED_PIN 12 ///< Status LED pin
 
+// ====== Tuning ======
+/**
+ * @def INBOUND_SWEEP_MS
+ * @brief Period of the SIM storage read that catches +CMTI lost during commands
+ */
+#ifndef INBOUND_SWEEP_MS
+#define INBOUND_SWEEP_MS 60000
+#endif
+
+/**
+ * @def INBOUND_DELETE_MAX
+ * @brief Handed-over messages deleted per read; matches typical SIM storage
+ */
+#ifndef INBOUND_DELETE_MAX
+#define INBOUND_DELETE_MAX 50
+#endif
+
+/**
+ * @def MODEM_PROBE_MS
+ * @brief AT probe before bring-up; only a silent modem gets a PWRKEY pulse
+ */
+#ifndef MODEM_PROBE_MS
+#define MODEM_PROBE_MS 2000
+#endif
+
+/**
+ * @def MODEM_INIT_BUDGET_MS
+ * @brief Supervisor budget of initModemClean(): every preferred mode plus the AUTO fallback
+ *
+ * Raised at run time when the registration and settle times of RadioTiming
+ * need more.
+ */
+#ifndef MODEM_INIT_BUDGET_MS
+#define MODEM_INIT_BUDGET_MS 240000
+#endif
+
+/**
+ * @def MODEM_SUBMIT_BUDGET_MS
+ * @brief Supervisor budget of one part submission: prompt, body and the 60 s +CMGS wait
+ */
+#ifndef MODEM_SUBMIT_BUDGET_MS
+#define MODEM_SUBMIT_BUDGET_MS 70000
+#endif
+
 /**
  * @struct CarrierProfile
  * @brief Carrier-specific configuration profile for optimal modem settings
@@ -59,6 +117,11 @@
  * - 8: Cat-M (LTE-M)
  * - 9: NB-IoT
  * - -1: Unspecified/automatic
+ *
+ * Bearer Values (SMS submit domain, AT+CGSMS):
+ * - CsOnly: circuit-switched only
+ * - PsPreferred: packet domain first, CS when PS fails or is not attached
+ * - CsPreferred: CS first, packet domain when CS fails or flaps
  */
 struct CarrierProfile
 {
@@ -118,6 +181,15 @@ struct CarrierProfile
 
     const char *user; ///< Username for APN authentication (usually empty for SMS-only)
     const char *pass; ///< Password for APN authentication (usually empty for SMS-only)
+
+    /**
+     * @brief SMS bearer strategy
+     *
+     * Starting domain for SMS submission. The BearerSelector switches on
+     * repeated failures and converges on the faster domain measured at the
+     * site; CsOnly never submits over the packet domain.
+     */
+    SmsBearer bearer;
 };
 
 /**
@@ -140,7 +212,8 @@ static const CarrierProfile PROFILES[] = {
         /*modes*/ {38, 51, 13, 2}, /*prefer LTE-M/NB first, fallback GSM*/
         /*cmnb*/ 0,                /*CAT-M preferred*/
         /*lock*/ "22601", 8,       /*optional: lock CAT-M (8)*/
-        /*APN*/ "", "", ""         /*fill your APN if you need data*/
+        /*APN*/ "", "", "",        /*fill your APN if you need data*/
+        /*SMS*/ SmsBearer::PsPreferred /*SMS over LTE-M PS domain*/
     },
 
     // Digi RO (22605) — practical for SIM7000G only on GSM
@@ -149,7 +222,8 @@ static const CarrierProfile PROFILES[] = {
         /*modes*/ {13, 2, 38, 51}, /*prefer GSM first*/
         /*cmnb*/ -1,
         /*lock*/ "22605", 0,       /*optional: lock GSM*/
-        /*APN*/ "internet", "", "" /*common generic APN; change if required*/
+        /*APN*/ "internet", "", "", /*common generic APN; change if required*/
+        /*SMS*/ SmsBearer::CsOnly   /*GSM: CS domain*/
     },
 
     // Orange RO (22610) — LTE-M/NB often available
@@ -157,7 +231,19 @@ static const CarrierProfile PROFILES[] = {
      /*modes*/ {38, 51, 13, 2},
      /*cmnb*/ 0,
      /*lock*/ "22610", 8,
-     /*APN*/ "", "", ""},
+     /*APN*/ "", "", "",
+     /*SMS*/ SmsBearer::PsPreferred},
+};
+
+/**
+ * @brief Site-specific changes to a carrier profile (e.g. from a provisioning bundle)
+ */
+struct CarrierOverride
+{
+    String apn;            ///< Replaces CarrierProfile::apn
+    String user;           ///< Replaces CarrierProfile::user
+    String pass;           ///< Replaces CarrierProfile::pass
+    uint8_t bearer = 0xFF; ///< SmsBearer, or 0xFF to keep the profile's
 };
 
 /**
@@ -167,7 +253,8 @@ static const CarrierProfile PROFILES[] = {
  * Responsibilities:
  * - Power sequencing helpers for the SIM7000G (power on/off/restart)
  * - Modem bring-up and capability probing
- * - Network mode selection and registration checks (CS domain)
+ * - Network mode selection and registration checks (CS and PS domain)
+ * - SMS bearer (CS/PS) selection per submit
  * - Minimal SMS sending primitive used by higher layers (HTTP API)
  *
  * Hardware notes:
@@ -177,6 +264,16 @@ static const CarrierProfile PROFILES[] = {
 class Modem
 {
 public:
+    /**
+     * @brief Lookup of the override for a network; false when there is none
+     */
+    using CarrierOverrideFunction = std::function<bool(const char *mccmnc, CarrierOverride &out)>;
+
+    /**
+     * @brief Receiver of incoming SMS (text mode, first line of the body)
+     */
+    using InboundFunction = std::function<void(const char *from, const char *text)>;
+
     Modem();
     ~Modem();
 
@@ -217,10 +314,48 @@ public:
      * This method is used when carrier-specific optimizations are not needed
      * or when the automatic carrier detection fails.
      *
+     * A modem that answers an AT probe (kept on through deep sleep, or across
+     * an ESP32 restart) is not pulsed: PWRKEY would switch it off. The DTR
+     * hold of prepareSleep() is released first.
+     *
      * @note Less comprehensive than initModem() but more reliable across carriers
      */
     void initModemClean();
 
+    /**
+     * @brief Reattach to a modem that stayed powered through ESP32 deep sleep
+     *
+     * Minimal wake path: releases the DTR hold, reopens the UART, pulls DTR
+     * low to leave DTR sleep and waits briefly for CS registration. PWRKEY
+     * is not touched (a pulse would switch a running modem off).
+     *
+     * @retval true Modem answered and is CS registered
+     * @retval false Modem lost or not registered; the caller should fall
+     *         back to initModemClean()
+     */
+    bool resumeFromSleep();
+
+    /**
+     * @brief Put the modem in its low-power state before ESP32 deep sleep
+     *
+     * Enables PSM (AT+CPSMS=1) so the registration is kept, enables
+     * DTR-controlled sleep (AT+CSCLK=1), raises DTR and holds the pin level
+     * through deep sleep.
+     */
+    void prepareSleep();
+
+    /**
+     * @brief Set the ESP32 system clock from the network time (NITZ)
+     *
+     * Reads AT+CCLK (kept up to date by AT+CLTS=1, enabled in
+     * initModemClean()) and converts it to UTC. Used as the wall clock source
+     * for send windows when SNTP is unavailable.
+     *
+     * @retval true System clock set
+     * @retval false No network time received yet
+     */
+    bool syncClock();
+
     /**
      * @brief Read the International Mobile Subscriber Identity (IMSI) from the SIM card
      *
@@ -262,6 +397,14 @@ public:
      */
     const CarrierProfile *selectProfile(const String &mccmnc);
 
+    /**
+     * @brief Install the carrier override lookup used by selectProfile()
+     *
+     * An override replaces the APN credentials and the SMS bearer strategy of
+     * the matched profile. For unknown carriers only the bearer applies.
+     */
+    void setCarrierOverride(CarrierOverrideFunction fn) { carrierOverride = fn; }
+
     /**
      * @brief Configure radio parameters using carrier-specific profile
      *
@@ -304,10 +447,27 @@ public:
      * @param ms Timeout in milliseconds (default: 30000ms = 30 seconds)
      * @retval true Registration successful within timeout period
      * @retval false Timeout expired without successful registration
-     * @note Blocking function that polls every few seconds until timeout
+     * @note Blocking function that polls every RadioTiming pollMs until timeout
      */
     bool waitCsRegistered(uint32_t ms = 30000);
 
+    /**
+     * @brief Check Packet-Switched (PS) registration using AT+CGREG? / AT+CEREG?
+     *
+     * GPRS attach is read first, then EPS (LTE-M/NB-IoT). Returns true for
+     * 1 (home) or 5 (roaming). Quick check only.
+     */
+    bool isPsRegistered();
+
+    /**
+     * @brief Wait for Packet-Switched registration with timeout
+     *
+     * @param ms Timeout in milliseconds
+     * @retval true Registered within the timeout
+     * @retval false Timeout expired
+     */
+    bool waitPsRegistered(uint32_t ms = 30000);
+
     /**
      * @brief Check if the GSM modem is registered on the cellular network
      *
@@ -333,37 +493,66 @@ public:
      * Expects the destination number in E.164 or local dial format.
      * Message text must be GSM-7/UTF-8 compatible as supported by TinyGSM.
      *
-     * @param to Destination phone number (prefer E.164, e.g. "+40123456789")
-     * @param text Message body to send
+     * @param to Destination phone number (prefer international, e.g. "+40123456789")
+     * @param text Message body to send (NUL-terminated)
      * @retval true Message was accepted for sending by the modem
      * @retval false Sending failed (e.g., not registered, invalid number, or modem error)
      */
-    bool sendSMS(const String &to, const String &text);
+    bool sendSMS(const PhoneNumber &to, const char *text);
 
     /**
-     * @brief Send SMS with additional safety checks and error recovery
-     *
-     * Enhanced SMS sending function that includes additional validation and
-     * recovery mechanisms compared to the basic sendSMS() method:
-     * - Pre-flight validation of modem registration status
-     * - Phone number format validation and normalization
-     * - Message length checks and segmentation warnings
-     * - Automatic retry on temporary failures
-     * - Detailed error logging for troubleshooting
+     * @brief Send a queued job with additional safety checks
+     *
+     * Enhanced SMS sending function that includes additional validation
+     * compared to the basic sendSMS() method:
+     * - Phone number must be international with at least 7 digits
+     * - Body must fit JOB_MAX_SEGMENTS parts once converted to GSM-7
+     * - Waits up to 15 s for registration in the chosen SMS domain
+     *
+     * A body of up to 160 septets is sent as one text-mode SMS. Longer
+     * bodies are sent in PDU mode as concatenated parts sharing
+     * job.concatRef. Each part is tracked in job.segments (message
+     * reference, state, attempts, last error). A failed part is resubmitted
+     * on its own while the RetryClassifier allows it, with the same
+     * reference so the handset reassembles the message; parts already sent
+     * are never resent.
+     *
+     * Every attempt is pinned to one domain (AT+CGSMS) chosen by the
+     * BearerSelector from the carrier's bearer strategy. Its latency and
+     * outcome are fed back, so the selector switches after repeated failures
+     * and converges on the faster domain.
+     *
+     * Unlike sendSMS(), the +CMGS exchange is driven here so the message
+     * references can be captured. Trace stages RegCheck, CmgsIssued and
+     * MsgRef are recorded for the job, and job.msgRef is set to the
+     * reference of the last part on success.
+     *
+     * @param job Job being sent (JobState::Sending)
+     * @retval true Every part was accepted by the network
+     * @retval false A part failed for good, or invalid parameters
+     * @note Slightly slower than sendSMS() due to additional checks
+     */
+    bool sendSmsSafe(SmsJob &job);
+
+    /**
+     * @brief Process unsolicited result codes while the modem is idle
      *
-     * Safety Features:
-     * - Validates network registration before attempting send
-     * - Implements retry logic for temporary network issues
-     * - Provides more detailed error reporting
-     * - Handles edge cases in phone number formatting
+     * Reads complete lines without blocking and forwards +CDS status reports
+     * to the JobTracer. Call regularly from the main loop. URCs that arrive
+     * while another command is waiting for its response may be consumed by
+     * that command, so delivery tracking is best effort.
      *
-     * @param to Destination phone number (E.164 format recommended)
-     * @param text Message content (will be segmented if >160 characters)
-     * @retval true Message sent successfully or queued for delivery
-     * @retval false Send failed after all retry attempts or invalid parameters
-     * @note Slightly slower than sendSMS() due to additional checks
+     * With an inbound receiver set, a +CMTI indication (or every
+     * INBOUND_SWEEP_MS, for indications lost that way) reads the unread
+     * messages from SIM storage, hands them to the receiver and deletes
+     * exactly those by index. Entries that do not parse stay on the SIM.
      */
-    bool sendSmsSafe(const String &to, const String &text);
+    void poll();
+
+    /**
+     * @brief Set the receiver of incoming messages (enables reading them)
+     */
+    void onInbound(InboundFunction fn) { inbound = fn; }
 
     /**
      * @brief Power on the GSM modem
@@ -396,7 +585,125 @@ public:
      */
     static void modemRestart();
 
+    /**
+     * @brief Supervisor recovery of a stuck AT exchange
+     *
+     * Powers the modem off from the supervisor task, so the blocked command
+     * fails; the next poll() powers it on and re-initialises it
+     * (initModemClean()).
+     */
+    void recover();
+
 private:
     TinyGsm modem;
     volatile bool modemBusy = false;
+    std::atomic<bool> reinitPending{false}; ///< recover() ran, poll() re-initialises
+    bool powerCycled = false;    ///< Next initModemClean() pulses PWRKEY without trusting the probe
+    char urcBuf[160];   ///< Partial URC line collected by poll()
+    size_t urcLen = 0;  ///< Bytes currently in urcBuf
+    uint8_t septetBuf[JOB_MAX_SEGMENTS * SmsPdu::PART_SEPTETS]; ///< GSM-7 body of the job being sent
+    uint8_t nextConcatRef = 0;   ///< Concatenation reference for the next multipart job
+    RetryClassifier retry;       ///< Per-segment outcomes and retry decisions
+    BearerSelector bearer;       ///< SMS domain choice and per-domain stats
+    int8_t cgsms = -1;           ///< AT+CGSMS value last applied (-1 = unknown)
+    CarrierOverrideFunction carrierOverride; ///< Site overrides of the carrier profiles
+    CarrierOverride override_;   ///< Override of the selected network (owns the strings)
+    CarrierProfile profile_;     ///< Selected profile with the override applied
+    InboundFunction inbound;     ///< Receiver of incoming messages (none: left in storage)
+    bool inboundPending = false; ///< +CMTI seen, storage not read yet
+    uint32_t lastSweepMs = 0;    ///< millis() of the last storage read
+
+    bool attach();
+
+    /**
+     * @brief Submit a text-mode SMS and return its message reference
+     *
+     * @param number Destination as text
+     * @param text NUL-terminated body
+     * @param jobId Job id for trace marks
+     * @param error Set to the +CMS ERROR code or RetryClassifier::TIMEOUT on failure
+     * @return int TP-MR (0..255), or -1 on failure
+     */
+    int submitText(const char *number, const char *text, uint32_t jobId, int &error);
+
+    /**
+     * @brief Submit one part of a concatenated message in PDU mode
+     *
+     * @param job Job being sent (segmentCount and concatRef set)
+     * @param part 0-based part index
+     * @param bounds Part boundaries in septetBuf (SmsPdu::split())
+     * @param error Set to the +CMS ERROR code or RetryClassifier::TIMEOUT on failure
+     * @return int TP-MR (0..255), or -1 on failure
+     */
+    int submitPart(const SmsJob &job, uint8_t part, const uint16_t *bounds, int &error);
+
+    /**
+     * @brief Submit one part until it is sent or the classifier gives up
+     *
+     * Each attempt is timed and reported to the BearerSelector; a retry
+     * re-chooses the domain.
+     *
+     * @retval true Part sent (now or earlier)
+     * @retval false Part abandoned
+     */
+    bool sendSegment(SmsJob &job, uint8_t part, const uint16_t *bounds, const char *number, SmsDomain &domain);
+
+    /**
+     * @brief Choose the SMS domain and wait for registration in it
+     *
+     * Falls back to the other domain when the strategy allows it and the
+     * chosen one does not register in time; an unregistered domain counts
+     * as a failure for the selector. Applies AT+CGSMS for the result.
+     *
+     * The chosen domain is waited for up to RadioTiming readyMs.
+     *
+     * @param domain Set to the domain to submit over
+     * @retval false Neither allowed domain is registered
+     */
+    bool readyDomain(SmsDomain &domain);
+
+    /**
+     * @brief waitCsRegistered() for the RadioTiming value @p p, noted as its effect
+     */
+    bool waitCsTimed(RadioParam p);
+
+    /**
+     * @brief waitResponse() with the RadioTiming timeout @p p, noted as its effect
+     */
+    template <typename... Args>
+    int8_t waitTimed(RadioParam p, Args &&...args)
+    {
+        RadioTiming &timing = RadioTiming::instance();
+        uint32_t started = millis();
+        int8_t r = modem.waitResponse(timing.get(p), std::forward<Args>(args)...);
+        timing.note(p, millis() - started, r == 0);
+        return r;
+    }
+
+    /**
+     * @brief Supervisor budget of initModemClean() for the current RadioTiming
+     */
+    static uint32_t initBudgetMs();
+
+    /**
+     * @brief Pin SMS submission to @p domain (AT+CGSMS), only on change
+     */
+    void pinDomain(SmsDomain domain);
+
+    /**
+     * @brief Wait for the +CMGS result after the body was written
+     *
+     * @return int TP-MR, or -1 with @p error set
+     */
+    int awaitCmgs(int &error);
+
+    /**
+     * @brief Handle one complete URC line collected by poll()
+     */
+    void handleUrc(const char *line);
+
+    /**
+     * @brief Read, hand over and delete the unread messages in storage
+     */
+    void readInbound();
 };
\ No newline at end of file
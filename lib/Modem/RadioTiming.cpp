@@ -0,0 +1,140 @@
+#include "RadioTiming.hpp"
+#include "ProbeRegistry.hpp"
+
+namespace
+{
+    const char *NVS_NAMESPACE = "radio";
+}
+
+const RadioTiming::Spec RadioTiming::SPECS[RadioTiming::COUNT] = {
+    {"registerMs", 30000, 5000, 180000},
+    {"readyMs", 15000, 1000, 120000},
+    {"settleMs", 1500, 0, 10000},
+    {"pollMs", 500, 100, 5000},
+    {"commandMs", 1000, 300, 10000},
+    {"queryMs", 2000, 300, 10000},
+};
+
+RadioTiming &RadioTiming::instance()
+{
+    static RadioTiming inst;
+    return inst;
+}
+
+RadioTiming::RadioTiming()
+{
+    for (uint8_t i = 0; i < COUNT; ++i)
+        values[i] = SPECS[i].def;
+    ProbeRegistry::instance().registerProbe("radioTiming", [this](JsonObject &dst)
+                                            { toJson(dst); });
+    SettingsApi::instance().registerSection(
+        "radio",
+        [this](JsonObject &dst, bool)
+        { sectionToJson(dst); },
+        [this](JsonObjectConst patch, String &error)
+        { return validatePatch(patch, error); },
+        [this](JsonObjectConst patch)
+        { return applyPatch(patch); });
+}
+
+/**
+ * @brief Stored values outside the bounds of this build fall back to the default
+ */
+void RadioTiming::begin()
+{
+    preferences.begin(NVS_NAMESPACE, true);
+    for (uint8_t i = 0; i < COUNT; ++i)
+    {
+        uint32_t v = preferences.getUInt(SPECS[i].name, SPECS[i].def);
+        values[i] = v >= SPECS[i].min && v <= SPECS[i].max ? v : SPECS[i].def;
+    }
+    preferences.end();
+}
+
+void RadioTiming::note(RadioParam p, uint32_t elapsedMs, bool expired)
+{
+    Effect &e = effects[uint8_t(p)];
+    e.uses++;
+    if (expired)
+    {
+        e.expired++;
+        return;
+    }
+    e.okTotalMs += elapsedMs;
+    if (elapsedMs > e.okMaxMs)
+        e.okMaxMs = elapsedMs;
+}
+
+const RadioTiming::Spec *RadioTiming::find(const char *name, uint8_t &index) const
+{
+    for (index = 0; index < COUNT; ++index)
+        if (strcmp(SPECS[index].name, name) == 0)
+            return &SPECS[index];
+    return nullptr;
+}
+
+void RadioTiming::sectionToJson(JsonObject &dst)
+{
+    for (uint8_t i = 0; i < COUNT; ++i)
+        dst[SPECS[i].name] = values[i];
+}
+
+bool RadioTiming::validatePatch(JsonObjectConst patch, String &error)
+{
+    for (JsonPairConst kv : patch)
+    {
+        uint8_t i;
+        const Spec *spec = find(kv.key().c_str(), i);
+        if (spec == nullptr)
+        {
+            error = String(kv.key().c_str()) + ": unknown setting";
+            return false;
+        }
+        JsonVariantConst v = kv.value();
+        if (!v.is<uint32_t>() || v.as<uint32_t>() < spec->min || v.as<uint32_t>() > spec->max)
+        {
+            error = String(spec->name) + ": " + spec->min + ".." + spec->max + " ms";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Store and use the new values at once; waits already running keep theirs
+ */
+SettingsEffect RadioTiming::applyPatch(JsonObjectConst patch)
+{
+    SettingsEffect effect = SettingsEffect::None;
+    preferences.begin(NVS_NAMESPACE, false);
+    for (JsonPairConst kv : patch)
+    {
+        uint8_t i;
+        if (find(kv.key().c_str(), i) == nullptr || values[i] == kv.value().as<uint32_t>())
+            continue;
+        values[i] = kv.value().as<uint32_t>();
+        preferences.putUInt(SPECS[i].name, values[i]);
+        effect = SettingsEffect::Live;
+    }
+    preferences.end();
+    return effect;
+}
+
+void RadioTiming::toJson(JsonObject &dst) const
+{
+    for (uint8_t i = 0; i < COUNT; ++i)
+    {
+        const Effect &e = effects[i];
+        JsonObject p = dst[SPECS[i].name].to<JsonObject>();
+        p["value"] = values[i];
+        p["default"] = SPECS[i].def;
+        JsonArray range = p["range"].to<JsonArray>();
+        range.add(SPECS[i].min);
+        range.add(SPECS[i].max);
+        p["uses"] = e.uses;
+        p["expired"] = e.expired;
+        p["okMaxMs"] = e.okMaxMs;
+        uint32_t ok = e.uses - e.expired;
+        p["okAvgMs"] = ok ? uint32_t(e.okTotalMs / ok) : 0;
+    }
+}
@@ -0,0 +1,106 @@
+/**
+ * @file RadioTiming.hpp
+ * @brief Runtime-tunable registration and AT timing of the modem, with effect counters
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "SettingsApi.hpp"
+#include "WearPreferences.hpp"
+
+/**
+ * @brief Timing parameters of the modem; index into the RadioTiming table
+ */
+enum class RadioParam : uint8_t
+{
+    RegisterMs = 0, ///< CS registration wait per network mode at bring-up
+    ReadyMs,        ///< Registration wait before a send (and between part retries)
+    SettleMs,       ///< Pause after switching the network mode, before polling
+    PollMs,         ///< Period of the registration queries while waiting
+    CommandMs,      ///< Answer timeout of short AT commands (+CNMP?, +CMNB?)
+    QueryMs,        ///< Answer timeout of status queries (+CREG?, +CGREG?, +CEREG?, +CIMI)
+    Count,
+};
+
+/**
+ * @brief Typed table of the modem timing, stored in NVS and patched live
+ *
+ * Every parameter has a default (the former hard-coded value) and bounds.
+ * The table is the "radio" section of the settings document, so
+ * `PATCH /settings {"radio":{"registerMs":45000}}` or the BLE key "radio"
+ * changes it; values outside the bounds are refused. Changes apply to the
+ * next wait or command, without a restart.
+ *
+ * The Modem reports each use with note(). The "radioTiming" probe then shows
+ * per parameter how often it was used, how often its budget ran out and
+ * how long the uses that did not run out took, which is the margin to tune
+ * against:
+ * - registerMs, readyMs: registration waits; "expired" are waits that gave up
+ * - settleMs: the registration waits that followed a settle
+ * - pollMs: registration queries sent (AT traffic while waiting)
+ * - commandMs, queryMs: answered commands; "expired" are timeouts
+ *
+ * The Supervisor stage budgets of the modem follow the table (see Modem).
+ */
+class RadioTiming
+{
+public:
+    static RadioTiming &instance();
+
+    /**
+     * @brief Load the stored values (call after NVS is available)
+     */
+    void begin();
+
+    /** @brief Current value of @p p in milliseconds */
+    uint32_t get(RadioParam p) const { return values[uint8_t(p)]; }
+
+    /**
+     * @brief Record one use of @p p
+     *
+     * @param elapsedMs How long the wait or command took
+     * @param expired The whole budget was used without success
+     */
+    void note(RadioParam p, uint32_t elapsedMs, bool expired);
+
+    /**
+     * @brief Write {"<param>":{"value","default","range":[min,max],"uses",
+     * "expired","okMaxMs","okAvgMs"}, ...}
+     */
+    void toJson(JsonObject &dst) const;
+
+private:
+    struct Spec
+    {
+        const char *name;
+        uint32_t def;
+        uint32_t min;
+        uint32_t max;
+    };
+
+    struct Effect
+    {
+        uint32_t uses = 0;
+        uint32_t expired = 0;
+        uint32_t okMaxMs = 0;
+        uint64_t okTotalMs = 0;
+    };
+
+    static constexpr uint8_t COUNT = uint8_t(RadioParam::Count);
+    static const Spec SPECS[COUNT];
+
+    RadioTiming();
+    RadioTiming(const RadioTiming &) = delete;
+    RadioTiming &operator=(const RadioTiming &) = delete;
+
+    const Spec *find(const char *name, uint8_t &index) const;
+    void sectionToJson(JsonObject &dst);
+    bool validatePatch(JsonObjectConst patch, String &error);
+    SettingsEffect applyPatch(JsonObjectConst patch);
+
+    volatile uint32_t values[COUNT]; ///< Patched from the BLE task, read by the modem
+    Effect effects[COUNT];
+    WearPreferences preferences{"radio"};
+};
@@ -0,0 +1,121 @@
+#include "RetryClassifier.hpp"
+#include <stdio.h>
+
+/**
+ * @brief Transient: timeouts, RP congestion/temporary causes, SC busy or
+ * failing, ME failures and lost network service
+ */
+bool RetryClassifier::isTransient(int error)
+{
+    switch (error)
+    {
+    case TIMEOUT:
+    case 27:  // RP: destination out of service
+    case 38:  // RP: network out of order
+    case 41:  // RP: temporary failure
+    case 42:  // RP: congestion
+    case 47:  // RP: resources unavailable
+    case 111: // RP: protocol error, unspecified
+    case 127: // RP: interworking, unspecified
+    case 192: // TP-FCS: SC busy
+    case 194: // TP-FCS: SC system failure
+    case 300: // ME failure
+    case 331: // no network service
+    case 332: // network timeout
+    case 500: // unknown error
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Static class, attempt budget, then the learned recovery rate
+ */
+bool RetryClassifier::shouldRetry(int error, uint8_t attempts) const
+{
+    if (attempts >= SMS_SEGMENT_ATTEMPTS || !isTransient(error))
+        return false;
+    const CodeStats *s = find(error);
+    return s == nullptr || !learnedHopeless(*s);
+}
+
+void RetryClassifier::noteAttempt(uint8_t attempt, int error, int previousError)
+{
+    attempts_++;
+    if (attempt <= 1 && error == OK)
+        firstTry_++;
+    if (attempt > 1)
+    {
+        retries_++;
+        CodeStats &prev = slot(previousError);
+        prev.retries++;
+        if (error == OK)
+        {
+            recovered_++;
+            prev.recovered++;
+        }
+    }
+    if (error != OK)
+        slot(error).seen++;
+}
+
+void RetryClassifier::toJson(JsonObject &root) const
+{
+    root["attempts"] = attempts_;
+    root["firstTry"] = firstTry_;
+    root["retries"] = retries_;
+    root["recovered"] = recovered_;
+    root["gaveUp"] = gaveUp_;
+    root["multipartOk"] = multipartOk_;
+    root["multipartFailed"] = multipartFailed_;
+    JsonObject codes = root["codes"].to<JsonObject>();
+    for (const CodeStats &s : codes_)
+    {
+        if (!s.used)
+            continue;
+        char key[12];
+        snprintf(key, sizeof(key), "%d", s.code);
+        JsonObject o = codes[key].to<JsonObject>();
+        o["seen"] = s.seen;
+        o["retries"] = s.retries;
+        o["recovered"] = s.recovered;
+        o["retry"] = isTransient(s.code) && !learnedHopeless(s);
+    }
+}
+
+const RetryClassifier::CodeStats *RetryClassifier::find(int code) const
+{
+    for (const CodeStats &s : codes_)
+        if (s.used && s.code == code)
+            return &s;
+    return nullptr;
+}
+
+/**
+ * @brief Stats slot of a code, replacing the least recently used one
+ */
+RetryClassifier::CodeStats &RetryClassifier::slot(int code)
+{
+    CodeStats *victim = &codes_[0];
+    for (CodeStats &s : codes_)
+    {
+        if (s.used && s.code == code)
+        {
+            s.lastUse = ++tick_;
+            return s;
+        }
+        if (!s.used || (victim->used && s.lastUse < victim->lastUse))
+            victim = &s;
+    }
+    *victim = CodeStats();
+    victim->code = code;
+    victim->used = true;
+    victim->lastUse = ++tick_;
+    return *victim;
+}
+
+bool RetryClassifier::learnedHopeless(const CodeStats &s) const
+{
+    return s.retries >= RETRY_LEARN_MIN && s.recovered * 100 < s.retries * RETRY_LEARN_FLOOR_PCT;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file RetryClassifier.hpp
+ * @brief Per-segment submit outcomes and the retry decision they feed
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ArduinoJson.h>
+
+// ====== Tuning ======
+/**
+ * @def SMS_SEGMENT_ATTEMPTS
+ * @brief Submit attempts per segment (first try included)
+ */
+#ifndef SMS_SEGMENT_ATTEMPTS
+#define SMS_SEGMENT_ATTEMPTS 3
+#endif
+
+/**
+ * @def SMS_SEGMENT_RETRY_MS
+ * @brief Pause before resubmitting a failed segment
+ */
+#ifndef SMS_SEGMENT_RETRY_MS
+#define SMS_SEGMENT_RETRY_MS 2000
+#endif
+
+/**
+ * @def RETRY_LEARN_MIN
+ * @brief Retries of one error code observed before its recovery rate is trusted
+ */
+#ifndef RETRY_LEARN_MIN
+#define RETRY_LEARN_MIN 8
+#endif
+
+/**
+ * @def RETRY_LEARN_FLOOR_PCT
+ * @brief Retries of a code stop once fewer than this share of them recover
+ */
+#ifndef RETRY_LEARN_FLOOR_PCT
+#define RETRY_LEARN_FLOOR_PCT 10
+#endif
+
+/**
+ * @def RETRY_CODES
+ * @brief Distinct error codes tracked (least recently seen replaced first)
+ */
+#ifndef RETRY_CODES
+#define RETRY_CODES 8
+#endif
+
+/**
+ * @brief Decides whether a failed segment is worth resubmitting
+ *
+ * Errors are "+CMS ERROR: <code>" values (TS 27.005 §3.2.5), or TIMEOUT when
+ * the modem gave no prompt or no +CMGS within the timeout. The static base
+ * class says which codes can recover at all (network congestion, temporary
+ * failure, SC busy, no network service, ...); unknown-subscriber style codes
+ * and malformed PDUs are never retried.
+ *
+ * Every submit attempt is reported back with noteAttempt(). Per code the
+ * classifier counts how many retries followed it and how many of those
+ * succeeded; once RETRY_LEARN_MIN retries were seen and fewer than
+ * RETRY_LEARN_FLOOR_PCT recovered, that code is no longer retried on this
+ * network. Counters are exported in the "modem" probe under "segments".
+ *
+ * No Arduino dependency.
+ */
+class RetryClassifier
+{
+public:
+    static constexpr int TIMEOUT = -1; ///< No prompt or no +CMGS in time
+    static constexpr int OK = 0;       ///< Attempt succeeded
+
+    /**
+     * @brief Static classification of an error
+     *
+     * @retval true The error is transient (worth a retry)
+     * @retval false The error is permanent
+     */
+    static bool isTransient(int error);
+
+    /**
+     * @brief Retry decision for a segment that just failed
+     *
+     * @param error Error of the failed attempt
+     * @param attempts Attempts made so far for the segment
+     */
+    bool shouldRetry(int error, uint8_t attempts) const;
+
+    /**
+     * @brief Report one submit attempt of a segment
+     *
+     * @param attempt 1-based attempt number of the segment
+     * @param error OK or the error of this attempt
+     * @param previousError Error of the previous attempt (ignored for attempt 1)
+     */
+    void noteAttempt(uint8_t attempt, int error, int previousError);
+
+    /**
+     * @brief Report a segment abandoned after its last failed attempt
+     */
+    void noteGaveUp() { gaveUp_++; }
+
+    /**
+     * @brief Report a finished multipart job (all parts sent or abandoned)
+     */
+    void noteMultipart(bool ok) { ok ? multipartOk_++ : multipartFailed_++; }
+
+    /**
+     * @brief Write {"attempts","firstTry","retries","recovered","gaveUp",
+     * "multipartOk","multipartFailed","codes":{"<code>":{"seen","retries",
+     * "recovered","retry"}}}
+     */
+    void toJson(JsonObject &root) const;
+
+private:
+    struct CodeStats
+    {
+        int code = 0;
+        uint32_t seen = 0;
+        uint32_t retries = 0;   ///< Retries that followed this error
+        uint32_t recovered = 0; ///< Of which succeeded
+        uint32_t lastUse = 0;
+        bool used = false;
+    };
+
+    CodeStats codes_[RETRY_CODES];
+    uint32_t tick_ = 0;
+    uint32_t attempts_ = 0;
+    uint32_t firstTry_ = 0;
+    uint32_t retries_ = 0;
+    uint32_t recovered_ = 0;
+    uint32_t gaveUp_ = 0;
+    uint32_t multipartOk_ = 0;
+    uint32_t multipartFailed_ = 0;
+
+    const CodeStats *find(int code) const;
+    CodeStats &slot(int code);
+    bool learnedHopeless(const CodeStats &s) const;
+};
@@ -0,0 +1,166 @@
+#include "SmsPdu.hpp"
+#include <string.h>
+
+namespace
+{
+    /// Unicode code point of each GSM 03.38 default alphabet septet
+    const uint16_t GSM7_BASIC[128] = {
+        0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC, 0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
+        0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8, 0x03A3, 0x0398, 0x039E, 0x001B, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+        0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027, 0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+        0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037, 0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+        0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047, 0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+        0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+        0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067, 0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+        0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0,
+    };
+
+    /// Extension table: code point and septet following the 0x1B escape
+    const struct
+    {
+        uint16_t cp;
+        uint8_t septet;
+    } GSM7_EXT[] = {
+        {0x000C, 0x0A}, {0x005E, 0x14}, {0x007B, 0x28}, {0x007D, 0x29}, {0x005C, 0x2F},
+        {0x005B, 0x3C}, {0x007E, 0x3D}, {0x005D, 0x3E}, {0x007C, 0x40}, {0x20AC, 0x65},
+    };
+
+    const uint8_t ESC = 0x1B;
+    const uint8_t UDH_CONCAT[] = {0x05, 0x00, 0x03}; ///< UDHL, IEI 8-bit concatenation, IEDL
+    const uint8_t UDH_SEPTETS = 7;                   ///< 6 UDH octets + 1 fill bit
+
+    /**
+     * @brief Decode one UTF-8 sequence (invalid bytes decode as U+FFFD)
+     */
+    uint32_t nextCodePoint(const uint8_t *&p, const uint8_t *end)
+    {
+        uint8_t b = *p++;
+        if (b < 0x80)
+            return b;
+        int extra = (b & 0xE0) == 0xC0 ? 1 : (b & 0xF0) == 0xE0 ? 2 : (b & 0xF8) == 0xF0 ? 3 : -1;
+        if (extra < 0 || end - p < extra)
+            return 0xFFFD;
+        uint32_t cp = b & (0x3F >> extra);
+        for (int i = 0; i < extra; ++i)
+        {
+            if ((*p & 0xC0) != 0x80)
+                return 0xFFFD;
+            cp = (cp << 6) | (*p++ & 0x3F);
+        }
+        return cp;
+    }
+
+    /**
+     * @brief Pack septets LSB first starting at bit @p startBit of @p out
+     */
+    size_t pack(const uint8_t *septets, size_t n, uint8_t *out, size_t startBit)
+    {
+        size_t bytes = (startBit + 7 * n + 7) / 8;
+        memset(out + startBit / 8, 0, bytes - startBit / 8);
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t bit = startBit + 7 * i;
+            uint16_t v = uint16_t(septets[i] & 0x7F) << (bit & 7);
+            out[bit >> 3] |= uint8_t(v);
+            if (v >> 8)
+                out[(bit >> 3) + 1] |= uint8_t(v >> 8);
+        }
+        return bytes;
+    }
+}
+
+/**
+ * @brief Default alphabet first (ASCII fast path), then the extension table
+ *
+ * @return int Septet, or -1 if the code point is not representable
+ */
+int SmsPdu::toSeptet(uint32_t cp, bool &escaped)
+{
+    escaped = false;
+    if (cp < 0x80 && GSM7_BASIC[cp] == cp && cp != ESC)
+        return int(cp);
+    for (size_t i = 0; i < 128; ++i)
+        if (GSM7_BASIC[i] == cp && i != ESC)
+            return int(i);
+    for (const auto &e : GSM7_EXT)
+    {
+        if (e.cp == cp)
+        {
+            escaped = true;
+            return e.septet;
+        }
+    }
+    return -1;
+}
+
+size_t SmsPdu::toGsm7(const char *utf8, size_t len, uint8_t *septets, size_t cap)
+{
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(utf8);
+    const uint8_t *end = p + len;
+    size_t n = 0;
+    while (p < end)
+    {
+        bool escaped;
+        int s = toSeptet(nextCodePoint(p, end), escaped);
+        if (s < 0)
+            s = '?';
+        if (n + (escaped ? 2 : 1) > cap)
+            return cap + 1;
+        if (escaped)
+            septets[n++] = ESC;
+        septets[n++] = uint8_t(s);
+    }
+    return n;
+}
+
+/**
+ * @brief 153-septet parts; a part never ends on an escape septet
+ */
+uint8_t SmsPdu::split(const uint8_t *septets, size_t n, uint16_t *bounds, uint8_t maxParts)
+{
+    bounds[0] = 0;
+    if (n <= SINGLE_SEPTETS)
+    {
+        if (maxParts < 1)
+            return 0;
+        bounds[1] = uint16_t(n);
+        return 1;
+    }
+    uint8_t parts = 0;
+    size_t at = 0;
+    while (at < n)
+    {
+        if (parts == maxParts)
+            return 0;
+        size_t endAt = at + PART_SEPTETS < n ? at + PART_SEPTETS : n;
+        if (endAt < n && septets[endAt - 1] == ESC)
+            endAt--;
+        bounds[++parts] = uint16_t(endAt);
+        at = endAt;
+    }
+    return parts;
+}
+
+/**
+ * @brief First octet 0x71: SMS-SUBMIT, relative VP, SRR, UDHI
+ */
+size_t SmsPdu::buildPart(const PhoneNumber &to, const uint8_t *septets, size_t n, uint8_t ref, uint8_t total, uint8_t seq, uint8_t *out)
+{
+    if (!to.isValid() || n == 0 || n > PART_SEPTETS || seq == 0 || seq > total)
+        return 0;
+    uint8_t *p = out;
+    *p++ = 0x71; // MTI=01 | VPF=10 | SRR | UDHI
+    *p++ = 0x00; // TP-MR, assigned by the modem
+    p += to.writePduAddress(p);
+    *p++ = 0x00; // TP-PID
+    *p++ = 0x00; // TP-DCS: GSM-7
+    *p++ = 167;  // TP-VP: 24 h
+    *p++ = uint8_t(UDH_SEPTETS + n);
+    uint8_t *ud = p;
+    memcpy(ud, UDH_CONCAT, sizeof(UDH_CONCAT));
+    ud[3] = ref;
+    ud[4] = total;
+    ud[5] = seq;
+    p += pack(septets, n, ud, UDH_SEPTETS * 7);
+    return size_t(p - out);
+}
@@ -0,0 +1,75 @@
+/**
+ * @file SmsPdu.hpp
+ * @brief GSM-7 encoding, segmentation and SMS-SUBMIT PDU construction
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "PhoneNumber.hpp"
+
+/**
+ * @brief Allocation-free helpers for concatenated (multipart) SMS
+ *
+ * Bodies are converted from UTF-8 to GSM 03.38 septets (default alphabet
+ * plus the extension table, which costs two septets per character);
+ * characters outside both tables become '?'. A body of up to 160 septets
+ * is one SMS; longer bodies are split into parts of at most 153 septets,
+ * each carrying an 8-bit concatenation UDH (IEI 0x00), never splitting an
+ * escape sequence.
+ *
+ * No Arduino dependency, like AtParser.
+ */
+class SmsPdu
+{
+public:
+    static constexpr size_t SINGLE_SEPTETS = 160; ///< Septets in a non-concatenated SMS
+    static constexpr size_t PART_SEPTETS = 153;   ///< Septets per part after the 6 octet UDH
+    static constexpr size_t SUBMIT_MAX = 176;     ///< Largest SMS-SUBMIT TPDU (without SCA)
+
+    /**
+     * @brief Convert a UTF-8 body to GSM-7 septets
+     *
+     * @param utf8 Body bytes
+     * @param len Body length in bytes
+     * @param septets Output, one septet per byte
+     * @param cap Capacity of @p septets
+     * @return size_t Septets written, or cap + 1 if the body does not fit
+     */
+    static size_t toGsm7(const char *utf8, size_t len, uint8_t *septets, size_t cap);
+
+    /**
+     * @brief Split septets into parts
+     *
+     * @param septets Encoded body
+     * @param n Septet count
+     * @param bounds Output part boundaries: part i is [bounds[i], bounds[i+1])
+     *        (@p maxParts + 1 entries)
+     * @param maxParts Most parts allowed
+     * @return uint8_t Part count, or 0 if the body needs more than @p maxParts
+     */
+    static uint8_t split(const uint8_t *septets, size_t n, uint16_t *bounds, uint8_t maxParts);
+
+    /**
+     * @brief Build one SMS-SUBMIT TPDU of a concatenated message
+     *
+     * Same parameters as AT+CSMP=49,167,0,0: status report requested,
+     * relative validity 24 h, PID 0, DCS GSM-7. The UDH carries the
+     * concatenation reference, so a resent part is reassembled with the
+     * parts already delivered.
+     *
+     * @param to Destination
+     * @param septets Septets of this part
+     * @param n Septet count (1..PART_SEPTETS)
+     * @param ref Concatenation reference, identical for all parts of a message
+     * @param total Number of parts
+     * @param seq Part number, 1-based
+     * @param out TPDU output (SUBMIT_MAX bytes suffice)
+     * @return size_t TPDU length (the AT+CMGS=<length> value), 0 on bad input
+     */
+    static size_t buildPart(const PhoneNumber &to, const uint8_t *septets, size_t n, uint8_t ref, uint8_t total, uint8_t seq, uint8_t *out);
+
+private:
+    static int toSeptet(uint32_t cp, bool &escaped);
+};
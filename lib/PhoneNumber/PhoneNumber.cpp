@@ -0,0 +1,153 @@
+/**
+ * @file PhoneNumber.cpp
+ * @brief Implementation of the packed phone number type
+ */
+
+#include "PhoneNumber.hpp"
+
+namespace
+{
+    /**
+     * @brief ASCII for a GSM 03.38 default alphabet septet, '?' when there is none
+     */
+    char septetToAscii(uint8_t s)
+    {
+        switch (s)
+        {
+        case 0x00:
+            return '@';
+        case 0x02:
+            return '$';
+        case 0x11:
+            return '_';
+        case 0x24:
+        case 0x40:
+        case 0x5B:
+        case 0x5C:
+        case 0x5D:
+        case 0x5E:
+        case 0x5F:
+        case 0x60:
+            return '?'; // national letters and currency signs
+        default:
+            return (s >= 0x20 && s <= 0x7A) ? char(s) : '?';
+        }
+    }
+}
+
+/**
+ * @brief Parse and pack a textual phone number
+ *
+ * Validates the same rules as the previous string check (7..20 chars,
+ * digits and a leading '+'), then packs two digits per byte.
+ */
+bool PhoneNumber::parse(const char *s, size_t n)
+{
+    clear();
+    if (s == nullptr || n < MIN_CHARS || n > MAX_CHARS)
+        return false;
+
+    bool international = (s[0] == '+');
+    size_t i = international ? 1 : 0;
+    uint8_t count = 0;
+    for (; i < n; ++i)
+    {
+        char c = s[i];
+        if (c < '0' || c > '9')
+        {
+            clear();
+            return false;
+        }
+        uint8_t d = uint8_t(c - '0');
+        if (count & 1)
+            bcd_[count >> 1] |= uint8_t(d << 4);
+        else
+            bcd_[count >> 1] = d;
+        ++count;
+    }
+    if (count == 0)
+    {
+        clear();
+        return false;
+    }
+    if (count & 1)
+        bcd_[count >> 1] |= 0xF0; // filler semi-octet
+
+    len_ = count;
+    toa_ = international ? TOA_INTERNATIONAL : TOA_UNKNOWN;
+    return true;
+}
+
+/**
+ * @brief Unpack a PDU address field (Address-Length, TOA, semi-octets)
+ */
+size_t PhoneNumber::readPduAddress(const uint8_t *in, size_t n)
+{
+    clear();
+    if (in == nullptr || n < 2)
+        return 0;
+    uint8_t digits = in[0];
+    uint8_t toa = in[1];
+    size_t octets = (digits + 1u) >> 1;
+    if (digits == 0 || digits > MAX_DIGITS || n < 2 + octets || (toa & 0x80) == 0)
+        return 0;
+    if ((toa & TON_MASK) == TON_ALPHANUMERIC)
+    {
+        // Packed GSM-7; semi-octets past the length carry no characters
+        len_ = digits;
+        toa_ = toa;
+        memcpy(bcd_, in + 2, octets);
+        if (digits & 1)
+            bcd_[digits >> 1] &= 0x0F;
+        return 2 + octets;
+    }
+    for (uint8_t i = 0; i < digits; ++i)
+    {
+        uint8_t b = in[2 + (i >> 1)];
+        uint8_t d = (i & 1) ? (b >> 4) : (b & 0x0F);
+        if (d > 9)
+        {
+            clear();
+            return 0;
+        }
+    }
+    len_ = digits;
+    toa_ = toa;
+    memcpy(bcd_, in + 2, octets);
+    if (digits & 1)
+        bcd_[digits >> 1] |= 0xF0;
+    return 2 + octets;
+}
+
+/**
+ * @brief Render digits (with '+' for international numbers) into a buffer
+ */
+size_t PhoneNumber::toChars(char *out, size_t cap) const
+{
+    if (isAlphanumeric())
+    {
+        size_t septets = (len_ * 4u) / 7u;
+        if (out == nullptr || cap < septets + 1)
+            return 0;
+        for (size_t i = 0; i < septets; ++i)
+        {
+            size_t bit = i * 7;
+            uint16_t v = bcd_[bit >> 3];
+            if ((bit >> 3) + 1 < sizeof(bcd_))
+                v |= uint16_t(bcd_[(bit >> 3) + 1]) << 8;
+            out[i] = septetToAscii(uint8_t((v >> (bit & 7)) & 0x7F));
+        }
+        out[septets] = '\0';
+        return septets;
+    }
+    size_t need = len_ + (isInternational() ? 1 : 0);
+    if (out == nullptr || cap < need + 1)
+        return 0;
+    size_t w = 0;
+    if (isInternational())
+        out[w++] = '+';
+    for (uint8_t i = 0; i < len_; ++i)
+        out[w++] = digitAt(i);
+    out[w] = '\0';
+    return w;
+}
@@ -0,0 +1,233 @@
+/**
+ * @file PhoneNumber.hpp
+ * @brief Compact semi-octet (packed BCD) phone number representation
+ *
+ * Phone numbers are the key of every per-recipient store (queues, history,
+ * opt-out lists, rate-limit tables). Keeping them as `String` costs a heap
+ * block per copy; PhoneNumber keeps the digits packed two per byte in the
+ * exact layout of a 3GPP TS 23.040 address field, so a stored number can be
+ * hashed, compared and written into a PDU without any conversion.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+/**
+ * @brief Phone number stored as a 3GPP TS 23.040 address field
+ *
+ * Memory layout (12 bytes, no heap):
+ * - len_: number of digits (the "Address-Length" octet of a PDU address)
+ * - toa_: type of address as parsed (0x91 international, 0x81 unknown; a
+ *   PDU address keeps its own, e.g. 0xA1 national or 0xD0 alphanumeric)
+ * - bcd_: semi-octets, low nibble first, odd count padded with 0xF; for an
+ *   alphanumeric address the packed GSM-7 octets (bits past len_ zeroed)
+ *
+ * Unused trailing bytes are always zero, so equal numbers have equal fields.
+ * Equality, ordering, hashing and writePduAddress() go field by field and do
+ * not depend on the member layout.
+ *
+ * Accepted input (same rules as the former HTTP validation):
+ * - 7..20 characters in total
+ * - an optional leading '+' (marks the number as international)
+ * - digits only otherwise
+ *
+ * Storage comparison per stored number on ESP32 (Arduino core 2.x):
+ * | Representation            | Bytes / record       | 10,000 records |
+ * |---------------------------|----------------------|----------------|
+ * | `char[21]` fixed field    | 21                   | 210,000 B      |
+ * | `String` (SSO, <=15 chars)| 16                   | 160,000 B      |
+ * | `String` (heap, >15 chars)| 16 + ~32 heap block  | ~480,000 B     |
+ * | PhoneNumber               | 12                   | 120,000 B      |
+ *
+ * i.e. 90 KB saved per 10,000 records against a fixed char buffer, 40 KB
+ * against short `String`s and ~360 KB against heap-backed ones, without
+ * counting allocator fragmentation.
+ */
+class PhoneNumber
+{
+public:
+    static constexpr uint8_t MAX_DIGITS = 20;             ///< Maximum digits that can be stored
+    static constexpr uint8_t MIN_CHARS = 7;               ///< Minimum accepted input length (incl. '+')
+    static constexpr uint8_t MAX_CHARS = 20;              ///< Maximum accepted input length (incl. '+')
+    static constexpr size_t STRING_MAX = MAX_DIGITS + 2;  ///< Buffer size for toChars() ('+' + digits + NUL)
+    static constexpr size_t PDU_ADDRESS_MAX = 2 + (MAX_DIGITS + 1) / 2; ///< Largest writePduAddress() output
+    static constexpr uint8_t TOA_INTERNATIONAL = 0x91;    ///< Type of address: international, ISDN plan
+    static constexpr uint8_t TOA_UNKNOWN = 0x81;          ///< Type of address: unknown, ISDN plan
+    static constexpr uint8_t TON_MASK = 0x70;             ///< Type-of-number bits of the TOA octet
+    static constexpr uint8_t TON_INTERNATIONAL = 0x10;    ///< Type of number: international
+    static constexpr uint8_t TON_ALPHANUMERIC = 0x50;     ///< Type of number: alphanumeric (GSM-7 packed)
+
+    /**
+     * @brief Construct an empty (invalid) phone number
+     */
+    PhoneNumber() { clear(); }
+
+    /**
+     * @brief Reset to the empty (invalid) state
+     */
+    void clear()
+    {
+        len_ = 0;
+        toa_ = 0;
+        memset(bcd_, 0, sizeof(bcd_));
+    }
+
+    /**
+     * @brief Parse a textual phone number into packed form
+     *
+     * @param s Input characters (not necessarily NUL-terminated)
+     * @param n Number of characters in s
+     * @retval true Input was valid; this object now holds the number
+     * @retval false Input was rejected; this object is left empty
+     */
+    bool parse(const char *s, size_t n);
+
+    /**
+     * @brief Parse a NUL-terminated phone number
+     *
+     * @param s NUL-terminated input (nullptr is rejected)
+     * @retval true Input was valid
+     * @retval false Input was rejected; this object is left empty
+     */
+    bool parse(const char *s) { return s != nullptr && parse(s, strlen(s)); }
+
+    /**
+     * @brief Load a number from a PDU address field (inverse of writePduAddress())
+     *
+     * The type of address is kept as read. Alphanumeric senders (up to 11
+     * characters) are stored packed; digitAt() does not apply to them.
+     *
+     * @param in Address bytes starting at the Address-Length octet
+     * @param n Number of bytes available in @p in
+     * @return size_t Bytes consumed, or 0 if the field is malformed
+     */
+    size_t readPduAddress(const uint8_t *in, size_t n);
+
+    /** @return true if a number is stored */
+    bool isValid() const { return len_ != 0; }
+
+    /** @return true if the number was given with a leading '+' (or has an international TOA) */
+    bool isInternational() const { return (toa_ & TON_MASK) == TON_INTERNATIONAL; }
+
+    /** @return true for an alphanumeric sender read from a PDU */
+    bool isAlphanumeric() const { return (toa_ & TON_MASK) == TON_ALPHANUMERIC; }
+
+    /** @return The type-of-address octet (0 when empty) */
+    uint8_t typeOfAddress() const { return toa_; }
+
+    /** @return Number of stored digits (excluding '+'); semi-octets when alphanumeric */
+    uint8_t digitCount() const { return len_; }
+
+    /**
+     * @brief Get a single digit as ASCII
+     *
+     * @param i Digit index (0-based, must be < digitCount())
+     * @return char '0'..'9'
+     */
+    char digitAt(uint8_t i) const
+    {
+        uint8_t b = bcd_[i >> 1];
+        return char('0' + ((i & 1) ? (b >> 4) : (b & 0x0F)));
+    }
+
+    /**
+     * @brief Render the number as text ("+40712345678", "0712345678" or the
+     * sender name; GSM-7 characters without an ASCII equivalent become '?')
+     *
+     * @param out Destination buffer (STRING_MAX bytes always suffice)
+     * @param cap Capacity of out in bytes
+     * @return size_t Characters written (excluding NUL), 0 if cap is too small
+     */
+    size_t toChars(char *out, size_t cap) const;
+
+    /**
+     * @brief Write the number as a TS 23.040 address field
+     *
+     * Output is Address-Length, Type-of-Address and the semi-octets, i.e. the
+     * DA field of an SMS-SUBMIT PDU. The semi-octets are already stored in
+     * PDU order, so this is two octets and one copy.
+     *
+     * @param out Destination buffer (PDU_ADDRESS_MAX bytes always suffice)
+     * @return size_t Number of bytes written
+     */
+    size_t writePduAddress(uint8_t *out) const
+    {
+        out[0] = len_;
+        out[1] = toa_;
+        memcpy(out + 2, bcd_, (len_ + 1u) >> 1);
+        return pduAddressSize();
+    }
+
+    /** @return Size in bytes of the PDU address field for this number */
+    size_t pduAddressSize() const { return 2 + ((len_ + 1u) >> 1); }
+
+    /**
+     * @brief 32-bit FNV-1a hash over the PDU address (length, TOA, semi-octets)
+     *
+     * Stable across boots and builds, so it may be persisted or used as a
+     * bucket index in fixed-size tables.
+     */
+    uint32_t hash() const
+    {
+        uint32_t h = 2166136261u;
+        h = (h ^ len_) * 16777619u;
+        h = (h ^ toa_) * 16777619u;
+        for (size_t i = 0, n = (len_ + 1u) >> 1; i < n; ++i)
+            h = (h ^ bcd_[i]) * 16777619u;
+        return h;
+    }
+
+    bool operator==(const PhoneNumber &o) const
+    {
+        return len_ == o.len_ && toa_ == o.toa_ && memcmp(bcd_, o.bcd_, sizeof(bcd_)) == 0;
+    }
+    bool operator!=(const PhoneNumber &o) const { return !(*this == o); }
+    /** Total order (length, type, digits); suitable for sorted tables */
+    bool operator<(const PhoneNumber &o) const
+    {
+        if (len_ != o.len_)
+            return len_ < o.len_;
+        if (toa_ != o.toa_)
+            return toa_ < o.toa_;
+        return memcmp(bcd_, o.bcd_, sizeof(bcd_)) < 0;
+    }
+
+#ifdef ARDUINO
+    /**
+     * @brief Parse from an Arduino String
+     */
+    bool parse(const String &s) { return parse(s.c_str(), s.length()); }
+
+    /**
+     * @brief Render as an Arduino String (for logs and JSON only)
+     */
+    String toString() const
+    {
+        char buf[STRING_MAX];
+        toChars(buf, sizeof(buf));
+        return String(buf);
+    }
+#endif
+
+private:
+    uint8_t len_;                        ///< Digit count (PDU Address-Length)
+    uint8_t toa_;                        ///< Type of address (PDU TOA octet)
+    uint8_t bcd_[(MAX_DIGITS + 1) / 2];  ///< Semi-octets, low nibble first, 0xF filler
+};
+
+static_assert(sizeof(PhoneNumber) == 12, "PhoneNumber must stay packed (used as a stored key)");
+
+/**
+ * @brief Hash functor for unordered containers keyed by PhoneNumber
+ */
+struct PhoneNumberHash
+{
+    size_t operator()(const PhoneNumber &n) const { return n.hash(); }
+};
@@ -1,4 +1,5 @@
 #include "ProbeRegistry.hpp"
+#include "ProfileZone.hpp"
 
 /**
  * @brief Register a named probe function in the registry
@@ -50,6 +51,7 @@ bool ProbeRegistry::call(const char *name, JsonDocument &dst)
  */
 void ProbeRegistry::collectAll(JsonDocument &doc)
 {
+    PROFILE_ZONE("probes.collect");
     // Snapshot under lock
     size_t n = 0;
     Entry snap[PROBE_MAX];
@@ -75,6 +77,9 @@ String ProbeRegistry::collectAllAsJson()
     JsonDocument doc;
     collectAll(doc);
     String out;
-    serializeJson(doc, out);
+    {
+        PROFILE_ZONE("json.encode");
+        serializeJson(doc, out);
+    }
     return out;
 }
\ No newline at end of file
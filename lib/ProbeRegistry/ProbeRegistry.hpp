@@ -13,7 +13,7 @@
  * needs to expose more metrics or status blocks.
  */
 #ifndef PROBE_MAX
-#define PROBE_MAX 16 // max number of registered probes
+#define PROBE_MAX 24 // max number of registered probes
 #endif
 
 /**
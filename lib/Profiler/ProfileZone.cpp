@@ -0,0 +1,112 @@
+#include "ProfileZone.hpp"
+
+#if FEATURE_ZONES
+
+#include <string.h>
+
+#ifdef ARDUINO
+#include "ProbeRegistry.hpp"
+#endif
+
+/**
+ * @brief Register the "zones" probe (Arduino builds only)
+ *
+ * Probe layout: {"unit":"cycles","zones":{"<name>":{"count","min","max",
+ * "avg","hist":[...]}}}; "hist" is trimmed after the last non-empty bucket.
+ */
+ZoneRegistry::ZoneRegistry()
+{
+#ifdef ARDUINO
+    ProbeRegistry::instance().registerProbe("zones", [this](JsonObject &dst)
+                                            {
+        dst["unit"] = ZoneClock::UNIT;
+        JsonObject zones = dst["zones"].to<JsonObject>();
+        ZoneStats z;
+        for (size_t i = 0; snapshot(i, z); ++i)
+        {
+            JsonObject o = zones[z.name].to<JsonObject>();
+            o["count"] = z.count;
+            o["min"]   = z.count ? z.min : 0;
+            o["max"]   = z.max;
+            o["avg"]   = z.count ? uint32_t(z.sum / z.count) : 0;
+            size_t last = 0;
+            for (size_t b = 0; b < ZONE_HIST_BUCKETS; ++b)
+                if (z.hist[b])
+                    last = b + 1;
+            JsonArray hist = o["hist"].to<JsonArray>();
+            for (size_t b = 0; b < last; ++b)
+                hist.add(z.hist[b]);
+        } });
+#endif
+}
+
+/**
+ * @brief Look up a zone by name, creating it on first use
+ */
+ZoneStats *ZoneRegistry::zone(const char *name)
+{
+    ZoneStats *found = nullptr;
+    lock_();
+    for (size_t i = 0; i < count_ && found == nullptr; ++i)
+    {
+        if (strcmp(zones_[i].name, name) == 0)
+            found = &zones_[i];
+    }
+    if (found == nullptr && count_ < ZONE_MAX)
+    {
+        found = &zones_[count_++];
+        found->name = name;
+    }
+    unlock_();
+    return found;
+}
+
+/**
+ * @brief Update count/min/max/sum and the log2 histogram
+ */
+void ZoneRegistry::record(ZoneStats *zone, uint32_t ticks)
+{
+    size_t bucket = 0;
+    for (uint32_t v = ticks; v > 1 && bucket < ZONE_HIST_BUCKETS - 1; v >>= 1)
+        bucket++;
+
+    lock_();
+    zone->count++;
+    zone->sum += ticks;
+    if (ticks < zone->min)
+        zone->min = ticks;
+    if (ticks > zone->max)
+        zone->max = ticks;
+    zone->hist[bucket]++;
+    unlock_();
+}
+
+/**
+ * @brief Consistent copy of one zone
+ */
+bool ZoneRegistry::snapshot(size_t index, ZoneStats &out)
+{
+    lock_();
+    bool ok = index < count_;
+    if (ok)
+        out = zones_[index];
+    unlock_();
+    return ok;
+}
+
+/**
+ * @brief Zero all aggregates
+ */
+void ZoneRegistry::reset()
+{
+    lock_();
+    for (size_t i = 0; i < count_; ++i)
+    {
+        const char *name = zones_[i].name;
+        zones_[i] = ZoneStats();
+        zones_[i].name = name;
+    }
+    unlock_();
+}
+
+#endif // FEATURE_ZONES
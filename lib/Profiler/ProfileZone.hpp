@@ -0,0 +1,201 @@
+/**
+ * @file ProfileZone.hpp
+ * @brief Scoped cycle-counter timing of named code sections
+ *
+ * Arduino-free so the same zones work in host builds.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__XTENSA__)
+#include <freertos/FreeRTOS.h>
+#else
+#include <chrono>
+#endif
+
+// ====== Tuning ======
+/**
+ * @def FEATURE_ZONES
+ * @brief Compile PROFILE_ZONE() instrumentation in
+ *
+ * Off by default; with 0 every PROFILE_ZONE() expands to nothing.
+ */
+#ifndef FEATURE_ZONES
+#define FEATURE_ZONES 0
+#endif
+
+/**
+ * @def ZONE_MAX
+ * @brief Maximum number of distinct named zones
+ */
+#ifndef ZONE_MAX
+#define ZONE_MAX 16
+#endif
+
+/**
+ * @def ZONE_HIST_BUCKETS
+ * @brief Log2 histogram buckets per zone (bucket i counts [2^i, 2^(i+1)) ticks)
+ */
+#ifndef ZONE_HIST_BUCKETS
+#define ZONE_HIST_BUCKETS 32
+#endif
+
+/**
+ * @brief Aggregated timings of one named zone
+ *
+ * Durations are in ZoneClock ticks: CPU cycles (CCOUNT) on the ESP32,
+ * nanoseconds on the host.
+ */
+struct ZoneStats
+{
+    const char *name = nullptr;          ///< Zone name (string literal)
+    uint32_t count = 0;                  ///< Completed scopes
+    uint32_t min = UINT32_MAX;           ///< Shortest scope
+    uint32_t max = 0;                    ///< Longest scope
+    uint64_t sum = 0;                    ///< Total of all scopes
+    uint32_t hist[ZONE_HIST_BUCKETS] = {}; ///< Log2 duration histogram
+};
+
+/**
+ * @brief Monotonic tick source for zones
+ */
+struct ZoneClock
+{
+#if defined(__XTENSA__)
+    static constexpr const char *UNIT = "cycles";
+
+    /** @return CCOUNT of the current core (wraps every ~17 s at 240 MHz) */
+    static inline uint32_t now()
+    {
+        uint32_t ccount;
+        __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+        return ccount;
+    }
+#else
+    static constexpr const char *UNIT = "ns";
+
+    /** @return Nanoseconds from a steady clock, truncated to 32 bits */
+    static inline uint32_t now()
+    {
+        return uint32_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count());
+    }
+#endif
+};
+
+/**
+ * @brief Fixed table of zone statistics in static storage
+ *
+ * Zones are registered on first use by PROFILE_ZONE(). Updates are guarded
+ * by a spinlock on the ESP32 so zones may be hit from several tasks.
+ */
+class ZoneRegistry
+{
+public:
+    /**
+     * @brief Singleton accessor (same pattern as ProbeRegistry)
+     */
+    static ZoneRegistry &instance()
+    {
+        static ZoneRegistry inst;
+        return inst;
+    }
+
+    /**
+     * @brief Find or create the stats slot for a zone name
+     *
+     * @param name Zone name (must outlive the program, use a literal)
+     * @return ZoneStats* Slot, or nullptr when ZONE_MAX zones exist
+     */
+    ZoneStats *zone(const char *name);
+
+    /**
+     * @brief Fold one measured duration into a zone
+     */
+    void record(ZoneStats *zone, uint32_t ticks);
+
+    /**
+     * @brief Copy a zone under the lock
+     *
+     * @param index Zone index (0..size()-1)
+     * @param out Destination copy
+     * @retval true Zone exists
+     */
+    bool snapshot(size_t index, ZoneStats &out);
+
+    /** @return Number of registered zones */
+    size_t size() const { return count_; }
+
+    /** @brief Clear all aggregates (zone names are kept) */
+    void reset();
+
+private:
+    ZoneStats zones_[ZONE_MAX];
+    size_t count_ = 0;
+
+#if defined(__XTENSA__)
+    portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+    void lock_() { portENTER_CRITICAL(&mux_); }
+    void unlock_() { portEXIT_CRITICAL(&mux_); }
+#else
+    void lock_() {}
+    void unlock_() {}
+#endif
+
+    ZoneRegistry();
+    ZoneRegistry(const ZoneRegistry &) = delete;
+    ZoneRegistry &operator=(const ZoneRegistry &) = delete;
+};
+
+/**
+ * @brief RAII timer: measures from construction to destruction
+ */
+class ScopedZone
+{
+public:
+    explicit ScopedZone(ZoneStats *zone) : zone_(zone), start_(ZoneClock::now()) {}
+    ~ScopedZone()
+    {
+        if (zone_ != nullptr)
+            ZoneRegistry::instance().record(zone_, ZoneClock::now() - start_);
+    }
+
+private:
+    ZoneStats *zone_;
+    uint32_t start_;
+
+    ScopedZone(const ScopedZone &) = delete;
+    ScopedZone &operator=(const ScopedZone &) = delete;
+};
+
+#define PROFILE_ZONE_CAT2(a, b) a##b
+#define PROFILE_ZONE_CAT(a, b) PROFILE_ZONE_CAT2(a, b)
+
+/**
+ * @def PROFILE_ZONE
+ * @brief Time the rest of the enclosing scope under a name
+ *
+ * The zone slot is looked up once per call site (function-local static).
+ * Expands to nothing unless FEATURE_ZONES is 1.
+ *
+ * @code
+ * void handleSend() {
+ *     PROFILE_ZONE("http.send");
+ *     ...
+ * }
+ * @endcode
+ */
+#if FEATURE_ZONES
+#define PROFILE_ZONE(name)                                                                               \
+    static ZoneStats *const PROFILE_ZONE_CAT(zoneStats_, __LINE__) = ZoneRegistry::instance().zone(name); \
+    ScopedZone PROFILE_ZONE_CAT(zoneScope_, __LINE__)(PROFILE_ZONE_CAT(zoneStats_, __LINE__))
+#else
+#define PROFILE_ZONE(name) \
+    do                     \
+    {                      \
+    } while (0)
+#endif
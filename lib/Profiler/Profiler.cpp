@@ -0,0 +1,259 @@
+#include "Profiler.hpp"
+
+#if FEATURE_PROFILER
+
+#include "ProbeRegistry.hpp"
+#include <freertos/xtensa_context.h>
+
+// FreeRTOS (tasks.c): running TCB per core; pxTopOfStack is the first member
+extern "C" void *volatile pxCurrentTCB[portNUM_PROCESSORS];
+
+static Profiler *activeProfiler = nullptr; ///< Set while the timer is attached
+
+/**
+ * @brief Register the "profiler" probe
+ */
+Profiler::Profiler()
+{
+    ProbeRegistry::instance().registerProbe("profiler", [this](JsonObject &dst)
+                                            { statusToJson(dst); });
+}
+
+/**
+ * @brief Sample the interrupted task
+ *
+ * The interrupt entry code stores the interrupted task's stack pointer in
+ * pxCurrentTCB->pxTopOfStack, which points at the saved exception frame.
+ */
+void IRAM_ATTR Profiler::onTimer()
+{
+    Profiler *p = activeProfiler;
+    if (p == nullptr || !p->running_)
+        return;
+
+    size_t n = p->count_;
+    if (n >= p->capacity_)
+    {
+        p->running_ = false; // buffer full: requested duration reached
+        return;
+    }
+
+    void *tcb = pxCurrentTCB[xPortGetCoreID()];
+    if (tcb == nullptr)
+    {
+        p->dropped_++;
+        return;
+    }
+    const XtExcFrame *frame = *(XtExcFrame *const *)tcb;
+    p->buffer_[n].pc = frame->pc;
+    p->buffer_[n].task = (uint32_t)(uintptr_t)tcb;
+    p->count_ = n + 1;
+}
+
+/**
+ * @brief Allocate a PSRAM buffer for the capture and arm the timer
+ */
+bool Profiler::start(uint32_t seconds)
+{
+    if (seconds == 0 || seconds > PROFILER_MAX_SECONDS || timer_ != nullptr)
+        return false;
+
+    free(buffer_);
+    buffer_ = nullptr;
+    capacity_ = 0;
+    count_ = 0;
+    dropped_ = 0;
+    taskCount_ = 0;
+
+    size_t capacity = size_t(seconds) * PROFILER_HZ;
+    buffer_ = (ProfileSample *)ps_malloc(capacity * sizeof(ProfileSample));
+    if (buffer_ == nullptr)
+    {
+        Serial.println(F("[PROF] Out of PSRAM"));
+        return false;
+    }
+    capacity_ = capacity;
+    core_ = xPortGetCoreID();
+    startMs_ = millis();
+    durationMs_ = 0;
+
+    activeProfiler = this;
+    running_ = true;
+    timer_ = timerBegin(PROFILER_TIMER, 80, true); // 80 MHz APB / 80 = 1 µs ticks
+    timerAttachInterrupt(timer_, &Profiler::onTimer, true);
+    timerAlarmWrite(timer_, 1000000 / PROFILER_HZ, true);
+    timerAlarmEnable(timer_);
+
+    Serial.printf("[PROF] Sampling core %u at %u Hz for %lu s\n", core_, PROFILER_HZ, (unsigned long)seconds);
+    return true;
+}
+
+/**
+ * @brief Stop an ongoing capture and keep what was recorded
+ */
+void Profiler::stop()
+{
+    running_ = false;
+    releaseTimer();
+}
+
+/**
+ * @brief Detach the timer once the ISR filled the buffer
+ */
+void Profiler::poll()
+{
+    if (timer_ != nullptr && !running_)
+        releaseTimer();
+}
+
+/**
+ * @brief Export capture state for the probe and the HTTP endpoint
+ */
+void Profiler::statusToJson(JsonObject &dst) const
+{
+    dst["running"] = bool(running_);
+    dst["samples"] = size_t(count_);
+    dst["capacity"] = capacity_;
+    dst["dropped"] = uint32_t(dropped_);
+    dst["hz"] = PROFILER_HZ;
+}
+
+/**
+ * @brief Header + task table + 5 bytes per sample
+ */
+size_t Profiler::exportSize()
+{
+    if (!hasCapture())
+        return 0;
+    size_t size = 4 + 4 + 12 + 1;
+    for (size_t i = 0; i < taskCount_; ++i)
+        size += 1 + strlen(taskNames_[i]);
+    return size + count_ * 5;
+}
+
+/**
+ * @brief Emit the capture in "SPRF" format through a chunked sink
+ */
+size_t Profiler::exportBinary(const std::function<void(const uint8_t *, size_t)> &sink)
+{
+    if (!hasCapture())
+        return 0;
+
+    uint8_t chunk[512];
+    size_t len = 0;
+    size_t total = 0;
+    auto flush = [&]()
+    {
+        if (len > 0)
+            sink(chunk, len);
+        total += len;
+        len = 0;
+    };
+    auto put32 = [&](uint32_t v)
+    {
+        chunk[len++] = uint8_t(v);
+        chunk[len++] = uint8_t(v >> 8);
+        chunk[len++] = uint8_t(v >> 16);
+        chunk[len++] = uint8_t(v >> 24);
+    };
+
+    memcpy(chunk, "SPRF", 4);
+    len = 4;
+    chunk[len++] = 1; // version
+    chunk[len++] = core_;
+    chunk[len++] = uint8_t(PROFILER_HZ);
+    chunk[len++] = uint8_t(PROFILER_HZ >> 8);
+    put32(count_);
+    put32(dropped_);
+    put32(durationMs_);
+    chunk[len++] = taskCount_;
+    for (size_t i = 0; i < taskCount_; ++i)
+    {
+        size_t n = strlen(taskNames_[i]);
+        if (len + 1 + n > sizeof(chunk))
+            flush();
+        chunk[len++] = uint8_t(n);
+        memcpy(chunk + len, taskNames_[i], n);
+        len += n;
+    }
+
+    for (size_t i = 0; i < count_; ++i)
+    {
+        if (len + 5 > sizeof(chunk))
+            flush();
+        put32(buffer_[i].pc);
+        chunk[len++] = taskIndex(buffer_[i].task);
+    }
+    flush();
+    return total;
+}
+
+/**
+ * @brief Stop the timer and resolve the task table for the export
+ */
+void Profiler::releaseTimer()
+{
+    if (timer_ == nullptr)
+        return;
+    timerAlarmDisable(timer_);
+    timerDetachInterrupt(timer_);
+    timerEnd(timer_);
+    timer_ = nullptr;
+    activeProfiler = nullptr;
+
+    durationMs_ = uint32_t((uint64_t(count_) + dropped_) * 1000u / PROFILER_HZ);
+    collectTasks();
+    Serial.printf("[PROF] Captured %u samples (%lu dropped), %u tasks\n",
+                  (unsigned)count_, (unsigned long)dropped_, taskCount_);
+}
+
+/**
+ * @brief Build the table of distinct tasks and copy their names
+ *
+ * Names are looked up among live tasks only, so a task deleted during the
+ * capture is reported as "?" instead of dereferencing a freed TCB.
+ */
+void Profiler::collectTasks()
+{
+    taskCount_ = 0;
+    for (size_t i = 0; i < count_ && taskCount_ < PROFILER_MAX_TASKS; ++i)
+    {
+        if (taskIndex(buffer_[i].task) == 0xFF)
+        {
+            tasks_[taskCount_] = buffer_[i].task;
+            strcpy(taskNames_[taskCount_], "?");
+            taskCount_++;
+        }
+    }
+
+    UBaseType_t n = uxTaskGetNumberOfTasks();
+    TaskStatus_t *status = (TaskStatus_t *)malloc(n * sizeof(TaskStatus_t));
+    if (status == nullptr)
+        return;
+    n = uxTaskGetSystemState(status, n, nullptr);
+    for (UBaseType_t k = 0; k < n; ++k)
+    {
+        uint8_t idx = taskIndex((uint32_t)(uintptr_t)status[k].xHandle);
+        if (idx != 0xFF)
+        {
+            strncpy(taskNames_[idx], status[k].pcTaskName, sizeof(taskNames_[idx]) - 1);
+            taskNames_[idx][sizeof(taskNames_[idx]) - 1] = '\0';
+        }
+    }
+    free(status);
+}
+
+/**
+ * @brief Position of a task handle in the task table (0xFF if absent)
+ */
+uint8_t Profiler::taskIndex(uint32_t task) const
+{
+    for (uint8_t i = 0; i < taskCount_; ++i)
+    {
+        if (tasks_[i] == task)
+            return i;
+    }
+    return 0xFF;
+}
+
+#endif // FEATURE_PROFILER
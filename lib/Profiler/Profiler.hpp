@@ -0,0 +1,170 @@
+/**
+ * @file Profiler.hpp
+ * @brief Optional statistical sampling profiler (timer ISR → PSRAM buffer)
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+
+// ====== Tuning ======
+/**
+ * @def FEATURE_PROFILER
+ * @brief Build the sampling profiler and its `/debug/profile` endpoint
+ *
+ * Off by default. Enable with `-DFEATURE_PROFILER=1` in build_flags.
+ */
+#ifndef FEATURE_PROFILER
+#define FEATURE_PROFILER 0
+#endif
+
+/**
+ * @def PROFILER_HZ
+ * @brief Sampling frequency of the profiling timer interrupt
+ */
+#ifndef PROFILER_HZ
+#define PROFILER_HZ 1000
+#endif
+
+/**
+ * @def PROFILER_MAX_SECONDS
+ * @brief Longest allowed capture; bounds the PSRAM buffer size
+ */
+#ifndef PROFILER_MAX_SECONDS
+#define PROFILER_MAX_SECONDS 60
+#endif
+
+/**
+ * @def PROFILER_TIMER
+ * @brief Hardware timer (0-3) used for sampling
+ */
+#ifndef PROFILER_TIMER
+#define PROFILER_TIMER 3
+#endif
+
+/**
+ * @def PROFILER_MAX_TASKS
+ * @brief Distinct tasks named in an export; further tasks map to "?"
+ */
+#ifndef PROFILER_MAX_TASKS
+#define PROFILER_MAX_TASKS 32
+#endif
+
+#if FEATURE_PROFILER
+
+/**
+ * @brief One captured sample (raw, as written by the ISR)
+ */
+struct ProfileSample
+{
+    uint32_t pc;   ///< Interrupted program counter (Xtensa window bits included)
+    uint32_t task; ///< Interrupted task handle (TCB address)
+};
+
+/**
+ * @brief Statistical sampling profiler
+ *
+ * A hardware timer interrupt fires PROFILER_HZ times per second on the core
+ * that called start() (the Arduino loop core) and records the interrupted
+ * program counter and task. Samples go to a PSRAM buffer sized for the
+ * requested duration; nothing is symbolized on the device.
+ *
+ * Export format ("SPRF" v1, little-endian):
+ * - char[4] "SPRF", u8 version, u8 core, u16 hz
+ * - u32 samples, u32 dropped, u32 durationMs
+ * - u8 taskCount, then per task: u8 nameLen, name bytes
+ * - per sample: u32 pc, u8 taskIndex (0xFF = unknown task)
+ *
+ * Use tools/symbolize_profile.py with the firmware ELF to turn an export
+ * into a flat profile or folded stacks.
+ *
+ * @note Samples cannot be taken while the flash cache is disabled (NVS or
+ *       LittleFS writes); such periods are under-represented.
+ */
+class Profiler
+{
+public:
+    /**
+     * @brief Singleton accessor (the ISR needs a fixed instance)
+     */
+    static Profiler &instance()
+    {
+        static Profiler inst;
+        return inst;
+    }
+
+    /**
+     * @brief Allocate the sample buffer and start the sampling timer
+     *
+     * Any previous capture is discarded.
+     *
+     * @param seconds Capture length (1..PROFILER_MAX_SECONDS)
+     * @retval true Sampling started
+     * @retval false Invalid duration, already running or out of PSRAM
+     */
+    bool start(uint32_t seconds);
+
+    /**
+     * @brief Stop sampling early and release the timer
+     */
+    void stop();
+
+    /**
+     * @brief Release the timer once the requested duration elapsed
+     *
+     * Call regularly from the main loop.
+     */
+    void poll();
+
+    /** @return true while samples are being taken */
+    bool isRunning() const { return running_; }
+
+    /** @return true if a finished capture is available for export */
+    bool hasCapture() const { return !running_ && buffer_ != nullptr && count_ > 0; }
+
+    /**
+     * @brief Write capture state: {"running","samples","capacity","dropped","hz"}
+     */
+    void statusToJson(JsonObject &dst) const;
+
+    /**
+     * @brief Size in bytes of the binary export of the current capture
+     */
+    size_t exportSize();
+
+    /**
+     * @brief Stream the current capture in "SPRF" format
+     *
+     * @param sink Called with consecutive chunks of the export
+     * @return size_t Total bytes produced
+     */
+    size_t exportBinary(const std::function<void(const uint8_t *, size_t)> &sink);
+
+private:
+    ProfileSample *buffer_ = nullptr; ///< PSRAM sample buffer
+    size_t capacity_ = 0;             ///< Samples the buffer can hold
+    volatile size_t count_ = 0;       ///< Samples recorded
+    volatile uint32_t dropped_ = 0;   ///< Ticks that could not be recorded
+    volatile bool running_ = false;   ///< ISR records while true
+    hw_timer_t *timer_ = nullptr;     ///< Sampling timer (nullptr when released)
+    uint8_t core_ = 0;                ///< Core being sampled
+    uint32_t startMs_ = 0;            ///< millis() at start
+    uint32_t durationMs_ = 0;         ///< Actual capture length
+
+    uint32_t tasks_[PROFILER_MAX_TASKS];     ///< Task handles seen in the capture
+    char taskNames_[PROFILER_MAX_TASKS][16]; ///< Names resolved when the capture ends
+    uint8_t taskCount_ = 0;                  ///< Valid entries in tasks_
+
+    static void IRAM_ATTR onTimer();
+    void releaseTimer();
+    void collectTasks();
+    uint8_t taskIndex(uint32_t task) const;
+
+    Profiler();
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+};
+
+#endif // FEATURE_PROFILER
@@ -0,0 +1,92 @@
+#include "ProvisionBundle.hpp"
+#include <string.h>
+
+ProvisionError ProvisionBundle::validate(const uint8_t *bundle, size_t len, ProvisionHeader &header)
+{
+    if (len < sizeof(ProvisionHeader) + SIGNATURE_LEN || len > PROVISION_MAX)
+        return ProvisionError::Size;
+    memcpy(&header, bundle, sizeof(header));
+    if (header.magic != ProvisionHeader::MAGIC)
+        return ProvisionError::Format;
+    if (header.version != ProvisionHeader::VERSION)
+        return ProvisionError::Version;
+    if (signedLength(header) + SIGNATURE_LEN != len)
+        return ProvisionError::Format;
+
+    const uint8_t *p = bundle + sizeof(ProvisionHeader);
+    const uint8_t *end = p + header.payloadLen;
+    uint16_t records = 0;
+    while (p < end)
+    {
+        if (end - p < 2 || end - p - 2 < p[1])
+            return ProvisionError::Format;
+        p += 2 + p[1];
+        records++;
+    }
+    return records == header.records ? ProvisionError::None : ProvisionError::Format;
+}
+
+void ProvisionBundle::forEach(const uint8_t *bundle, const ProvisionRecordFunction &fn)
+{
+    ProvisionHeader header;
+    memcpy(&header, bundle, sizeof(header));
+    const uint8_t *p = bundle + sizeof(ProvisionHeader);
+    const uint8_t *end = p + header.payloadLen;
+    while (p < end)
+    {
+        if (!fn(ProvisionRecord(p[0]), p + 2, p[1]))
+            return;
+        p += 2 + p[1];
+    }
+}
+
+uint16_t ProvisionBundle::count(const uint8_t *bundle, ProvisionRecord type)
+{
+    uint16_t n = 0;
+    forEach(bundle, [&](ProvisionRecord t, const uint8_t *, uint8_t)
+            {
+        if (t == type)
+            n++;
+        return true; });
+    return n;
+}
+
+bool ProvisionBundle::field(const uint8_t *value, uint8_t len, size_t &pos, char *out, size_t cap)
+{
+    size_t start = pos < len ? pos : len;
+    const void *nul = memchr(value + start, 0, len - start);
+    size_t n = nul ? size_t(static_cast<const uint8_t *>(nul) - value) - start : len - start;
+    pos = nul ? start + n + 1 : len;
+    if (n >= cap)
+    {
+        out[0] = '\0';
+        return false;
+    }
+    memcpy(out, value + start, n);
+    out[n] = '\0';
+    return true;
+}
+
+const char *ProvisionBundle::errorName(ProvisionError error)
+{
+    switch (error)
+    {
+    case ProvisionError::None:
+        return "none";
+    case ProvisionError::Size:
+        return "size";
+    case ProvisionError::Format:
+        return "format";
+    case ProvisionError::Version:
+        return "version";
+    case ProvisionError::Signature:
+        return "signature";
+    case ProvisionError::Rollback:
+        return "rollback";
+    case ProvisionError::Storage:
+        return "storage";
+    case ProvisionError::Transfer:
+        return "transfer";
+    }
+    return "unknown";
+}
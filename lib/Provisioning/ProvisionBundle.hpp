@@ -0,0 +1,139 @@
+/**
+ * @file ProvisionBundle.hpp
+ * @brief Versioned binary provisioning bundle: header, TLV records, signature
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+// ====== Tuning ======
+/**
+ * @def PROVISION_MAX
+ * @brief Largest bundle accepted, signature included
+ */
+#ifndef PROVISION_MAX
+#define PROVISION_MAX 2048
+#endif
+
+/**
+ * @brief Record types of a bundle
+ *
+ * Unknown types are skipped, so a newer tool may add records that older
+ * firmware ignores. String values are not NUL-terminated unless stated.
+ */
+enum class ProvisionRecord : uint8_t
+{
+    DeviceName = 0x01,      ///< BLE/host name
+    Network = 0x02,         ///< u8 ssidLen, ssid, password (first one is the primary)
+    SleepInterval = 0x03,   ///< u32 seconds
+    ApMode = 0x04,          ///< u8 ApMode
+    ApPassword = 0x05,      ///< SoftAP password
+    WifiPowerSave = 0x06,   ///< u8 WifiPowerSave
+    ListenInterval = 0x07,  ///< u8 beacons
+    ApiKeyHash = 0x10,      ///< SHA-256 of an HTTP API key (32 bytes)
+    CarrierOverride = 0x20, ///< u8 bearer (0xFF = keep), then "mccmnc\0apn\0user\0pass"
+    Template = 0x30,        ///< "name\0body"
+};
+
+/**
+ * @brief Fixed bundle header, stored little-endian as-is
+ *
+ * Layout: header, payloadLen bytes of records (u8 type, u8 length, value),
+ * then a 64 byte ECDSA P-256 signature (r || s) over the SHA-256 of header
+ * and records.
+ */
+struct ProvisionHeader
+{
+    static constexpr uint32_t MAGIC = 0x42565250; ///< "PRVB"
+    static constexpr uint8_t VERSION = 1;
+
+    uint32_t magic;
+    uint8_t version;
+    uint8_t flags;        ///< FLAG_RESTART
+    uint16_t records;     ///< Record count
+    uint32_t serial;      ///< Bundle serial, must grow (no rollback)
+    uint32_t payloadLen;  ///< Bytes of records
+
+    static constexpr uint8_t FLAG_RESTART = 0x01; ///< Restart once applied
+};
+
+static_assert(sizeof(ProvisionHeader) == 16, "ProvisionHeader is the wire format");
+
+/**
+ * @brief Why a bundle was refused
+ */
+enum class ProvisionError : uint8_t
+{
+    None = 0,
+    Size,      ///< Shorter than header + signature, or over PROVISION_MAX
+    Format,    ///< Bad magic, length mismatch or a record overruns the payload
+    Version,   ///< Unsupported format version
+    Signature, ///< Signature does not verify (or no key built in)
+    Rollback,  ///< Serial not newer than the applied bundle
+    Storage,   ///< NVS commit failed
+    Transfer,  ///< Chunk out of order, or END before all bytes arrived
+};
+
+/**
+ * @brief Called per record; return false to stop
+ */
+using ProvisionRecordFunction = std::function<bool(ProvisionRecord type, const uint8_t *value, uint8_t len)>;
+
+/**
+ * @brief Structural checks and record iteration (no Arduino dependency)
+ *
+ * Signature verification is left to the caller: validate() only proves the
+ * bundle is well formed, so records can be walked without bounds checks.
+ */
+class ProvisionBundle
+{
+public:
+    static constexpr size_t SIGNATURE_LEN = 64;
+
+    /**
+     * @brief Check header, lengths and every record boundary
+     *
+     * @param header Set from the bundle when it is well formed
+     */
+    static ProvisionError validate(const uint8_t *bundle, size_t len, ProvisionHeader &header);
+
+    /**
+     * @brief Bytes covered by the signature (header + records)
+     */
+    static size_t signedLength(const ProvisionHeader &header) { return sizeof(ProvisionHeader) + header.payloadLen; }
+
+    /**
+     * @brief The signature of a validated bundle
+     */
+    static const uint8_t *signature(const uint8_t *bundle, const ProvisionHeader &header)
+    {
+        return bundle + signedLength(header);
+    }
+
+    /**
+     * @brief Walk the records of a validated bundle
+     */
+    static void forEach(const uint8_t *bundle, const ProvisionRecordFunction &fn);
+
+    /**
+     * @brief Records of one type in a validated bundle
+     */
+    static uint16_t count(const uint8_t *bundle, ProvisionRecord type);
+
+    /**
+     * @brief Split a value at the first NUL
+     *
+     * @param value Record value
+     * @param len Record length
+     * @param pos In: start offset; out: offset after the NUL (or len)
+     * @param out Destination, always NUL-terminated
+     * @param cap Size of @p out
+     * @retval false Field longer than cap - 1
+     */
+    static bool field(const uint8_t *value, uint8_t len, size_t &pos, char *out, size_t cap);
+
+    static const char *errorName(ProvisionError error);
+};
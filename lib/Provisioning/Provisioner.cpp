@@ -0,0 +1,498 @@
+#include "Provisioner.hpp"
+#include <string.h>
+#include <mbedtls/md.h>
+#include <mbedtls/ecdsa.h>
+#include "ProbeRegistry.hpp"
+#include "RemoteLog.hpp"
+#include "FlashWear.hpp"
+
+namespace
+{
+    const char *NVS_NAMESPACE = "provision";
+    const char *NVS_KEY = "bundle";
+
+    bool sha256(const uint8_t *data, size_t len, uint8_t out[32])
+    {
+        return mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), data, len, out) == 0;
+    }
+
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    /**
+     * @brief PROVISION_PUBKEY as the 65 byte uncompressed point
+     */
+    bool publicKey(uint8_t out[65])
+    {
+        const char *hex = PROVISION_PUBKEY;
+        if (strlen(hex) != 130)
+            return false;
+        for (size_t i = 0; i < 65; ++i)
+        {
+            int hi = hexValue(hex[2 * i]);
+            int lo = hexValue(hex[2 * i + 1]);
+            if (hi < 0 || lo < 0)
+                return false;
+            out[i] = uint8_t(hi << 4 | lo);
+        }
+        return out[0] == 0x04;
+    }
+
+    String text(const uint8_t *value, uint8_t len)
+    {
+        char buf[256];
+        memcpy(buf, value, len);
+        buf[len] = '\0';
+        return String(buf);
+    }
+}
+
+Provisioner &Provisioner::instance()
+{
+    static Provisioner inst;
+    return inst;
+}
+
+Provisioner::Provisioner()
+{
+    ProbeRegistry::instance().registerProbe("provisioning", [this](JsonObject &dst)
+                                            { toJson(dst); });
+}
+
+/**
+ * @brief Keep the stored bundle in RAM; re-apply it if the settings are older
+ */
+void Provisioner::begin(GSettings &settings)
+{
+    this->settings = &settings;
+    preferences.begin(NVS_NAMESPACE, true);
+    size_t len = preferences.getBytesLength(NVS_KEY);
+    uint8_t *buf = len ? (uint8_t *)malloc(len) : nullptr;
+    if (buf != nullptr)
+        preferences.getBytes(NVS_KEY, buf, len);
+    preferences.end();
+    if (buf == nullptr)
+        return;
+
+    ProvisionHeader header;
+    if (ProvisionBundle::validate(buf, len, header) != ProvisionError::None)
+    {
+        LOG_WARN("PROV", "Stored bundle unreadable, ignored");
+        free(buf);
+        return;
+    }
+    bundle_ = buf;
+    bundleLen_ = len;
+    serial_ = header.serial;
+    if (settings.getProvisionSerial() != serial_)
+    {
+        LOG_NOTICE("PROV", "Finishing interrupted apply of bundle %lu", (unsigned long)serial_);
+        applySettings(bundle_);
+    }
+}
+
+/**
+ * @brief Transfer state machine; only buffers, the work happens in poll()
+ */
+void Provisioner::handleFrame(const uint8_t *data, size_t len)
+{
+    if (len == 0)
+        return;
+    uint32_t now = millis();
+    switch (data[0])
+    {
+    case 'B':
+    {
+        if (len < 5)
+            return;
+        uint32_t total;
+        memcpy(&total, data + 1, sizeof(total));
+        uint8_t *buf = total <= PROVISION_MAX ? (uint8_t *)malloc(total) : nullptr;
+        uint8_t *old = nullptr;
+        portENTER_CRITICAL(&rxMux_);
+        if (rxState_ != RxState::Complete)
+        {
+            old = rx_;
+            rx_ = buf;
+            rxTotal_ = total;
+            rxGot_ = 0;
+            rxStartMs_ = rxLastMs_ = now;
+            rxError_ = buf ? ProvisionError::None : ProvisionError::Size;
+            rxState_ = buf ? RxState::Receiving : RxState::Complete;
+            buf = nullptr;
+        }
+        portEXIT_CRITICAL(&rxMux_);
+        free(old);
+        free(buf); // previous bundle still waiting for poll()
+        break;
+    }
+    case 'D':
+    {
+        if (len < 3)
+            return;
+        uint16_t offset;
+        memcpy(&offset, data + 1, sizeof(offset));
+        size_t n = len - 3;
+        portENTER_CRITICAL(&rxMux_);
+        if (rxState_ == RxState::Receiving)
+        {
+            if (offset != rxGot_ || rxGot_ + n > rxTotal_)
+            {
+                rxError_ = ProvisionError::Transfer;
+                rxState_ = RxState::Complete;
+            }
+            else
+            {
+                memcpy(rx_ + rxGot_, data + 3, n);
+                rxGot_ += n;
+                rxLastMs_ = now;
+            }
+        }
+        portEXIT_CRITICAL(&rxMux_);
+        break;
+    }
+    case 'E':
+        portENTER_CRITICAL(&rxMux_);
+        if (rxState_ == RxState::Receiving)
+        {
+            if (rxGot_ != rxTotal_)
+                rxError_ = ProvisionError::Transfer;
+            rxState_ = RxState::Complete;
+        }
+        portEXIT_CRITICAL(&rxMux_);
+        break;
+    case 'A':
+    {
+        uint8_t *old = nullptr;
+        portENTER_CRITICAL(&rxMux_);
+        if (rxState_ == RxState::Receiving)
+        {
+            old = rx_;
+            rx_ = nullptr;
+            rxState_ = RxState::Idle;
+        }
+        portEXIT_CRITICAL(&rxMux_);
+        free(old);
+        break;
+    }
+    }
+}
+
+/**
+ * @brief Take a finished (or stalled) transfer out of the rx fields and run it
+ */
+void Provisioner::poll()
+{
+    uint8_t *buf = nullptr;
+    size_t len = 0;
+    uint32_t startMs = 0;
+    ProvisionError error = ProvisionError::None;
+    bool complete = false;
+
+    portENTER_CRITICAL(&rxMux_);
+    if (rxState_ == RxState::Complete ||
+        (rxState_ == RxState::Receiving && millis() - rxLastMs_ > PROVISION_TIMEOUT_MS))
+    {
+        complete = true;
+        error = rxState_ == RxState::Complete ? rxError_ : ProvisionError::Transfer;
+        buf = rx_;
+        len = rxGot_;
+        startMs = rxStartMs_;
+        transferMs_ = rxLastMs_ - rxStartMs_;
+        rx_ = nullptr;
+        rxState_ = RxState::Idle;
+    }
+    portEXIT_CRITICAL(&rxMux_);
+    if (!complete)
+        return;
+
+    ProvisionHeader header = {};
+    if (error == ProvisionError::None)
+    {
+        error = apply(buf, len);
+        if (error == ProvisionError::None)
+            memcpy(&header, buf, sizeof(header));
+    }
+    free(buf);
+    finish(error, header.serial, startMs);
+    if (error == ProvisionError::None && (header.flags & ProvisionHeader::FLAG_RESTART))
+    {
+        delay(200); // let the acknowledgement go out
+        FlashWear::instance().save();
+        ESP.restart();
+    }
+}
+
+/**
+ * @brief Steps 1-4 of the class description, each one timed
+ */
+ProvisionError Provisioner::apply(const uint8_t *bundle, size_t len)
+{
+    lastBytes_ = len;
+    verifyMs_ = commitMs_ = applyMs_ = 0;
+
+    uint32_t t = millis();
+    ProvisionHeader header;
+    ProvisionError error = ProvisionBundle::validate(bundle, len, header);
+    if (error != ProvisionError::None)
+        return error;
+    bool valid = verify(bundle, header);
+    verifyMs_ = millis() - t;
+    if (!valid)
+        return ProvisionError::Signature;
+    if (bundle_ != nullptr && header.serial <= serial_)
+        return ProvisionError::Rollback;
+
+    t = millis();
+    uint8_t *copy = (uint8_t *)malloc(len);
+    if (copy == nullptr)
+        return ProvisionError::Size;
+    memcpy(copy, bundle, len);
+    preferences.begin(NVS_NAMESPACE, false);
+    size_t written = preferences.putBytes(NVS_KEY, bundle, len);
+    preferences.end();
+    commitMs_ = millis() - t;
+    if (written != len)
+    {
+        free(copy);
+        return ProvisionError::Storage;
+    }
+    free(bundle_);
+    bundle_ = copy;
+    bundleLen_ = len;
+    serial_ = header.serial;
+
+    t = millis();
+    bool networksChanged = applySettings(bundle_);
+    applyMs_ = millis() - t;
+    if (applied)
+        applied(networksChanged);
+    return ProvisionError::None;
+}
+
+bool Provisioner::hasApiKeys() const
+{
+    return bundle_ != nullptr && ProvisionBundle::count(bundle_, ProvisionRecord::ApiKeyHash) > 0;
+}
+
+/**
+ * @brief SHA-256 of the key against every stored hash, constant time per hash
+ */
+bool Provisioner::checkApiKey(const char *key) const
+{
+    uint8_t digest[32];
+    if (bundle_ == nullptr || key == nullptr || !sha256((const uint8_t *)key, strlen(key), digest))
+        return false;
+    bool match = false;
+    ProvisionBundle::forEach(bundle_, [&](ProvisionRecord type, const uint8_t *value, uint8_t len)
+                             {
+        if (type != ProvisionRecord::ApiKeyHash || len != sizeof(digest))
+            return true;
+        uint8_t diff = 0;
+        for (size_t i = 0; i < sizeof(digest); ++i)
+            diff |= value[i] ^ digest[i];
+        match = match || diff == 0;
+        return true; });
+    return match;
+}
+
+bool Provisioner::carrierOverride(const char *mccmnc, uint8_t &bearer, String &apn, String &user, String &pass) const
+{
+    if (bundle_ == nullptr)
+        return false;
+    bool found = false;
+    ProvisionBundle::forEach(bundle_, [&](ProvisionRecord type, const uint8_t *value, uint8_t len)
+                             {
+        if (type != ProvisionRecord::CarrierOverride || len < 2)
+            return true;
+        char id[8], a[64], u[32], p[32];
+        size_t pos = 1;
+        if (!ProvisionBundle::field(value, len, pos, id, sizeof(id)) || strcmp(id, mccmnc) != 0)
+            return true;
+        if (!ProvisionBundle::field(value, len, pos, a, sizeof(a)) ||
+            !ProvisionBundle::field(value, len, pos, u, sizeof(u)) ||
+            !ProvisionBundle::field(value, len, pos, p, sizeof(p)))
+            return true;
+        bearer = value[0];
+        apn = a;
+        user = u;
+        pass = p;
+        found = true;
+        return false; });
+    return found;
+}
+
+bool Provisioner::findTemplate(const char *name, String &body) const
+{
+    if (bundle_ == nullptr)
+        return false;
+    bool found = false;
+    ProvisionBundle::forEach(bundle_, [&](ProvisionRecord type, const uint8_t *value, uint8_t len)
+                             {
+        if (type != ProvisionRecord::Template)
+            return true;
+        char id[32];
+        size_t pos = 0;
+        if (!ProvisionBundle::field(value, len, pos, id, sizeof(id)) || strcmp(id, name) != 0)
+            return true;
+        body = text(value + pos, uint8_t(len - pos));
+        found = true;
+        return false; });
+    return found;
+}
+
+void Provisioner::toJson(JsonObject &dst) const
+{
+    dst["serial"] = serial_;
+    dst["bytes"] = bundleLen_;
+    if (bundle_ != nullptr)
+    {
+        dst["networks"] = ProvisionBundle::count(bundle_, ProvisionRecord::Network);
+        dst["apiKeys"] = ProvisionBundle::count(bundle_, ProvisionRecord::ApiKeyHash);
+        dst["carrierOverrides"] = ProvisionBundle::count(bundle_, ProvisionRecord::CarrierOverride);
+        dst["templates"] = ProvisionBundle::count(bundle_, ProvisionRecord::Template);
+    }
+    dst["accepted"] = accepted_;
+    dst["rejected"] = rejected_;
+    dst["lastError"] = ProvisionBundle::errorName(lastError_);
+    JsonObject last = dst["last"].to<JsonObject>();
+    last["bytes"] = lastBytes_;
+    last["transferMs"] = transferMs_;
+    last["verifyMs"] = verifyMs_;
+    last["commitMs"] = commitMs_;
+    last["applyMs"] = applyMs_;
+    last["totalMs"] = transferMs_ + verifyMs_ + commitMs_ + applyMs_;
+}
+
+/**
+ * @brief ECDSA P-256 over SHA-256(header || records), signature r || s
+ */
+bool Provisioner::verify(const uint8_t *bundle, const ProvisionHeader &header) const
+{
+    uint8_t key[65];
+    uint8_t digest[32];
+    if (!publicKey(key) || !sha256(bundle, ProvisionBundle::signedLength(header), digest))
+        return false;
+    const uint8_t *sig = ProvisionBundle::signature(bundle, header);
+
+    mbedtls_ecp_group grp;
+    mbedtls_ecp_point q;
+    mbedtls_mpi r, s;
+    mbedtls_ecp_group_init(&grp);
+    mbedtls_ecp_point_init(&q);
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+    int rc = mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256R1);
+    if (rc == 0)
+        rc = mbedtls_ecp_point_read_binary(&grp, &q, key, sizeof(key));
+    if (rc == 0)
+        rc = mbedtls_mpi_read_binary(&r, sig, 32);
+    if (rc == 0)
+        rc = mbedtls_mpi_read_binary(&s, sig + 32, 32);
+    if (rc == 0)
+        rc = mbedtls_ecdsa_verify(&grp, digest, sizeof(digest), &q, &r, &s);
+    mbedtls_mpi_free(&s);
+    mbedtls_mpi_free(&r);
+    mbedtls_ecp_point_free(&q);
+    mbedtls_ecp_group_free(&grp);
+    return rc == 0;
+}
+
+/**
+ * @brief Copy the settings records into GSettings and save them
+ *
+ * Network records replace the whole stored list; without any, the stored
+ * networks are kept.
+ *
+ * @return true The networks changed
+ */
+bool Provisioner::applySettings(const uint8_t *bundle)
+{
+    if (settings == nullptr)
+        return false;
+    String before;
+    for (uint8_t i = 0; i < WIFI_NETWORKS; ++i)
+        before += settings->getNetworkSsid(i) + '\n' + settings->getNetworkPassword(i) + '\n';
+    uint8_t networks = 0;
+    ProvisionBundle::forEach(bundle, [&](ProvisionRecord type, const uint8_t *value, uint8_t len)
+                             {
+        switch (type)
+        {
+        case ProvisionRecord::DeviceName:
+            settings->setDeviceName(text(value, len));
+            break;
+        case ProvisionRecord::Network:
+            if (len >= 1 && value[0] <= len - 1 && networks < WIFI_NETWORKS)
+            {
+                settings->setNetwork(networks++, text(value + 1, value[0]),
+                                     text(value + 1 + value[0], uint8_t(len - 1 - value[0])));
+            }
+            break;
+        case ProvisionRecord::SleepInterval:
+            if (len == 4)
+            {
+                uint32_t seconds;
+                memcpy(&seconds, value, sizeof(seconds));
+                settings->setSleepInterval(seconds);
+            }
+            break;
+        case ProvisionRecord::ApMode:
+            if (len == 1 && value[0] <= uint8_t(ApMode::Off))
+                settings->setApMode(ApMode(value[0]));
+            break;
+        case ProvisionRecord::ApPassword:
+            settings->setApPassword(text(value, len));
+            break;
+        case ProvisionRecord::WifiPowerSave:
+            if (len == 1 && value[0] <= uint8_t(WifiPowerSave::Max))
+                settings->setWifiPowerSave(WifiPowerSave(value[0]));
+            break;
+        case ProvisionRecord::ListenInterval:
+            if (len == 1)
+                settings->setListenInterval(value[0]);
+            break;
+        default:
+            break; // kept in the bundle: keys, overrides, templates, newer types
+        }
+        return true; });
+    if (networks > 0)
+        for (uint8_t i = networks; i < WIFI_NETWORKS; ++i)
+            settings->setNetwork(i, "", "");
+    settings->setProvisionSerial(serial_);
+    settings->save();
+
+    String after;
+    for (uint8_t i = 0; i < WIFI_NETWORKS; ++i)
+        after += settings->getNetworkSsid(i) + '\n' + settings->getNetworkPassword(i) + '\n';
+    return after != before;
+}
+
+/**
+ * @brief Count, log and acknowledge the outcome of a transfer
+ */
+void Provisioner::finish(ProvisionError error, uint32_t serial, uint32_t startMs)
+{
+    lastError_ = error;
+    char msg[48];
+    if (error == ProvisionError::None)
+    {
+        accepted_++;
+        snprintf(msg, sizeof(msg), "P:OK,%lu,%lu", (unsigned long)serial, (unsigned long)(millis() - startMs));
+    }
+    else
+    {
+        rejected_++;
+        snprintf(msg, sizeof(msg), "P:ERR,%s", ProvisionBundle::errorName(error));
+    }
+    LOG_NOTICE("PROV", "%s", msg);
+    if (notify)
+        notify(String(msg));
+}
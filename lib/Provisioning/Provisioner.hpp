@@ -0,0 +1,170 @@
+/**
+ * @file Provisioner.hpp
+ * @brief Signed provisioning bundles: chunked transfer, verification, atomic commit
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include "ProvisionBundle.hpp"
+#include "GSettings.hpp"
+#include "WearPreferences.hpp"
+
+// ====== Tuning ======
+/**
+ * @def PROVISION_PUBKEY
+ * @brief Fleet signing key: uncompressed P-256 point as 130 hex digits ("04...")
+ *
+ * Printed by `tools/make_bundle.py keygen`. Without a key every bundle is
+ * refused with a signature error.
+ */
+#ifndef PROVISION_PUBKEY
+#define PROVISION_PUBKEY ""
+#endif
+
+/**
+ * @def PROVISION_TIMEOUT_MS
+ * @brief A transfer with no chunk for this long is dropped
+ */
+#ifndef PROVISION_TIMEOUT_MS
+#define PROVISION_TIMEOUT_MS 30000
+#endif
+
+/**
+ * @brief Applies signed provisioning bundles in one storage commit
+ *
+ * A bundle (ProvisionBundle) carries settings, WiFi networks, API key
+ * hashes, carrier overrides and message templates. It arrives as chunks
+ * through handleFrame() (BLE write characteristic):
+ * - 'B' u32 total length: start a transfer
+ * - 'D' u16 offset, bytes: next chunk, offsets must be contiguous
+ * - 'E': transfer complete
+ * - 'A': abort
+ *
+ * poll() then runs the bundle from the main loop:
+ * 1. Check the structure and the ECDSA P-256 signature (PROVISION_PUBKEY).
+ * 2. Refuse a serial not newer than the applied one (no rollback).
+ * 3. Store the whole bundle as one NVS blob. This single write is the
+ *    commit point.
+ * 4. Copy the settings and networks into GSettings and save them.
+ *    GSettings saves the bundle serial last.
+ *
+ * If power is lost during step 4, begin() finds a stored bundle newer than
+ * the saved settings and applies it again. A bundle is therefore either
+ * fully applied or not at all. The result is notified as "P:OK,<serial>,<ms>"
+ * or "P:ERR,<reason>".
+ *
+ * Transfer, verification, commit and apply times of the last bundle are
+ * exported in the "provisioning" probe.
+ */
+class Provisioner
+{
+public:
+    using NotifyFunction = std::function<void(const String &)>;
+    using AppliedFunction = std::function<void(bool networksChanged)>;
+
+    static Provisioner &instance();
+
+    /**
+     * @brief Load the stored bundle and finish an interrupted apply
+     *
+     * Call after GSettings::load().
+     */
+    void begin(GSettings &settings);
+
+    /** @brief Where "P:..." acknowledgements go (BLE notify) */
+    void onNotify(NotifyFunction fn) { notify = fn; }
+
+    /** @brief Called after a bundle was applied (reconnect WiFi, ...) */
+    void onApplied(AppliedFunction fn) { applied = fn; }
+
+    /**
+     * @brief Feed one transfer frame (any task; no flash access)
+     */
+    void handleFrame(const uint8_t *data, size_t len);
+
+    /**
+     * @brief Run a completed transfer, drop a stalled one
+     */
+    void poll();
+
+    /**
+     * @brief Verify, commit and apply a complete bundle
+     */
+    ProvisionError apply(const uint8_t *bundle, size_t len);
+
+    /** @return true once a bundle with at least one API key is applied */
+    bool hasApiKeys() const;
+
+    /**
+     * @brief Match a presented API key against the provisioned hashes
+     */
+    bool checkApiKey(const char *key) const;
+
+    /**
+     * @brief Carrier override for @p mccmnc
+     *
+     * @param bearer Set to the SmsBearer value, or 0xFF to keep the profile's
+     * @retval false No override for this network
+     */
+    bool carrierOverride(const char *mccmnc, uint8_t &bearer, String &apn, String &user, String &pass) const;
+
+    /**
+     * @brief Body of the template @p name
+     *
+     * @retval false Unknown template
+     */
+    bool findTemplate(const char *name, String &body) const;
+
+    /**
+     * @brief Write {"serial","records","networks","apiKeys","carrierOverrides",
+     * "templates","accepted","rejected","lastError","last":{"bytes",
+     * "transferMs","verifyMs","commitMs","applyMs","totalMs"}}
+     */
+    void toJson(JsonObject &dst) const;
+
+private:
+    enum class RxState : uint8_t
+    {
+        Idle,
+        Receiving,
+        Complete,
+    };
+
+    Provisioner();
+    Provisioner(const Provisioner &) = delete;
+    Provisioner &operator=(const Provisioner &) = delete;
+
+    bool verify(const uint8_t *bundle, const ProvisionHeader &header) const;
+    bool applySettings(const uint8_t *bundle);
+    void finish(ProvisionError error, uint32_t serial, uint32_t startMs);
+
+    GSettings *settings = nullptr;
+    WearPreferences preferences{"provisioning"};
+    NotifyFunction notify;
+    AppliedFunction applied;
+
+    uint8_t *bundle_ = nullptr; ///< Applied bundle (heap), kept for keys, overrides and templates
+    size_t bundleLen_ = 0;
+    uint32_t serial_ = 0;
+
+    portMUX_TYPE rxMux_ = portMUX_INITIALIZER_UNLOCKED; ///< Guards the rx_* fields (BLE task vs loop)
+    uint8_t *rx_ = nullptr; ///< Transfer buffer (heap, only during a transfer)
+    size_t rxTotal_ = 0;
+    size_t rxGot_ = 0;
+    RxState rxState_ = RxState::Idle;
+    ProvisionError rxError_ = ProvisionError::None;
+    uint32_t rxStartMs_ = 0;
+    uint32_t rxLastMs_ = 0;
+
+    uint32_t accepted_ = 0;
+    uint32_t rejected_ = 0;
+    ProvisionError lastError_ = ProvisionError::None;
+    uint32_t lastBytes_ = 0;
+    uint32_t transferMs_ = 0;
+    uint32_t verifyMs_ = 0;
+    uint32_t commitMs_ = 0;
+    uint32_t applyMs_ = 0;
+};
@@ -0,0 +1,485 @@
+#include "RemoteLog.hpp"
+
+#if FEATURE_SYSLOG
+
+#include <WiFi.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+#include <new>
+#include <stdarg.h>
+#include <sys/time.h>
+#include <time.h>
+
+namespace
+{
+    const uint8_t FACILITY_LOCAL0 = 16;
+    const char APP_NAME[] = "sms-sender";
+    const uint32_t CLOCK_VALID = 1600000000; ///< Wall clock before 2020: not set yet
+
+    const uint8_t LOOKUP_IDLE = 0;
+    const uint8_t LOOKUP_PENDING = 1;
+    const uint8_t LOOKUP_DONE = 2;
+    const uint8_t LOOKUP_FAILED = 3;
+
+    /** @brief Lookup handed to the tcpip thread; freed there */
+    struct LookupRequest
+    {
+        uint32_t gen;
+        char host[64];
+    };
+
+    const LogSeverity SEVERITIES[] = {LogSeverity::Error, LogSeverity::Warning, LogSeverity::Notice,
+                                      LogSeverity::Info, LogSeverity::Debug};
+
+    /** @brief Rate-limit bucket of a severity; -1 for Error (never limited) */
+    int8_t bucketOf(LogSeverity s)
+    {
+        switch (s)
+        {
+        case LogSeverity::Warning:
+            return 0;
+        case LogSeverity::Notice:
+            return 1;
+        case LogSeverity::Info:
+        case LogSeverity::Debug:
+            return 2;
+        default:
+            return -1;
+        }
+    }
+}
+
+RemoteLog &RemoteLog::instance()
+{
+    static RemoteLog inst;
+    return inst;
+}
+
+RemoteLog::RemoteLog()
+{
+    ProbeRegistry::instance().registerProbe("syslog", [this](JsonObject &dst)
+                                            { toJson(dst); });
+    SettingsApi::instance().registerSection(
+        "syslog",
+        [this](JsonObject &dst, bool)
+        { sectionToJson(dst); },
+        [this](JsonObjectConst patch, String &error)
+        { return validatePatch(patch, error); },
+        [this](JsonObjectConst patch)
+        { return applyPatch(patch); });
+    inbox.on<WifiStateChanged>([this](const WifiStateChanged &e)
+                               { staUp = e.staUp; });
+}
+
+void RemoteLog::begin(const String &hostname)
+{
+    // RFC 5424 HOSTNAME: printable, no spaces
+    this->hostname = hostname.length() ? hostname : String("-");
+    this->hostname.replace(' ', '_');
+    preferences.begin("syslog", true);
+    host = preferences.getString("host", host);
+    port = uint16_t(preferences.getUInt("port", port));
+    LogSeverity stored = LogSeverity(preferences.getUChar("level", uint8_t(level)));
+    if (stored >= LogSeverity::Error && stored <= LogSeverity::Debug)
+        level = stored;
+    preferences.end();
+    resolved = false;
+    resolveAtMs = millis();
+    portENTER_CRITICAL(&mux);
+    lookupGen++;
+    lookupState = LOOKUP_IDLE;
+    portEXIT_CRITICAL(&mux);
+    staUp = WiFi.status() == WL_CONNECTED; // later changes arrive as WifiStateChanged
+}
+
+void RemoteLog::log(LogSeverity severity, const char *tag, const char *fmt, ...)
+{
+    char line[192];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    Serial.printf("[%s] %s\n", tag, line);
+    if (severity > level)
+        return;
+    push(severity, tag, line, millis());
+}
+
+/**
+ * @brief Refill by elapsed time, then take one record's worth if there is one
+ */
+bool RemoteLog::admit(Bucket &b, uint16_t perMin, uint16_t burst, uint32_t now)
+{
+    uint32_t elapsed = now - b.refillMs;
+    b.refillMs = now;
+    uint32_t cap = uint32_t(burst) * 1000;
+    uint64_t tokens = uint64_t(b.tokens) + uint64_t(elapsed) * perMin / 60;
+    b.tokens = tokens > cap ? cap : uint32_t(tokens);
+    if (b.tokens < 1000)
+        return false;
+    b.tokens -= 1000;
+    return true;
+}
+
+/**
+ * @brief Rate limit, then copy into the ring, dropping the oldest record when full
+ */
+void RemoteLog::push(LogSeverity severity, const char *tag, const char *text, uint32_t now)
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    bool clockSet = uint32_t(tv.tv_sec) >= CLOCK_VALID;
+
+    static const uint16_t PER_MIN[] = {SYSLOG_WARN_PER_MIN, SYSLOG_NOTICE_PER_MIN, SYSLOG_INFO_PER_MIN};
+    static const uint16_t BURST[] = {SYSLOG_WARN_BURST, SYSLOG_NOTICE_BURST, SYSLOG_INFO_BURST};
+    int8_t b = bucketOf(severity);
+    char note[48];
+    note[0] = '\0';
+
+    portENTER_CRITICAL(&mux);
+    if (b >= 0 && !admit(buckets[b], PER_MIN[b], BURST[b], now))
+    {
+        buckets[b].suppressed++;
+        buckets[b].suppressedTotal++;
+        portEXIT_CRITICAL(&mux);
+        return;
+    }
+    if (b >= 0 && buckets[b].suppressed)
+    {
+        snprintf(note, sizeof(note), "%lu %s records suppressed by rate limit",
+                 (unsigned long)buckets[b].suppressed, severityName(severity));
+        buckets[b].suppressed = 0;
+    }
+    for (int i = note[0] ? 0 : 1; i < 2; ++i)
+    {
+        if (count == SYSLOG_RECORDS)
+        {
+            count--; // the oldest is overwritten at head
+            overflow++;
+        }
+        Record &r = ring[head];
+        r.seq = nextSeq;
+        nextSeq = nextSeq == 0x7FFFFFFF ? 1 : nextSeq + 1; // RFC 5424 7.3.1
+        r.uptimeMs = now;
+        r.utc = clockSet ? uint32_t(tv.tv_sec) : 0;
+        r.utcMs = uint16_t(tv.tv_usec / 1000);
+        r.severity = i == 0 ? LogSeverity::Notice : severity;
+        strlcpy(r.tag, i == 0 ? "LOG" : tag, sizeof(r.tag));
+        strlcpy(r.text, i == 0 ? note : text, sizeof(r.text));
+        head = uint8_t((head + 1) % SYSLOG_RECORDS);
+        count++;
+    }
+    if (count > maxQueued)
+        maxQueued = count;
+    portEXIT_CRITICAL(&mux);
+}
+
+/**
+ * @brief One RFC 5424 message: <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID SD MSG
+ */
+size_t RemoteLog::format(const Record &r, char *out, size_t cap) const
+{
+    char stamp[32] = "-";
+    if (r.utc)
+    {
+        time_t t = time_t(r.utc);
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        size_t n = strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+        snprintf(stamp + n, sizeof(stamp) - n, ".%03uZ", unsigned(r.utcMs));
+    }
+    int n = snprintf(out, cap, "<%u>1 %s %s %s - %s [meta sequenceId=\"%lu\" sysUpTime=\"%lu\"] %s",
+                     unsigned(FACILITY_LOCAL0 * 8 + uint8_t(r.severity)), stamp, hostname.c_str(), APP_NAME, r.tag,
+                     (unsigned long)r.seq, (unsigned long)(r.uptimeMs / 10), r.text);
+    return n < 0 || size_t(n) >= cap ? 0 : size_t(n);
+}
+
+/**
+ * @brief Collector address from a dotted quad, or an asynchronous DNS lookup
+ *
+ * Hands the lookup to the tcpip thread (dnsLookup()) and returns; the
+ * answer (dnsFound()) is picked up by a later poll(). A failed lookup is retried after
+ * SYSLOG_RESOLVE_MS. Records wait in the ring meanwhile.
+ */
+bool RemoteLog::resolve()
+{
+    if (resolved)
+        return true;
+    portENTER_CRITICAL(&mux);
+    uint8_t state = lookupState;
+    uint32_t addr = lookupAddr;
+    if (state == LOOKUP_DONE || state == LOOKUP_FAILED)
+        lookupState = LOOKUP_IDLE;
+    portEXIT_CRITICAL(&mux);
+
+    if (state == LOOKUP_PENDING)
+        return false;
+    if (state == LOOKUP_DONE)
+    {
+        collector = IPAddress(addr);
+        resolved = true;
+        return true;
+    }
+    if (state == LOOKUP_FAILED)
+    {
+        resolveAtMs = millis() + SYSLOG_RESOLVE_MS;
+        LOG_WARN("LOG", "Collector %s not resolved", host.c_str());
+        return false;
+    }
+    if (int32_t(millis() - resolveAtMs) < 0)
+        return false;
+    if (collector.fromString(host))
+    {
+        resolved = true;
+        return true;
+    }
+
+    LookupRequest *req = new (std::nothrow) LookupRequest;
+    if (req == nullptr)
+    {
+        resolveAtMs = millis() + SYSLOG_RESOLVE_MS;
+        return false;
+    }
+    strlcpy(req->host, host.c_str(), sizeof(req->host));
+    portENTER_CRITICAL(&mux);
+    req->gen = ++lookupGen;
+    lookupState = LOOKUP_PENDING;
+    portEXIT_CRITICAL(&mux);
+    // The raw DNS API belongs to the tcpip thread; the answer comes back
+    // through dnsFound() and is picked up by a later poll()
+    if (tcpip_callback(&RemoteLog::dnsLookup, req) != ERR_OK)
+    {
+        dnsFound(req->host, nullptr, reinterpret_cast<void *>(uintptr_t(req->gen)));
+        delete req;
+    }
+    return false;
+}
+
+/**
+ * @brief Start a lookup on the tcpip thread (tcpip_callback)
+ */
+void RemoteLog::dnsLookup(void *arg)
+{
+    LookupRequest *req = static_cast<LookupRequest *>(arg);
+    void *gen = reinterpret_cast<void *>(uintptr_t(req->gen));
+    ip_addr_t ip;
+    err_t err = dns_gethostbyname(req->host, &ip, &RemoteLog::dnsFound, gen);
+    if (err != ERR_INPROGRESS)
+        dnsFound(req->host, err == ERR_OK ? &ip : nullptr, gen); // Cache hit, or refused right away
+    delete req;
+}
+
+/**
+ * @brief Lookup answer, on the tcpip thread
+ */
+void RemoteLog::dnsFound(const char *, const ip_addr_t *ip, void *arg)
+{
+    RemoteLog &self = instance();
+    portENTER_CRITICAL(&self.mux);
+    if (uint32_t(uintptr_t(arg)) == self.lookupGen && self.lookupState == LOOKUP_PENDING)
+    {
+        self.lookupAddr = ip ? ip4_addr_get_u32(ip_2_ip4(ip)) : 0;
+        self.lookupState = ip ? LOOKUP_DONE : LOOKUP_FAILED;
+    }
+    portEXIT_CRITICAL(&self.mux);
+}
+
+/**
+ * @brief Batch the oldest records into one datagram once it is due
+ */
+void RemoteLog::poll()
+{
+    inbox.drain();
+    if (!staUp || host.length() == 0)
+        return;
+
+    uint32_t now = millis();
+    Record r;
+    bool due = false;
+    portENTER_CRITICAL(&mux);
+    if (count)
+    {
+        // Due when the oldest waited long enough, the ring could fill a datagram, or an error waits
+        const Record &oldest = ring[(head + SYSLOG_RECORDS - count) % SYSLOG_RECORDS];
+        due = now - oldest.uptimeMs >= SYSLOG_FLUSH_MS || count >= SYSLOG_DATAGRAM_MAX / (SYSLOG_TEXT_MAX + 100);
+        for (uint8_t i = 0; i < count && !due; ++i)
+            due = ring[(head + SYSLOG_RECORDS - 1 - i) % SYSLOG_RECORDS].severity <= LogSeverity::Error;
+    }
+    portEXIT_CRITICAL(&mux);
+    if (!due || !resolve())
+        return;
+
+    size_t len = 0;
+    uint8_t records = 0;
+    while (true)
+    {
+        // Copy the oldest out, format it without the lock, then pop it if it still is the oldest
+        portENTER_CRITICAL(&mux);
+        bool any = count > 0;
+        if (any)
+            r = ring[(head + SYSLOG_RECORDS - count) % SYSLOG_RECORDS];
+        portEXIT_CRITICAL(&mux);
+        if (!any)
+            break;
+        size_t sep = len ? 1 : 0;
+        size_t n = format(r, datagram + len + sep, sizeof(datagram) - len - sep);
+        if (n == 0)
+            break; // datagram full
+        if (sep)
+            datagram[len] = '\n';
+        len += sep + n;
+        records++;
+        portENTER_CRITICAL(&mux);
+        if (count && ring[(head + SYSLOG_RECORDS - count) % SYSLOG_RECORDS].seq == r.seq)
+            count--;
+        portEXIT_CRITICAL(&mux);
+    }
+    if (len == 0)
+        return;
+    if (!udp.beginPacket(collector, port) || udp.write(reinterpret_cast<const uint8_t *>(datagram), len) != len ||
+        !udp.endPacket())
+    {
+        sendErrors++; // records are gone: the collector sees a sequence gap
+        return;
+    }
+    shipped += records;
+    datagrams++;
+    bytes += uint32_t(len);
+}
+
+const char *RemoteLog::severityName(LogSeverity s)
+{
+    switch (s)
+    {
+    case LogSeverity::Error:
+        return "error";
+    case LogSeverity::Warning:
+        return "warning";
+    case LogSeverity::Notice:
+        return "notice";
+    case LogSeverity::Info:
+        return "info";
+    default:
+        return "debug";
+    }
+}
+
+bool RemoteLog::parseSeverity(const char *name, LogSeverity &out)
+{
+    if (name == nullptr)
+        return false;
+    for (LogSeverity s : SEVERITIES)
+    {
+        if (strcmp(name, severityName(s)) == 0)
+        {
+            out = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Write the "syslog" section of GET /settings: {"host","port","level"}
+ */
+void RemoteLog::sectionToJson(JsonObject &dst)
+{
+    dst["host"] = host;
+    dst["port"] = port;
+    dst["level"] = severityName(level);
+}
+
+bool RemoteLog::validatePatch(JsonObjectConst patch, String &error)
+{
+    for (JsonPairConst kv : patch)
+    {
+        const char *key = kv.key().c_str();
+        JsonVariantConst v = kv.value();
+        bool ok;
+        LogSeverity s;
+        if (strcmp(key, "host") == 0)
+            ok = v.is<const char *>() && strlen(v.as<const char *>()) <= 63 && strchr(v.as<const char *>(), ' ') == nullptr;
+        else if (strcmp(key, "port") == 0)
+            ok = v.is<uint16_t>() && v.as<uint16_t>() != 0;
+        else if (strcmp(key, "level") == 0)
+            ok = parseSeverity(v.as<const char *>(), s);
+        else
+        {
+            error = String(key) + ": unknown setting";
+            return false;
+        }
+        if (!ok)
+        {
+            error = String(key) + ": invalid value";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Store and use the new collector at once; the next poll() resolves it
+ */
+SettingsEffect RemoteLog::applyPatch(JsonObjectConst patch)
+{
+    SettingsEffect effect = SettingsEffect::None;
+    preferences.begin("syslog", false);
+    for (JsonPairConst kv : patch)
+    {
+        const char *key = kv.key().c_str();
+        JsonVariantConst v = kv.value();
+        if (strcmp(key, "host") == 0 && host != v.as<const char *>())
+        {
+            host = v.as<String>();
+            preferences.putString("host", host);
+        }
+        else if (strcmp(key, "port") == 0 && port != v.as<uint16_t>())
+        {
+            port = v.as<uint16_t>();
+            preferences.putUInt("port", port);
+        }
+        else if (strcmp(key, "level") == 0)
+        {
+            LogSeverity s = level;
+            parseSeverity(v.as<const char *>(), s);
+            if (s == level)
+                continue;
+            level = s;
+            preferences.putUChar("level", uint8_t(level));
+        }
+        else
+            continue;
+        effect = SettingsEffect::Live;
+    }
+    preferences.end();
+    resolved = false;
+    resolveAtMs = millis();
+    portENTER_CRITICAL(&mux);
+    lookupGen++; // an answer for the old host is dropped
+    lookupState = LOOKUP_IDLE;
+    portEXIT_CRITICAL(&mux);
+    return effect;
+}
+
+void RemoteLog::toJson(JsonObject &dst) const
+{
+    if (host.length())
+        dst["collector"] = host + ":" + String(port);
+    else
+        dst["collector"] = nullptr;
+    dst["level"] = severityName(level);
+    dst["queued"] = count;
+    dst["maxQueued"] = maxQueued;
+    dst["seq"] = nextSeq - 1;
+    dst["shipped"] = shipped;
+    dst["datagrams"] = datagrams;
+    dst["bytes"] = bytes;
+    dst["overflow"] = overflow;
+    JsonObject s = dst["suppressed"].to<JsonObject>();
+    s["warning"] = buckets[0].suppressedTotal;
+    s["notice"] = buckets[1].suppressedTotal;
+    s["info"] = buckets[2].suppressedTotal;
+    dst["sendErrors"] = sendErrors;
+}
+
+#endif // FEATURE_SYSLOG
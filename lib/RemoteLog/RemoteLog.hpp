@@ -0,0 +1,265 @@
+/**
+ * @file RemoteLog.hpp
+ * @brief Serial log lines with severities, shipped in batches to a UDP syslog collector
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "Features.hpp"
+
+#if FEATURE_SYSLOG
+#include <ArduinoJson.h>
+#include <WiFiUdp.h>
+#include <lwip/ip_addr.h>
+#include "EventBus.hpp"
+#include "ProbeRegistry.hpp"
+#include "SettingsApi.hpp"
+#include "WearPreferences.hpp"
+#endif
+
+// ====== Tuning ======
+/**
+ * @def SYSLOG_PORT
+ * @brief Default collector UDP port
+ */
+#ifndef SYSLOG_PORT
+#define SYSLOG_PORT 514
+#endif
+
+/**
+ * @def SYSLOG_RECORDS
+ * @brief Records waiting for shipping; the oldest is dropped when full
+ */
+#ifndef SYSLOG_RECORDS
+#define SYSLOG_RECORDS 32
+#endif
+
+/**
+ * @def SYSLOG_TEXT_MAX
+ * @brief Message text kept per record (longer lines are shipped truncated)
+ */
+#ifndef SYSLOG_TEXT_MAX
+#define SYSLOG_TEXT_MAX 120
+#endif
+
+/**
+ * @def SYSLOG_DATAGRAM_MAX
+ * @brief Largest batch datagram (below the WiFi path MTU, so never fragmented)
+ */
+#ifndef SYSLOG_DATAGRAM_MAX
+#define SYSLOG_DATAGRAM_MAX 1200
+#endif
+
+/**
+ * @def SYSLOG_FLUSH_MS
+ * @brief Longest time a record waits for its batch to fill (errors go at once)
+ */
+#ifndef SYSLOG_FLUSH_MS
+#define SYSLOG_FLUSH_MS 2000
+#endif
+
+/**
+ * @def SYSLOG_RESOLVE_MS
+ * @brief Retry interval of a failed collector name lookup (asynchronous, never blocks the loop)
+ */
+#ifndef SYSLOG_RESOLVE_MS
+#define SYSLOG_RESOLVE_MS 60000
+#endif
+
+/**
+ * @def SYSLOG_WARN_PER_MIN
+ * @brief Warning records queued per minute on average (burst SYSLOG_WARN_BURST)
+ */
+#ifndef SYSLOG_WARN_PER_MIN
+#define SYSLOG_WARN_PER_MIN 60
+#endif
+
+#ifndef SYSLOG_WARN_BURST
+#define SYSLOG_WARN_BURST 20
+#endif
+
+/**
+ * @def SYSLOG_NOTICE_PER_MIN
+ * @brief Notice records queued per minute on average (burst SYSLOG_NOTICE_BURST)
+ */
+#ifndef SYSLOG_NOTICE_PER_MIN
+#define SYSLOG_NOTICE_PER_MIN 30
+#endif
+
+#ifndef SYSLOG_NOTICE_BURST
+#define SYSLOG_NOTICE_BURST 10
+#endif
+
+/**
+ * @def SYSLOG_INFO_PER_MIN
+ * @brief Info and Debug records queued per minute on average (burst SYSLOG_INFO_BURST)
+ */
+#ifndef SYSLOG_INFO_PER_MIN
+#define SYSLOG_INFO_PER_MIN 30
+#endif
+
+#ifndef SYSLOG_INFO_BURST
+#define SYSLOG_INFO_BURST 10
+#endif
+
+/**
+ * @brief Syslog severities (RFC 5424 numbering); lower is more severe
+ */
+enum class LogSeverity : uint8_t
+{
+    Error = 3,   ///< Operation failed (send aborted, storage lost)
+    Warning = 4, ///< Degraded but working (fallbacks, retries, throttling)
+    Notice = 5,  ///< Significant normal events (restarts, recoveries, config)
+    Info = 6,    ///< Routine progress (sends, registration, wakes)
+    Debug = 7,   ///< Diagnostics
+};
+
+#if FEATURE_SYSLOG
+
+/**
+ * @brief Log front end: every line goes to Serial, and is queued for a syslog collector
+ *
+ * log() formats the line, prints it to Serial as "[TAG] text" like before,
+ * and copies it into a fixed ring of records. It never touches the network
+ * and never waits, so logging on the send path costs a format and a copy.
+ * poll() ships from the main loop, one datagram per call at most:
+ * - records are batched into one datagram until it is full or the oldest
+ *   waited SYSLOG_FLUSH_MS; an Error ships at once
+ * - each record is an RFC 5424 message (facility local0, APP-NAME
+ *   "sms-sender", MSGID the tag) with `[meta sequenceId sysUpTime]`;
+ *   records in one datagram are separated by LF (RFC 6587 non-transparent
+ *   framing), so a batch of one is a plain RFC 5426 syslog datagram
+ * - sequenceId counts queued records from 1 after every boot: a gap at the
+ *   collector is a record lost in the ring (overflow) or on the network
+ *
+ * Below Error, severities are rate limited with a token bucket each, so a
+ * chatty subsystem cannot flood the ring or the collector. Records over
+ * the limit are printed but not queued; the next queued record of that
+ * severity is preceded by a "LOG" record with the suppressed count. When
+ * the ring is full the oldest record is dropped; the writer never blocks.
+ *
+ * Configured by the "syslog" settings section ({"host","port","level"},
+ * live); an empty host ships nothing. Records keep queueing (and dropping
+ * the oldest) while no collector is configured or WiFi is down, so the
+ * lines just before a link comes up are shipped when it does.
+ */
+class RemoteLog
+{
+public:
+    static RemoteLog &instance();
+
+    /**
+     * @brief Load the collector settings; call once after GSettings::load()
+     *
+     * @param hostname HOSTNAME field of the records (device name)
+     */
+    void begin(const String &hostname);
+
+    /**
+     * @brief Print a line and queue it for shipping; any task, never blocks
+     *
+     * @param tag Subsystem tag without brackets (static string, "SMS")
+     */
+    void log(LogSeverity severity, const char *tag, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+
+    /**
+     * @brief Ship at most one datagram; call from the main loop
+     */
+    void poll();
+
+    /**
+     * @brief Write {"collector","level","queued","maxQueued","seq","shipped","datagrams",
+     * "bytes","overflow","suppressed":{"<severity>":n},"sendErrors"}
+     */
+    void toJson(JsonObject &dst) const;
+
+    static const char *severityName(LogSeverity s);
+    static bool parseSeverity(const char *name, LogSeverity &out);
+
+private:
+    struct Record
+    {
+        uint32_t seq;      ///< RFC 5424 sequenceId
+        uint32_t uptimeMs; ///< millis() when logged
+        uint32_t utc;      ///< Wall clock seconds (0: clock not set)
+        uint16_t utcMs;
+        LogSeverity severity;
+        char tag[8];
+        char text[SYSLOG_TEXT_MAX];
+    };
+
+    /** @brief Token bucket of one severity, in thousandths of a record */
+    struct Bucket
+    {
+        uint32_t tokens;
+        uint32_t refillMs;
+        uint32_t suppressed; ///< Since the last queued record of this severity
+        uint32_t suppressedTotal;
+    };
+
+    RemoteLog();
+    RemoteLog(const RemoteLog &) = delete;
+    RemoteLog &operator=(const RemoteLog &) = delete;
+
+    bool admit(Bucket &b, uint16_t perMin, uint16_t burst, uint32_t now);
+    void push(LogSeverity severity, const char *tag, const char *text, uint32_t now);
+    size_t format(const Record &r, char *out, size_t cap) const;
+    bool resolve();
+    static void dnsLookup(void *arg);
+    static void dnsFound(const char *name, const ip_addr_t *ip, void *arg);
+
+    void sectionToJson(JsonObject &dst);
+    bool validatePatch(JsonObjectConst patch, String &error);
+    SettingsEffect applyPatch(JsonObjectConst patch);
+
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED; ///< Guards the ring and buckets (any task logs)
+    Record ring[SYSLOG_RECORDS];
+    uint8_t head = 0;  ///< Next record written
+    uint8_t count = 0; ///< Records waiting
+    uint8_t maxQueued = 0;
+    uint32_t nextSeq = 1;
+    Bucket buckets[3] = {}; ///< Warning, Notice, Info/Debug
+
+    String host;
+    uint16_t port = SYSLOG_PORT;
+    LogSeverity level = LogSeverity::Info; ///< Least severe level queued
+    String hostname = "-";
+    IPAddress collector;
+    bool resolved = false;
+    uint32_t resolveAtMs = 0;
+    uint32_t lookupGen = 0;   ///< Id of the current DNS lookup; a host change orphans older ones
+    uint8_t lookupState = 0;  ///< LOOKUP_* (guarded by mux: the lwIP task writes it)
+    uint32_t lookupAddr = 0;  ///< Answer of a finished lookup
+    bool staUp = false;
+
+    WiFiUDP udp;
+    EventInbox inbox{"syslog"}; ///< WifiStateChanged
+    WearPreferences preferences{"syslog"}; ///< Operator settings: critical, never throttled
+    char datagram[SYSLOG_DATAGRAM_MAX];
+
+    uint32_t shipped = 0;
+    uint32_t datagrams = 0;
+    uint32_t bytes = 0;
+    uint32_t overflow = 0;
+    uint32_t sendErrors = 0;
+};
+
+#define LOG_AT(severity, tag, fmt, ...) RemoteLog::instance().log(severity, tag, fmt, ##__VA_ARGS__)
+
+#else
+
+#define LOG_AT(severity, tag, fmt, ...) Serial.printf("[" tag "] " fmt "\n", ##__VA_ARGS__)
+
+#endif // FEATURE_SYSLOG
+
+/**
+ * @brief Log one line: "[TAG] text" on Serial, and a syslog record with FEATURE_SYSLOG
+ *
+ * @p tag and @p fmt are string literals; no trailing newline.
+ */
+#define LOG_ERROR(tag, fmt, ...) LOG_AT(LogSeverity::Error, tag, fmt, ##__VA_ARGS__)
+#define LOG_WARN(tag, fmt, ...) LOG_AT(LogSeverity::Warning, tag, fmt, ##__VA_ARGS__)
+#define LOG_NOTICE(tag, fmt, ...) LOG_AT(LogSeverity::Notice, tag, fmt, ##__VA_ARGS__)
+#define LOG_INFO(tag, fmt, ...) LOG_AT(LogSeverity::Info, tag, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(tag, fmt, ...) LOG_AT(LogSeverity::Debug, tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,495 @@
+#include "RuleEngine.hpp"
+#include <new>
+#include "JobTracer.hpp"
+#include "ProbeRegistry.hpp"
+#include "Provisioner.hpp"
+#include "RemoteLog.hpp"
+
+namespace
+{
+    const char *NVS_NAMESPACE = "rules";
+    const char *NVS_KEY = "src";
+    const char *DEFAULT_TEXT = "{device}: {rule} {state}";
+    const uint32_t SEND_RETRY_MS = 1000; ///< Modem or job slots unavailable: look again after
+
+    /**
+     * @brief Numeric value at a dotted @p path below @p v (booleans are 0/1)
+     */
+    bool lookup(JsonVariantConst v, const char *path, float &out)
+    {
+        char key[RULES_PATH_MAX];
+        while (*path)
+        {
+            const char *dot = strchr(path, '.');
+            size_t n = dot ? size_t(dot - path) : strlen(path);
+            memcpy(key, path, n);
+            key[n] = '\0';
+            if (v.is<JsonArrayConst>() && key[0] >= '0' && key[0] <= '9')
+                v = v[size_t(atoi(key))];
+            else
+                v = v[key];
+            path += dot ? n + 1 : n;
+        }
+        if (v.is<bool>())
+        {
+            out = v.as<bool>() ? 1.0f : 0.0f;
+            return true;
+        }
+        if (v.is<float>())
+        {
+            out = v.as<float>();
+            return true;
+        }
+        return false;
+    }
+}
+
+RuleEngine &RuleEngine::instance()
+{
+    static RuleEngine inst;
+    return inst;
+}
+
+RuleEngine::RuleEngine()
+{
+    ProbeRegistry::instance().registerProbe("rules", [this](JsonObject &dst)
+                                            { toJson(dst); });
+}
+
+void RuleEngine::begin(JobQueue &jobs, PostFunction postFunc, CheckModemRegisteredFunction checkModemRegisteredFunc,
+                       const String &deviceName)
+{
+    this->jobs = &jobs;
+    post = postFunc;
+    checkModemRegistered = checkModemRegisteredFunc;
+    this->deviceName = deviceName;
+
+    preferences.begin(NVS_NAMESPACE, true);
+    source_ = preferences.getString(NVS_KEY, "");
+    preferences.end();
+    if (source_.length() == 0)
+        return;
+
+    RuleProgram *loaded;
+    String error;
+    if (!compile(source_.c_str(), source_.length(), loaded, error))
+    {
+        // Templates or pins the stored set relies on may have changed
+        refused++;
+        lastError = error;
+        LOG_ERROR("RULES", "Stored rule set refused: %s", error.c_str());
+        return;
+    }
+    install(loaded);
+    LOG_INFO("RULES", "%u rule(s), %u input(s), %u probe value(s), %u code bytes", (unsigned)program->ruleCount,
+             (unsigned)program->inputCount, (unsigned)program->signalCount, (unsigned)program->codeLen);
+}
+
+bool RuleEngine::compile(const char *source, size_t len, RuleProgram *&out, String &error)
+{
+    out = nullptr;
+    if (len > RULES_SOURCE_MAX)
+    {
+        error = "rule set too long (RULES_SOURCE_MAX)";
+        return false;
+    }
+    JsonDocument doc;
+    DeserializationError jsonError = deserializeJson(doc, source, len);
+    if (jsonError)
+    {
+        error = String("invalid JSON: ") + jsonError.c_str();
+        return false;
+    }
+    if (!doc.is<JsonObject>())
+    {
+        error = "rule set must be a JSON object";
+        return false;
+    }
+    RuleProgram *compiled = new (std::nothrow) RuleProgram();
+    if (compiled == nullptr)
+    {
+        error = "out of memory";
+        return false;
+    }
+    if (!RuleProgram::compile(doc.as<JsonObjectConst>(), *compiled, error))
+    {
+        delete compiled;
+        return false;
+    }
+    out = compiled;
+    return true;
+}
+
+bool RuleEngine::update(const char *source, size_t len, String &error)
+{
+    RuleProgram *compiled;
+    if (!compile(source, len, compiled, error))
+    {
+        refused++;
+        lastError = error;
+        LOG_WARN("RULES", "Rule set refused: %s", error.c_str());
+        return false;
+    }
+    String text;
+    text.concat(source, len);
+    preferences.begin(NVS_NAMESPACE, false);
+    size_t written = preferences.putString(NVS_KEY, text);
+    preferences.end();
+    if (written != text.length())
+    {
+        delete compiled;
+        refused++;
+        error = lastError = "could not store the rule set";
+        LOG_ERROR("RULES", "%s", error.c_str());
+        return false;
+    }
+    source_ = text;
+    install(compiled);
+    updates++;
+    lastError = "";
+    LOG_NOTICE("RULES", "Rule set updated: %u rule(s), %u code bytes", (unsigned)program->ruleCount,
+               (unsigned)program->codeLen);
+    return true;
+}
+
+void RuleEngine::submit(const char *source, size_t len)
+{
+    char *copy = static_cast<char *>(malloc(len + 1));
+    if (copy == nullptr)
+        return;
+    memcpy(copy, source, len);
+    copy[len] = '\0';
+    portENTER_CRITICAL(&submitMux_);
+    char *dropped = submitted_;
+    submitted_ = copy;
+    submittedLen_ = len;
+    portEXIT_CRITICAL(&submitMux_);
+    free(dropped);
+}
+
+/**
+ * @brief Run @p next; rules keep their state across sets by name
+ */
+void RuleEngine::install(RuleProgram *next)
+{
+    RuleState kept[RULES_MAX];
+    for (uint8_t i = 0; i < next->ruleCount; ++i)
+    {
+        for (uint8_t j = 0; program != nullptr && j < program->ruleCount; ++j)
+        {
+            if (strcmp(next->rules[i].name, program->rules[j].name) == 0)
+            {
+                kept[i] = states[j];
+                uint8_t all = uint8_t((1u << next->rules[i].toCount) - 1);
+                kept[i].pendingAlarm &= all;
+                kept[i].pendingClear &= all;
+                break;
+            }
+        }
+    }
+
+    // Inputs the new set no longer uses go back to plain inputs
+    for (uint8_t j = 0; program != nullptr && j < program->inputCount; ++j)
+    {
+        bool used = false;
+        for (uint8_t i = 0; i < next->inputCount; ++i)
+            used = used || next->inputs[i].pin == program->inputs[j].pin;
+        if (!used)
+            pinMode(program->inputs[j].pin, INPUT);
+    }
+
+    uint32_t now = millis();
+    values = RuleValues();
+    for (uint8_t i = 0; i < next->inputCount; ++i)
+    {
+        const RuleInput &in = next->inputs[i];
+        pinMode(in.pin, in.mode);
+        uint8_t level = uint8_t((digitalRead(in.pin) == LOW) == in.activeLow);
+        inputs[i].raw = level;
+        inputs[i].changedMs = now;
+        values.inputs[i] = level;
+    }
+    for (uint8_t i = 0; i < RULES_SIGNALS; ++i)
+        sampledMs[i] = now - RULES_SAMPLE_MS; // due at once
+    for (uint8_t i = 0; i < RULES_MAX; ++i)
+        states[i] = kept[i];
+    next_ = 0;
+
+    RuleProgram *old = program;
+    program = next;
+    delete old;
+}
+
+void RuleEngine::poll()
+{
+    char *pending = nullptr;
+    size_t pendingLen = 0;
+    portENTER_CRITICAL(&submitMux_);
+    pending = submitted_;
+    pendingLen = submittedLen_;
+    submitted_ = nullptr;
+    portEXIT_CRITICAL(&submitMux_);
+    if (pending != nullptr)
+    {
+        String error;
+        bool ok = update(pending, pendingLen, error);
+        free(pending);
+        if (notify)
+            notify(ok ? String("R:OK,") + program->ruleCount : String("R:ERR,") + error);
+    }
+
+    if (program == nullptr || program->ruleCount == 0)
+        return;
+    uint32_t now = millis();
+    readInputs(now);
+    sample(now);
+    evaluate(now);
+    send(now);
+}
+
+void RuleEngine::readInputs(uint32_t now)
+{
+    for (uint8_t i = 0; i < program->inputCount; ++i)
+    {
+        const RuleInput &in = program->inputs[i];
+        uint8_t level = uint8_t((digitalRead(in.pin) == LOW) == in.activeLow);
+        if (level != inputs[i].raw)
+        {
+            inputs[i].raw = level;
+            inputs[i].changedMs = now;
+        }
+        else if (level != values.inputs[i] && now - inputs[i].changedMs >= in.debounceMs)
+            values.inputs[i] = level;
+    }
+}
+
+/**
+ * @brief Call the probe of the oldest due value; refresh all its values
+ */
+void RuleEngine::sample(uint32_t now)
+{
+    int8_t oldest = -1;
+    for (uint8_t i = 0; i < program->signalCount; ++i)
+    {
+        if (now - sampledMs[i] >= RULES_SAMPLE_MS &&
+            (oldest < 0 || int32_t(sampledMs[i] - sampledMs[oldest]) < 0))
+            oldest = int8_t(i);
+    }
+    if (oldest < 0)
+        return;
+
+    const char *probe = program->signals[oldest].probe;
+    uint32_t start = micros();
+    JsonDocument doc;
+    bool found = ProbeRegistry::instance().call(probe, doc);
+    JsonVariantConst root = doc[probe];
+    for (uint8_t i = 0; i < program->signalCount; ++i)
+    {
+        if (strcmp(program->signals[i].probe, probe) != 0)
+            continue;
+        values.valid[i] = found && lookup(root, program->signals[i].path, values.signals[i]);
+        sampledMs[i] = now;
+    }
+    uint32_t us = micros() - start;
+    samples++;
+    if (us > maxSampleUs)
+        maxSampleUs = us;
+}
+
+/**
+ * @brief Run rules round robin until the instruction budget is spent
+ *
+ * Every rule fits the budget (RULES_RULE_OPS), and each rule runs at most
+ * once per pass.
+ */
+void RuleEngine::evaluate(uint32_t now)
+{
+    uint32_t start = micros();
+    uint16_t ops = 0;
+    for (uint8_t n = 0; n < program->ruleCount; ++n)
+    {
+        const Rule &rule = program->rules[next_];
+        if (ops + rule.cost > RULES_TICK_OPS)
+            break;
+        RuleState &st = states[next_];
+        RuleResult result = program->run(st.active ? rule.clear : rule.trip, values, ops);
+        evaluations++;
+        step(rule, st, result, now);
+        next_ = uint8_t((next_ + 1) % program->ruleCount);
+    }
+    uint32_t us = micros() - start;
+    ticks++;
+    if (ops > maxTickOps)
+        maxTickOps = ops;
+    if (us > maxTickUs)
+        maxTickUs = us;
+}
+
+/**
+ * @brief Advance one rule's state with the result of its current condition
+ */
+void RuleEngine::step(const Rule &rule, RuleState &st, RuleResult result, uint32_t now)
+{
+    uint8_t all = uint8_t((1u << rule.toCount) - 1);
+    if (result == RuleResult::Unknown)
+        return;
+    if (!st.active)
+    {
+        if (result == RuleResult::False)
+        {
+            st.holding = false;
+            return;
+        }
+        if (!st.holding)
+        {
+            st.holding = true;
+            st.sinceMs = now;
+        }
+        if (now - st.sinceMs < rule.forMs)
+            return;
+        st.active = true;
+        st.holding = false;
+        st.sentMs = now;
+        st.pendingAlarm = all;
+        trips++;
+        LOG_NOTICE("RULES", "%s: ALARM", rule.name);
+        return;
+    }
+    if (result == RuleResult::True)
+    {
+        st.active = false;
+        if (rule.onClear)
+            st.pendingClear = all;
+        clears++;
+        LOG_NOTICE("RULES", "%s: OK", rule.name);
+        return;
+    }
+    if (rule.repeatMs != 0 && now - st.sentMs >= rule.repeatMs)
+    {
+        st.sentMs = now;
+        st.pendingAlarm = all;
+    }
+}
+
+/**
+ * @brief Queue the first owed SMS, if the modem and a job slot are available
+ */
+void RuleEngine::send(uint32_t now)
+{
+    uint8_t index = 0;
+    while (index < program->ruleCount && (states[index].pendingAlarm | states[index].pendingClear) == 0)
+        ++index;
+    if (index == program->ruleCount)
+    {
+        waitStartMs = 0;
+        return;
+    }
+    if (waitStartMs != 0 && now - lastTryMs < SEND_RETRY_MS)
+        return;
+    lastTryMs = now;
+    SmsJob *job = nullptr;
+    if (jobs->inUse() < JOB_SLOTS && checkModemRegistered())
+        job = jobs->acquire();
+    if (job == nullptr)
+    {
+        if (waitStartMs == 0)
+            waitStartMs = now;
+        return;
+    }
+    if (waitStartMs != 0 && now - waitStartMs > maxWaitMs)
+        maxWaitMs = now - waitStartMs;
+    waitStartMs = 0;
+
+    const Rule &rule = program->rules[index];
+    RuleState &st = states[index];
+    bool alarm = st.pendingAlarm != 0;
+    uint8_t &mask = alarm ? st.pendingAlarm : st.pendingClear;
+    uint8_t recipient = uint8_t(__builtin_ctz(mask));
+    mask &= uint8_t(mask - 1);
+
+    String text = render(rule, alarm);
+    size_t len = text.length();
+    if (len >= JOB_BODY_MAX)
+    {
+        len = JOB_BODY_MAX - 1;
+        while (len > 0 && (uint8_t(text[len]) & 0xC0) == 0x80)
+            --len; // do not split a UTF-8 sequence
+    }
+    JobTracer::instance().begin(job->id);
+    job->to = rule.to[recipient];
+    job->priority = rule.priority;
+    memcpy(job->body, text.c_str(), len);
+    job->body[len] = '\0';
+    job->bodyLen = uint16_t(len);
+    uint32_t id = job->id;
+    post(*job);
+    sent++;
+    LOG_INFO("RULES", "%s: %s queued as job %lu", rule.name, alarm ? "alarm" : "clear", (unsigned long)id);
+}
+
+/**
+ * @brief Message text of @p rule with its placeholders filled in
+ */
+String RuleEngine::render(const Rule &rule, bool alarm) const
+{
+    String text;
+    if (!rule.isTemplate)
+        text = program->textOf(rule);
+    else if (!Provisioner::instance().findTemplate(program->textOf(rule), text))
+        text = DEFAULT_TEXT; // template removed by a newer bundle
+
+    char value[16] = "";
+    if (rule.valueRef != 0xFF && (rule.valueRef & 0x80))
+        snprintf(value, sizeof(value), "%u", (unsigned)values.inputs[rule.valueRef & 0x7F]);
+    else if (rule.valueRef != 0xFF && values.valid[rule.valueRef])
+        snprintf(value, sizeof(value), "%g", (double)values.signals[rule.valueRef]);
+    text.replace("{device}", deviceName);
+    text.replace("{rule}", rule.name);
+    text.replace("{state}", alarm ? "ALARM" : "OK");
+    text.replace("{value}", value);
+    return text;
+}
+
+void RuleEngine::toJson(JsonObject &dst) const
+{
+    uint8_t unknown = 0;
+    uint32_t pending = 0;
+    JsonArray active = dst["active"].to<JsonArray>();
+    if (program != nullptr)
+    {
+        dst["rules"] = program->ruleCount;
+        dst["inputs"] = program->inputCount;
+        dst["signals"] = program->signalCount;
+        dst["codeBytes"] = program->codeLen;
+        for (uint8_t i = 0; i < program->signalCount; ++i)
+            unknown += values.valid[i] ? 0 : 1;
+        for (uint8_t i = 0; i < program->ruleCount; ++i)
+        {
+            if (states[i].active)
+                active.add(program->rules[i].name);
+            pending += __builtin_popcount(states[i].pendingAlarm) + __builtin_popcount(states[i].pendingClear);
+        }
+    }
+    else
+    {
+        dst["rules"] = 0;
+        dst["inputs"] = 0;
+        dst["signals"] = 0;
+        dst["codeBytes"] = 0;
+    }
+    dst["unknownSignals"] = unknown;
+    dst["ticks"] = ticks;
+    dst["evaluations"] = evaluations;
+    dst["maxTickOps"] = maxTickOps;
+    dst["maxTickUs"] = maxTickUs;
+    dst["samples"] = samples;
+    dst["maxSampleUs"] = maxSampleUs;
+    dst["trips"] = trips;
+    dst["clears"] = clears;
+    dst["sent"] = sent;
+    dst["pending"] = pending;
+    dst["maxWaitMs"] = maxWaitMs;
+    dst["updates"] = updates;
+    dst["refused"] = refused;
+    dst["lastError"] = lastError;
+}
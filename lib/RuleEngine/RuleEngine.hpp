@@ -0,0 +1,188 @@
+/**
+ * @file RuleEngine.hpp
+ * @brief Runs the alarm rule set: debounced GPIOs, probe sampling, SMS on trip and clear
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include "JobQueue.hpp"
+#include "RuleProgram.hpp"
+#include "WearPreferences.hpp"
+
+// ====== Tuning ======
+/**
+ * @def RULES_TICK_OPS
+ * @brief Interpreter instructions per loop pass; rules left over run on the next pass
+ */
+#ifndef RULES_TICK_OPS
+#define RULES_TICK_OPS 64
+#endif
+
+/**
+ * @def RULES_SAMPLE_MS
+ * @brief Age at which a probe value is sampled again
+ *
+ * At most one probe is called per loop pass. Probes that talk to the modem
+ * ("modem") cost an AT exchange per sample.
+ */
+#ifndef RULES_SAMPLE_MS
+#define RULES_SAMPLE_MS 5000
+#endif
+
+/**
+ * @def RULES_SOURCE_MAX
+ * @brief Longest rule set source (JSON) accepted and stored
+ */
+#ifndef RULES_SOURCE_MAX
+#define RULES_SOURCE_MAX 4096
+#endif
+
+static_assert(RULES_TICK_OPS >= RULES_RULE_OPS + 1, "RULES_TICK_OPS must fit the longest condition");
+static_assert(RULES_RECIPIENTS <= 8, "pending sends are a byte mask per rule");
+
+/**
+ * @brief Evaluates the compiled rule set from the main loop and queues alarm SMS
+ *
+ * The source (JSON, see RuleProgram) is stored in NVS and compiled at
+ * begin() and on every update. A rule set that does not compile is
+ * refused and the running one is kept.
+ *
+ * Each poll():
+ * 1. Reads the GPIO inputs and debounces them.
+ * 2. Samples the probe value that is oldest and due (RULES_SAMPLE_MS).
+ *    Every value of that probe comes from the same call. A value the probe
+ *    no longer reports makes its conditions unknown: the rules using it
+ *    keep their state.
+ * 3. Evaluates rules round robin, within RULES_TICK_OPS instructions.
+ * 4. Queues at most one SMS. Sends wait while the modem is not registered
+ *    or all job slots are in use. They are kept as one bit per rule,
+ *    recipient and kind (alarm/clear), so a flapping input cannot pile up
+ *    messages.
+ *
+ * A rule trips when its condition has held for forMs. It then sends the
+ * alarm (and again every repeatMs while active) until its all-clear
+ * condition holds, which sends the clear message if onClear is set. After
+ * an update, rules keep their state if the new set has a rule of the same
+ * name.
+ *
+ * Message text placeholders: {device}, {rule}, {state} (ALARM or OK) and
+ * {value} (first input or probe value of the condition).
+ *
+ * Rule sets arrive over HTTP (update(), loop task) or BLE (submit(), any
+ * task; compiled in poll() and answered "R:OK,<rules>" or "R:ERR,<reason>").
+ */
+class RuleEngine
+{
+public:
+    using PostFunction = std::function<void(SmsJob &job)>;
+    using CheckModemRegisteredFunction = std::function<bool()>;
+    using NotifyFunction = std::function<void(const String &)>;
+
+    static RuleEngine &instance();
+
+    /**
+     * @brief Load and compile the stored rule set, configure its inputs
+     *
+     * @param deviceName Replaces {device} in message texts
+     */
+    void begin(JobQueue &jobs, PostFunction postFunc, CheckModemRegisteredFunction checkModemRegisteredFunc,
+               const String &deviceName);
+
+    /** @brief Where "R:..." answers to submit() go (BLE notify) */
+    void onNotify(NotifyFunction fn) { notify = fn; }
+
+    /**
+     * @brief Compile, store and run a new rule set (loop task)
+     *
+     * @param error Set to "<where>: <what>" when refused
+     */
+    bool update(const char *source, size_t len, String &error);
+
+    /**
+     * @brief Hand over a rule set for the next poll() (any task; no flash access)
+     */
+    void submit(const char *source, size_t len);
+
+    /**
+     * @brief Inputs, sampling, evaluation and sending; call every loop pass
+     */
+    void poll();
+
+    /** @brief The stored rule set source ("" when none) */
+    const String &source() const { return source_; }
+
+    /**
+     * @brief Write {"rules","inputs","signals","codeBytes","active":[names],
+     * "unknownSignals","ticks","evaluations","maxTickOps","maxTickUs","samples",
+     * "maxSampleUs","trips","clears","sent","pending","maxWaitMs","updates","refused","lastError"}
+     */
+    void toJson(JsonObject &dst) const;
+
+private:
+    struct InputState
+    {
+        uint8_t raw = 0;          ///< Last read (1 active)
+        uint32_t changedMs = 0;   ///< When raw last changed
+    };
+
+    struct RuleState
+    {
+        bool active = false;
+        bool holding = false;     ///< Trip condition true, forMs running
+        uint32_t sinceMs = 0;     ///< Start of holding
+        uint32_t sentMs = 0;      ///< Last alarm queued (repeatMs)
+        uint8_t pendingAlarm = 0; ///< Recipients still owed the alarm SMS
+        uint8_t pendingClear = 0; ///< Recipients still owed the clear SMS
+    };
+
+    RuleEngine();
+    RuleEngine(const RuleEngine &) = delete;
+    RuleEngine &operator=(const RuleEngine &) = delete;
+
+    bool compile(const char *source, size_t len, RuleProgram *&out, String &error);
+    void install(RuleProgram *next);
+    void readInputs(uint32_t now);
+    void sample(uint32_t now);
+    void evaluate(uint32_t now);
+    void step(const Rule &rule, RuleState &st, RuleResult result, uint32_t now);
+    void send(uint32_t now);
+    String render(const Rule &rule, bool alarm) const;
+
+    JobQueue *jobs = nullptr;
+    PostFunction post;
+    CheckModemRegisteredFunction checkModemRegistered;
+    NotifyFunction notify;
+    String deviceName;
+    WearPreferences preferences{"rules"};
+
+    RuleProgram *program = nullptr; ///< Running rule set (heap)
+    String source_;
+    RuleValues values;
+    InputState inputs[RULES_INPUTS];
+    uint32_t sampledMs[RULES_SIGNALS] = {};
+    RuleState states[RULES_MAX];
+    uint8_t next_ = 0;               ///< Round robin position
+
+    portMUX_TYPE submitMux_ = portMUX_INITIALIZER_UNLOCKED; ///< Guards submitted_ (BLE task vs loop)
+    char *submitted_ = nullptr;      ///< Rule set from submit() (heap), NUL terminated
+    size_t submittedLen_ = 0;
+
+    uint32_t ticks = 0;
+    uint32_t evaluations = 0;
+    uint16_t maxTickOps = 0;
+    uint32_t maxTickUs = 0;
+    uint32_t samples = 0;
+    uint32_t maxSampleUs = 0;
+    uint32_t trips = 0;
+    uint32_t clears = 0;
+    uint32_t sent = 0;
+    uint32_t waitStartMs = 0;       ///< First poll a send was due but could not go (0: none)
+    uint32_t lastTryMs = 0;
+    uint32_t maxWaitMs = 0;
+    uint32_t updates = 0;
+    uint32_t refused = 0;
+    String lastError;
+};
@@ -0,0 +1,533 @@
+#include "RuleProgram.hpp"
+#include "Provisioner.hpp"
+
+namespace
+{
+    bool isNameStart(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+    bool isNameChar(char c) { return isNameStart(c) || (c >= '0' && c <= '9'); }
+
+    bool copyName(char *dst, size_t cap, const char *s, size_t n)
+    {
+        if (n == 0 || n >= cap)
+            return false;
+        memcpy(dst, s, n);
+        dst[n] = '\0';
+        return true;
+    }
+
+    /**
+     * @brief Recursive descent over one condition, emitting postfix bytecode
+     *
+     *     expr    := and ('||' and)*
+     *     and     := unary ('&&' unary)*
+     *     unary   := '!' unary | compare
+     *     compare := operand (('<' | '<=' | '>' | '>=' | '==' | '!=') operand)?
+     *     operand := number | input | probe '.' field ('.' field)* | '(' expr ')'
+     */
+    struct Compiler
+    {
+        RuleProgram &p;
+        const char *s;
+        const char *error = nullptr;
+        uint8_t ops = 0;
+        uint8_t depth = 0;
+        uint8_t valueRef = 0xFF; ///< First input or signal operand
+
+        Compiler(RuleProgram &p, const char *s) : p(p), s(s) {}
+
+        void skip()
+        {
+            while (*s == ' ' || *s == '\t')
+                ++s;
+        }
+
+        bool fail(const char *what)
+        {
+            if (!error)
+                error = what;
+            return false;
+        }
+
+        bool emit(RuleOp op, int push)
+        {
+            if (p.codeLen >= RULES_CODE_MAX)
+                return fail("rule set too large (RULES_CODE_MAX)");
+            if (++ops > RULES_RULE_OPS)
+                return fail("condition too long (RULES_RULE_OPS)");
+            depth = uint8_t(depth + push);
+            if (depth > RULES_STACK)
+                return fail("condition nested too deep (RULES_STACK)");
+            p.code[p.codeLen++] = uint8_t(op);
+            return true;
+        }
+
+        bool operand8(uint8_t v)
+        {
+            if (p.codeLen >= RULES_CODE_MAX)
+                return fail("rule set too large (RULES_CODE_MAX)");
+            p.code[p.codeLen++] = v;
+            return true;
+        }
+
+        bool constant(float v)
+        {
+            if (!emit(RuleOp::Const, 1))
+                return false;
+            if (p.codeLen + 4 > RULES_CODE_MAX)
+                return fail("rule set too large (RULES_CODE_MAX)");
+            memcpy(p.code + p.codeLen, &v, 4);
+            p.codeLen += 4;
+            return true;
+        }
+
+        /** @brief Whole condition: an expression and nothing after it */
+        bool condition()
+        {
+            if (!expr())
+                return false;
+            skip();
+            if (*s != '\0')
+                return fail("unexpected text in condition");
+            return emit(RuleOp::End, 0);
+        }
+
+        bool expr()
+        {
+            if (!conj())
+                return false;
+            for (skip(); s[0] == '|' && s[1] == '|'; skip())
+            {
+                s += 2;
+                if (!conj() || !emit(RuleOp::Or, -1))
+                    return false;
+            }
+            return true;
+        }
+
+        bool conj()
+        {
+            if (!unary())
+                return false;
+            for (skip(); s[0] == '&' && s[1] == '&'; skip())
+            {
+                s += 2;
+                if (!unary() || !emit(RuleOp::And, -1))
+                    return false;
+            }
+            return true;
+        }
+
+        bool unary()
+        {
+            skip();
+            if (*s == '!' && s[1] != '=')
+            {
+                ++s;
+                return unary() && emit(RuleOp::Not, 0);
+            }
+            return compare();
+        }
+
+        bool compare()
+        {
+            if (!operand())
+                return false;
+            skip();
+            RuleOp op;
+            if (s[0] == '<' && s[1] == '=')
+                op = RuleOp::Le;
+            else if (s[0] == '>' && s[1] == '=')
+                op = RuleOp::Ge;
+            else if (s[0] == '=' && s[1] == '=')
+                op = RuleOp::Eq;
+            else if (s[0] == '!' && s[1] == '=')
+                op = RuleOp::Ne;
+            else if (s[0] == '<')
+                op = RuleOp::Lt;
+            else if (s[0] == '>')
+                op = RuleOp::Gt;
+            else
+                return true;
+            s += (op == RuleOp::Lt || op == RuleOp::Gt) ? 1 : 2;
+            return operand() && emit(op, -1);
+        }
+
+        bool operand()
+        {
+            skip();
+            if (*s == '(')
+            {
+                ++s;
+                if (!expr())
+                    return false;
+                skip();
+                if (*s != ')')
+                    return fail("missing ')'");
+                ++s;
+                return true;
+            }
+            if ((*s >= '0' && *s <= '9') || *s == '-' || *s == '.')
+            {
+                char *end;
+                float v = strtof(s, &end);
+                if (end == s)
+                    return fail("bad number");
+                s = end;
+                return constant(v);
+            }
+            if (!isNameStart(*s))
+                return fail("expected a name, number or '('");
+
+            const char *name = s;
+            while (isNameChar(*s))
+                ++s;
+            size_t nameLen = size_t(s - name);
+            if (*s != '.')
+            {
+                for (uint8_t i = 0; i < p.inputCount; ++i)
+                {
+                    if (strlen(p.inputs[i].name) == nameLen && strncmp(p.inputs[i].name, name, nameLen) == 0)
+                    {
+                        if (valueRef == 0xFF)
+                            valueRef = uint8_t(0x80 | i);
+                        return emit(RuleOp::Input, 1) && operand8(i);
+                    }
+                }
+                return fail("unknown input (probe values are written probe.field)");
+            }
+
+            // probe.field(.field)*
+            const char *path = ++s;
+            while (isNameChar(*s) || (*s == '.' && isNameChar(s[1])))
+                ++s;
+            RuleSignal sig;
+            if (!copyName(sig.probe, sizeof(sig.probe), name, nameLen) ||
+                !copyName(sig.path, sizeof(sig.path), path, size_t(s - path)))
+                return fail("probe name or field path too long");
+            uint8_t i = 0;
+            while (i < p.signalCount && (strcmp(p.signals[i].probe, sig.probe) != 0 || strcmp(p.signals[i].path, sig.path) != 0))
+                ++i;
+            if (i == p.signalCount)
+            {
+                if (p.signalCount == RULES_SIGNALS)
+                    return fail("too many probe values (RULES_SIGNALS)");
+                p.signals[p.signalCount++] = sig;
+            }
+            if (valueRef == 0xFF)
+                valueRef = i;
+            return emit(RuleOp::Signal, 1) && operand8(i);
+        }
+    };
+
+    /**
+     * @brief All-clear of "signal CMP constant" with the threshold moved by @p h
+     *
+     * `x < 10` with hysteresis 2 clears on `x >= 12`; `x > 10` clears on `x <= 8`.
+     */
+    bool hysteresisClear(RuleProgram &p, uint16_t trip, float h, const char *&error)
+    {
+        const uint8_t *c = p.code + trip;
+        if (p.codeLen - trip != 9 || RuleOp(c[0]) != RuleOp::Signal || RuleOp(c[2]) != RuleOp::Const || RuleOp(c[8]) != RuleOp::End)
+        {
+            error = "hysteresis needs a condition like 'probe.field < number'";
+            return false;
+        }
+        float threshold;
+        memcpy(&threshold, c + 3, 4);
+        RuleOp op = RuleOp(c[7]);
+        RuleOp inverse;
+        switch (op)
+        {
+        case RuleOp::Lt:
+            inverse = RuleOp::Ge;
+            threshold += h;
+            break;
+        case RuleOp::Le:
+            inverse = RuleOp::Gt;
+            threshold += h;
+            break;
+        case RuleOp::Gt:
+            inverse = RuleOp::Le;
+            threshold -= h;
+            break;
+        case RuleOp::Ge:
+            inverse = RuleOp::Lt;
+            threshold -= h;
+            break;
+        default:
+            error = "hysteresis needs <, <=, > or >=";
+            return false;
+        }
+        if (p.codeLen + 9 > RULES_CODE_MAX)
+        {
+            error = "rule set too large (RULES_CODE_MAX)";
+            return false;
+        }
+        uint8_t *out = p.code + p.codeLen;
+        out[0] = uint8_t(RuleOp::Signal);
+        out[1] = c[1];
+        out[2] = uint8_t(RuleOp::Const);
+        memcpy(out + 3, &threshold, 4);
+        out[7] = uint8_t(inverse);
+        out[8] = uint8_t(RuleOp::End);
+        p.codeLen += 9;
+        return true;
+    }
+
+    bool refuse(String &error, const String &why)
+    {
+        error = why;
+        return false;
+    }
+
+    bool addText(RuleProgram &p, const char *text, uint16_t &offset)
+    {
+        size_t n = strlen(text) + 1;
+        if (p.textLen + n > RULES_TEXT_MAX)
+            return false;
+        offset = p.textLen;
+        memcpy(p.texts + p.textLen, text, n);
+        p.textLen += uint16_t(n);
+        return true;
+    }
+
+    bool compileInputs(JsonObjectConst inputs, RuleProgram &p, String &error)
+    {
+        for (JsonPairConst kv : inputs)
+        {
+            String where = String("inputs.") + kv.key().c_str() + ": ";
+            if (p.inputCount == RULES_INPUTS)
+                return refuse(error, where + "too many inputs (RULES_INPUTS)");
+            RuleInput &in = p.inputs[p.inputCount];
+            const char *name = kv.key().c_str();
+            size_t n = strlen(name);
+            bool valid = isNameStart(name[0]);
+            for (size_t i = 1; i < n; ++i)
+                valid = valid && isNameChar(name[i]);
+            if (!valid || !copyName(in.name, sizeof(in.name), name, n))
+                return refuse(error, where + "names are letters, digits and '_', up to 15");
+            JsonObjectConst spec = kv.value().as<JsonObjectConst>();
+            if (!spec["pin"].is<uint8_t>())
+                return refuse(error, where + "pin required");
+            in.pin = spec["pin"].as<uint8_t>();
+            if (in.pin > 39 || (in.pin >= 28 && in.pin <= 31) || (uint64_t(RULES_RESERVED_PINS) >> in.pin) & 1)
+                return refuse(error, where + "pin not available");
+            const char *pull = spec["pull"] | "none";
+            if (strcmp(pull, "up") == 0)
+                in.mode = INPUT_PULLUP;
+            else if (strcmp(pull, "down") == 0)
+                in.mode = INPUT_PULLDOWN;
+            else if (strcmp(pull, "none") == 0)
+                in.mode = INPUT;
+            else
+                return refuse(error, where + "pull is up, down or none");
+            if (in.mode != INPUT && in.pin >= 34)
+                return refuse(error, where + "GPIO 34-39 have no pull resistors");
+            in.activeLow = spec["activeLow"] | false;
+            uint32_t debounce = spec["debounceMs"] | 50u;
+            if (debounce > 60000)
+                return refuse(error, where + "debounceMs is 0..60000");
+            in.debounceMs = uint16_t(debounce);
+            for (uint8_t i = 0; i < p.inputCount; ++i)
+                if (p.inputs[i].pin == in.pin)
+                    return refuse(error, where + "pin already used by " + p.inputs[i].name);
+            p.inputCount++;
+        }
+        return true;
+    }
+
+    bool compileRule(JsonObjectConst src, uint8_t index, RuleProgram &p, String &error)
+    {
+        Rule &r = p.rules[index];
+        String where = String("rules[") + index + "]";
+        const char *name = src["name"] | "";
+        if (!copyName(r.name, sizeof(r.name), name, strlen(name)))
+            return refuse(error, where + ": name required, up to 15 characters");
+        where = String("rules.") + name;
+        for (uint8_t i = 0; i < index; ++i)
+            if (strcmp(p.rules[i].name, r.name) == 0)
+                return refuse(error, where + ": duplicate name");
+
+        const char *when = src["when"] | "";
+        r.trip = p.codeLen;
+        Compiler trip(p, when);
+        if (!trip.condition())
+            return refuse(error, where + ".when: " + trip.error);
+        r.valueRef = trip.valueRef;
+        uint8_t cost = trip.ops;
+
+        r.clear = p.codeLen;
+        if (src["clear"].is<const char *>())
+        {
+            if (src["hysteresis"].is<float>())
+                return refuse(error, where + ": give clear or hysteresis, not both");
+            Compiler clear(p, src["clear"].as<const char *>());
+            if (!clear.condition())
+                return refuse(error, where + ".clear: " + clear.error);
+            cost = max(cost, clear.ops);
+        }
+        else if (src["hysteresis"].is<float>())
+        {
+            const char *e = nullptr;
+            if (!hysteresisClear(p, r.trip, src["hysteresis"].as<float>(), e))
+                return refuse(error, where + ".hysteresis: " + e);
+        }
+        else
+        {
+            // Not(alarm): the alarm program without its End
+            uint16_t len = uint16_t(r.clear - r.trip);
+            if (p.codeLen + len + 1 > RULES_CODE_MAX || trip.ops + 1 > RULES_RULE_OPS)
+                return refuse(error, where + ".when: too long to negate");
+            memcpy(p.code + p.codeLen, p.code + r.trip, len - 1);
+            p.codeLen += len - 1;
+            p.code[p.codeLen++] = uint8_t(RuleOp::Not);
+            p.code[p.codeLen++] = uint8_t(RuleOp::End);
+            cost = uint8_t(trip.ops + 1);
+        }
+        r.cost = cost;
+
+        r.forMs = src["forMs"] | 0u;
+        r.repeatMs = src["repeatMs"] | 0u;
+        if (r.repeatMs != 0 && r.repeatMs < 60000)
+            return refuse(error, where + ": repeatMs is 0 or at least 60000");
+        r.onClear = src["onClear"] | false;
+        const char *priority = src["priority"] | "high";
+        if (strcmp(priority, "high") == 0)
+            r.priority = JobPriority::High;
+        else if (strcmp(priority, "normal") == 0)
+            r.priority = JobPriority::Normal;
+        else if (strcmp(priority, "low") == 0)
+            r.priority = JobPriority::Low;
+        else
+            return refuse(error, where + ": priority is low, normal or high");
+
+        r.toCount = 0;
+        JsonArrayConst list = src["to"].as<JsonArrayConst>();
+        if (src["to"].is<const char *>())
+        {
+            if (!r.to[0].parse(src["to"].as<const char *>()))
+                return refuse(error, where + ".to: invalid phone number");
+            r.toCount = 1;
+        }
+        for (JsonVariantConst v : list)
+        {
+            if (r.toCount == RULES_RECIPIENTS)
+                return refuse(error, where + ".to: too many numbers (RULES_RECIPIENTS)");
+            if (!r.to[r.toCount].parse(v.as<const char *>()))
+                return refuse(error, where + ".to: invalid phone number");
+            r.toCount++;
+        }
+        if (r.toCount == 0)
+            return refuse(error, where + ".to: destination number required");
+
+        const char *text = src["text"] | "";
+        const char *templateName = src["template"] | "";
+        r.isTemplate = *templateName != '\0';
+        if (r.isTemplate)
+        {
+            String body;
+            if (*text)
+                return refuse(error, where + ": give text or template, not both");
+            if (!Provisioner::instance().findTemplate(templateName, body))
+                return refuse(error, where + ".template: unknown template");
+            text = templateName;
+        }
+        else if (!*text)
+            text = "{device}: {rule} {state}";
+        if (!addText(p, text, r.text))
+            return refuse(error, where + ": texts too long (RULES_TEXT_MAX)");
+        return true;
+    }
+}
+
+bool RuleProgram::compile(JsonObjectConst src, RuleProgram &out, String &error)
+{
+    out.inputCount = 0;
+    out.signalCount = 0;
+    out.ruleCount = 0;
+    out.codeLen = 0;
+    out.textLen = 0;
+    if (!compileInputs(src["inputs"].as<JsonObjectConst>(), out, error))
+        return false;
+    JsonArrayConst rules = src["rules"].as<JsonArrayConst>();
+    if (rules.size() > RULES_MAX)
+        return refuse(error, "rules: too many rules (RULES_MAX)");
+    for (JsonObjectConst rule : rules)
+    {
+        if (!compileRule(rule, out.ruleCount, out, error))
+            return false;
+        out.ruleCount++;
+    }
+    return true;
+}
+
+RuleResult RuleProgram::run(uint16_t at, const RuleValues &values, uint16_t &ops) const
+{
+    float stack[RULES_STACK];
+    uint8_t sp = 0;
+    bool unknown = false;
+    const uint8_t *pc = code + at;
+    for (;;)
+    {
+        RuleOp op = RuleOp(*pc++);
+        ops++;
+        switch (op)
+        {
+        case RuleOp::End:
+            if (unknown)
+                return RuleResult::Unknown;
+            return stack[sp - 1] != 0.0f ? RuleResult::True : RuleResult::False;
+        case RuleOp::Input:
+            stack[sp++] = values.inputs[*pc++];
+            break;
+        case RuleOp::Signal:
+            unknown = unknown || !values.valid[*pc];
+            stack[sp++] = values.signals[*pc++];
+            break;
+        case RuleOp::Const:
+            memcpy(&stack[sp++], pc, 4);
+            pc += 4;
+            break;
+        case RuleOp::Not:
+            stack[sp - 1] = stack[sp - 1] == 0.0f ? 1.0f : 0.0f;
+            break;
+        default:
+        {
+            float b = stack[--sp];
+            float a = stack[sp - 1];
+            bool r = false;
+            switch (op)
+            {
+            case RuleOp::Lt:
+                r = a < b;
+                break;
+            case RuleOp::Le:
+                r = a <= b;
+                break;
+            case RuleOp::Gt:
+                r = a > b;
+                break;
+            case RuleOp::Ge:
+                r = a >= b;
+                break;
+            case RuleOp::Eq:
+                r = a == b;
+                break;
+            case RuleOp::Ne:
+                r = a != b;
+                break;
+            case RuleOp::And:
+                r = a != 0.0f && b != 0.0f;
+                break;
+            case RuleOp::Or:
+                r = a != 0.0f || b != 0.0f;
+                break;
+            default:
+                break;
+            }
+            stack[sp - 1] = r ? 1.0f : 0.0f;
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,221 @@
+/**
+ * @file RuleProgram.hpp
+ * @brief Alarm rules compiled from JSON into a compact bytecode, and its interpreter
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "PhoneNumber.hpp"
+#include "SmsJob.hpp"
+
+// ====== Tuning ======
+/**
+ * @def RULES_MAX
+ * @brief Rules in one rule set
+ */
+#ifndef RULES_MAX
+#define RULES_MAX 16
+#endif
+
+/**
+ * @def RULES_INPUTS
+ * @brief Debounced GPIO inputs in one rule set
+ */
+#ifndef RULES_INPUTS
+#define RULES_INPUTS 8
+#endif
+
+/**
+ * @def RULES_SIGNALS
+ * @brief Distinct probe values (probe name and path) read by one rule set
+ */
+#ifndef RULES_SIGNALS
+#define RULES_SIGNALS 8
+#endif
+
+/**
+ * @def RULES_RECIPIENTS
+ * @brief Destination numbers per rule
+ */
+#ifndef RULES_RECIPIENTS
+#define RULES_RECIPIENTS 3
+#endif
+
+/**
+ * @def RULES_CODE_MAX
+ * @brief Bytecode of all rules
+ */
+#ifndef RULES_CODE_MAX
+#define RULES_CODE_MAX 512
+#endif
+
+/**
+ * @def RULES_TEXT_MAX
+ * @brief Message texts and template names of all rules
+ */
+#ifndef RULES_TEXT_MAX
+#define RULES_TEXT_MAX 768
+#endif
+
+/**
+ * @def RULES_RULE_OPS
+ * @brief Most instructions one condition may execute (bounds the cost of a rule)
+ */
+#ifndef RULES_RULE_OPS
+#define RULES_RULE_OPS 24
+#endif
+
+/**
+ * @def RULES_STACK
+ * @brief Interpreter stack depth; deeper expressions are refused when compiled
+ */
+#ifndef RULES_STACK
+#define RULES_STACK 8
+#endif
+
+/**
+ * @def RULES_RESERVED_PINS
+ * @brief GPIOs rules may not use: flash and PSRAM, UART0, strapping, modem, LED and SD card
+ */
+#ifndef RULES_RESERVED_PINS
+#define RULES_RESERVED_PINS                                                                   \
+    ((1ULL << 0) | (1ULL << 1) | (1ULL << 2) | (1ULL << 3) | (1ULL << 4) | (1ULL << 5) |      \
+     (0x3FULL << 6) | (1ULL << 12) | (1ULL << 13) | (1ULL << 14) | (1ULL << 15) |             \
+     (1ULL << 16) | (1ULL << 17) | (1ULL << 23) | (1ULL << 26) | (1ULL << 27) | (1ULL << 32) | \
+     (1ULL << 33))
+#endif
+
+static constexpr size_t RULES_NAME_MAX = 16; ///< Rule, input and probe names, with NUL
+static constexpr size_t RULES_PATH_MAX = 32; ///< Field path inside a probe, with NUL
+
+/**
+ * @brief Interpreter instructions; operands follow the opcode byte
+ */
+enum class RuleOp : uint8_t
+{
+    End = 0, ///< Result: top of stack != 0
+    Input,   ///< u8 input index: push its debounced state (1 active)
+    Signal,  ///< u8 signal index: push the last sampled probe value
+    Const,   ///< f32 little-endian: push
+    Lt,
+    Le,
+    Gt,
+    Ge,
+    Eq,
+    Ne,
+    And,
+    Or,
+    Not,
+};
+
+enum class RuleResult : uint8_t
+{
+    False,
+    True,
+    Unknown, ///< A probe value is not sampled (yet): the rule keeps its state
+};
+
+/**
+ * @brief GPIO input as declared in the rule set
+ */
+struct RuleInput
+{
+    char name[RULES_NAME_MAX];
+    uint8_t pin;
+    uint8_t mode;       ///< INPUT, INPUT_PULLUP or INPUT_PULLDOWN
+    bool activeLow;     ///< Active (1) when the pin reads LOW
+    uint16_t debounceMs; ///< Level must be stable this long
+};
+
+/**
+ * @brief Numeric field of a probe, e.g. "modem.rssi"
+ */
+struct RuleSignal
+{
+    char probe[RULES_NAME_MAX];
+    char path[RULES_PATH_MAX]; ///< Dotted path below the probe object
+};
+
+/**
+ * @brief One compiled rule
+ */
+struct Rule
+{
+    char name[RULES_NAME_MAX];
+    uint16_t trip;      ///< Code offset of the alarm condition
+    uint16_t clear;     ///< Code offset of the all-clear condition
+    uint8_t cost;       ///< Instructions of the longer condition
+    uint8_t valueRef;   ///< {value}: signal index, 0x80 | input index, or 0xFF
+    uint32_t forMs;     ///< Condition must hold this long before the alarm
+    uint32_t repeatMs;  ///< Repeat the alarm SMS while active (0: once)
+    bool onClear;       ///< Also send an SMS when the alarm clears
+    bool isTemplate;    ///< text is a provisioned template name
+    JobPriority priority;
+    uint16_t text;      ///< Offset in texts
+    uint8_t toCount;
+    PhoneNumber to[RULES_RECIPIENTS];
+};
+
+/**
+ * @brief Current operand values the bytecode reads
+ */
+struct RuleValues
+{
+    uint8_t inputs[RULES_INPUTS] = {};
+    float signals[RULES_SIGNALS] = {};
+    bool valid[RULES_SIGNALS] = {};
+};
+
+/**
+ * @brief A compiled rule set: inputs, probe signals, rules, bytecode and texts
+ *
+ * Source (JSON):
+ * ```
+ * {"inputs": {"door": {"pin": 25, "pull": "up", "activeLow": true, "debounceMs": 50}},
+ *  "rules": [{"name": "door", "when": "door", "to": "+40712345678", "template": "door_open", "onClear": true},
+ *            {"name": "signal", "when": "modem.rssi < 8", "hysteresis": 4, "forMs": 60000,
+ *             "to": ["+40712345678"], "text": "{device}: weak signal ({value})", "repeatMs": 3600000}]}
+ * ```
+ * Conditions are expressions over input names, `probe.field` paths and
+ * numbers with `< <= > >= == != && || !` and parentheses. The all-clear
+ * condition is "clear" if given, the alarm condition with "hysteresis"
+ * applied to its threshold (single comparisons only), or else its negation.
+ *
+ * compile() checks everything the interpreter relies on (indices, stack
+ * depth, instruction count), so run() does no checks of its own. Every
+ * condition is a straight-line program of at most RULES_RULE_OPS
+ * instructions, which bounds the cost of evaluating a rule.
+ */
+class RuleProgram
+{
+public:
+    RuleInput inputs[RULES_INPUTS];
+    uint8_t inputCount = 0;
+    RuleSignal signals[RULES_SIGNALS];
+    uint8_t signalCount = 0;
+    Rule rules[RULES_MAX];
+    uint8_t ruleCount = 0;
+    uint8_t code[RULES_CODE_MAX];
+    uint16_t codeLen = 0;
+    char texts[RULES_TEXT_MAX];
+    uint16_t textLen = 0;
+
+    /**
+     * @brief Compile a rule set
+     *
+     * @param error Set to "<where>: <what>" when refused; @p out is then unusable
+     */
+    static bool compile(JsonObjectConst src, RuleProgram &out, String &error);
+
+    /**
+     * @brief Evaluate the condition at @p at
+     *
+     * @param ops Incremented by the instructions executed
+     */
+    RuleResult run(uint16_t at, const RuleValues &values, uint16_t &ops) const;
+
+    /** @brief Text (or template name) of @p rule */
+    const char *textOf(const Rule &rule) const { return texts + rule.text; }
+};
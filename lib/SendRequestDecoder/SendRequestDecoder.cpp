@@ -0,0 +1,459 @@
+#include "SendRequestDecoder.hpp"
+#include "ProfileZone.hpp"
+#include "SendWindow.hpp"
+#include <string.h>
+
+namespace
+{
+    /**
+     * @brief Read position inside the request body
+     */
+    struct Cursor
+    {
+        const char *p;
+        const char *end;
+
+        bool atEnd() const { return p >= end; }
+        char peek() const { return p < end ? *p : '\0'; }
+    };
+
+    void skipWs(Cursor &c)
+    {
+        while (c.p < c.end && (*c.p == ' ' || *c.p == '\t' || *c.p == '\n' || *c.p == '\r'))
+            ++c.p;
+    }
+
+    int hexVal(char ch)
+    {
+        if (ch >= '0' && ch <= '9')
+            return ch - '0';
+        if (ch >= 'a' && ch <= 'f')
+            return ch - 'a' + 10;
+        if (ch >= 'A' && ch <= 'F')
+            return ch - 'A' + 10;
+        return -1;
+    }
+
+    bool readHex4(Cursor &c, uint32_t &out)
+    {
+        if (c.end - c.p < 4)
+            return false;
+        out = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            int v = hexVal(c.p[i]);
+            if (v < 0)
+                return false;
+            out = (out << 4) | uint32_t(v);
+        }
+        c.p += 4;
+        return true;
+    }
+
+    /**
+     * @brief Append bytes to a bounded output, tracking the full length
+     */
+    struct Sink
+    {
+        char *dst;
+        size_t cap;
+        size_t len = 0;
+
+        void put(char ch)
+        {
+            if (dst && len < cap)
+                dst[len] = ch;
+            ++len;
+        }
+        bool overflowed() const { return len > cap; }
+    };
+
+    void putUtf8(Sink &s, uint32_t cp)
+    {
+        if (cp < 0x80)
+        {
+            s.put(char(cp));
+        }
+        else if (cp < 0x800)
+        {
+            s.put(char(0xC0 | (cp >> 6)));
+            s.put(char(0x80 | (cp & 0x3F)));
+        }
+        else if (cp < 0x10000)
+        {
+            s.put(char(0xE0 | (cp >> 12)));
+            s.put(char(0x80 | ((cp >> 6) & 0x3F)));
+            s.put(char(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            s.put(char(0xF0 | (cp >> 18)));
+            s.put(char(0x80 | ((cp >> 12) & 0x3F)));
+            s.put(char(0x80 | ((cp >> 6) & 0x3F)));
+            s.put(char(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    /**
+     * @brief Parse a JSON string at the cursor, unescaping into the sink
+     *
+     * The cursor must be on the opening quote. A null sink destination only
+     * validates and measures the string (used for keys and skipped values).
+     */
+    bool readString(Cursor &c, Sink &s)
+    {
+        if (c.peek() != '"')
+            return false;
+        ++c.p;
+        while (c.p < c.end)
+        {
+            char ch = *c.p++;
+            if (ch == '"')
+                return true;
+            if ((unsigned char)ch < 0x20)
+                return false;
+            if (ch != '\\')
+            {
+                s.put(ch);
+                continue;
+            }
+            if (c.atEnd())
+                return false;
+            char e = *c.p++;
+            switch (e)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                s.put(e);
+                break;
+            case 'b':
+                s.put('\b');
+                break;
+            case 'f':
+                s.put('\f');
+                break;
+            case 'n':
+                s.put('\n');
+                break;
+            case 'r':
+                s.put('\r');
+                break;
+            case 't':
+                s.put('\t');
+                break;
+            case 'u':
+            {
+                uint32_t cp;
+                if (!readHex4(c, cp))
+                    return false;
+                if (cp >= 0xD800 && cp <= 0xDBFF)
+                {
+                    uint32_t lo;
+                    if (c.end - c.p < 6 || c.p[0] != '\\' || c.p[1] != 'u')
+                        return false;
+                    c.p += 2;
+                    if (!readHex4(c, lo) || lo < 0xDC00 || lo > 0xDFFF)
+                        return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                else if ((cp >= 0xDC00 && cp <= 0xDFFF) || cp == 0)
+                {
+                    // Lone low surrogate; or NUL, which would cut the body short for strlen() readers
+                    return false;
+                }
+                putUtf8(s, cp);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+
+    bool skipLiteral(Cursor &c, const char *lit)
+    {
+        size_t n = strlen(lit);
+        if (size_t(c.end - c.p) < n || memcmp(c.p, lit, n) != 0)
+            return false;
+        c.p += n;
+        return true;
+    }
+
+    bool skipNumber(Cursor &c)
+    {
+        const char *start = c.p;
+        if (c.peek() == '-')
+            ++c.p;
+        if (!(c.peek() >= '0' && c.peek() <= '9'))
+            return false;
+        while (c.peek() >= '0' && c.peek() <= '9')
+            ++c.p;
+        if (c.peek() == '.')
+        {
+            ++c.p;
+            if (!(c.peek() >= '0' && c.peek() <= '9'))
+                return false;
+            while (c.peek() >= '0' && c.peek() <= '9')
+                ++c.p;
+        }
+        if (c.peek() == 'e' || c.peek() == 'E')
+        {
+            ++c.p;
+            if (c.peek() == '+' || c.peek() == '-')
+                ++c.p;
+            if (!(c.peek() >= '0' && c.peek() <= '9'))
+                return false;
+            while (c.peek() >= '0' && c.peek() <= '9')
+                ++c.p;
+        }
+        return c.p > start;
+    }
+
+    /**
+     * @brief Structurally skip any JSON value without materializing it
+     */
+    bool skipValue(Cursor &c, int depth)
+    {
+        if (depth > SEND_DECODER_MAX_DEPTH)
+            return false;
+        skipWs(c);
+        char ch = c.peek();
+        if (ch == '"')
+        {
+            Sink none{nullptr, 0};
+            return readString(c, none);
+        }
+        if (ch == '{' || ch == '[')
+        {
+            const char close = (ch == '{') ? '}' : ']';
+            ++c.p;
+            skipWs(c);
+            if (c.peek() == close)
+            {
+                ++c.p;
+                return true;
+            }
+            while (true)
+            {
+                if (close == '}')
+                {
+                    skipWs(c);
+                    Sink none{nullptr, 0};
+                    if (!readString(c, none))
+                        return false;
+                    skipWs(c);
+                    if (c.peek() != ':')
+                        return false;
+                    ++c.p;
+                }
+                if (!skipValue(c, depth + 1))
+                    return false;
+                skipWs(c);
+                if (c.peek() == ',')
+                {
+                    ++c.p;
+                    continue;
+                }
+                if (c.peek() == close)
+                {
+                    ++c.p;
+                    return true;
+                }
+                return false;
+            }
+        }
+        if (ch == 't')
+            return skipLiteral(c, "true");
+        if (ch == 'f')
+            return skipLiteral(c, "false");
+        if (ch == 'n')
+            return skipLiteral(c, "null");
+        return skipNumber(c);
+    }
+
+    enum class Field : uint8_t
+    {
+        Unknown,
+        Phone,
+        Message,
+        Priority,
+        Window,
+    };
+
+    /**
+     * @brief Match a key against the send schema
+     *
+     * Keys are compared in their raw (escaped) form; schema keys never need
+     * escaping, so an escaped key can only ever be an unknown one.
+     */
+    Field matchKey(const char *k, size_t n)
+    {
+        if (n == 5 && memcmp(k, "phone", 5) == 0)
+            return Field::Phone;
+        if (n == 7 && memcmp(k, "message", 7) == 0)
+            return Field::Message;
+        if (n == 8 && memcmp(k, "priority", 8) == 0)
+            return Field::Priority;
+        if (n == 6 && memcmp(k, "window", 6) == 0)
+            return Field::Window;
+        return Field::Unknown;
+    }
+}
+
+/**
+ * @brief Decode a `/send` body in a single pass into a job record
+ *
+ * Field errors are remembered while the rest of the document is still
+ * validated, so a malformed body is always reported as InvalidJson first.
+ */
+DecodeStatus SendRequestDecoder::decode(const char *json, size_t len, SmsJob &job)
+{
+    PROFILE_ZONE("json.decode");
+    job.resetRequest();
+    if (json == nullptr)
+        return DecodeStatus::InvalidJson;
+
+    Cursor c{json, json + len};
+    bool phoneOk = false;
+    bool messageOk = false;
+    bool optionOk = true;
+    bool windowOk = true;
+
+    skipWs(c);
+    if (c.peek() != '{')
+        return DecodeStatus::InvalidJson;
+    ++c.p;
+    skipWs(c);
+    if (c.peek() == '}')
+    {
+        ++c.p;
+    }
+    else
+    {
+        while (true)
+        {
+            skipWs(c);
+            if (c.peek() != '"')
+                return DecodeStatus::InvalidJson;
+            const char *keyStart = c.p + 1;
+            Sink none{nullptr, 0};
+            if (!readString(c, none))
+                return DecodeStatus::InvalidJson;
+            Field field = matchKey(keyStart, size_t(c.p - 1 - keyStart));
+            skipWs(c);
+            if (c.peek() != ':')
+                return DecodeStatus::InvalidJson;
+            ++c.p;
+            skipWs(c);
+
+            if (field == Field::Unknown || c.peek() != '"')
+            {
+                // Unknown key, or a known key with a non-string value
+                if (field == Field::Phone)
+                    phoneOk = false;
+                else if (field == Field::Message)
+                    messageOk = false;
+                else if (field == Field::Priority)
+                    optionOk = false;
+                else if (field == Field::Window)
+                    windowOk = false;
+                if (!skipValue(c, 1))
+                    return DecodeStatus::InvalidJson;
+            }
+            else if (field == Field::Phone)
+            {
+                char buf[PhoneNumber::MAX_CHARS + 1];
+                Sink s{buf, PhoneNumber::MAX_CHARS};
+                if (!readString(c, s))
+                    return DecodeStatus::InvalidJson;
+                phoneOk = !s.overflowed() && job.to.parse(buf, s.len);
+            }
+            else if (field == Field::Message)
+            {
+                Sink s{job.body, JOB_BODY_MAX};
+                if (!readString(c, s))
+                    return DecodeStatus::InvalidJson;
+                messageOk = s.len >= 1 && !s.overflowed();
+                job.bodyLen = uint16_t(messageOk ? s.len : 0);
+                if (job.body)
+                    job.body[job.bodyLen] = '\0';
+            }
+            else if (field == Field::Window)
+            {
+                char buf[12];
+                Sink s{buf, sizeof(buf)};
+                if (!readString(c, s))
+                    return DecodeStatus::InvalidJson;
+                windowOk = !s.overflowed() && SendWindow::parse(buf, s.len, job.windowStart, job.windowEnd);
+                if (!windowOk)
+                    job.windowStart = SendWindow::NONE;
+            }
+            else // Field::Priority
+            {
+                char buf[8];
+                Sink s{buf, sizeof(buf)};
+                if (!readString(c, s))
+                    return DecodeStatus::InvalidJson;
+                if (s.len == 3 && memcmp(buf, "low", 3) == 0)
+                    job.priority = JobPriority::Low;
+                else if (s.len == 6 && memcmp(buf, "normal", 6) == 0)
+                    job.priority = JobPriority::Normal;
+                else if (s.len == 4 && memcmp(buf, "high", 4) == 0)
+                    job.priority = JobPriority::High;
+                else
+                    optionOk = false;
+            }
+
+            skipWs(c);
+            if (c.peek() == ',')
+            {
+                ++c.p;
+                continue;
+            }
+            if (c.peek() == '}')
+            {
+                ++c.p;
+                break;
+            }
+            return DecodeStatus::InvalidJson;
+        }
+    }
+    skipWs(c);
+    if (!c.atEnd())
+        return DecodeStatus::InvalidJson;
+
+    if (!phoneOk)
+        return DecodeStatus::InvalidPhone;
+    if (!messageOk)
+        return DecodeStatus::InvalidMessage;
+    if (!optionOk)
+        return DecodeStatus::InvalidOption;
+    if (!windowOk)
+        return DecodeStatus::InvalidWindow;
+    return DecodeStatus::Ok;
+}
+
+/**
+ * @brief Map a decode status to the JSON error body sent to HTTP clients
+ */
+const char *SendRequestDecoder::errorJson(DecodeStatus status)
+{
+    switch (status)
+    {
+    case DecodeStatus::Ok:
+        return "{\"status\":\"ok\"}";
+    case DecodeStatus::InvalidJson:
+        return "{\"error\":\"Invalid JSON\"}";
+    case DecodeStatus::InvalidPhone:
+        return "{\"error\":\"Invalid phone format. Use +407...\"}";
+    case DecodeStatus::InvalidMessage:
+        return "{\"error\":\"Message length 1..480 required\"}";
+    case DecodeStatus::InvalidOption:
+        return "{\"error\":\"Invalid priority. Use low, normal or high\"}";
+    case DecodeStatus::InvalidWindow:
+        return "{\"error\":\"Invalid window. Use HH:MM-HH:MM\"}";
+    }
+    return "{\"error\":\"Invalid request\"}";
+}
@@ -0,0 +1,73 @@
+/**
+ * @file SendRequestDecoder.hpp
+ * @brief Single-pass decoder for `/send` request bodies into SmsJob records
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "SmsJob.hpp"
+
+/**
+ * @def SEND_DECODER_MAX_DEPTH
+ * @brief Maximum nesting depth accepted when skipping unknown values
+ */
+#ifndef SEND_DECODER_MAX_DEPTH
+#define SEND_DECODER_MAX_DEPTH 10
+#endif
+
+/**
+ * @brief Result of decoding a send request
+ *
+ * Ordered by reporting precedence: a malformed document is reported before
+ * any field error, and phone errors before message errors.
+ */
+enum class DecodeStatus : uint8_t
+{
+    Ok = 0,         ///< Job record fully populated
+    InvalidJson,    ///< Body is not a well-formed JSON object
+    InvalidPhone,   ///< "phone" missing, not a string or not a valid number
+    InvalidMessage, ///< "message" missing, not a string, empty or too long
+    InvalidOption,  ///< An option (e.g. "priority") has an unknown value
+    InvalidWindow,  ///< "window" is not "HH:MM-HH:MM"
+};
+
+/**
+ * @brief Schema-specific JSON decoder for SMS send requests
+ *
+ * Walks the JSON text once and writes recognised fields straight into a
+ * preallocated SmsJob, without building a DOM or temporary Strings:
+ * - "phone"    (string)  -> SmsJob::to, parsed into packed form
+ * - "message"  (string)  -> SmsJob::body, unescaped into the payload slab
+ * - "priority" (string)  -> SmsJob::priority ("low" | "normal" | "high")
+ * - "window"   (string)  -> SmsJob::windowStart/windowEnd ("HH:MM-HH:MM",
+ *   recipient-local time, see SendWindow)
+ *
+ * Unknown keys are skipped structurally (nested objects/arrays included).
+ * An escaped NUL (\u0000) anywhere makes the body InvalidJson: bodies are
+ * NUL-terminated C strings further down (PDU encoding, history, logs).
+ * The decoder has no Arduino dependency so it also builds on the host;
+ * tools/decoder_bench.cpp times it against the JsonDocument path.
+ */
+class SendRequestDecoder
+{
+public:
+    /**
+     * @brief Decode a request body into a job record
+     *
+     * @param json Request body (not necessarily NUL-terminated)
+     * @param len Body length in bytes
+     * @param job Destination record (request fields are reset first)
+     * @return DecodeStatus Ok on success, otherwise the first error by precedence
+     */
+    static DecodeStatus decode(const char *json, size_t len, SmsJob &job);
+
+    /**
+     * @brief JSON error body matching a decode status (for HTTP responses)
+     *
+     * @param status Decode result
+     * @return const char* Static JSON string, e.g. {"error":"Invalid JSON"}
+     */
+    static const char *errorJson(DecodeStatus status);
+};
@@ -0,0 +1,237 @@
+#include "SendWindow.hpp"
+
+namespace
+{
+    /**
+     * @brief Country calling code to standard-time offsets
+     *
+     * Covers the destinations seen in practice; anything else falls back to
+     * the home zone.
+     */
+    struct CountryZone
+    {
+        uint16_t code;
+        int16_t minOffset;
+        int16_t maxOffset;
+        DstRule dst;
+    };
+
+    const CountryZone ZONES[] = {
+        {1, -600, -300, DstRule::NorthAmerica}, // US, CA (Hawaii..Eastern)
+        {7, 120, 720, DstRule::None},           // RU, KZ
+        {20, 120, 120, DstRule::None},          // EG
+        {27, 120, 120, DstRule::None},          // ZA
+        {30, 120, 120, DstRule::Eu},            // GR
+        {31, 60, 60, DstRule::Eu},              // NL
+        {32, 60, 60, DstRule::Eu},              // BE
+        {33, 60, 60, DstRule::Eu},              // FR
+        {34, 0, 60, DstRule::Eu},               // ES (incl. Canary Islands)
+        {36, 60, 60, DstRule::Eu},              // HU
+        {39, 60, 60, DstRule::Eu},              // IT
+        {40, 120, 120, DstRule::Eu},            // RO
+        {41, 60, 60, DstRule::Eu},              // CH
+        {43, 60, 60, DstRule::Eu},              // AT
+        {44, 0, 0, DstRule::Eu},                // GB
+        {45, 60, 60, DstRule::Eu},              // DK
+        {46, 60, 60, DstRule::Eu},              // SE
+        {47, 60, 60, DstRule::Eu},              // NO
+        {48, 60, 60, DstRule::Eu},              // PL
+        {49, 60, 60, DstRule::Eu},              // DE
+        {52, -480, -300, DstRule::None},        // MX
+        {55, -300, -120, DstRule::None},        // BR
+        {61, 480, 600, DstRule::None},          // AU
+        {62, 420, 540, DstRule::None},          // ID
+        {63, 480, 480, DstRule::None},          // PH
+        {64, 720, 720, DstRule::None},          // NZ
+        {65, 480, 480, DstRule::None},          // SG
+        {66, 420, 420, DstRule::None},          // TH
+        {81, 540, 540, DstRule::None},          // JP
+        {82, 540, 540, DstRule::None},          // KR
+        {86, 480, 480, DstRule::None},          // CN
+        {90, 180, 180, DstRule::None},          // TR
+        {91, 330, 330, DstRule::None},          // IN
+        {351, 0, 0, DstRule::Eu},               // PT
+        {353, 0, 0, DstRule::Eu},               // IE
+        {358, 120, 120, DstRule::Eu},           // FI
+        {359, 120, 120, DstRule::Eu},           // BG
+        {370, 120, 120, DstRule::Eu},           // LT
+        {371, 120, 120, DstRule::Eu},           // LV
+        {372, 120, 120, DstRule::Eu},           // EE
+        {373, 120, 120, DstRule::Eu},           // MD
+        {380, 120, 120, DstRule::Eu},           // UA
+        {381, 60, 60, DstRule::Eu},             // RS
+        {385, 60, 60, DstRule::Eu},             // HR
+        {386, 60, 60, DstRule::Eu},             // SI
+        {420, 60, 60, DstRule::Eu},             // CZ
+        {421, 60, 60, DstRule::Eu},             // SK
+        {971, 240, 240, DstRule::None},         // AE
+        {972, 120, 120, DstRule::None},         // IL
+    };
+
+    const uint32_t DAY = 86400;
+
+    /** @return 0 = Sunday .. 6 = Saturday (1970-01-01 was a Thursday) */
+    int32_t weekday(int32_t days)
+    {
+        return (days % 7 + 11) % 7;
+    }
+
+    /** @return Civil year of a day count (inverse of daysFromCivil) */
+    int32_t yearOfDays(int32_t z)
+    {
+        z += 719468;
+        int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+        uint32_t doe = uint32_t(z - era * 146097);
+        uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        uint32_t mp = (5 * doy + 2) / 153;
+        int32_t y = int32_t(yoe) + era * 400;
+        return mp >= 10 ? y + 1 : y;
+    }
+
+    int32_t lastSunday(int32_t y, uint32_t m)
+    {
+        int32_t last = (m == 12 ? SendWindow::daysFromCivil(y + 1, 1, 1) : SendWindow::daysFromCivil(y, m + 1, 1)) - 1;
+        return last - weekday(last);
+    }
+
+    int32_t nthSunday(int32_t y, uint32_t m, int32_t n)
+    {
+        int32_t first = SendWindow::daysFromCivil(y, m, 1);
+        return first + (7 - weekday(first)) % 7 + 7 * (n - 1);
+    }
+
+    /** @return Minute of the local day at a UTC time and offset */
+    uint16_t localMinute(uint32_t utc, int16_t offset)
+    {
+        int32_t m = int32_t((utc / 60) % 1440) + offset;
+        return uint16_t(((m % 1440) + 1440) % 1440);
+    }
+
+    bool inWindow(uint16_t m, uint16_t start, uint16_t end)
+    {
+        return start < end ? (m >= start && m < end) : (m >= start || m < end);
+    }
+
+    /** @return Earliest minute boundary at or after utc when open at this offset */
+    uint32_t nextOpenAt(uint32_t utc, int16_t offset, uint16_t start, uint16_t end)
+    {
+        uint16_t m = localMinute(utc, offset);
+        if (inWindow(m, start, end))
+            return utc;
+        uint32_t wait = uint32_t((start + 1440 - m) % 1440);
+        return utc - utc % 60 + wait * 60;
+    }
+
+    bool readHhMm(const char *s, uint16_t &out)
+    {
+        for (int i = 0; i < 5; ++i)
+        {
+            if (i != 2 && (s[i] < '0' || s[i] > '9'))
+                return false;
+        }
+        if (s[2] != ':')
+            return false;
+        uint16_t h = uint16_t((s[0] - '0') * 10 + (s[1] - '0'));
+        uint16_t m = uint16_t((s[3] - '0') * 10 + (s[4] - '0'));
+        if (h > 24 || m > 59 || (h == 24 && m != 0))
+            return false;
+        out = uint16_t((h * 60 + m) % 1440);
+        return true;
+    }
+}
+
+/**
+ * @brief Parse "HH:MM-HH:MM"; "24:00" is accepted as an end of day alias
+ */
+bool SendWindow::parse(const char *s, size_t n, uint16_t &start, uint16_t &end)
+{
+    if (s == nullptr || n != 11 || s[5] != '-')
+        return false;
+    return readHhMm(s, start) && readHhMm(s + 6, end) && start != end;
+}
+
+/**
+ * @brief Longest matching country code (3, 2 then 1 digits) or the home zone
+ */
+UtcOffsetRange SendWindow::zoneFor(const PhoneNumber &to)
+{
+    if (to.isInternational())
+    {
+        for (uint8_t len = 3; len >= 1; --len)
+        {
+            if (to.digitCount() <= len)
+                continue;
+            uint16_t code = 0;
+            for (uint8_t i = 0; i < len; ++i)
+                code = uint16_t(code * 10 + (to.digitAt(i) - '0'));
+            for (const CountryZone &z : ZONES)
+            {
+                if (z.code == code)
+                    return {z.minOffset, z.maxOffset, z.dst};
+            }
+        }
+    }
+    return {WINDOW_HOME_UTC_OFFSET_MIN, WINDOW_HOME_UTC_OFFSET_MIN, DstRule(WINDOW_HOME_DST)};
+}
+
+/**
+ * @brief EU switches at 01:00 UTC; North America is taken at 02:00 Eastern
+ */
+int16_t SendWindow::dstShift(DstRule rule, uint32_t utc)
+{
+    if (rule == DstRule::None)
+        return 0;
+    int32_t y = yearOfDays(int32_t(utc / DAY));
+    uint32_t from, to;
+    if (rule == DstRule::Eu)
+    {
+        from = uint32_t(lastSunday(y, 3)) * DAY + 3600;
+        to = uint32_t(lastSunday(y, 10)) * DAY + 3600;
+    }
+    else
+    {
+        from = uint32_t(nthSunday(y, 3, 2)) * DAY + 7 * 3600;
+        to = uint32_t(nthSunday(y, 11, 1)) * DAY + 6 * 3600;
+    }
+    return (utc >= from && utc < to) ? 60 : 0;
+}
+
+/**
+ * @brief Alternate between the zone extremes until both agree on an opening
+ *
+ * Converges within two rounds when the window fits all zones of the country;
+ * otherwise the candidates keep leapfrogging and the window is reported as
+ * never open.
+ */
+uint32_t SendWindow::nextOpen(uint32_t utc, uint16_t start, uint16_t end, const PhoneNumber &to)
+{
+    UtcOffsetRange zone = zoneFor(to);
+    int16_t shift = dstShift(zone.dst, utc);
+    int16_t west = int16_t(zone.minOffset + shift);
+    int16_t east = int16_t(zone.maxOffset + shift);
+
+    uint32_t t = utc;
+    for (int round = 0; round < 4; ++round)
+    {
+        uint32_t a = nextOpenAt(t, west, start, end);
+        uint32_t b = nextOpenAt(a, east, start, end);
+        if (a == b)
+            return a;
+        t = b;
+    }
+    return 0;
+}
+
+/**
+ * @brief days_from_civil (proleptic Gregorian calendar)
+ */
+int32_t SendWindow::daysFromCivil(int32_t y, uint32_t m, uint32_t d)
+{
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = uint32_t(y - era * 400);
+    uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + int32_t(doe) - 719468;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file SendWindow.hpp
+ * @brief Recipient-local send windows (quiet hours) for campaign traffic
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "PhoneNumber.hpp"
+
+// ====== Tuning ======
+/**
+ * @def WINDOW_HOME_UTC_OFFSET_MIN
+ * @brief Standard-time UTC offset (minutes) assumed for national-format numbers
+ *
+ * Numbers without a leading '+' carry no country code; they are taken to be
+ * in the device's home zone (Romania by default).
+ */
+#ifndef WINDOW_HOME_UTC_OFFSET_MIN
+#define WINDOW_HOME_UTC_OFFSET_MIN 120
+#endif
+
+/**
+ * @def WINDOW_HOME_DST
+ * @brief Daylight saving rule of the home zone (0 = none, 1 = EU, 2 = North America)
+ */
+#ifndef WINDOW_HOME_DST
+#define WINDOW_HOME_DST 1
+#endif
+
+/**
+ * @def WINDOW_MIN_VALID_EPOCH
+ * @brief Wall clock values below this (2024-01-01) mean "time not set yet"
+ */
+#ifndef WINDOW_MIN_VALID_EPOCH
+#define WINDOW_MIN_VALID_EPOCH 1704067200UL
+#endif
+
+/**
+ * @brief Daylight saving rule applied on top of a standard-time offset
+ */
+enum class DstRule : uint8_t
+{
+    None = 0,     ///< No daylight saving
+    Eu = 1,       ///< Last Sunday of March to last Sunday of October, 01:00 UTC
+    NorthAmerica, ///< Second Sunday of March to first Sunday of November
+};
+
+/**
+ * @brief Standard-time UTC offsets spanned by a destination country
+ *
+ * Countries spanning several zones (e.g. +1, +7) report their westernmost and
+ * easternmost offsets; a window is only considered open when it is open in
+ * all of them.
+ */
+struct UtcOffsetRange
+{
+    int16_t minOffset; ///< Westernmost offset in minutes
+    int16_t maxOffset; ///< Easternmost offset in minutes
+    DstRule dst;       ///< Daylight saving rule
+};
+
+/**
+ * @brief Send window arithmetic in the recipient's local time
+ *
+ * A window is a pair of minutes-of-day [start, end) in local time; start >
+ * end wraps past midnight ("22:00-06:00"). The recipient's zone is derived
+ * from the country calling code of international numbers through a compact
+ * built-in table; unknown codes and national-format numbers use the home
+ * zone. Offsets are standard time plus the country's DST rule where known,
+ * so windows should keep a margin for countries with other DST schemes.
+ *
+ * No Arduino dependency; times are UTC seconds since the epoch.
+ */
+class SendWindow
+{
+public:
+    /** Marker for "no window" in SmsJob::windowStart */
+    static constexpr uint16_t NONE = 0xFFFF;
+
+    /**
+     * @brief Parse "HH:MM-HH:MM" into minutes of day
+     *
+     * @param s Input characters (not necessarily NUL-terminated)
+     * @param n Number of characters
+     * @param start Window start, minutes after local midnight
+     * @param end Window end (exclusive), minutes after local midnight
+     * @retval true Well-formed window with start != end
+     */
+    static bool parse(const char *s, size_t n, uint16_t &start, uint16_t &end);
+
+    /**
+     * @brief Zone of a destination number
+     *
+     * @param to Destination number
+     * @return UtcOffsetRange Offsets by country code, or the home zone
+     */
+    static UtcOffsetRange zoneFor(const PhoneNumber &to);
+
+    /**
+     * @brief Daylight saving shift in effect at a given time
+     *
+     * @param rule DST rule
+     * @param utc UTC seconds
+     * @return int16_t 60 while DST is in effect, otherwise 0
+     */
+    static int16_t dstShift(DstRule rule, uint32_t utc);
+
+    /**
+     * @brief Earliest time at or after @p utc when the window is open for @p to
+     *
+     * @param utc Current UTC seconds
+     * @param start Window start (minutes of day)
+     * @param end Window end (minutes of day)
+     * @param to Destination number
+     * @return uint32_t @p utc itself if open now, the start of the next
+     *         opening otherwise, or 0 if the window never opens in all of
+     *         the destination's zones at once
+     */
+    static uint32_t nextOpen(uint32_t utc, uint16_t start, uint16_t end, const PhoneNumber &to);
+
+    /**
+     * @brief Convert a civil UTC date to days since 1970-01-01
+     */
+    static int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d);
+};
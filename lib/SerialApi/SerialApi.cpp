@@ -0,0 +1,164 @@
+#include "SerialApi.hpp"
+#include "JobTracer.hpp"
+#include "RemoteLog.hpp"
+#include "SendRequestDecoder.hpp"
+
+SerialApi::SerialApi(Stream &io, JobQueue &jobs, PostFunction postFunc, ScheduleFunction scheduleFunc,
+                     CheckModemRegisteredFunction checkModemRegisteredFunc)
+    : io(io), jobs(jobs), post(postFunc), schedule(scheduleFunc), checkModemRegistered(checkModemRegisteredFunc)
+{
+    for (uint32_t &id : owned)
+        id = 0;
+    ProbeRegistry::instance().registerProbe("serial", [this](JsonObject &dst)
+                                            { toJson(dst); });
+    LOG_INFO("SERIAL", "Send API on the console, one JSON object per line");
+}
+
+/**
+ * @brief Collect bytes into lines; CR is dropped, so CRLF and LF both work
+ */
+void SerialApi::loop()
+{
+    for (int n = 0; n < SERIAL_API_BYTES_PER_LOOP && io.available() > 0; ++n)
+    {
+        int c = io.read();
+        if (c < 0)
+            break;
+        if (c == '\r')
+            continue;
+        if (c != '\n')
+        {
+            if (lineLen < SERIAL_API_LINE_MAX)
+                line[lineLen++] = char(c);
+            else
+                overlong = true;
+            continue;
+        }
+        line[lineLen] = '\0';
+        if (overlong)
+        {
+            overlongLines++;
+            reply("{\"error\":\"Line too long\"}");
+        }
+        else if (lineLen > 0 && line[0] == '{')
+            handleLine();
+        lineLen = 0;
+        overlong = false;
+    }
+}
+
+/**
+ * @brief Same decoder, queue paths and checks as `POST /send`, without waiting for the modem
+ */
+void SerialApi::handleLine()
+{
+    lines++;
+    SmsJob *job = jobs.acquire();
+    if (job == nullptr)
+    {
+        rejected++;
+        reply("{\"error\":\"Busy, try again\"}");
+        return;
+    }
+    JobTracer::instance().begin(job->id);
+
+    DecodeStatus status = SendRequestDecoder::decode(line, lineLen, *job);
+    if (status != DecodeStatus::Ok)
+    {
+        jobs.release(job);
+        rejected++;
+        reply(SendRequestDecoder::errorJson(status));
+        return;
+    }
+
+    uint32_t id = job->id;
+    char out[80];
+    if (job->hasWindow())
+    {
+        // Campaign traffic: registration is checked when the job is sent
+        ScheduleResult result = schedule(*job);
+        if (result != ScheduleResult::Accepted)
+        {
+            jobs.release(job);
+            rejected++;
+            reply(result == ScheduleResult::ParkFull ? "{\"error\":\"Busy, try again\"}"
+                                                     : "{\"error\":\"Window never open for destination\"}");
+            return;
+        }
+        own(id);
+        scheduled++;
+        snprintf(out, sizeof(out), "{\"status\":\"scheduled\",\"id\":%lu,\"releaseAt\":%lu}",
+                 (unsigned long)id, (unsigned long)job->releaseAt);
+        reply(out);
+        return;
+    }
+
+    if (!checkModemRegistered())
+    {
+        jobs.release(job);
+        rejected++;
+        reply("{\"error\":\"Modem not registered on network\"}");
+        return;
+    }
+    own(id);
+    post(*job);
+    queued++;
+    snprintf(out, sizeof(out), "{\"status\":\"queued\",\"id\":%lu}", (unsigned long)id);
+    reply(out);
+}
+
+void SerialApi::jobFinished(const SmsJob &job)
+{
+    for (uint32_t &id : owned)
+    {
+        if (id != job.id)
+            continue;
+        id = 0;
+        char out[64];
+        if (job.state == JobState::Sent)
+        {
+            sent++;
+            snprintf(out, sizeof(out), "{\"id\":%lu,\"status\":\"sent\",\"msgRef\":%d}",
+                     (unsigned long)job.id, int(job.msgRef));
+        }
+        else
+        {
+            failed++;
+            snprintf(out, sizeof(out), "{\"id\":%lu,\"status\":\"failed\"}", (unsigned long)job.id);
+        }
+        reply(out);
+        return;
+    }
+}
+
+void SerialApi::toJson(JsonObject &dst) const
+{
+    dst["lines"] = lines;
+    dst["queued"] = queued;
+    dst["scheduled"] = scheduled;
+    dst["rejected"] = rejected;
+    dst["overlong"] = overlongLines;
+    dst["sent"] = sent;
+    dst["failed"] = failed;
+}
+
+void SerialApi::reply(const char *json)
+{
+    io.println(json);
+}
+
+/**
+ * @brief Remember an accepted id for its outcome line; a slot is always free
+ * since each owned id holds a job slot
+ */
+void SerialApi::own(uint32_t id)
+{
+    for (uint32_t &o : owned)
+    {
+        if (o == 0)
+        {
+            o = id;
+            return;
+        }
+    }
+}
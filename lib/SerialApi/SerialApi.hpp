@@ -0,0 +1,110 @@
+/**
+ * @file SerialApi.hpp
+ * @brief JSON-lines send API on the USB serial console
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+#include "JobQueue.hpp"
+#include "ProbeRegistry.hpp"
+
+// ====== Tuning ======
+/**
+ * @def SERIAL_API_LINE_MAX
+ * @brief Longest request line; fits a JOB_BODY_MAX message with some escapes and options
+ */
+#ifndef SERIAL_API_LINE_MAX
+#define SERIAL_API_LINE_MAX (2 * JOB_BODY_MAX + 128)
+#endif
+
+/**
+ * @def SERIAL_API_BYTES_PER_LOOP
+ * @brief Input bytes handled per loop() call
+ */
+#ifndef SERIAL_API_BYTES_PER_LOOP
+#define SERIAL_API_BYTES_PER_LOOP 256
+#endif
+
+/**
+ * @brief `POST /send` over the serial console, one JSON object per line
+ *
+ * For builds without WiFi, and for a host that drives the board over USB.
+ * A line starting with `{` is decoded by SendRequestDecoder, exactly like
+ * a `/send` body (phone, message, priority, window), and queued without
+ * waiting for the modem. Other lines (blank lines, terminal noise) are
+ * ignored. Every answer is a single line starting with `{`, so a host can
+ * tell it apart from the tagged log lines sharing the port:
+ *
+ *     {"status":"queued","id":12}
+ *     {"status":"scheduled","id":13,"releaseAt":1751356800}
+ *     {"error":"Busy, try again"}
+ *     {"id":12,"status":"sent","msgRef":5}
+ *
+ * The last form reports the outcome of a job accepted here (jobFinished()).
+ * The console is a local, physical connection: no API key is asked for.
+ * Counters are exported in the "serial" probe.
+ */
+class SerialApi
+{
+public:
+    using PostFunction = std::function<void(SmsJob &job)>;
+    using ScheduleFunction = std::function<ScheduleResult(SmsJob &job)>;
+    using CheckModemRegisteredFunction = std::function<bool()>;
+
+    /**
+     * @brief Bind to a stream (normally Serial, already started)
+     *
+     * @param io Console stream
+     * @param jobs Job pool requests are decoded into
+     * @param postFunc Queues jobs without a window
+     * @param scheduleFunc Queues or parks windowed jobs
+     * @param checkModemRegisteredFunc Registration check for jobs without a window
+     */
+    SerialApi(Stream &io, JobQueue &jobs, PostFunction postFunc, ScheduleFunction scheduleFunc,
+              CheckModemRegisteredFunction checkModemRegisteredFunc);
+
+    /**
+     * @brief Read available input and answer complete lines; call from the main loop
+     */
+    void loop();
+
+    /**
+     * @brief Print the outcome of a job accepted here
+     *
+     * Hook for SmsDispatcher::onFinish(); jobs from other ingress paths are
+     * ignored.
+     */
+    void jobFinished(const SmsJob &job);
+
+    /**
+     * @brief Write {"lines","queued","scheduled","rejected","overlong","sent","failed"}
+     */
+    void toJson(JsonObject &dst) const;
+
+private:
+    Stream &io;
+    JobQueue &jobs;
+    PostFunction post;
+    ScheduleFunction schedule;
+    CheckModemRegisteredFunction checkModemRegistered;
+
+    char line[SERIAL_API_LINE_MAX + 1];
+    size_t lineLen = 0;
+    bool overlong = false;     ///< Line cut, rest discarded up to the newline
+    uint32_t owned[JOB_SLOTS]; ///< Ids of accepted jobs not finished yet (0 = free)
+
+    uint32_t lines = 0;
+    uint32_t queued = 0;
+    uint32_t scheduled = 0;
+    uint32_t rejected = 0;
+    uint32_t overlongLines = 0;
+    uint32_t sent = 0;
+    uint32_t failed = 0;
+
+    void handleLine();
+    void reply(const char *json);
+    void own(uint32_t id);
+};
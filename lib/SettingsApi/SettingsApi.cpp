@@ -0,0 +1,133 @@
+#include "SettingsApi.hpp"
+#include <esp_system.h>
+#include <mbedtls/md.h>
+#include "WearPreferences.hpp"
+
+SettingsApi &SettingsApi::instance()
+{
+    static SettingsApi inst;
+    return inst;
+}
+
+bool SettingsApi::registerSection(const char *name, ReadFunction read, ValidateFunction validate, ApplyFunction apply)
+{
+    if (count >= SETTINGS_SECTIONS_MAX || find(name) != nullptr)
+        return false;
+    sections[count++] = Section{name, read, validate, apply};
+    return true;
+}
+
+void SettingsApi::read(JsonObject &dst)
+{
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        JsonObject obj = dst[sections[i].name].to<JsonObject>();
+        sections[i].read(obj, false);
+    }
+}
+
+/**
+ * @brief Keyed hash of the unmasked document, so secret-only changes move the tag too
+ *
+ * HMAC-SHA256 under a random per-device key, truncated to 64 bits: without
+ * the key the tag cannot be used to test guesses of a masked password.
+ */
+String SettingsApi::etag()
+{
+    loadKey();
+    JsonDocument doc;
+    JsonObject root = doc.to<JsonObject>();
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        JsonObject obj = root[sections[i].name].to<JsonObject>();
+        sections[i].read(obj, true);
+    }
+    String text;
+    serializeJson(doc, text);
+    uint8_t mac[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), etagKey, sizeof(etagKey),
+                    reinterpret_cast<const uint8_t *>(text.c_str()), text.length(), mac);
+    char tag[20];
+    snprintf(tag, sizeof(tag), "\"%02x%02x%02x%02x%02x%02x%02x%02x\"",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], mac[6], mac[7]);
+    return String(tag);
+}
+
+/**
+ * @brief Read the ETag key from NVS, creating it on first use
+ */
+void SettingsApi::loadKey()
+{
+    if (keyLoaded)
+        return;
+    keyLoaded = true;
+    WearPreferences prefs("settings");
+    if (!prefs.begin("settingsapi", false))
+    {
+        esp_fill_random(etagKey, sizeof(etagKey)); // tags change on every boot, still unguessable
+        return;
+    }
+    if (prefs.getBytes("etagKey", etagKey, sizeof(etagKey)) != sizeof(etagKey))
+    {
+        esp_fill_random(etagKey, sizeof(etagKey));
+        prefs.putBytes("etagKey", etagKey, sizeof(etagKey));
+    }
+    prefs.end();
+}
+
+/**
+ * @brief Check the precondition, validate every section, then apply them in order
+ */
+PatchStatus SettingsApi::patch(const char *body, size_t len, const String &ifMatch, String &error, SettingsEffect &effect)
+{
+    effect = SettingsEffect::None;
+    JsonDocument doc;
+    if (deserializeJson(doc, body, len) || !doc.is<JsonObjectConst>())
+    {
+        error = "Body must be a JSON object";
+        return PatchStatus::BadRequest;
+    }
+    JsonObjectConst root = doc.as<JsonObjectConst>();
+
+    for (JsonPairConst kv : root)
+    {
+        if (find(kv.key().c_str()) == nullptr)
+        {
+            error = String("Unknown section: ") + kv.key().c_str();
+            return PatchStatus::BadRequest;
+        }
+        if (!kv.value().is<JsonObjectConst>())
+        {
+            error = String("Section must be an object: ") + kv.key().c_str();
+            return PatchStatus::BadRequest;
+        }
+    }
+
+    if (!ifMatch.isEmpty() && ifMatch != "*" && ifMatch != etag())
+        return PatchStatus::Precondition;
+
+    for (JsonPairConst kv : root)
+    {
+        if (!find(kv.key().c_str())->validate(kv.value().as<JsonObjectConst>(), error))
+        {
+            error = String(kv.key().c_str()) + "." + error;
+            return PatchStatus::Invalid;
+        }
+    }
+
+    for (JsonPairConst kv : root)
+    {
+        SettingsEffect e = find(kv.key().c_str())->apply(kv.value().as<JsonObjectConst>());
+        if (e > effect)
+            effect = e;
+    }
+    return PatchStatus::Ok;
+}
+
+SettingsApi::Section *SettingsApi::find(const char *name)
+{
+    for (uint8_t i = 0; i < count; ++i)
+        if (strcmp(sections[i].name, name) == 0)
+            return &sections[i];
+    return nullptr;
+}
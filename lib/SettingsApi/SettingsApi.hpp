@@ -0,0 +1,123 @@
+/**
+ * @file SettingsApi.hpp
+ * @brief Registry of settings sections behind GET/PATCH /settings
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+
+// ====== Tuning ======
+/**
+ * @def SETTINGS_SECTIONS_MAX
+ * @brief Maximum number of sections that can be registered
+ */
+#ifndef SETTINGS_SECTIONS_MAX
+#define SETTINGS_SECTIONS_MAX 8
+#endif
+
+/**
+ * @brief How a committed change takes effect
+ *
+ * Ordered: the effect of a patch is the strongest effect of its sections.
+ */
+enum class SettingsEffect : uint8_t
+{
+    None = 0,    ///< Nothing changed
+    Live = 1,    ///< In effect now (or on the owner's next poll)
+    Restart = 2, ///< Stored, applies after a restart
+};
+
+/**
+ * @brief Outcome of SettingsApi::patch()
+ */
+enum class PatchStatus : uint8_t
+{
+    Ok = 0,       ///< Committed (or nothing to change)
+    BadRequest,   ///< Not a JSON object, unknown section or a section is not an object
+    Precondition, ///< If-Match does not match the current ETag
+    Invalid,      ///< A section refused a value; nothing was committed
+};
+
+/**
+ * @brief One settings document assembled from independent sections
+ *
+ * Each owner (GSettings, later tunables) registers a section with three
+ * functions, following the ProbeRegistry pattern:
+ * - read: write the current values; secrets are masked unless asked for
+ * - validate: check a merge-patch object without changing anything
+ * - apply: commit a validated patch (including persistence) and report
+ *   whether it is live or needs a restart
+ *
+ * patch() implements JSON merge-patch (RFC 7396) over the sections with
+ * an optimistic concurrency check: the ETag is a 64-bit HMAC of the
+ * unmasked document, so it changes whatever path (HTTP, BLE, provisioning)
+ * modified a value, and needs no stored version counter. Its key is random
+ * per device (NVS "settingsapi"), so a tag reveals nothing about the
+ * secrets it covers. Every section of a patch is validated before the
+ * first one is applied.
+ */
+class SettingsApi
+{
+public:
+    /** @brief Write the section's values; @p secrets false masks passwords */
+    using ReadFunction = std::function<void(JsonObject &dst, bool secrets)>;
+    /** @brief Check a patch object; set @p error (field name and reason) on failure */
+    using ValidateFunction = std::function<bool(JsonObjectConst patch, String &error)>;
+    /** @brief Commit a validated patch object */
+    using ApplyFunction = std::function<SettingsEffect(JsonObjectConst patch)>;
+
+    static SettingsApi &instance();
+
+    /**
+     * @brief Register a section (call once per owner, typically from its constructor)
+     *
+     * @param name Key of the section in the settings document (static string)
+     * @retval false Table full or name already used
+     */
+    bool registerSection(const char *name, ReadFunction read, ValidateFunction validate, ApplyFunction apply);
+
+    /**
+     * @brief Write every section, secrets masked
+     */
+    void read(JsonObject &dst);
+
+    /**
+     * @brief Current entity tag, quoted ("\"0123456789abcdef\"")
+     */
+    String etag();
+
+    /**
+     * @brief Validate and commit a merge-patch document
+     *
+     * @param body JSON object {"<section>":{...}}
+     * @param len Body length
+     * @param ifMatch If-Match header value; empty or "*" skips the check
+     * @param error Set to a message for BadRequest and Invalid
+     * @param effect Set to the combined effect for Ok
+     */
+    PatchStatus patch(const char *body, size_t len, const String &ifMatch, String &error, SettingsEffect &effect);
+
+private:
+    struct Section
+    {
+        const char *name;
+        ReadFunction read;
+        ValidateFunction validate;
+        ApplyFunction apply;
+    };
+
+    SettingsApi() = default;
+    SettingsApi(const SettingsApi &) = delete;
+    SettingsApi &operator=(const SettingsApi &) = delete;
+
+    Section *find(const char *name);
+    void loadKey();
+
+    Section sections[SETTINGS_SECTIONS_MAX];
+    uint8_t count = 0;
+    uint8_t etagKey[32] = {}; ///< HMAC key of the ETag
+    bool keyLoaded = false;
+};
@@ -0,0 +1,133 @@
+#include "SmsDispatcher.hpp"
+#include <time.h>
+
+/**
+ * @brief Construct a new SmsDispatcher bound to a queue and a send function
+ */
+SmsDispatcher::SmsDispatcher(JobQueue &jobs, SubmitFunction submit) : jobs(jobs), submit(submit)
+{
+}
+
+/**
+ * @brief Dequeue one job, send it and record the outcome
+ */
+bool SmsDispatcher::poll()
+{
+    releaseParked();
+    SmsJob *job = jobs.dequeue();
+    if (job == nullptr)
+        return false;
+    bool ok = submit(*job);
+    finish(*job, ok);
+    return true;
+}
+
+/**
+ * @brief Enqueue the caller's job and drain the queue until it is done
+ */
+bool SmsDispatcher::runToCompletion(SmsJob &job)
+{
+    jobs.enqueue(&job);
+    while (!job.isDone())
+    {
+        if (!poll())
+        {
+            // Nothing queued but our job is not done: it was lost
+            job.state = JobState::Failed;
+            JobTracer::instance().fail(job.id);
+            break;
+        }
+    }
+    return job.state == JobState::Sent;
+}
+
+/**
+ * @brief Send now if inside the window, otherwise park until it opens
+ */
+ScheduleResult SmsDispatcher::schedule(SmsJob &job)
+{
+    uint32_t now = clockNow();
+    uint32_t at = now == 0 ? 0 : SendWindow::nextOpen(now, job.windowStart, job.windowEnd, job.to);
+    if (now != 0 && at == 0)
+        return ScheduleResult::WindowNever;
+    if (now != 0 && at == now)
+    {
+        job.detached = true;
+        job.releaseAt = now;
+        jobs.enqueue(&job);
+        return ScheduleResult::Accepted;
+    }
+    // Outside the window, or the clock is not set yet (released once it is)
+    if (!jobs.park(&job, at))
+        return ScheduleResult::ParkFull;
+    job.detached = true;
+    return ScheduleResult::Accepted;
+}
+
+/**
+ * @brief Queue a detached job; its slot is released by finish()
+ */
+void SmsDispatcher::post(SmsJob &job)
+{
+    job.detached = true;
+    jobs.enqueue(&job);
+}
+
+/**
+ * @brief Slots not parked are in flight; parked ones only count once due
+ */
+bool SmsDispatcher::hasWork() const
+{
+    if (jobs.inUse() > jobs.parked())
+        return true;
+    return jobs.parked() > 0 && jobs.nextRelease() <= clockNow();
+}
+
+/**
+ * @brief Wall clock, or 0 while it still reads as unset
+ */
+uint32_t SmsDispatcher::clockNow()
+{
+    time_t now = time(nullptr);
+    return now >= time_t(WINDOW_MIN_VALID_EPOCH) ? uint32_t(now) : 0;
+}
+
+/**
+ * @brief Feed the earliest due parked job back in, re-checking its window
+ *
+ * Only while nothing else is queued and at most once per
+ * SCHED_RELEASE_PACE_MS, so released campaign traffic never queues ahead
+ * of, or in bulk with, live traffic.
+ */
+void SmsDispatcher::releaseParked()
+{
+    if (jobs.parked() == 0 || jobs.pending() > 0 || millis() - lastReleaseMs < SCHED_RELEASE_PACE_MS)
+        return;
+    uint32_t now = clockNow();
+    if (now == 0)
+        return;
+    SmsJob *job = jobs.popDue(now);
+    if (job == nullptr)
+        return;
+
+    lastReleaseMs = millis();
+    uint32_t at = SendWindow::nextOpen(now, job->windowStart, job->windowEnd, job->to);
+    if (at == now)
+        jobs.enqueue(job);
+    else if (at == 0 || !jobs.park(job, at)) // park: pacing ran past the window end
+        finish(*job, false);
+}
+
+/**
+ * @brief Move a job to its final state and free detached slots
+ */
+void SmsDispatcher::finish(SmsJob &job, bool ok)
+{
+    job.state = ok ? JobState::Sent : JobState::Failed;
+    if (!ok)
+        JobTracer::instance().fail(job.id);
+    if (finished)
+        finished(job);
+    if (job.detached)
+        jobs.release(&job);
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <functional>
+#include "JobQueue.hpp"
+#include "SendWindow.hpp"
+
+// ====== Tuning ======
+/**
+ * @def SCHED_RELEASE_PACE_MS
+ * @brief Minimum spacing between parked jobs released into the queue
+ *
+ * Matches the sustained submit rate of the modem (about 10 SMS per minute),
+ * so a campaign whose window opens is fed in at the rate it can be sent
+ * instead of as one burst.
+ */
+#ifndef SCHED_RELEASE_PACE_MS
+#define SCHED_RELEASE_PACE_MS 6000
+#endif
+
+/**
+ * @brief Function type that hands one job to the modem
+ *
+ * @param job Job in JobState::Sending; implementations may set job.msgRef
+ * @return true if the network accepted the message
+ * @return false if sending failed
+ */
+using SubmitFunction = std::function<bool(SmsJob &job)>;
+
+/**
+ * @brief Observer of finished jobs, called before a detached slot is released
+ *
+ * @param job Job in JobState::Sent or JobState::Failed
+ */
+using FinishFunction = std::function<void(const SmsJob &job)>;
+
+/**
+ * @brief Drains the JobQueue into the modem, one job at a time
+ *
+ * The dispatcher is the only consumer of the queue. It is pumped from the
+ * main loop via poll(); synchronous callers (the HTTP `/send` handler) use
+ * runToCompletion(), which keeps pumping in queue order until their own job
+ * is finished.
+ *
+ * Jobs with a send window (campaign traffic) go through schedule() instead:
+ * outside the window they are parked in the JobQueue release heap and fed
+ * back into the queue when the window opens, at most one every
+ * SCHED_RELEASE_PACE_MS and only while the queue is otherwise empty.
+ * High-priority jobs never carry a window (SmsJob::hasWindow()).
+ */
+class SmsDispatcher
+{
+public:
+    /**
+     * @brief Construct a new SmsDispatcher
+     *
+     * @param jobs Queue to consume
+     * @param submit Function that sends one job through the modem
+     */
+    SmsDispatcher(JobQueue &jobs, SubmitFunction submit);
+
+    /**
+     * @brief Send the next queued job, if any
+     *
+     * Detached jobs are released back to the pool once finished.
+     *
+     * @retval true A job was processed
+     * @retval false The queue was empty
+     */
+    bool poll();
+
+    /**
+     * @brief Enqueue a job and pump the queue until it is finished
+     *
+     * Jobs queued earlier with the same or higher priority are sent first.
+     * The caller keeps ownership of the slot and must release it.
+     *
+     * @param job Decoded job (JobState::Decoding)
+     * @retval true The job was sent
+     * @retval false The job failed
+     */
+    bool runToCompletion(SmsJob &job);
+
+    /**
+     * @brief Queue a windowed job, parking it until its window opens
+     *
+     * The job is detached: the dispatcher releases its slot once sent. While
+     * the wall clock is not set yet the job is parked and evaluated as soon
+     * as it is.
+     *
+     * @param job Decoded job with SmsJob::hasWindow()
+     * @return ScheduleResult Accepted when queued or parked (job.releaseAt
+     *         holds the release time); otherwise the caller keeps the slot
+     */
+    ScheduleResult schedule(SmsJob &job);
+
+    /**
+     * @brief Queue a job without waiting for it
+     *
+     * The job is detached: the dispatcher releases its slot once sent. Used
+     * by ingress paths that report the outcome asynchronously (onFinish()).
+     *
+     * @param job Decoded job without a send window
+     */
+    void post(SmsJob &job);
+
+    /**
+     * @brief Whether anything is to be sent now
+     *
+     * @retval true A job is queued or being sent, or a parked job is due
+     * @retval false Idle; parked jobs may wait (deep sleep carries them)
+     */
+    bool hasWork() const;
+
+    /**
+     * @brief Set the observer called for every finished job
+     */
+    void onFinish(FinishFunction fn) { finished = fn; }
+
+    /**
+     * @brief Current UTC time from the system clock
+     *
+     * @return uint32_t UTC seconds, or 0 until the clock has been set (SNTP or
+     *         modem network time)
+     */
+    static uint32_t clockNow();
+
+private:
+    JobQueue &jobs;        ///< Queue being drained
+    SubmitFunction submit; ///< Modem send path
+    FinishFunction finished; ///< Outcome observer (asynchronous ingress paths)
+    uint32_t lastReleaseMs = 0; ///< millis() of the last parked job release
+
+    void finish(SmsJob &job, bool ok);
+
+    /**
+     * @brief Move at most one due parked job into the queue (paced)
+     */
+    void releaseParked();
+};
@@ -0,0 +1,536 @@
+#include "MailText.hpp"
+#include <string.h>
+#include <strings.h>
+
+namespace
+{
+    bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+    /** @brief Case-insensitive prefix test */
+    bool startsWith(const char *s, size_t n, const char *prefix)
+    {
+        size_t k = strlen(prefix);
+        return n >= k && strncasecmp(s, prefix, k) == 0;
+    }
+
+    /** @brief Case-insensitive equality of a counted string and a literal */
+    bool equals(const char *s, size_t n, const char *literal)
+    {
+        return strlen(literal) == n && strncasecmp(s, literal, n) == 0;
+    }
+
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        return -1;
+    }
+
+    int base64Value(char c)
+    {
+        if (c >= 'A' && c <= 'Z')
+            return c - 'A';
+        if (c >= 'a' && c <= 'z')
+            return c - 'a' + 26;
+        if (c >= '0' && c <= '9')
+            return c - '0' + 52;
+        if (c == '+')
+            return 62;
+        if (c == '/')
+            return 63;
+        return -1;
+    }
+
+    uint64_t fnv1a64(const char *s, size_t n)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < n; ++i)
+        {
+            h ^= uint8_t(s[i]);
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    /**
+     * @brief Value of a Content-Type parameter ("boundary", "charset"), quotes removed
+     *
+     * @return false if absent; the value is cut to @p cap - 1 bytes
+     */
+    bool parameter(const char *v, const char *name, char *out, size_t cap)
+    {
+        size_t nameLen = strlen(name);
+        for (const char *p = strchr(v, ';'); p; p = strchr(p, ';'))
+        {
+            ++p;
+            while (isBlank(*p))
+                ++p;
+            if (strncasecmp(p, name, nameLen) != 0 || p[nameLen] != '=')
+                continue;
+            p += nameLen + 1;
+            size_t n;
+            if (*p == '"')
+            {
+                ++p;
+                const char *q = strchr(p, '"');
+                n = q ? size_t(q - p) : strlen(p);
+            }
+            else
+                n = strcspn(p, "; \t");
+            if (n >= cap)
+                n = cap - 1;
+            memcpy(out, p, n);
+            out[n] = '\0';
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Charset handling: 0 unsupported, 1 UTF-8 (or ASCII) as is, 2 Latin-1 to UTF-8
+     */
+    int charsetKind(const char *s, size_t n)
+    {
+        if (equals(s, n, "utf-8") || equals(s, n, "us-ascii"))
+            return 1;
+        if (equals(s, n, "iso-8859-1") || equals(s, n, "windows-1252"))
+            return 2;
+        return 0;
+    }
+}
+
+void MailText::reset()
+{
+    text_[0] = '\0';
+    len_ = 0;
+    truncated_ = false;
+    newlines_ = 0;
+    leading_ = true;
+
+    mode_ = Mode::Headers;
+    topLevel_ = true;
+    textChosen_ = false;
+    lineStart_ = true;
+    headerLen_ = 0;
+
+    multipart_ = false;
+    plain_ = true;
+    encoding_ = Encoding::Plain;
+    latin1_ = false;
+    boundary_[0] = '\0';
+    depth_ = 0;
+
+    b64Bits_ = 0;
+    b64Count_ = 0;
+
+    hasMessageId_ = false;
+    messageIdHash_ = 0;
+    priority_ = JobPriority::Normal;
+}
+
+void MailText::line(const char *s, size_t n, bool complete)
+{
+    if (mode_ == Mode::Done)
+        return;
+
+    const bool start = lineStart_;
+    lineStart_ = complete;
+    if (start && complete && depth_ > 0 && boundaryLine(s, n))
+        return;
+
+    switch (mode_)
+    {
+    case Mode::Headers:
+        if (start)
+        {
+            if (n == 0 && complete)
+            {
+                header();
+                endOfHeaders();
+                return;
+            }
+            // A line starting with blanks continues (folds) the current field
+            if (n == 0 || !isBlank(s[0]))
+                header();
+        }
+        if (n > MAIL_HEADER_MAX - 1 - headerLen_)
+            n = MAIL_HEADER_MAX - 1 - headerLen_;
+        memcpy(header_ + headerLen_, s, n);
+        headerLen_ += n;
+        return;
+    case Mode::Text:
+        if (start && complete && n == 3 && memcmp(s, "-- ", 3) == 0)
+        {
+            mode_ = Mode::Done; // Signature delimiter
+            return;
+        }
+        bodyLine(s, n, complete);
+        if (truncated_)
+            mode_ = Mode::Done;
+        return;
+    default:
+        return;
+    }
+}
+
+void MailText::header()
+{
+    if (headerLen_ == 0)
+        return;
+    header_[headerLen_] = '\0';
+    headerLen_ = 0;
+
+    const char *colon = strchr(header_, ':');
+    if (!colon)
+        return;
+    const char *name = header_;
+    size_t nameLen = colon - header_;
+    const char *v = colon + 1;
+    while (isBlank(*v))
+        ++v;
+    size_t n = strlen(v);
+    while (n > 0 && isBlank(v[n - 1]))
+        --n;
+
+    if (equals(name, nameLen, "Content-Type"))
+    {
+        plain_ = startsWith(v, n, "text/plain");
+        multipart_ = startsWith(v, n, "multipart/");
+        if (!parameter(v, "boundary", boundary_, sizeof(boundary_)))
+            boundary_[0] = '\0';
+        char charset[16];
+        latin1_ = parameter(v, "charset", charset, sizeof(charset)) && charsetKind(charset, strlen(charset)) == 2;
+    }
+    else if (equals(name, nameLen, "Content-Transfer-Encoding"))
+    {
+        if (startsWith(v, n, "quoted-printable"))
+            encoding_ = Encoding::QuotedPrintable;
+        else if (startsWith(v, n, "base64"))
+            encoding_ = Encoding::Base64;
+        else
+            encoding_ = Encoding::Plain;
+    }
+    else if (!topLevel_)
+        return;
+    else if (equals(name, nameLen, "Message-ID"))
+    {
+        hasMessageId_ = n > 0;
+        messageIdHash_ = fnv1a64(v, n);
+    }
+    else if (equals(name, nameLen, "Subject"))
+    {
+        if (len_ == 0)
+            decodeWords(v, n);
+    }
+    else if (equals(name, nameLen, "X-Priority"))
+    {
+        if (n > 0 && (v[0] == '1' || v[0] == '2'))
+            priority_ = JobPriority::High;
+        else if (n > 0 && (v[0] == '4' || v[0] == '5'))
+            priority_ = JobPriority::Low;
+    }
+    else if (equals(name, nameLen, "Importance"))
+    {
+        if (startsWith(v, n, "high"))
+            priority_ = JobPriority::High;
+        else if (startsWith(v, n, "low"))
+            priority_ = JobPriority::Low;
+    }
+}
+
+void MailText::endOfHeaders()
+{
+    if (topLevel_)
+    {
+        topLevel_ = false;
+        if (len_ > 0)
+            newlines_ = 1; // Subject, then the body on its own line
+    }
+    b64Bits_ = 0;
+    b64Count_ = 0;
+
+    if (multipart_ && boundary_[0])
+    {
+        // Too deep: skipped whole, up to a boundary of an outer level
+        if (depth_ < MAIL_MIME_DEPTH)
+            strcpy(boundaries_[depth_++], boundary_);
+        mode_ = Mode::Skip; // Preamble
+        return;
+    }
+    if (plain_ && !textChosen_)
+    {
+        textChosen_ = true;
+        mode_ = Mode::Text;
+        return;
+    }
+    mode_ = Mode::Skip;
+}
+
+bool MailText::boundaryLine(const char *s, size_t n)
+{
+    if (n < 3 || s[0] != '-' || s[1] != '-')
+        return false;
+    for (int d = depth_ - 1; d >= 0; --d)
+    {
+        size_t b = strlen(boundaries_[d]);
+        if (n < 2 + b || memcmp(s + 2, boundaries_[d], b) != 0)
+            continue;
+        const char *rest = s + 2 + b;
+        size_t restLen = n - 2 - b;
+        bool close = restLen >= 2 && rest[0] == '-' && rest[1] == '-';
+        for (size_t i = close ? 2 : 0; i < restLen; ++i)
+            if (!isBlank(rest[i]))
+                return false;
+
+        if (textChosen_)
+        {
+            mode_ = Mode::Done; // Nothing after the text part is used
+            return true;
+        }
+        if (close)
+        {
+            depth_ = d;
+            mode_ = Mode::Skip; // Epilogue
+            return true;
+        }
+        // Next part: defaults of RFC 2045 until its header says otherwise
+        depth_ = d + 1;
+        mode_ = Mode::Headers;
+        headerLen_ = 0;
+        multipart_ = false;
+        plain_ = true;
+        encoding_ = Encoding::Plain;
+        latin1_ = false;
+        boundary_[0] = '\0';
+        return true;
+    }
+    return false;
+}
+
+void MailText::bodyLine(const char *s, size_t n, bool complete)
+{
+    switch (encoding_)
+    {
+    case Encoding::Plain:
+        for (size_t i = 0; i < n; ++i)
+            emit(uint8_t(s[i]));
+        if (complete)
+            put('\n');
+        return;
+    case Encoding::QuotedPrintable:
+    {
+        // Trailing blanks are transport padding; "=" at the end is a soft break
+        if (complete)
+            while (n > 0 && isBlank(s[n - 1]))
+                --n;
+        bool soft = false;
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (s[i] != '=')
+            {
+                emit(uint8_t(s[i]));
+                continue;
+            }
+            if (i + 1 == n)
+            {
+                soft = true;
+                break;
+            }
+            int hi = hexValue(s[i + 1]);
+            int lo = i + 2 < n ? hexValue(s[i + 2]) : -1;
+            if (hi < 0 || lo < 0)
+            {
+                emit('=');
+                continue;
+            }
+            emit(uint8_t(hi << 4 | lo));
+            i += 2;
+        }
+        if (complete && !soft)
+            put('\n');
+        return;
+    }
+    case Encoding::Base64:
+        base64(s, n);
+        return;
+    }
+}
+
+void MailText::base64(const char *s, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (s[i] == '=')
+        {
+            b64Bits_ = 0; // Padding: the leftover bits are not data
+            b64Count_ = 0;
+            continue;
+        }
+        int v = base64Value(s[i]);
+        if (v < 0)
+            continue;
+        b64Bits_ = (b64Bits_ << 6 | uint32_t(v)) & 0xFFFFFF;
+        b64Count_ += 6;
+        if (b64Count_ >= 8)
+        {
+            b64Count_ -= 8;
+            emit(uint8_t(b64Bits_ >> b64Count_));
+        }
+    }
+}
+
+void MailText::emit(uint8_t b)
+{
+    if (latin1_ && b >= 0x80)
+    {
+        put(char(0xC0 | b >> 6));
+        put(char(0x80 | (b & 0x3F)));
+    }
+    else
+        put(char(b));
+}
+
+void MailText::put(char c)
+{
+    if (truncated_ || c == '\r')
+        return;
+    if (c == '\n')
+    {
+        if (!leading_ && newlines_ < 2)
+            ++newlines_;
+        return;
+    }
+    if (mode_ == Mode::Text)
+    {
+        if (leading_ && isBlank(c))
+            return;
+        leading_ = false;
+    }
+
+    size_t breaks = len_ > 0 ? newlines_ : 0;
+    if (len_ + breaks + 1 > JOB_BODY_MAX)
+    {
+        truncated_ = true;
+        return;
+    }
+    while (breaks-- > 0)
+        text_[len_++] = '\n';
+    newlines_ = 0;
+    text_[len_++] = c;
+    text_[len_] = '\0';
+}
+
+void MailText::decodeWords(const char *s, size_t n)
+{
+    const char *p = s;
+    const char *end = s + n;
+    bool afterWord = false;
+    const char *held = nullptr; // Blanks after an encoded word: dropped if another follows
+    const char *heldEnd = nullptr;
+    while (p < end)
+    {
+        if (isBlank(*p))
+        {
+            const char *blanks = p;
+            while (p < end && isBlank(*p))
+                ++p;
+            if (afterWord)
+            {
+                held = blanks;
+                heldEnd = p;
+            }
+            else
+                while (blanks < p)
+                    put(*blanks++);
+            continue;
+        }
+        const char *next = (*p == '=' && p + 1 < end && p[1] == '?') ? word(p, end) : nullptr;
+        if (next)
+        {
+            held = nullptr;
+            afterWord = true;
+            p = next;
+            continue;
+        }
+        while (held && held < heldEnd)
+            put(*held++);
+        held = nullptr;
+        afterWord = false;
+        put(*p++);
+    }
+}
+
+const char *MailText::word(const char *p, const char *end)
+{
+    // =?charset?B|Q?text?=
+    const char *charset = p + 2;
+    const char *q = static_cast<const char *>(memchr(charset, '?', end - charset));
+    if (!q || end - q < 4 || q[2] != '?')
+        return nullptr;
+    char encoding = q[1];
+    if (encoding != 'B' && encoding != 'b' && encoding != 'Q' && encoding != 'q')
+        return nullptr;
+    const char *t = q + 3;
+    const char *te = t;
+    while (te + 1 < end && !(te[0] == '?' && te[1] == '='))
+        ++te;
+    if (te + 1 >= end)
+        return nullptr;
+
+    // RFC 2231 language suffix: utf-8*en
+    const char *star = static_cast<const char *>(memchr(charset, '*', q - charset));
+    int kind = charsetKind(charset, (star ? star : q) - charset);
+    if (kind == 0)
+        return nullptr; // Left as is
+
+    const bool latin1 = latin1_;
+    latin1_ = kind == 2;
+    if (encoding == 'Q' || encoding == 'q')
+    {
+        for (const char *c = t; c < te; ++c)
+        {
+            int hi, lo;
+            if (*c == '_')
+                emit(' ');
+            else if (*c == '=' && te - c > 2 && (hi = hexValue(c[1])) >= 0 && (lo = hexValue(c[2])) >= 0)
+            {
+                emit(uint8_t(hi << 4 | lo));
+                c += 2;
+            }
+            else
+                emit(uint8_t(*c));
+        }
+    }
+    else
+    {
+        b64Bits_ = 0;
+        b64Count_ = 0;
+        base64(t, te - t);
+        b64Bits_ = 0;
+        b64Count_ = 0;
+    }
+    latin1_ = latin1;
+    return te + 2;
+}
+
+void MailText::finish()
+{
+    // Drop a UTF-8 sequence left incomplete by the cut (or by a broken encoding)
+    size_t i = len_;
+    while (i > 0 && (uint8_t(text_[i - 1]) & 0xC0) == 0x80)
+        --i;
+    if (i > 0 && uint8_t(text_[i - 1]) >= 0xC0)
+    {
+        uint8_t lead = uint8_t(text_[i - 1]);
+        size_t want = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+        if (len_ - (i - 1) < want)
+            len_ = i - 1;
+    }
+    while (len_ > 0 && (isBlank(text_[len_ - 1]) || text_[len_ - 1] == '\n'))
+        --len_;
+    text_[len_] = '\0';
+}
@@ -0,0 +1,130 @@
+/**
+ * @file MailText.hpp
+ * @brief Streaming extraction of an SMS text from an Internet message (RFC 5322, MIME)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "SmsJob.hpp"
+
+// ====== Tuning ======
+/**
+ * @def MAIL_HEADER_MAX
+ * @brief Unfolded header field kept for parsing; longer fields are cut
+ */
+#ifndef MAIL_HEADER_MAX
+#define MAIL_HEADER_MAX 256
+#endif
+
+/**
+ * @def MAIL_MIME_DEPTH
+ * @brief Nested multipart levels followed (mixed > alternative > related)
+ */
+#ifndef MAIL_MIME_DEPTH
+#define MAIL_MIME_DEPTH 3
+#endif
+
+/**
+ * @brief Builds the SMS text of a mail one line at a time, without keeping the message
+ *
+ * Fed the DATA lines (dot-unstuffed, without CRLF), it keeps only what
+ * ends up in the SMS: the Subject (RFC 2047 UTF-8 encoded words decoded),
+ * a line break, then the first text/plain part (quoted-printable and
+ * base64 decoded; multipart nested up to MAIL_MIME_DEPTH). HTML-only and
+ * attachment parts are skipped, as is a signature after "-- ". Blank line
+ * runs are collapsed. The text stops at JOB_BODY_MAX bytes, cut on a UTF-8
+ * character boundary.
+ *
+ * Also picked up from the top-level header: Message-ID (as a 64-bit hash,
+ * for idempotency) and X-Priority / Importance (job priority).
+ */
+class MailText
+{
+public:
+    MailText() { reset(); }
+
+    /** @brief Start a new message */
+    void reset();
+
+    /**
+     * @brief Feed one line of the message
+     *
+     * @param complete false: the line continues (it was longer than the reader's buffer)
+     */
+    void line(const char *s, size_t n, bool complete = true);
+
+    /** @brief End of the message: trim the text */
+    void finish();
+
+    const char *text() const { return text_; }
+    size_t length() const { return len_; }
+
+    /** @return true if the text was cut at JOB_BODY_MAX */
+    bool truncated() const { return truncated_; }
+
+    /** @return true if the top-level header had a Message-ID */
+    bool hasMessageId() const { return hasMessageId_; }
+
+    /** @brief FNV-1a 64 of the Message-ID value (angle brackets included) */
+    uint64_t messageIdHash() const { return messageIdHash_; }
+
+    JobPriority priority() const { return priority_; }
+
+private:
+    enum class Mode : uint8_t
+    {
+        Headers, ///< Header block of the message or of a part
+        Text,    ///< Body of the chosen text/plain entity
+        Skip,    ///< Anything else, up to the next boundary
+        Done,    ///< Text complete (signature, or full)
+    };
+
+    enum class Encoding : uint8_t
+    {
+        Plain,
+        QuotedPrintable,
+        Base64,
+    };
+
+    void header();
+    void endOfHeaders();
+    bool boundaryLine(const char *s, size_t n);
+    void bodyLine(const char *s, size_t n, bool complete);
+    void put(char c);
+    void emit(uint8_t b);
+    void decodeWords(const char *s, size_t n);
+    const char *word(const char *p, const char *end);
+    void base64(const char *s, size_t n);
+
+    char text_[JOB_BODY_MAX + 1];
+    size_t len_;
+    bool truncated_;
+    uint8_t newlines_; ///< Line breaks waiting for the next printable character
+    bool leading_;     ///< No body character yet (leading blank lines are dropped)
+
+    Mode mode_;
+    bool topLevel_;    ///< Header block being read is the message's own
+    bool textChosen_;  ///< The text/plain entity was found
+    bool lineStart_;   ///< Next body bytes start a new line (boundary check)
+    char header_[MAIL_HEADER_MAX];
+    size_t headerLen_;
+
+    // Current entity, from its header
+    bool multipart_;
+    bool plain_;
+    Encoding encoding_;
+    bool latin1_; ///< charset=iso-8859-1: bytes are converted to UTF-8
+    char boundary_[71];
+
+    char boundaries_[MAIL_MIME_DEPTH][71];
+    uint8_t depth_;
+
+    uint32_t b64Bits_;
+    uint8_t b64Count_; ///< Bits held in b64Bits_
+
+    bool hasMessageId_;
+    uint64_t messageIdHash_;
+    JobPriority priority_;
+};
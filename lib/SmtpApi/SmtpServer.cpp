@@ -0,0 +1,634 @@
+#include "SmtpServer.hpp"
+#include <stdarg.h>
+#include <strings.h>
+#include "JobTracer.hpp"
+#include "Provisioner.hpp"
+#include "RemoteLog.hpp"
+
+namespace
+{
+    /**
+     * @brief Command verb test, case-insensitive: "NOOP" matches "noop" and "NOOP x"
+     */
+    bool isVerb(const char *line, const char *verb)
+    {
+        size_t n = strlen(verb);
+        return strncasecmp(line, verb, n) == 0 && (line[n] == '\0' || line[n] == ' ');
+    }
+
+    int base64Value(char c)
+    {
+        if (c >= 'A' && c <= 'Z')
+            return c - 'A';
+        if (c >= 'a' && c <= 'z')
+            return c - 'a' + 26;
+        if (c >= '0' && c <= '9')
+            return c - '0' + 52;
+        if (c == '+')
+            return 62;
+        if (c == '/')
+            return 63;
+        return -1;
+    }
+
+    /**
+     * @brief Decode base64 up to the padding; false on a foreign character or overflow
+     */
+    bool base64Decode(const char *in, uint8_t *out, size_t cap, size_t &n)
+    {
+        uint32_t bits = 0;
+        uint8_t count = 0;
+        n = 0;
+        for (; *in && *in != '='; ++in)
+        {
+            int v = base64Value(*in);
+            if (v < 0)
+                return false;
+            bits = (bits << 6 | uint32_t(v)) & 0xFFFFFF;
+            count += 6;
+            if (count >= 8)
+            {
+                count -= 8;
+                if (n == cap)
+                    return false;
+                out[n++] = uint8_t(bits >> count);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Value of an ESMTP parameter ("SIZE=1234") after the address, or nullptr
+     */
+    const char *mailParameter(const char *arg, const char *name)
+    {
+        const char *p = strchr(arg, '>');
+        size_t n = strlen(name);
+        for (p = p ? p + 1 : arg; *p; ++p)
+        {
+            if (*p == ' ' && strncasecmp(p + 1, name, n) == 0 && p[1 + n] == '=')
+                return p + 2 + n;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Local part of a forward-path: "<+40712345678@sms>" gives "+40712345678"
+     */
+    void localPart(const char *arg, const char *&s, size_t &n)
+    {
+        while (*arg == ' ')
+            ++arg;
+        if (*arg == '<')
+            ++arg;
+        size_t len = strcspn(arg, "> ");
+        const char *at = nullptr;
+        for (size_t i = 0; i < len; ++i)
+            if (arg[i] == '@')
+                at = arg + i;
+        s = arg;
+        n = at ? size_t(at - arg) : len;
+        if (n >= 2 && s[0] == '"' && s[n - 1] == '"')
+        {
+            ++s;
+            n -= 2;
+        }
+    }
+}
+
+/**
+ * @brief Start the TCP listener and register the "smtp" probe
+ */
+SmtpServer::SmtpServer(JobQueue &jobs, PostFunction postFunc, CheckModemRegisteredFunction checkModemRegisteredFunc,
+                       uint16_t port)
+    : server(port), jobs(jobs), post(postFunc), checkModemRegistered(checkModemRegisteredFunc)
+{
+    server.begin();
+    server.setNoDelay(true);
+    ProbeRegistry::instance().registerProbe("smtp", [this](JsonObject &dst)
+                                            { toJson(dst); });
+    LOG_INFO("SMTP", "Listening on TCP port %u", (unsigned)port);
+}
+
+void SmtpServer::loop()
+{
+    accept();
+    uint32_t now = millis();
+    for (Session &s : sessions)
+    {
+        if (s.used)
+            serve(s, now);
+    }
+}
+
+/**
+ * @brief Take waiting connections while sessions are free
+ *
+ * With every session busy nothing is accepted: the connection stays in the
+ * listener's backlog (the client sees a slow greeting, not a refusal).
+ */
+void SmtpServer::accept()
+{
+    for (Session &s : sessions)
+    {
+        if (s.used)
+            continue;
+        if (!server.hasClient())
+            return;
+        s.client = server.accept();
+        if (!s.client)
+            return;
+        s.client.setNoDelay(true);
+        s.used = true;
+        s.phase = Phase::Command;
+        s.greeted = false;
+        s.authed = false;
+        s.closing = false;
+        s.lastMs = millis();
+        s.lineLen = 0;
+        s.overlong = false;
+        s.rxPos = 0;
+        s.rxLen = 0;
+        s.outLen = 0;
+        resetTransaction(s);
+        connections++;
+
+        uint8_t active = 0;
+        for (const Session &o : sessions)
+            active += o.used ? 1 : 0;
+        if (active > maxSessions)
+            maxSessions = active;
+        LOG_DEBUG("SMTP", "Session opened (%u active)", (unsigned)active);
+        reply(s, "220 sms-sender ESMTP ready");
+    }
+}
+
+/**
+ * @brief One pass over a session: finish a held message, read, reply
+ */
+void SmtpServer::serve(Session &s, uint32_t now)
+{
+    if (s.phase == Phase::Waiting)
+    {
+        if (!s.client.connected())
+        {
+            close(s); // Nothing was queued; the client sends it again
+            return;
+        }
+        if (!finishMessage(s, now))
+            return;
+        s.lastMs = now;
+    }
+
+    uint32_t budget = SMTP_BYTES_PER_LOOP;
+    while (!s.closing && s.phase != Phase::Waiting)
+    {
+        if (s.rxPos == s.rxLen)
+        {
+            if (budget == 0)
+                break;
+            int n = s.client.read(s.rx, budget < sizeof(s.rx) ? budget : sizeof(s.rx));
+            if (n <= 0)
+                break;
+            s.rxPos = 0;
+            s.rxLen = uint16_t(n);
+            budget -= uint32_t(n);
+            bytesIn += uint32_t(n);
+            s.lastMs = now;
+        }
+        while (s.rxPos < s.rxLen && !s.closing && s.phase != Phase::Waiting)
+            consume(s, s.rx[s.rxPos++]);
+    }
+
+    if (!s.closing && s.phase != Phase::Waiting && now - s.lastMs > SMTP_IDLE_MS)
+    {
+        timeouts++;
+        reply(s, "421 4.4.2 Idle timeout, closing");
+        s.closing = true;
+    }
+    flush(s);
+    if (s.closing || (!s.client.connected() && s.rxPos == s.rxLen))
+        close(s);
+}
+
+/**
+ * @brief Assemble lines; DATA lines longer than the buffer are passed on in pieces
+ */
+void SmtpServer::consume(Session &s, uint8_t c)
+{
+    if (c == '\n')
+    {
+        size_t n = s.lineLen;
+        if (n > 0 && s.line[n - 1] == '\r')
+            --n;
+        s.line[n] = '\0';
+        s.lineLen = 0;
+        if (s.phase == Phase::Data)
+            dataLine(s, s.line, n, true);
+        else if (s.overlong)
+        {
+            s.overlong = false;
+            s.phase = Phase::Command;
+            reply(s, "500 5.5.6 Line too long");
+        }
+        else
+            command(s);
+        return;
+    }
+    if (s.lineLen < SMTP_LINE_MAX)
+    {
+        s.line[s.lineLen++] = char(c);
+        return;
+    }
+    if (s.phase == Phase::Data)
+    {
+        dataLine(s, s.line, s.lineLen, false);
+        s.lineLen = 0;
+        s.line[s.lineLen++] = char(c);
+        return;
+    }
+    s.overlong = true;
+}
+
+void SmtpServer::command(Session &s)
+{
+    const char *line = s.line;
+    const bool keys = Provisioner::instance().hasApiKeys();
+
+    if (s.phase == Phase::Auth)
+    {
+        s.phase = Phase::Command;
+        if (strcmp(line, "*") == 0)
+            return reply(s, "501 5.0.0 Authentication cancelled");
+        return authPlain(s, line);
+    }
+
+    if (isVerb(line, "EHLO") || isVerb(line, "HELO"))
+    {
+        resetTransaction(s);
+        s.greeted = true;
+        if (toupper(line[0]) == 'H')
+            return reply(s, "250 sms-sender");
+        reply(s, "250-sms-sender");
+        reply(s, "250-PIPELINING");
+        reply(s, "250-8BITMIME");
+        reply(s, "250-SIZE %u", (unsigned)SMTP_MESSAGE_MAX);
+        if (keys)
+            reply(s, "250-AUTH PLAIN");
+        return reply(s, "250 ENHANCEDSTATUSCODES");
+    }
+    if (strncasecmp(line, "MAIL FROM:", 10) == 0)
+    {
+        if (!s.greeted)
+            return reply(s, "503 5.5.1 Send EHLO first");
+        if (s.mail)
+            return reply(s, "503 5.5.1 Sender already given");
+        if (keys && !s.authed)
+            return reply(s, "530 5.7.0 Authentication required");
+        const char *size = mailParameter(line + 10, "SIZE");
+        if (size && strtoul(size, nullptr, 10) > SMTP_MESSAGE_MAX)
+        {
+            tooLarge++;
+            return reply(s, "552 5.3.4 Message size exceeds %u bytes", (unsigned)SMTP_MESSAGE_MAX);
+        }
+        s.mail = true;
+        return reply(s, "250 2.1.0 Sender OK");
+    }
+    if (strncasecmp(line, "RCPT TO:", 8) == 0)
+    {
+        if (!s.mail)
+            return reply(s, "503 5.5.1 Need MAIL first");
+        if (s.rcptCount >= SMTP_RCPT_MAX)
+            return reply(s, "452 4.5.3 Too many recipients");
+        const char *local;
+        size_t n;
+        localPart(line + 8, local, n);
+        if (!s.rcpt[s.rcptCount].parse(local, n))
+            return reply(s, "550 5.1.1 Local part is not a valid phone number");
+        s.rcptCount++;
+        return reply(s, "250 2.1.5 Recipient OK");
+    }
+    if (isVerb(line, "DATA"))
+    {
+        if (!s.mail)
+            return reply(s, "503 5.5.1 Need MAIL first");
+        if (s.rcptCount == 0)
+            return reply(s, "554 5.5.1 No valid recipients");
+        s.phase = Phase::Data;
+        s.dataStart = true;
+        s.dataBytes = 0;
+        s.tooLarge = false;
+        s.text.reset();
+        return reply(s, "354 End data with <CR><LF>.<CR><LF>");
+    }
+    if (isVerb(line, "RSET"))
+    {
+        resetTransaction(s);
+        return reply(s, "250 2.0.0 OK");
+    }
+    if (isVerb(line, "NOOP"))
+        return reply(s, "250 2.0.0 OK");
+    if (isVerb(line, "QUIT"))
+    {
+        s.closing = true;
+        return reply(s, "221 2.0.0 Bye");
+    }
+    if (isVerb(line, "VRFY"))
+        return reply(s, "252 2.5.0 Cannot verify, send a message to find out");
+    if (isVerb(line, "AUTH"))
+    {
+        if (!keys)
+            return reply(s, "503 5.5.1 Authentication not enabled");
+        if (s.authed)
+            return reply(s, "503 5.5.1 Already authenticated");
+        if (s.mail)
+            return reply(s, "503 5.5.1 Not allowed during a mail transaction");
+        if (strncasecmp(line + 4, " PLAIN", 6) != 0 || (line[10] != '\0' && line[10] != ' '))
+            return reply(s, "504 5.5.4 Only AUTH PLAIN is supported");
+        if (line[10] == ' ')
+            return authPlain(s, line + 11);
+        s.phase = Phase::Auth;
+        return reply(s, "334 ");
+    }
+    reply(s, "500 5.5.2 Command not recognized");
+}
+
+/**
+ * @brief RFC 4616 response "authzid NUL authcid NUL passwd"; the password is an API key
+ */
+void SmtpServer::authPlain(Session &s, const char *response)
+{
+    uint8_t buf[160];
+    size_t n;
+    const char *password = nullptr;
+    if (base64Decode(response, buf, sizeof(buf) - 1, n))
+    {
+        buf[n] = '\0';
+        const uint8_t *first = static_cast<const uint8_t *>(memchr(buf, '\0', n));
+        const uint8_t *second = first ? static_cast<const uint8_t *>(memchr(first + 1, '\0', n - (first + 1 - buf))) : nullptr;
+        if (second)
+            password = reinterpret_cast<const char *>(second + 1);
+    }
+    if (password && Provisioner::instance().checkApiKey(password))
+    {
+        s.authed = true;
+        return reply(s, "235 2.7.0 Authentication successful");
+    }
+    authFailures++;
+    LOG_WARN("SMTP", "Authentication failed");
+    reply(s, "535 5.7.8 Authentication credentials invalid");
+}
+
+/**
+ * @brief One message line: end of data, dot-unstuffing, size limit, text extraction
+ */
+void SmtpServer::dataLine(Session &s, const char *p, size_t n, bool complete)
+{
+    const bool start = s.dataStart;
+    s.dataStart = complete;
+    if (start && complete && n == 1 && p[0] == '.')
+    {
+        messages++;
+        if (s.tooLarge)
+        {
+            tooLarge++;
+            resetTransaction(s);
+            LOG_NOTICE("SMTP", "Message over %u bytes refused", (unsigned)SMTP_MESSAGE_MAX);
+            return reply(s, "552 5.3.4 Message size exceeds %u bytes", (unsigned)SMTP_MESSAGE_MAX);
+        }
+        s.text.finish();
+        s.phase = Phase::Waiting;
+        s.waitSinceMs = millis();
+        if (!finishMessage(s, s.waitSinceMs))
+            slotWaits++;
+        return;
+    }
+    if (start && n > 0 && p[0] == '.')
+    {
+        ++p;
+        --n;
+    }
+    s.dataBytes += uint32_t(n) + (complete ? 2 : 0);
+    if (s.dataBytes > SMTP_MESSAGE_MAX)
+        s.tooLarge = true; // Read to the end, then refused
+    if (!s.tooLarge)
+        s.text.line(p, n, complete);
+}
+
+/**
+ * @brief Queue a complete message, one job per new recipient
+ *
+ * @return false while it has to wait for job slots (nothing answered yet)
+ */
+bool SmtpServer::finishMessage(Session &s, uint32_t now)
+{
+    const MailText &m = s.text;
+    bool known[SMTP_RCPT_MAX] = {};
+    uint8_t fresh = 0;
+    uint32_t knownJob = 0;
+    bool held = false;
+    for (uint8_t i = 0; i < s.rcptCount; ++i)
+    {
+        uint32_t jobId;
+        if (!m.hasMessageId())
+        {
+            fresh++;
+            continue;
+        }
+        uint64_t key = deliveryKey(m.messageIdHash(), s.rcpt[i]);
+        known[i] = findDelivered(key, jobId);
+        if (known[i])
+            knownJob = jobId;
+        else
+            fresh++;
+        if (!known[i] && findWaiting(s, key))
+            held = true;
+    }
+
+    uint32_t waited = now - s.waitSinceMs;
+    if (held)
+    {
+        // Resent while the original still waits in another session: its
+        // outcome decides, queued makes this a duplicate, deferred frees it
+        if (waited < SMTP_SLOT_WAIT_MS)
+            return false;
+        deferred++;
+        resetTransaction(s);
+        reply(s, "451 4.3.1 Same message still pending, try again later");
+        return true;
+    }
+    if (fresh == 0)
+    {
+        // Sent again after a lost reply: acknowledge without a second SMS
+        duplicates++;
+        resetTransaction(s);
+        reply(s, "250 2.0.0 Already queued as job %lu", (unsigned long)knownJob);
+        return true;
+    }
+    if (m.length() == 0)
+    {
+        rejected++;
+        resetTransaction(s);
+        reply(s, "554 5.6.0 No text to send (empty Subject and no text/plain part)");
+        return true;
+    }
+    if (JOB_SLOTS - jobs.inUse() < fresh)
+    {
+        if (waited < SMTP_SLOT_WAIT_MS)
+            return false;
+        deferred++;
+        resetTransaction(s);
+        LOG_WARN("SMTP", "No job slots for %lu ms, message deferred", (unsigned long)waited);
+        reply(s, "451 4.3.1 All job slots busy, try again later");
+        return true;
+    }
+    // Asked once slots are free: a held message would send AT+CREG? on every pass
+    if (!checkModemRegistered())
+    {
+        deferred++;
+        resetTransaction(s);
+        reply(s, "451 4.3.2 Modem not registered on network");
+        return true;
+    }
+    if (waited > maxSlotWaitMs)
+        maxSlotWaitMs = waited;
+
+    uint32_t firstJob = 0;
+    for (uint8_t i = 0; i < s.rcptCount; ++i)
+    {
+        if (known[i])
+            continue;
+        SmsJob *job = jobs.acquire();
+        if (job == nullptr)
+            break;
+        JobTracer::instance().begin(job->id);
+        job->to = s.rcpt[i];
+        job->priority = m.priority();
+        memcpy(job->body, m.text(), m.length() + 1);
+        job->bodyLen = uint16_t(m.length());
+        uint32_t id = job->id;
+        post(*job);
+        if (m.hasMessageId())
+        {
+            delivered[deliveredHead] = {deliveryKey(m.messageIdHash(), s.rcpt[i]), id};
+            deliveredHead = uint8_t((deliveredHead + 1) % SMTP_DEDUPE);
+        }
+        if (firstJob == 0)
+            firstJob = id;
+        queued++;
+    }
+    LOG_INFO("SMTP", "Message queued for %u recipient(s) from job %lu%s", (unsigned)fresh,
+             (unsigned long)firstJob, m.truncated() ? ", text truncated" : "");
+    resetTransaction(s);
+    reply(s, "250 2.0.0 Queued as job %lu", (unsigned long)firstJob);
+    return true;
+}
+
+void SmtpServer::resetTransaction(Session &s)
+{
+    s.phase = Phase::Command;
+    s.mail = false;
+    s.rcptCount = 0;
+}
+
+void SmtpServer::reply(Session &s, const char *fmt, ...)
+{
+    char text[128];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(text, sizeof(text) - 2, fmt, args);
+    va_end(args);
+    if (n < 0)
+        return;
+    if (size_t(n) > sizeof(text) - 3)
+        n = int(sizeof(text) - 3);
+    text[n++] = '\r';
+    text[n++] = '\n';
+    if (s.outLen + size_t(n) > sizeof(s.out))
+        flush(s);
+    memcpy(s.out + s.outLen, text, size_t(n));
+    s.outLen += size_t(n);
+}
+
+/**
+ * @brief Write the replies of this pass in one go (one segment for a pipelined batch)
+ */
+void SmtpServer::flush(Session &s)
+{
+    if (s.outLen == 0)
+        return;
+    s.client.write(reinterpret_cast<const uint8_t *>(s.out), s.outLen);
+    s.outLen = 0;
+}
+
+void SmtpServer::close(Session &s)
+{
+    flush(s);
+    s.client.stop();
+    s.used = false;
+    LOG_DEBUG("SMTP", "Session closed");
+}
+
+uint64_t SmtpServer::deliveryKey(uint64_t messageId, const PhoneNumber &to)
+{
+    return (messageId ^ to.hash()) * 0x100000001b3ULL;
+}
+
+bool SmtpServer::findDelivered(uint64_t key, uint32_t &jobId) const
+{
+    for (const Delivered &d : delivered)
+    {
+        if (d.jobId != 0 && d.key == key)
+        {
+            jobId = d.jobId;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Whether an older held message has the same (Message-ID, recipient) pair
+ *
+ * Of two sessions holding the same pair only the younger one waits (the
+ * earlier waitSinceMs, then the lower slot, is the original), so they never
+ * wait for each other.
+ */
+bool SmtpServer::findWaiting(const Session &s, uint64_t key) const
+{
+    for (const Session &o : sessions)
+    {
+        if (&o == &s || !o.used || o.phase != Phase::Waiting || !o.text.hasMessageId())
+            continue;
+        int32_t age = int32_t(s.waitSinceMs - o.waitSinceMs);
+        if (age < 0 || (age == 0 && &o > &s))
+            continue;
+        for (uint8_t i = 0; i < o.rcptCount; ++i)
+        {
+            if (deliveryKey(o.text.messageIdHash(), o.rcpt[i]) == key)
+                return true;
+        }
+    }
+    return false;
+}
+
+void SmtpServer::toJson(JsonObject &dst) const
+{
+    uint8_t active = 0;
+    for (const Session &s : sessions)
+        active += s.used ? 1 : 0;
+    dst["sessions"] = active;
+    dst["maxSessions"] = maxSessions;
+    dst["connections"] = connections;
+    dst["messages"] = messages;
+    dst["queued"] = queued;
+    dst["duplicates"] = duplicates;
+    dst["tooLarge"] = tooLarge;
+    dst["deferred"] = deferred;
+    dst["rejected"] = rejected;
+    dst["authFailures"] = authFailures;
+    dst["timeouts"] = timeouts;
+    dst["slotWaits"] = slotWaits;
+    dst["maxSlotWaitMs"] = maxSlotWaitMs;
+    dst["bytesIn"] = bytesIn;
+}
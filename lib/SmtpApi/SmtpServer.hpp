@@ -0,0 +1,231 @@
+/**
+ * @file SmtpServer.hpp
+ * @brief SMTP ingress: mail to <number>@<anything> becomes an SMS (email-to-SMS gateway)
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WiFi.h>
+#include <functional>
+#include "JobQueue.hpp"
+#include "MailText.hpp"
+#include "ProbeRegistry.hpp"
+
+// ====== Tuning ======
+/**
+ * @def SMTP_PORT
+ * @brief TCP port of the SMTP listener
+ */
+#ifndef SMTP_PORT
+#define SMTP_PORT 25
+#endif
+
+/**
+ * @def SMTP_SESSIONS
+ * @brief Connections served at once; further ones wait in the TCP accept backlog
+ */
+#ifndef SMTP_SESSIONS
+#define SMTP_SESSIONS 3
+#endif
+
+/**
+ * @def SMTP_LINE_MAX
+ * @brief Longest command line (RFC 5321 allows 512); longer DATA lines are fed in pieces
+ */
+#ifndef SMTP_LINE_MAX
+#define SMTP_LINE_MAX 512
+#endif
+
+/**
+ * @def SMTP_MESSAGE_MAX
+ * @brief Largest message accepted (advertised as EHLO SIZE)
+ */
+#ifndef SMTP_MESSAGE_MAX
+#define SMTP_MESSAGE_MAX 32768
+#endif
+
+/**
+ * @def SMTP_RCPT_MAX
+ * @brief Recipients per message; more are deferred with 452 (the client sends them again)
+ */
+#ifndef SMTP_RCPT_MAX
+#define SMTP_RCPT_MAX 5
+#endif
+
+/**
+ * @def SMTP_IDLE_MS
+ * @brief A session silent for this long is closed with 421
+ */
+#ifndef SMTP_IDLE_MS
+#define SMTP_IDLE_MS 60000
+#endif
+
+/**
+ * @def SMTP_SLOT_WAIT_MS
+ * @brief Longest a complete message waits for free job slots before 451
+ */
+#ifndef SMTP_SLOT_WAIT_MS
+#define SMTP_SLOT_WAIT_MS 60000
+#endif
+
+/**
+ * @def SMTP_DEDUPE
+ * @brief Accepted (Message-ID, recipient) pairs remembered for duplicate detection
+ */
+#ifndef SMTP_DEDUPE
+#define SMTP_DEDUPE 32
+#endif
+
+/**
+ * @def SMTP_BYTES_PER_LOOP
+ * @brief Input bytes handled per session and loop() call
+ */
+#ifndef SMTP_BYTES_PER_LOOP
+#define SMTP_BYTES_PER_LOOP 2048
+#endif
+
+/**
+ * @brief SMTP (RFC 5321) listener on SMTP_PORT turning mail into SMS jobs
+ *
+ * Meant for a local MTA, NAS or monitoring system that can only send mail:
+ * `RCPT TO:<+40712345678@sms>` queues one SMS per recipient. The domain is
+ * not checked; a local part that is not a valid number is refused with 550
+ * at RCPT time. The SMS text is built by MailText while the message streams
+ * in (Subject, then the first text/plain part), so a message is never held
+ * whole and its size only counts against SMTP_MESSAGE_MAX: a larger SIZE=
+ * is refused at MAIL, a larger body is read to the end and refused with 552.
+ *
+ * Bursts: EHLO advertises PIPELINING, and replies are written once per
+ * loop() per session. Up to SMTP_SESSIONS connections are served; later
+ * ones are only accepted when a session ends, so they wait in the TCP
+ * backlog instead of being refused. When a message is complete but the job
+ * pool has no free slots for its recipients, the reply to the final "." is
+ * held (and the session not read further) until slots free up, for up to
+ * SMTP_SLOT_WAIT_MS; after that it is deferred with 451 and the client
+ * retries later. Registration is checked once slots are free (451 when
+ * the modem is not registered), not on every pass of a held message.
+ *
+ * Idempotency: a client that lost the 250 after "." sends the message again.
+ * (Message-ID, recipient) pairs of the last SMTP_DEDUPE accepted jobs are
+ * remembered in RAM, and a repeat is answered 250 without a second SMS.
+ * A repeat arriving while the original is still held for slots is held
+ * too, until the original is queued or deferred. Messages without a
+ * Message-ID are not deduplicated.
+ *
+ * When API keys are provisioned, AUTH PLAIN with a key as the password is
+ * required before MAIL (no TLS: keep the listener on a trusted network).
+ * Counters are exported in the "smtp" probe.
+ */
+class SmtpServer
+{
+public:
+    using PostFunction = std::function<void(SmsJob &job)>;
+    using CheckModemRegisteredFunction = std::function<bool()>;
+
+    /**
+     * @brief Start listening
+     *
+     * @param jobs Job pool messages are queued from
+     * @param postFunc Queues a job for sending
+     * @param checkModemRegisteredFunc Registration check before a message is accepted
+     * @param port TCP port
+     */
+    SmtpServer(JobQueue &jobs, PostFunction postFunc, CheckModemRegisteredFunction checkModemRegisteredFunc,
+               uint16_t port = SMTP_PORT);
+
+    /**
+     * @brief Accept connections and serve sessions; call from the main loop
+     */
+    void loop();
+
+    /**
+     * @brief Write {"sessions","maxSessions","connections","messages","queued","duplicates",
+     * "tooLarge","deferred","rejected","authFailures","timeouts","slotWaits","maxSlotWaitMs","bytesIn"}
+     */
+    void toJson(JsonObject &dst) const;
+
+private:
+    enum class Phase : uint8_t
+    {
+        Command,
+        Auth,    ///< 334 sent, waiting for the AUTH PLAIN response
+        Data,    ///< Reading the message
+        Waiting, ///< Message complete, waiting for job slots
+    };
+
+    struct Session
+    {
+        WiFiClient client;
+        bool used = false;
+        Phase phase = Phase::Command;
+        bool greeted = false; ///< HELO/EHLO seen
+        bool authed = false;
+        bool mail = false;    ///< MAIL FROM accepted
+        bool closing = false; ///< Close once the replies are written
+        uint32_t lastMs = 0;
+        uint32_t waitSinceMs = 0;
+        PhoneNumber rcpt[SMTP_RCPT_MAX];
+        uint8_t rcptCount = 0;
+
+        char line[SMTP_LINE_MAX + 1];
+        size_t lineLen = 0;
+        bool overlong = false;  ///< Command line cut, rest discarded
+        bool dataStart = true;  ///< Next DATA byte starts a line
+        uint32_t dataBytes = 0;
+        bool tooLarge = false;
+        MailText text;
+
+        uint8_t rx[256]; ///< Read but not consumed yet (kept while Waiting)
+        uint16_t rxPos = 0;
+        uint16_t rxLen = 0;
+        char out[512];   ///< Replies written at the end of the loop() pass
+        size_t outLen = 0;
+    };
+
+    /** @brief Accepted (Message-ID, recipient) pair */
+    struct Delivered
+    {
+        uint64_t key = 0;
+        uint32_t jobId = 0;
+    };
+
+    WiFiServer server;
+    JobQueue &jobs;
+    PostFunction post;
+    CheckModemRegisteredFunction checkModemRegistered;
+    Session sessions[SMTP_SESSIONS];
+    Delivered delivered[SMTP_DEDUPE];
+    uint8_t deliveredHead = 0;
+
+    uint8_t maxSessions = 0;
+    uint32_t connections = 0;
+    uint32_t messages = 0;
+    uint32_t queued = 0;
+    uint32_t duplicates = 0;
+    uint32_t tooLarge = 0;
+    uint32_t deferred = 0;
+    uint32_t rejected = 0;
+    uint32_t authFailures = 0;
+    uint32_t timeouts = 0;
+    uint32_t slotWaits = 0;
+    uint32_t maxSlotWaitMs = 0;
+    uint32_t bytesIn = 0;
+
+    void accept();
+    void serve(Session &s, uint32_t now);
+    void consume(Session &s, uint8_t c);
+    void command(Session &s);
+    void authPlain(Session &s, const char *response);
+    void dataLine(Session &s, const char *p, size_t n, bool complete);
+    bool finishMessage(Session &s, uint32_t now);
+    void resetTransaction(Session &s);
+    void reply(Session &s, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+    void flush(Session &s);
+    void close(Session &s);
+
+    static uint64_t deliveryKey(uint64_t messageId, const PhoneNumber &to);
+    bool findDelivered(uint64_t key, uint32_t &jobId) const;
+    bool findWaiting(const Session &s, uint64_t key) const;
+};
@@ -0,0 +1,383 @@
+#include "Supervisor.hpp"
+
+#if FEATURE_SUPERVISOR
+
+#include <esp_task_wdt.h>
+#include "RemoteLog.hpp"
+#include "FlashWear.hpp"
+
+namespace
+{
+    /**
+     * @brief Stall record kept across a reset in RTC memory
+     */
+    struct StallRecord
+    {
+        uint32_t magic;
+        uint8_t subsystem;
+        uint8_t action; ///< SupervisorAction
+        char stage[24];
+        uint32_t stalledMs;
+        uint32_t uptimeMs;
+    };
+
+    const uint32_t STALL_MAGIC = 0x53555056; // "SUPV"
+
+    RTC_NOINIT_ATTR StallRecord decision;   ///< Last recovery or restart decision
+    RTC_NOINIT_ATTR StallRecord breadcrumb; ///< Innermost stage on the loop task at the last check
+
+    const char *resetReasonName(esp_reset_reason_t r)
+    {
+        switch (r)
+        {
+        case ESP_RST_POWERON:
+            return "powerOn";
+        case ESP_RST_EXT:
+            return "external";
+        case ESP_RST_SW:
+            return "software";
+        case ESP_RST_PANIC:
+            return "panic";
+        case ESP_RST_INT_WDT:
+            return "interruptWdt";
+        case ESP_RST_TASK_WDT:
+            return "taskWdt";
+        case ESP_RST_WDT:
+            return "otherWdt";
+        case ESP_RST_DEEPSLEEP:
+            return "deepSleep";
+        case ESP_RST_BROWNOUT:
+            return "brownout";
+        default:
+            return "unknown";
+        }
+    }
+
+    const char *actionName(SupervisorAction a)
+    {
+        switch (a)
+        {
+        case SupervisorAction::Recovered:
+            return "recovered";
+        case SupervisorAction::Reboot:
+            return "reboot";
+        case SupervisorAction::Panic:
+            return "panic";
+        default:
+            return "none";
+        }
+    }
+}
+
+Supervisor &Supervisor::instance()
+{
+    static Supervisor inst;
+    return inst;
+}
+
+Supervisor::Supervisor()
+{
+    ProbeRegistry::instance().registerProbe("supervisor", [this](JsonObject &dst)
+                                            { toJson(dst); });
+}
+
+void Supervisor::configure(Subsystem s, uint32_t periodMs, RecoverFunction recover)
+{
+    Watch &w = watches[uint8_t(s)];
+    w.periodMs = periodMs;
+    w.recover = recover;
+}
+
+void Supervisor::begin()
+{
+    if (started)
+        return;
+
+    // Why the previous run ended: a watchdog panic leaves only the breadcrumb,
+    // a supervisor restart its own decision
+    resetReason = esp_reset_reason();
+    bool panic = resetReason == ESP_RST_TASK_WDT || resetReason == ESP_RST_INT_WDT ||
+                 resetReason == ESP_RST_WDT || resetReason == ESP_RST_PANIC;
+    const StallRecord *r = nullptr;
+    if (panic && breadcrumb.magic == STALL_MAGIC)
+        r = &breadcrumb;
+    else if (resetReason == ESP_RST_SW && decision.magic == STALL_MAGIC &&
+             decision.action == uint8_t(SupervisorAction::Reboot))
+        r = &decision;
+    if (r || panic)
+    {
+        hasLastReset = true;
+        lastAction = panic ? SupervisorAction::Panic : SupervisorAction::Reboot;
+    }
+    if (r)
+    {
+        lastSubsystem = r->subsystem < uint8_t(Subsystem::Count) ? r->subsystem : 0;
+        strlcpy(lastStage, r->stage, sizeof(lastStage));
+        lastStalledMs = r->stalledMs;
+        lastUptimeMs = r->uptimeMs;
+        LOG_WARN("WDT", "Last reset: %s, %s in %s after %lu ms (uptime %lu s)",
+                 resetReasonName(resetReason), subsystemName(Subsystem(lastSubsystem)),
+                 lastStage[0] ? lastStage : "-", (unsigned long)lastStalledMs,
+                 (unsigned long)(lastUptimeMs / 1000));
+    }
+    else if (panic)
+        LOG_WARN("WDT", "Last reset: %s", resetReasonName(resetReason));
+    decision.magic = 0;
+    breadcrumb.magic = 0;
+
+    // Reconfigures the TWDT if the core already started it
+    esp_task_wdt_init(SUPERVISOR_TWDT_S, true);
+    loopTask = xTaskGetCurrentTaskHandle();
+    esp_task_wdt_add(loopTask);
+
+    // Same core as the loop and above its priority, so a busy loop cannot starve it
+    xTaskCreatePinnedToCore(taskEntry, "supervisor", SUPERVISOR_STACK, this, 2, &supervisorTask, xPortGetCoreID());
+    started = true;
+    LOG_INFO("WDT", "Supervising, task watchdog %u s", (unsigned)SUPERVISOR_TWDT_S);
+}
+
+void Supervisor::touch(Watch &w)
+{
+    if (w.task.load(std::memory_order_relaxed) == nullptr)
+        w.task.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+}
+
+void Supervisor::beat(Subsystem s)
+{
+    Watch &w = watches[uint8_t(s)];
+    touch(w);
+    w.lastBeatMs.store(millis(), std::memory_order_release);
+    if (started && xTaskGetCurrentTaskHandle() == loopTask)
+        esp_task_wdt_reset();
+}
+
+void Supervisor::taskEntry(void *arg)
+{
+    Supervisor *self = static_cast<Supervisor *>(arg);
+    esp_task_wdt_add(nullptr);
+    for (;;)
+    {
+        esp_task_wdt_reset();
+        self->check();
+        vTaskDelay(pdMS_TO_TICKS(SUPERVISOR_CHECK_MS));
+    }
+}
+
+/**
+ * @brief Past the stage deadline, or past the period since the last beat outside a stage
+ */
+bool Supervisor::overdue(const Watch &w, uint32_t now) const
+{
+    if (w.stage.load(std::memory_order_acquire))
+        return int32_t(now - w.stageDeadlineMs.load(std::memory_order_relaxed)) > 0;
+    return now - w.lastBeatMs.load(std::memory_order_acquire) > w.periodMs;
+}
+
+/**
+ * @brief Whether another subsystem on the same task explains the stall
+ *
+ * Blocked behind a stage that is within budget, or the other one is the
+ * more specific culprit: it is stuck inside a stage while this one is not.
+ * A stall outside every stage cannot be pinned on a subsystem and is the
+ * loop's.
+ */
+bool Supervisor::excused(uint8_t i, uint32_t now) const
+{
+    const Watch &w = watches[i];
+    TaskHandle_t task = w.task.load(std::memory_order_relaxed);
+    bool inStage = w.stage.load(std::memory_order_relaxed) != nullptr;
+    for (uint8_t j = 0; j < uint8_t(Subsystem::Count); ++j)
+    {
+        const Watch &o = watches[j];
+        if (j == i || o.task.load(std::memory_order_relaxed) != task)
+            continue;
+        bool otherInStage = o.stage.load(std::memory_order_relaxed) != nullptr;
+        if (!overdue(o, now))
+        {
+            if (otherInStage)
+                return true;
+            continue;
+        }
+        if (otherInStage && !inStage)
+            return true;
+        if (otherInStage == inStage && j == uint8_t(Subsystem::Loop))
+            return true;
+    }
+    return false;
+}
+
+void Supervisor::check()
+{
+    uint32_t now = millis();
+    int8_t crumb = -1;
+    uint32_t crumbStart = 0;
+    for (uint8_t i = 0; i < uint8_t(Subsystem::Count); ++i)
+    {
+        Watch &w = watches[i];
+        TaskHandle_t task = w.task.load(std::memory_order_relaxed);
+        if (task == nullptr)
+            continue;
+
+        uint32_t start = w.stageStartMs.load(std::memory_order_relaxed);
+        if (task == loopTask && w.stage.load(std::memory_order_relaxed) &&
+            (crumb < 0 || int32_t(start - crumbStart) > 0))
+        {
+            crumb = int8_t(i);
+            crumbStart = start;
+        }
+
+        if (w.level > 0 && int32_t(w.lastBeatMs.load(std::memory_order_relaxed) - w.recoveredAtMs) > 0)
+        {
+            w.level = 0;
+            LOG_NOTICE("WDT", "%s recovered", subsystemName(Subsystem(i)));
+        }
+        if (int32_t(now - w.graceUntilMs) < 0 || !overdue(w, now) || excused(i, now))
+            continue;
+        escalate(i, now);
+    }
+
+    // Survives a task watchdog panic, which gives no chance to write anything
+    if (crumb >= 0)
+    {
+        const char *stage = watches[crumb].stage.load(std::memory_order_relaxed);
+        breadcrumb.subsystem = uint8_t(crumb);
+        breadcrumb.action = uint8_t(SupervisorAction::Panic);
+        strlcpy(breadcrumb.stage, stage ? stage : "", sizeof(breadcrumb.stage));
+        breadcrumb.stalledMs = now - crumbStart;
+        breadcrumb.uptimeMs = now;
+        breadcrumb.magic = STALL_MAGIC;
+    }
+    else
+        breadcrumb.magic = 0;
+}
+
+/**
+ * @brief Recover once, then restart if the subsystem is still stalled
+ */
+void Supervisor::escalate(uint8_t i, uint32_t now)
+{
+    Watch &w = watches[i];
+    const char *stage = w.stage.load(std::memory_order_relaxed);
+    uint32_t stalledMs = stage ? now - w.stageStartMs.load(std::memory_order_relaxed)
+                               : now - w.lastBeatMs.load(std::memory_order_relaxed);
+    w.stalls++;
+    LOG_ERROR("WDT", "%s stalled in %s for %lu ms", subsystemName(Subsystem(i)),
+              stage ? stage : "-", (unsigned long)stalledMs);
+
+    if (w.level == 0 && w.recover)
+    {
+        record(i, SupervisorAction::Recovered, now);
+        LOG_WARN("WDT", "Recovering %s", subsystemName(Subsystem(i)));
+        w.recover();
+        w.level = 1;
+        w.recoveries++;
+        w.recoveredAtMs = millis();
+        w.graceUntilMs = w.recoveredAtMs + w.periodMs;
+        return;
+    }
+
+    record(i, SupervisorAction::Reboot, now);
+    LOG_ERROR("WDT", "Restarting: %s did not recover", subsystemName(Subsystem(i)));
+    if (Subsystem(i) != Subsystem::Storage)
+        FlashWear::instance().save(); // a stalled flash write would block it
+    Serial.flush();
+    ESP.restart();
+}
+
+void Supervisor::record(uint8_t i, SupervisorAction action, uint32_t now)
+{
+    const Watch &w = watches[i];
+    const char *stage = w.stage.load(std::memory_order_relaxed);
+    decision.subsystem = i;
+    decision.action = uint8_t(action);
+    strlcpy(decision.stage, stage ? stage : "", sizeof(decision.stage));
+    decision.stalledMs = stage ? now - w.stageStartMs.load(std::memory_order_relaxed)
+                               : now - w.lastBeatMs.load(std::memory_order_relaxed);
+    decision.uptimeMs = now;
+    decision.magic = STALL_MAGIC;
+}
+
+void Supervisor::toJson(JsonObject &dst)
+{
+    uint32_t now = millis();
+    dst["twdtS"] = SUPERVISOR_TWDT_S;
+    dst["running"] = started;
+    JsonObject subs = dst["subsystems"].to<JsonObject>();
+    for (uint8_t i = 0; i < uint8_t(Subsystem::Count); ++i)
+    {
+        const Watch &w = watches[i];
+        JsonObject o = subs[subsystemName(Subsystem(i))].to<JsonObject>();
+        o["periodMs"] = w.periodMs;
+        if (w.task.load(std::memory_order_relaxed) == nullptr)
+        {
+            o["watched"] = false;
+            continue;
+        }
+        o["sinceBeatMs"] = now - w.lastBeatMs.load(std::memory_order_relaxed);
+        const char *stage = w.stage.load(std::memory_order_relaxed);
+        if (stage)
+        {
+            o["stage"] = stage;
+            o["stageLeftMs"] = int32_t(w.stageDeadlineMs.load(std::memory_order_relaxed) - now);
+        }
+        o["stalls"] = w.stalls;
+        o["recoveries"] = w.recoveries;
+    }
+
+    JsonObject last = dst["lastReset"].to<JsonObject>();
+    last["reason"] = resetReasonName(resetReason);
+    if (hasLastReset)
+    {
+        last["action"] = actionName(lastAction);
+        if (lastStage[0] || lastUptimeMs)
+        {
+            last["subsystem"] = subsystemName(Subsystem(lastSubsystem));
+            last["stage"] = lastStage;
+            last["stalledMs"] = lastStalledMs;
+            last["uptimeMs"] = lastUptimeMs;
+        }
+    }
+}
+
+const char *Supervisor::subsystemName(Subsystem s)
+{
+    switch (s)
+    {
+    case Subsystem::Loop:
+        return "loop";
+    case Subsystem::Modem:
+        return "modem";
+    case Subsystem::Wifi:
+        return "wifi";
+    case Subsystem::Storage:
+        return "storage";
+    default:
+        return "unknown";
+    }
+}
+
+SupervisedStage::SupervisedStage(Subsystem s, const char *name, uint32_t budgetMs) : s(s)
+{
+    Supervisor::Watch &w = Supervisor::instance().watches[uint8_t(s)];
+    Supervisor::instance().touch(w);
+    prevStage = w.stage.load(std::memory_order_relaxed);
+    prevStartMs = w.stageStartMs.load(std::memory_order_relaxed);
+    prevDeadlineMs = w.stageDeadlineMs.load(std::memory_order_relaxed);
+    uint32_t now = millis();
+    // Deadline before the name: the supervisor reads the name first
+    w.stageStartMs.store(now, std::memory_order_relaxed);
+    w.stageDeadlineMs.store(now + budgetMs, std::memory_order_relaxed);
+    w.stage.store(name, std::memory_order_release);
+}
+
+SupervisedStage::~SupervisedStage()
+{
+    // Beat first, so the supervisor never sees the stage gone with a stale beat
+    Supervisor::instance().beat(s);
+    Supervisor::Watch &w = Supervisor::instance().watches[uint8_t(s)];
+    w.stageStartMs.store(prevStartMs, std::memory_order_relaxed);
+    w.stageDeadlineMs.store(prevDeadlineMs, std::memory_order_relaxed);
+    w.stage.store(prevStage, std::memory_order_release);
+}
+
+#endif // FEATURE_SUPERVISOR
@@ -0,0 +1,257 @@
+/**
+ * @file Supervisor.hpp
+ * @brief Per-subsystem heartbeats, stall recovery and the task watchdog
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include <functional>
+#include "Features.hpp"
+#include "ProbeRegistry.hpp"
+
+// ====== Tuning ======
+/**
+ * @def SUPERVISOR_CHECK_MS
+ * @brief Interval of the supervisor task's heartbeat check
+ */
+#ifndef SUPERVISOR_CHECK_MS
+#define SUPERVISOR_CHECK_MS 1000
+#endif
+
+/**
+ * @def SUPERVISOR_TWDT_S
+ * @brief ESP-IDF task watchdog timeout (panic and reboot), last resort
+ *
+ * Must exceed the longest single blocking call between two heartbeats of
+ * a watched task (the 60 s +CMGS wait). Applies to the idle tasks too.
+ */
+#ifndef SUPERVISOR_TWDT_S
+#define SUPERVISOR_TWDT_S 90
+#endif
+
+/**
+ * @def SUPERVISOR_PERIOD_MS
+ * @brief Default longest gap between two heartbeats outside a stage
+ */
+#ifndef SUPERVISOR_PERIOD_MS
+#define SUPERVISOR_PERIOD_MS 10000
+#endif
+
+/**
+ * @def SUPERVISOR_STACK
+ * @brief Stack of the supervisor task in bytes
+ */
+#ifndef SUPERVISOR_STACK
+#define SUPERVISOR_STACK 3072
+#endif
+
+/**
+ * @brief Supervised subsystems
+ *
+ * Fixed ids so any module can open a stage on a subsystem it does not own
+ * (the HTTP send handler runs the modem, History writes for storage).
+ */
+enum class Subsystem : uint8_t
+{
+    Loop = 0, ///< Arduino loop task: HTTP/WS handlers, dispatcher
+    Modem,    ///< AT exchanges
+    Wifi,     ///< Station/AP management
+    Storage,  ///< Flash writers (history, wear counters)
+    Count
+};
+
+/**
+ * @brief What the supervisor did about a stall
+ */
+enum class SupervisorAction : uint8_t
+{
+    None = 0,
+    Recovered, ///< Subsystem recovery ran
+    Reboot,    ///< Recovery failed or none exists: esp_restart()
+    Panic,     ///< Task watchdog or other panic reset (found at boot)
+};
+
+#if FEATURE_SUPERVISOR
+
+/**
+ * @brief Watches subsystem heartbeats from its own task and escalates stalls
+ *
+ * Each subsystem beats from the code that drives it (poll(), wait loops)
+ * and has a period: the longest gap allowed between two beats. Known long
+ * operations open a stage with their own budget instead (SUPERVISED_STAGE),
+ * which also names what was running when a stall hits. While one subsystem
+ * is inside a stage that is within budget, the other subsystems on the same
+ * task are not blamed: they are blocked behind it.
+ *
+ * A stalled subsystem is escalated in steps:
+ * 1. Its recovery function runs on the supervisor task (reset the modem,
+ *    drop the WiFi link) and it gets one more period
+ * 2. Still stalled, or no recovery exists: the stall is recorded and the
+ *    device restarts
+ *
+ * The supervisor task and the loop task are registered with the ESP-IDF
+ * task watchdog (SUPERVISOR_TWDT_S), fed by their heartbeats, as the last
+ * resort if the supervisor itself cannot run. The last stall decision and
+ * the stage running at the last check are kept in RTC memory, so the
+ * reason for a supervisor restart or a watchdog panic is reported after
+ * the reboot ("supervisor" probe, serial log).
+ *
+ * Subsystems share the loop task in this firmware; "restart the task" is
+ * therefore a targeted recovery of the stuck peripheral, not a task restart.
+ */
+class Supervisor
+{
+public:
+    /** @brief Targeted recovery; runs on the supervisor task, must not block long */
+    using RecoverFunction = std::function<void()>;
+
+    static Supervisor &instance();
+
+    /**
+     * @brief Declare a subsystem (typically from its owner's constructor)
+     *
+     * A subsystem is watched from its first beat() or stage on.
+     *
+     * @param periodMs Longest gap between two beats outside a stage
+     * @param recover Targeted recovery, nullptr to restart right away
+     */
+    void configure(Subsystem s, uint32_t periodMs, RecoverFunction recover = nullptr);
+
+    /**
+     * @brief Read the previous reset, watch the calling (loop) task and start the supervisor task
+     *
+     * Call early in setup(): the bring-up stages (modem init, WiFi join)
+     * are supervised from then on.
+     */
+    void begin();
+
+    /**
+     * @brief Heartbeat: the subsystem made progress; feeds the task watchdog
+     */
+    void beat(Subsystem s);
+
+    /**
+     * @brief Write {"twdtS","subsystems":{"<name>":{"periodMs","sinceBeatMs",
+     * "stage","stageLeftMs","stalls","recoveries"}},"lastReset":{"reason",
+     * "subsystem","stage","stalledMs","uptimeMs","action"}}
+     */
+    void toJson(JsonObject &dst);
+
+    static const char *subsystemName(Subsystem s);
+
+private:
+    friend class SupervisedStage;
+
+    struct Watch
+    {
+        uint32_t periodMs = SUPERVISOR_PERIOD_MS;
+        RecoverFunction recover;
+        std::atomic<TaskHandle_t> task{nullptr}; ///< Task seen beating (nullptr: not watched yet)
+        std::atomic<uint32_t> lastBeatMs{0};
+        std::atomic<const char *> stage{nullptr}; ///< Innermost open stage
+        std::atomic<uint32_t> stageStartMs{0};
+        std::atomic<uint32_t> stageDeadlineMs{0};
+        uint8_t level = 0;          ///< 0 healthy, 1 recovered and on probation
+        uint32_t recoveredAtMs = 0; ///< When the recovery ran
+        uint32_t graceUntilMs = 0;  ///< End of probation after a recovery
+        uint32_t stalls = 0;
+        uint32_t recoveries = 0;
+    };
+
+    Supervisor();
+    Supervisor(const Supervisor &) = delete;
+    Supervisor &operator=(const Supervisor &) = delete;
+
+    static void taskEntry(void *arg);
+    void check();
+    bool overdue(const Watch &w, uint32_t now) const;
+    bool excused(uint8_t i, uint32_t now) const;
+    void escalate(uint8_t i, uint32_t now);
+    void record(uint8_t i, SupervisorAction action, uint32_t now);
+    void touch(Watch &w);
+
+    Watch watches[uint8_t(Subsystem::Count)];
+    bool started = false;
+    TaskHandle_t loopTask = nullptr;
+    TaskHandle_t supervisorTask = nullptr;
+
+    // Copy of the RTC records taken at boot
+    esp_reset_reason_t resetReason = ESP_RST_UNKNOWN;
+    bool hasLastReset = false;
+    uint8_t lastSubsystem = 0;
+    SupervisorAction lastAction = SupervisorAction::None;
+    char lastStage[24] = {};
+    uint32_t lastStalledMs = 0;
+    uint32_t lastUptimeMs = 0;
+};
+
+/**
+ * @brief Scoped stage of a subsystem with its own time budget
+ *
+ * Nests: the enclosing stage is restored on exit, and leaving a stage
+ * counts as a heartbeat.
+ */
+class SupervisedStage
+{
+public:
+    SupervisedStage(Subsystem s, const char *name, uint32_t budgetMs);
+    ~SupervisedStage();
+
+    SupervisedStage(const SupervisedStage &) = delete;
+    SupervisedStage &operator=(const SupervisedStage &) = delete;
+
+private:
+    Subsystem s;
+    const char *prevStage;
+    uint32_t prevStartMs;
+    uint32_t prevDeadlineMs;
+};
+
+#define SUPERVISED_STAGE_CAT2(a, b) a##b
+#define SUPERVISED_STAGE_CAT(a, b) SUPERVISED_STAGE_CAT2(a, b)
+
+/**
+ * @def SUPERVISED_STAGE
+ * @brief Run the rest of the enclosing scope as a named stage of a subsystem
+ *
+ * @code
+ * SUPERVISED_STAGE(Subsystem::Modem, "sms.cmgs", 60000 + 5000);
+ * @endcode
+ */
+#define SUPERVISED_STAGE(subsystem, name, budgetMs) \
+    SupervisedStage SUPERVISED_STAGE_CAT(supervisedStage_, __LINE__)(subsystem, name, budgetMs)
+
+#else // !FEATURE_SUPERVISOR
+
+/**
+ * @brief Stand-in when the supervisor is compiled out
+ *
+ * Heartbeats and stages cost nothing; only the ESP-IDF default watchdogs
+ * guard the device.
+ */
+class Supervisor
+{
+public:
+    using RecoverFunction = std::function<void()>;
+
+    static Supervisor &instance()
+    {
+        static Supervisor inst;
+        return inst;
+    }
+
+    void configure(Subsystem, uint32_t, RecoverFunction = nullptr) {}
+    void begin() {}
+    void beat(Subsystem) {}
+};
+
+#define SUPERVISED_STAGE(subsystem, name, budgetMs) \
+    ((void)(subsystem), (void)(name), (void)(budgetMs))
+
+#endif // FEATURE_SUPERVISOR
@@ -1,4 +1,5 @@
 #include "WifiConnection.hpp"
+#include "RemoteLog.hpp"
 
 /**
  * @brief Static null IP address constant for connect_t initialization
@@ -118,6 +119,13 @@ void WifiStatus::toJson(JsonObject &root)
 {
     root["connected"] = isWifiConnected();
     root["ipAddress"] = getIpAddress();
+    bool ap = WiFi.getMode() & WIFI_AP;
+    root["apActive"] = ap;
+    if (ap)
+    {
+        root["apIp"] = WiFi.softAPIP().toString();
+        root["apClients"] = WiFi.softAPgetStationNum();
+    }
 }
 
 /**
@@ -139,6 +147,18 @@ String WifiStatus::toString()
  */
 WifiConnection::WifiConnection(GSettings &settings) : settings(settings), wifiStatus()
 {
+    ProbeRegistry::instance().registerProbe("wifiPowerSave", [this](JsonObject &dst)
+                                            { this->powerSaveToJson(dst); });
+    inbox.on<HttpRequestServed>([this](const HttpRequestServed &e)
+                                { noteRequest(e.us); });
+    inbox.on<WifiConnectRequested>([this](const WifiConnectRequested &)
+                                   {
+        attemptPending = true;
+        attemptStartMs = millis();
+        restartJoin(WiFi.status() == WL_CONNECTED); });
+    // A stuck join or driver call: dropping the link makes it return
+    Supervisor::instance().configure(Subsystem::Wifi, SUPERVISOR_PERIOD_MS, []()
+                                     { WiFi.disconnect(); });
 }
 
 /**
@@ -159,8 +179,9 @@ WifiConnection::~WifiConnection()
  * - Sets WiFi to station mode and configures hostname
  * - Enables auto-reconnect functionality
  * - Attempts connection using SSID and password from settings
- * - Waits up to 120 seconds for successful connection
+ * - Waits up to 20 seconds for successful connection
  * - Updates internal status on success/failure
+ * - Starts the SoftAP per the AP policy (failed link or ApMode::Always)
  *
  * Connection process includes visual feedback via Serial output.
  *
@@ -176,10 +197,26 @@ connect_t WifiConnection::connect()
         return {false, connect_t::NULL_IP};
     }
     isConnectionTrying = true;
-    WiFi.mode(WIFI_STA);
+    SUPERVISED_STAGE(Subsystem::Wifi, "wifi.join", 20000 + 5000);
+    networksRevision = settings.getNetworksRevision();
+    WiFi.mode(apActive ? WIFI_AP_STA : WIFI_STA);
     WiFi.setHostname(settings.getDeviceName().c_str());
     WiFi.setAutoReconnect(true);
+    if (settings.getApMode() == ApMode::Always && wantAccessPoint(false))
+        startAccessPoint();
+    if (settings.getSsid().isEmpty())
+    {
+        // Nothing to join: do not burn 20 s waiting, serve on the AP instead
+        Serial.println("No WiFi network configured");
+        isConnectionTrying = false;
+        if (wantAccessPoint(false))
+            startAccessPoint();
+        return {false, connect_t::NULL_IP};
+    }
     WiFi.begin(settings.getSsid().c_str(), settings.getPassword().c_str());
+    applyListenInterval();
+    applyPowerSave();
+    lastReconnectMs = millis();
     Serial.println("Connecting to WiFi...");
     int maxRetries = 40; // Wait for a maximum of 20 seconds (40 * 500ms = 20s)
     int i = 0;
@@ -193,6 +230,8 @@ connect_t WifiConnection::connect()
     {
         Serial.println("Could not connect to network");
         isConnectionTrying = false;
+        if (wantAccessPoint(false))
+            startAccessPoint();
         return {false, connect_t::NULL_IP};
     }
     isConnectionTrying = false;
@@ -229,3 +268,227 @@ WifiStatus &WifiConnection::getStatus()
 {
     return wifiStatus;
 }
+
+/**
+ * @brief Answer DNS, handle events, apply the AP policy and retry the station link
+ */
+void WifiConnection::poll()
+{
+    Supervisor::instance().beat(Subsystem::Wifi);
+    if (apActive)
+        dns.processNextRequest();
+    if (isConnectionTrying)
+        return;
+    inbox.drain();
+    applyPowerSave();
+
+    bool staUp = WiFi.status() == WL_CONNECTED;
+    if (settings.getNetworksRevision() != networksRevision)
+    {
+        // New credentials: retry right away, starting over at the primary
+        networksRevision = settings.getNetworksRevision();
+        restartJoin(staUp);
+        staUp = false;
+    }
+    bool want = wantAccessPoint(staUp);
+    if (want && !apActive)
+        startAccessPoint();
+    else if (!want && apActive)
+        stopAccessPoint();
+
+    if (!staUp && !settings.getSsid().isEmpty() && millis() - lastReconnectMs >= WIFI_RECONNECT_MS)
+    {
+        // Non-blocking: the result shows up in WiFi.status() on a later poll
+        lastReconnectMs = millis();
+        networkIndex = (networkIndex + 1) % settings.getNetworkCount();
+        WiFi.begin(settings.getNetworkSsid(networkIndex).c_str(), settings.getNetworkPassword(networkIndex).c_str());
+        applyListenInterval();
+    }
+
+    // Only a link joined after the request counts as its outcome
+    bool joined = staUp && int32_t(lastReconnectMs - attemptStartMs) >= 0;
+    if (attemptPending && (joined || millis() - attemptStartMs >= WIFI_CONNECT_TIMEOUT_MS))
+    {
+        attemptPending = false;
+        publishState(joined, true);
+    }
+    else if (staUp != publishedStaUp || apActive != publishedAp)
+        publishState(staUp, false);
+}
+
+void WifiConnection::restartJoin(bool staUp)
+{
+    networkIndex = settings.getNetworkCount() - 1; // the next retry wraps to the primary
+    lastReconnectMs = millis() - WIFI_RECONNECT_MS;
+    if (staUp)
+    {
+        LOG_INFO("WIFI", "Networks changed, reconnecting");
+        WiFi.disconnect();
+    }
+}
+
+void WifiConnection::publishState(bool staUp, bool attempt)
+{
+    publishedStaUp = staUp;
+    publishedAp = apActive;
+    if (staUp)
+        wifiStatus.updateConnection({true, WiFi.localIP()});
+    EventBus::instance().publish(WifiStateChanged{staUp, apActive, attempt, staUp ? uint32_t(WiFi.localIP()) : 0});
+}
+
+/**
+ * @brief Whether the SoftAP is currently running
+ */
+bool WifiConnection::isAccessPointActive()
+{
+    return apActive;
+}
+
+/**
+ * @brief Switch to no-sleep immediately; the configured policy is restored by poll()
+ */
+void WifiConnection::setLowLatency(bool on)
+{
+    if (on == lowLatency)
+        return;
+    lowLatency = on;
+    if (on)
+        applyPowerSave();
+}
+
+/**
+ * @brief Add a request latency sample to the policy in effect
+ */
+void WifiConnection::noteRequest(uint32_t us)
+{
+    RequestLatency &l = latency[uint8_t(appliedPs)];
+    l.count++;
+    l.sumUs += us;
+    if (us > l.maxUs)
+        l.maxUs = us;
+}
+
+/**
+ * @brief Export the configured/effective policy and per-policy request latency
+ */
+void WifiConnection::powerSaveToJson(JsonObject &root)
+{
+    root["configured"] = GSettings::powerSaveName(settings.getWifiPowerSave());
+    root["effective"] = GSettings::powerSaveName(appliedPs);
+    root["listenInterval"] = settings.getListenInterval();
+    JsonObject requests = root["requests"].to<JsonObject>();
+    for (WifiPowerSave m : {WifiPowerSave::None, WifiPowerSave::Min, WifiPowerSave::Max})
+    {
+        const RequestLatency &l = latency[uint8_t(m)];
+        JsonObject o = requests[GSettings::powerSaveName(m)].to<JsonObject>();
+        o["count"] = l.count;
+        o["avgUs"] = l.count ? uint32_t(l.sumUs / l.count) : 0;
+        o["maxUs"] = l.maxUs;
+    }
+}
+
+/**
+ * @brief Map the effective policy to wifi_ps_type_t, only when the driver differs
+ *
+ * Goes through WiFi.setSleep() so the core's STA_START handler re-applies
+ * our policy (it calls esp_wifi_set_ps() with its own copy after mode
+ * changes, disconnect(true) and begin()). The driver is asked for its
+ * current mode instead of trusting appliedPs, which the probe and the
+ * latency buckets report.
+ */
+void WifiConnection::applyPowerSave()
+{
+    WifiPowerSave want = lowLatency ? WifiPowerSave::None : settings.getWifiPowerSave();
+    if (WiFi.getMode() == WIFI_OFF)
+        return;
+
+    wifi_ps_type_t ps = want == WifiPowerSave::None  ? WIFI_PS_NONE
+                        : want == WifiPowerSave::Max ? WIFI_PS_MAX_MODEM
+                                                     : WIFI_PS_MIN_MODEM;
+    wifi_ps_type_t current;
+    if (want == appliedPs && esp_wifi_get_ps(&current) == ESP_OK && current == ps)
+        return;
+    if (!WiFi.setSleep(ps))
+    {
+        LOG_WARN("WIFI", "Power save change failed");
+        return;
+    }
+    appliedPs = want;
+    LOG_INFO("WIFI", "Power save: %s", GSettings::powerSaveName(want));
+}
+
+/**
+ * @brief WiFi.begin() resets listen_interval to the IDF default, so patch it afterwards
+ */
+void WifiConnection::applyListenInterval()
+{
+    wifi_config_t conf;
+    if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK)
+        return;
+    if (conf.sta.listen_interval == settings.getListenInterval())
+        return;
+    conf.sta.listen_interval = settings.getListenInterval();
+    esp_wifi_set_config(WIFI_IF_STA, &conf);
+}
+
+/**
+ * @brief Fallback: only while the station is down, but never drop an AP
+ * that still has clients attached (they may be mid-configuration)
+ */
+bool WifiConnection::wantAccessPoint(bool staUp)
+{
+    if (settings.getApPassword().length() < AP_PASSWORD_MIN)
+        return false; // never an open AP, whatever the mode
+    switch (settings.getApMode())
+    {
+    case ApMode::Always:
+        return true;
+    case ApMode::Off:
+        return false;
+    default:
+        return !staUp || (apActive && WiFi.softAPgetStationNum() > 0);
+    }
+}
+
+/**
+ * @brief Switch to AP+STA, start the SoftAP and the wildcard DNS responder
+ *
+ * Refuses a password shorter than AP_PASSWORD_MIN, whoever calls it.
+ */
+void WifiConnection::startAccessPoint()
+{
+    if (apActive)
+        return;
+    String pass = settings.getApPassword();
+    if (pass.length() < AP_PASSWORD_MIN)
+    {
+        LOG_WARN("WIFI", "SoftAP not started: apPassword needs %u+ characters", (unsigned)AP_PASSWORD_MIN);
+        return;
+    }
+    IPAddress apIp(WIFI_AP_IP);
+    WiFi.mode(WIFI_AP_STA);
+    WiFi.softAPConfig(apIp, apIp, IPAddress(255, 255, 255, 0));
+    if (!WiFi.softAP(settings.getDeviceName().c_str(), pass.c_str(), WIFI_AP_CHANNEL))
+    {
+        LOG_ERROR("WIFI", "SoftAP start failed");
+        return;
+    }
+    dns.setErrorReplyCode(DNSReplyCode::NoError);
+    dns.start(53, "*", apIp);
+    apActive = true;
+    LOG_NOTICE("WIFI", "SoftAP \"%s\" up at %s", settings.getDeviceName().c_str(), apIp.toString().c_str());
+}
+
+/**
+ * @brief Tear down the DNS responder and the SoftAP, keeping the station
+ */
+void WifiConnection::stopAccessPoint()
+{
+    if (!apActive)
+        return;
+    dns.stop();
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_STA);
+    apActive = false;
+    LOG_NOTICE("WIFI", "SoftAP stopped");
+}
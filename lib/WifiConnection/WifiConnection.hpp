@@ -1,8 +1,45 @@
 #pragma once
 
 #include <WiFi.h>
+#include <DNSServer.h>
+#include <esp_wifi.h>
 #include "GSettings.hpp"
 #include "ProbeRegistry.hpp"
+#include "EventBus.hpp"
+#include "Supervisor.hpp"
+
+// ====== Tuning ======
+/**
+ * @def WIFI_RECONNECT_MS
+ * @brief Interval between background station reconnect attempts while the link is down
+ */
+#ifndef WIFI_RECONNECT_MS
+#define WIFI_RECONNECT_MS (30 * SECOND)
+#endif
+
+/**
+ * @def WIFI_CONNECT_TIMEOUT_MS
+ * @brief Time a requested join (WifiConnectRequested) gets before it is reported as failed
+ */
+#ifndef WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_CONNECT_TIMEOUT_MS (20 * SECOND)
+#endif
+
+/**
+ * @def WIFI_AP_IP
+ * @brief SoftAP address (also the gateway and captive-portal DNS answer)
+ */
+#ifndef WIFI_AP_IP
+#define WIFI_AP_IP 192, 168, 4, 1
+#endif
+
+/**
+ * @def WIFI_AP_CHANNEL
+ * @brief SoftAP channel; the radio follows the station channel once associated
+ */
+#ifndef WIFI_AP_CHANNEL
+#define WIFI_AP_CHANNEL 6
+#endif
 
 /**
  * @brief Structure to hold WiFi connection information
@@ -131,7 +168,10 @@ public:
      * Output format:
      * {
      *   "connected": true/false,
-     *   "ipAddress": "192.168.1.100" or "0.0.0.0"
+     *   "ipAddress": "192.168.1.100" or "0.0.0.0",
+     *   "apActive": true/false,
+     *   "apIp": "192.168.4.1",   // only while the SoftAP runs
+     *   "apClients": 1           // only while the SoftAP runs
      * }
      *
      * @param root JSON object reference to populate with status data
@@ -165,7 +205,17 @@ private:
  * - Hostname configuration
  * - Auto-reconnect functionality
  * - Connection timeout handling
+ * - SoftAP alongside the station link (GSettings::getApMode()) with a
+ *   captive-portal DNS responder, so the API stays reachable without
+ *   infrastructure WiFi
+ * - Non-blocking background reconnects while the station link is down
+ * - Station power-save policy (GSettings::getWifiPowerSave()), forced to
+ *   WifiPowerSave::None while work is pending, with per-policy HTTP request
+ *   latency reported by the "wifiPowerSave" probe
  * - Clean disconnection and resource cleanup
+ * - EventBus: publishes WifiStateChanged on every station/AP change, joins
+ *   on WifiConnectRequested and accounts HttpRequestServed latency, all on
+ *   the loop task from poll()
  *
  * @note Connection attempts are protected against concurrent execution
  */
@@ -201,6 +251,8 @@ public:
      * - Enabling auto-reconnect functionality
      * - Waiting up to 20 seconds for connection establishment
      * - Updating internal status on success/failure
+     * - Starting the SoftAP when the link failed (ApMode::Fallback) or
+     *   unconditionally (ApMode::Always)
      *
      * @return connect_t Structure containing connection result:
      *         - isConnected: true if connection successful
@@ -234,8 +286,120 @@ public:
      */
     WifiStatus &getStatus();
 
+    /**
+     * @brief Service the captive portal and keep both links in shape
+     *
+     * Call from loop(). Answers pending DNS queries, applies the AP policy
+     * (start the SoftAP when the station link drops in fallback mode, stop it
+     * once the link is back and no client is attached) and retries the
+     * station association every WIFI_RECONNECT_MS without blocking. Each
+     * retry moves on to the next stored network (primary, then fallbacks).
+     * When the stored networks change (GSettings::getNetworksRevision())
+     * the station leaves its network and starts over at the primary.
+     * Handles the events queued for the "wifi" inbox first.
+     */
+    void poll();
+
+    /**
+     * @brief Whether the SoftAP is currently running
+     *
+     * @retval true Access point up (WIFI_AP_STA mode)
+     */
+    bool isAccessPointActive();
+
+    /**
+     * @brief Hold the radio awake while work is pending
+     *
+     * While on, WifiPowerSave::None is in effect regardless of the configured
+     * policy; the configured policy returns on the next poll() after it is
+     * released. Call every loop iteration (e.g. with "jobs queued").
+     *
+     * @param on true while jobs are queued or a batch is being received
+     */
+    void setLowLatency(bool on);
+
+    /**
+     * @brief Account one served HTTP request to the policy in effect
+     *
+     * @param us Time from accepting the request to the response being sent
+     */
+    void noteRequest(uint32_t us);
+
+    /**
+     * @brief Write power-save state: {"configured","effective","listenInterval",
+     * "requests":{"none"|"min"|"max":{"count","avgUs","maxUs"}}}
+     */
+    void powerSaveToJson(JsonObject &root);
+
 private:
+    /**
+     * @brief Request latency aggregate for one power-save policy
+     */
+    struct RequestLatency
+    {
+        uint32_t count = 0; ///< Requests served
+        uint64_t sumUs = 0; ///< Sum of latencies
+        uint32_t maxUs = 0; ///< Worst latency
+    };
+
+    /**
+     * @brief Push the effective power-save policy to the WiFi driver if it changed
+     */
+    void applyPowerSave();
+
+    /**
+     * @brief Store the configured listen interval in the station config
+     *
+     * Used by the access point from the next association on.
+     */
+    void applyListenInterval();
+
+    /**
+     * @brief Leave the current network and retry at the primary on this poll
+     */
+    void restartJoin(bool staUp);
+
+    /**
+     * @brief Publish WifiStateChanged with the current state
+     *
+     * @param attempt Outcome of a WifiConnectRequested
+     */
+    void publishState(bool staUp, bool attempt);
+
+    /**
+     * @brief Bring up the SoftAP and the captive-portal DNS responder
+     *
+     * SSID is the device name. Nothing is started when the configured
+     * password is shorter than AP_PASSWORD_MIN, so the AP is never open.
+     */
+    void startAccessPoint();
+
+    /**
+     * @brief Stop the captive-portal DNS responder and the SoftAP
+     */
+    void stopAccessPoint();
+
+    /**
+     * @brief Whether the AP policy wants the SoftAP up right now
+     *
+     * @param staUp Station link state
+     */
+    bool wantAccessPoint(bool staUp);
+
     GSettings &settings;             ///< Reference to global settings for WiFi credentials
     WifiStatus wifiStatus;           ///< WiFi status tracking object
+    DNSServer dns;                   ///< Captive-portal responder (all names resolve to the AP)
     bool isConnectionTrying = false; ///< Flag to prevent concurrent connection attempts
+    bool apActive = false;           ///< SoftAP and DNS responder running
+    uint32_t lastReconnectMs = 0;    ///< millis() of the last background WiFi.begin()
+    uint8_t networkIndex = 0;        ///< Stored network tried by the last background WiFi.begin()
+    uint32_t networksRevision = 0;   ///< GSettings::getNetworksRevision() the station is using
+    bool lowLatency = false;         ///< Pending work forces WifiPowerSave::None
+    WifiPowerSave appliedPs = WifiPowerSave::Min; ///< Policy last pushed to the driver (IDF default)
+    RequestLatency latency[3];       ///< Request latency indexed by WifiPowerSave
+    EventInbox inbox{"wifi"};        ///< WifiConnectRequested, HttpRequestServed
+    bool attemptPending = false;     ///< A WifiConnectRequested awaits its outcome
+    uint32_t attemptStartMs = 0;     ///< millis() of that request
+    bool publishedStaUp = false;     ///< Station state in the last WifiStateChanged
+    bool publishedAp = false;        ///< SoftAP state in the last WifiStateChanged
 };
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "WsProtocol.hpp"
+#include <string.h>
+
+namespace
+{
+    void put16(uint8_t *p, uint16_t v)
+    {
+        p[0] = uint8_t(v);
+        p[1] = uint8_t(v >> 8);
+    }
+
+    void put32(uint8_t *p, uint32_t v)
+    {
+        put16(p, uint16_t(v));
+        put16(p + 2, uint16_t(v >> 16));
+    }
+
+    uint16_t get16(const uint8_t *p) { return uint16_t(p[0] | (p[1] << 8)); }
+}
+
+/**
+ * @brief Field by field, in the precedence order of SendRequestDecoder
+ */
+WsReject WsProtocol::decodeSend(const uint8_t *frame, size_t len, uint16_t &corr, SmsJob &job)
+{
+    job.resetRequest();
+    if (len < 5 || frame[0] != uint8_t(WsOp::Send))
+        return WsReject::Frame;
+    corr = get16(frame + 1);
+    uint8_t flags = frame[3];
+    size_t phoneLen = frame[4];
+    size_t pos = 5 + phoneLen;
+    size_t windowLen = (flags & FLAG_WINDOW) ? 4 : 0;
+    if (pos + windowLen > len)
+        return WsReject::Frame;
+
+    if (!job.to.parse(reinterpret_cast<const char *>(frame + 5), phoneLen))
+        return WsReject::Phone;
+
+    size_t bodyLen = len - pos - windowLen;
+    if (bodyLen == 0 || bodyLen > JOB_BODY_MAX || job.body == nullptr)
+        return WsReject::Message;
+    memcpy(job.body, frame + pos + windowLen, bodyLen);
+    job.body[bodyLen] = '\0';
+    job.bodyLen = uint16_t(bodyLen);
+
+    uint8_t priority = flags & FLAG_PRIORITY;
+    if (priority > uint8_t(JobPriority::High))
+        return WsReject::Option;
+    job.priority = JobPriority(priority);
+
+    if (windowLen)
+    {
+        uint16_t start = get16(frame + pos);
+        uint16_t end = get16(frame + pos + 2);
+        if (start >= 24 * 60 || end >= 24 * 60 || start == end)
+            return WsReject::Window;
+        job.windowStart = start;
+        job.windowEnd = end;
+    }
+    return WsReject::None;
+}
+
+size_t WsProtocol::hello(uint8_t *out, uint8_t window, bool authRequired)
+{
+    out[0] = uint8_t(WsOp::Hello);
+    out[1] = VERSION;
+    out[2] = window;
+    put16(out + 3, JOB_BODY_MAX);
+    out[5] = authRequired ? 1 : 0;
+    return HELLO_LEN;
+}
+
+size_t WsProtocol::accept(uint8_t *out, uint16_t corr, uint32_t jobId, uint32_t releaseAt)
+{
+    out[0] = uint8_t(WsOp::Accept);
+    put16(out + 1, corr);
+    put32(out + 3, jobId);
+    put32(out + 7, releaseAt);
+    return ACCEPT_LEN;
+}
+
+size_t WsProtocol::reject(uint8_t *out, uint16_t corr, WsReject reason)
+{
+    out[0] = uint8_t(WsOp::Reject);
+    put16(out + 1, corr);
+    out[3] = uint8_t(reason);
+    return REJECT_LEN;
+}
+
+size_t WsProtocol::status(uint8_t *out, uint32_t jobId, WsJobStatus status, uint8_t tpStatus)
+{
+    out[0] = uint8_t(WsOp::Status);
+    put32(out + 1, jobId);
+    out[5] = uint8_t(status);
+    out[6] = tpStatus;
+    return STATUS_LEN;
+}
+
+size_t WsProtocol::inbound(uint8_t *out, size_t cap, uint32_t time, const char *from, const char *text)
+{
+    size_t fromLen = strlen(from);
+    if (fromLen > 255 || INBOUND_HEADER + fromLen > cap)
+        return 0;
+    out[0] = uint8_t(WsOp::Inbound);
+    put32(out + 1, time);
+    out[5] = uint8_t(fromLen);
+    memcpy(out + INBOUND_HEADER, from, fromLen);
+    size_t pos = INBOUND_HEADER + fromLen;
+    size_t textLen = strlen(text);
+    if (textLen > cap - pos)
+        textLen = cap - pos;
+    memcpy(out + pos, text, textLen);
+    return pos + textLen;
+}
+
+const char *WsProtocol::rejectName(WsReject reason)
+{
+    switch (reason)
+    {
+    case WsReject::None:
+        return "none";
+    case WsReject::Frame:
+        return "frame";
+    case WsReject::Phone:
+        return "phone";
+    case WsReject::Message:
+        return "message";
+    case WsReject::Option:
+        return "option";
+    case WsReject::Window:
+        return "window";
+    case WsReject::WindowNever:
+        return "windowNever";
+    case WsReject::Busy:
+        return "busy";
+    case WsReject::FlowControl:
+        return "flowControl";
+    case WsReject::NotRegistered:
+        return "notRegistered";
+    case WsReject::Unauthorized:
+        return "unauthorized";
+    }
+    return "unknown";
+}
@@ -0,0 +1,115 @@
+/**
+ * @file WsProtocol.hpp
+ * @brief Binary WebSocket frames of the pipelined send API
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "SmsJob.hpp"
+
+/**
+ * @brief First byte of every frame
+ *
+ * Client frames have the top bit clear, device frames have it set.
+ */
+enum class WsOp : uint8_t
+{
+    Send = 0x01,       ///< u16 corr, u8 flags, u8 phoneLen, phone, [u16 start, u16 end], body
+    Auth = 0x02,       ///< API key bytes
+    Hello = 0x80,      ///< u8 version, u8 window, u16 body max, u8 auth required
+    Accept = 0x81,     ///< u16 corr, u32 job id, u32 releaseAt (0 = queued now)
+    Reject = 0x82,     ///< u16 corr, u8 WsReject
+    Status = 0x83,     ///< u32 job id, u8 WsJobStatus, u8 TP-ST (0xFF = none)
+    Inbound = 0x84,    ///< u32 UTC seconds, u8 fromLen, from, text
+    AuthResult = 0x85, ///< u8 1 = accepted
+};
+
+/**
+ * @brief Why a Send frame was refused (Reject frame)
+ */
+enum class WsReject : uint8_t
+{
+    None = 0,
+    Frame,         ///< Truncated or unknown frame
+    Phone,         ///< Not a valid number
+    Message,       ///< Body empty or over JOB_BODY_MAX
+    Option,        ///< Unknown priority
+    Window,        ///< Window minutes out of range or empty
+    WindowNever,   ///< Window never open in all zones of the destination
+    Busy,          ///< No free job slot, or JOB_PARK_MAX jobs parked
+    FlowControl,   ///< Connection window exhausted
+    NotRegistered, ///< Modem not registered (jobs without a window)
+    Unauthorized,  ///< API keys are provisioned and no valid Auth frame was sent
+};
+
+/**
+ * @brief Outcome pushed in a Status frame
+ */
+enum class WsJobStatus : uint8_t
+{
+    Sent = 1,        ///< Network accepted every part
+    Failed = 2,      ///< Abandoned
+    Delivered = 3,   ///< Status report with TP-ST 0
+    Undelivered = 4, ///< Status report with any other TP-ST
+};
+
+/**
+ * @brief Encoders and the Send decoder (no Arduino dependency)
+ *
+ * All integers are little-endian. A Send frame carries everything the
+ * `/send` JSON body does, so it reuses the same job record and checks:
+ *
+ * | Offset | Size | Field |
+ * |--------|------|-------|
+ * | 0 | 1 | 0x01 |
+ * | 1 | 2 | correlation id, echoed in Accept/Reject |
+ * | 3 | 1 | flags: bits 0-1 priority (0 low, 1 normal, 2 high), bit 2 window |
+ * | 4 | 1 | phone length n |
+ * | 5 | n | phone as text ("+407...") |
+ * | 5+n | 4 | window start, end: recipient-local minutes of day (bit 2 only) |
+ * | ... | rest | UTF-8 body |
+ */
+class WsProtocol
+{
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr uint8_t FLAG_PRIORITY = 0x03;
+    static constexpr uint8_t FLAG_WINDOW = 0x04;
+    static constexpr size_t HELLO_LEN = 6;
+    static constexpr size_t ACCEPT_LEN = 11;
+    static constexpr size_t REJECT_LEN = 4;
+    static constexpr size_t STATUS_LEN = 7;
+    static constexpr size_t INBOUND_HEADER = 6; ///< Inbound bytes before from and text
+
+    /**
+     * @brief Decode a Send frame into a job record
+     *
+     * @param corr Set to the correlation id once the frame has one
+     * @param job Destination record (request fields are reset first)
+     * @return WsReject None on success, otherwise the first error
+     */
+    static WsReject decodeSend(const uint8_t *frame, size_t len, uint16_t &corr, SmsJob &job);
+
+    /** @brief Write a Hello frame (HELLO_LEN bytes) */
+    static size_t hello(uint8_t *out, uint8_t window, bool authRequired);
+
+    /** @brief Write an Accept frame (ACCEPT_LEN bytes) */
+    static size_t accept(uint8_t *out, uint16_t corr, uint32_t jobId, uint32_t releaseAt);
+
+    /** @brief Write a Reject frame (REJECT_LEN bytes) */
+    static size_t reject(uint8_t *out, uint16_t corr, WsReject reason);
+
+    /** @brief Write a Status frame (STATUS_LEN bytes) */
+    static size_t status(uint8_t *out, uint32_t jobId, WsJobStatus status, uint8_t tpStatus);
+
+    /**
+     * @brief Write an Inbound frame, truncating the text to fit @p cap
+     *
+     * @return size_t Frame length, 0 if not even the header and sender fit
+     */
+    static size_t inbound(uint8_t *out, size_t cap, uint32_t time, const char *from, const char *text);
+
+    static const char *rejectName(WsReject reason);
+};
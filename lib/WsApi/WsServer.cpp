@@ -0,0 +1,268 @@
+#include "WsServer.hpp"
+#include "SmsDispatcher.hpp"
+#include "Provisioner.hpp"
+#include "RemoteLog.hpp"
+
+/**
+ * @brief Bind the job path, start the socket server and register the "ws" probe
+ */
+WsServer::WsServer(JobQueue &jobs, PostFunction postFunc, ScheduleFunction scheduleFunc,
+                   CheckModemRegisteredFunction checkModemRegisteredFunc, uint16_t port)
+    : server(port), jobs(jobs), post(postFunc), schedule(scheduleFunc), checkModemRegistered(checkModemRegisteredFunc)
+{
+    server.onEvent([this](uint8_t num, WStype_t type, uint8_t *payload, size_t length)
+                   { onEvent(num, type, payload, length); });
+    server.begin();
+    ProbeRegistry::instance().registerProbe("ws", [this](JsonObject &dst)
+                                            { toJson(dst); });
+    LOG_INFO("WS", "Listening on port %u", (unsigned)port);
+}
+
+void WsServer::loop()
+{
+    server.loop();
+}
+
+/**
+ * @brief Connection bookkeeping and frame routing
+ */
+void WsServer::onEvent(uint8_t num, WStype_t type, uint8_t *payload, size_t length)
+{
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX)
+        return;
+    Client &c = clients[num];
+    switch (type)
+    {
+    case WStype_CONNECTED:
+    {
+        c = Client();
+        c.open = true;
+        c.authed = !Provisioner::instance().hasApiKeys();
+        uint8_t hello[WsProtocol::HELLO_LEN];
+        send(num, hello, WsProtocol::hello(hello, WS_WINDOW, !c.authed));
+        break;
+    }
+    case WStype_DISCONNECTED:
+        // Accepted jobs still run; their status has nowhere to go
+        c = Client();
+        break;
+    case WStype_BIN:
+        framesIn++;
+        wireIn += length + headerBytes(length, true);
+        if (length > 0 && payload[0] == uint8_t(WsOp::Send))
+            handleSend(num, payload, length);
+        else if (length > 0 && payload[0] == uint8_t(WsOp::Auth))
+            handleAuth(num, payload, length);
+        else
+        {
+            uint8_t reply[WsProtocol::REJECT_LEN];
+            send(num, reply, WsProtocol::reject(reply, 0, WsReject::Frame));
+            rejected[uint8_t(WsReject::Frame)]++;
+        }
+        break;
+    case WStype_TEXT:
+    {
+        framesIn++;
+        wireIn += length + headerBytes(length, true);
+        uint8_t reply[WsProtocol::REJECT_LEN];
+        send(num, reply, WsProtocol::reject(reply, 0, WsReject::Frame));
+        rejected[uint8_t(WsReject::Frame)]++;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Decode, check and queue one Send frame; answer Accept or Reject
+ */
+void WsServer::handleSend(uint8_t num, const uint8_t *frame, size_t len)
+{
+    Client &c = clients[num];
+    uint16_t corr = len >= 3 ? uint16_t(frame[1] | (frame[2] << 8)) : 0;
+    WsReject reason = WsReject::None;
+    SmsJob *job = nullptr;
+    uint32_t releaseAt = 0;
+
+    if (!c.authed)
+        reason = WsReject::Unauthorized;
+    else if (c.inflight >= WS_WINDOW)
+        reason = WsReject::FlowControl;
+    else if ((job = jobs.acquire()) == nullptr)
+        reason = WsReject::Busy;
+    else
+    {
+        JobTracer::instance().begin(job->id);
+        reason = WsProtocol::decodeSend(frame, len, corr, *job);
+        if (reason == WsReject::None)
+            reason = enqueue(c, *job, releaseAt);
+        if (reason != WsReject::None)
+            jobs.release(job);
+    }
+
+    if (reason != WsReject::None)
+    {
+        rejected[uint8_t(reason)]++;
+        uint8_t reply[WsProtocol::REJECT_LEN];
+        send(num, reply, WsProtocol::reject(reply, corr, reason));
+        return;
+    }
+    accepted++;
+    bodyBytes += job->bodyLen;
+    uint8_t reply[WsProtocol::ACCEPT_LEN];
+    WsProtocol::accept(reply, corr, c.jobs[c.inflight - 1], releaseAt);
+    send(num, reply, sizeof(reply));
+    jobWire += len + headerBytes(len, true) + sizeof(reply) + headerBytes(sizeof(reply), false);
+}
+
+/**
+ * @brief Same queue paths and checks as `POST /send`, without waiting for the modem
+ */
+WsReject WsServer::enqueue(Client &c, SmsJob &job, uint32_t &releaseAt)
+{
+    uint32_t id = job.id;
+    if (job.hasWindow())
+    {
+        // Campaign traffic: registration is checked when the job is sent
+        ScheduleResult result = schedule(job);
+        if (result == ScheduleResult::ParkFull)
+            return WsReject::Busy;
+        if (result == ScheduleResult::WindowNever)
+            return WsReject::WindowNever;
+        releaseAt = job.releaseAt;
+    }
+    else
+    {
+        if (!checkModemRegistered())
+            return WsReject::NotRegistered;
+        post(job);
+    }
+    c.jobs[c.inflight++] = id;
+    return WsReject::None;
+}
+
+/**
+ * @brief Check an API key; the connection may send once it matches
+ */
+void WsServer::handleAuth(uint8_t num, const uint8_t *frame, size_t len)
+{
+    char key[65];
+    size_t n = len - 1;
+    bool ok = n < sizeof(key);
+    if (ok)
+    {
+        memcpy(key, frame + 1, n);
+        key[n] = '\0';
+        ok = !Provisioner::instance().hasApiKeys() || Provisioner::instance().checkApiKey(key);
+    }
+    clients[num].authed = clients[num].authed || ok;
+    uint8_t reply[2] = {uint8_t(WsOp::AuthResult), uint8_t(ok ? 1 : 0)};
+    send(num, reply, sizeof(reply));
+}
+
+/**
+ * @brief Free the job's credit and push Sent/Failed to its connection
+ */
+void WsServer::jobFinished(const SmsJob &job)
+{
+    uint8_t num;
+    if (!ownerOf(job.id, num, false))
+        return;
+    uint8_t frame[WsProtocol::STATUS_LEN];
+    WsProtocol::status(frame, job.id, job.state == JobState::Sent ? WsJobStatus::Sent : WsJobStatus::Failed, 0xFF);
+    if (send(num, frame, sizeof(frame)))
+        jobWire += sizeof(frame) + headerBytes(sizeof(frame), false);
+}
+
+void WsServer::deliveryReport(uint32_t jobId, uint8_t status)
+{
+    uint8_t num;
+    if (!ownerOf(jobId, num, true))
+        return;
+    uint8_t frame[WsProtocol::STATUS_LEN];
+    WsProtocol::status(frame, jobId, status == 0 ? WsJobStatus::Delivered : WsJobStatus::Undelivered, status);
+    send(num, frame, sizeof(frame));
+}
+
+/**
+ * @brief Find (and retire) a job of a connection
+ *
+ * @param finished false: look in the in-flight jobs and move the match to
+ *        the report ring; true: look in the report ring and drop the match
+ */
+bool WsServer::ownerOf(uint32_t jobId, uint8_t &num, bool finished)
+{
+    for (uint8_t n = 0; n < WEBSOCKETS_SERVER_CLIENT_MAX; ++n)
+    {
+        Client &c = clients[n];
+        if (!c.open)
+            continue;
+        if (finished)
+        {
+            for (uint32_t &id : c.reported)
+            {
+                if (id == jobId)
+                {
+                    id = 0;
+                    num = n;
+                    return true;
+                }
+            }
+            continue;
+        }
+        for (uint8_t i = 0; i < c.inflight; ++i)
+        {
+            if (c.jobs[i] != jobId)
+                continue;
+            c.jobs[i] = c.jobs[--c.inflight];
+            c.reported[c.reportedHead] = jobId;
+            c.reportedHead = uint8_t((c.reportedHead + 1) % WS_REPORT_RING);
+            num = n;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Broadcast an incoming SMS to every authenticated connection
+ */
+void WsServer::inbound(const char *from, const char *text)
+{
+    uint8_t frame[WsProtocol::INBOUND_HEADER + PhoneNumber::STRING_MAX + 320];
+    size_t len = WsProtocol::inbound(frame, sizeof(frame), SmsDispatcher::clockNow(), from, text);
+    if (len == 0)
+        return;
+    for (uint8_t n = 0; n < WEBSOCKETS_SERVER_CLIENT_MAX; ++n)
+        if (clients[n].open && clients[n].authed)
+            send(n, frame, len);
+}
+
+bool WsServer::send(uint8_t num, uint8_t *frame, size_t len)
+{
+    if (!server.sendBIN(num, frame, len))
+        return false;
+    framesOut++;
+    wireOut += len + headerBytes(len, false);
+    return true;
+}
+
+void WsServer::toJson(JsonObject &dst) const
+{
+    uint8_t open = 0;
+    for (const Client &c : clients)
+        open += c.open ? 1 : 0;
+    dst["clients"] = open;
+    dst["accepted"] = accepted;
+    JsonObject r = dst["rejected"].to<JsonObject>();
+    for (uint8_t i = 1; i <= uint8_t(WsReject::Unauthorized); ++i)
+        if (rejected[i])
+            r[WsProtocol::rejectName(WsReject(i))] = rejected[i];
+    dst["framesIn"] = framesIn;
+    dst["framesOut"] = framesOut;
+    dst["wireIn"] = wireIn;
+    dst["wireOut"] = wireOut;
+    dst["bodyBytes"] = bodyBytes;
+    dst["overheadPerMessage"] = accepted ? (jobWire - bodyBytes) / accepted : 0;
+}
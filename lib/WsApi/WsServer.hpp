@@ -0,0 +1,163 @@
+/**
+ * @file WsServer.hpp
+ * @brief WebSocket endpoint for pipelined sends with pushed job status
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WebSocketsServer.h>
+#include <functional>
+#include "JobQueue.hpp"
+#include "WsProtocol.hpp"
+#include "ProbeRegistry.hpp"
+
+// ====== Tuning ======
+/**
+ * @def WS_PORT
+ * @brief TCP port of the WebSocket endpoint (the HTTP API keeps port 80)
+ */
+#ifndef WS_PORT
+#define WS_PORT 81
+#endif
+
+/**
+ * @def WS_WINDOW
+ * @brief Accepted but unfinished jobs allowed per connection
+ *
+ * A Send frame beyond the window is rejected with WsReject::FlowControl;
+ * each Sent/Failed status frame returns one credit. Parked (windowed) jobs
+ * hold their credit until they are sent.
+ */
+#ifndef WS_WINDOW
+#define WS_WINDOW 4
+#endif
+
+/**
+ * @def WS_REPORT_RING
+ * @brief Finished jobs per connection that still get their delivery report pushed
+ */
+#ifndef WS_REPORT_RING
+#define WS_REPORT_RING 8
+#endif
+
+/**
+ * @brief Binary WebSocket API on WS_PORT (path is ignored)
+ *
+ * One connection carries any number of pipelined Send frames, each with a
+ * client-chosen correlation id. The device answers every Send with an
+ * Accept (job id) or a Reject, then pushes a Status frame when the job is
+ * sent or failed and again when its delivery report arrives. Incoming SMS
+ * are pushed to every connection as Inbound frames. See WsProtocol for the
+ * frame layouts.
+ *
+ * Send frames go through the same job pool, decoder checks, registration
+ * check and dispatcher as `POST /send`; they never block the loop while
+ * the modem sends. When API keys are provisioned a connection must send an
+ * Auth frame first.
+ *
+ * Frame counts, bytes on the wire and the protocol overhead per accepted
+ * message are exported in the "ws" probe.
+ */
+class WsServer
+{
+public:
+    /**
+     * @brief Queue a job without a send window (SmsDispatcher::post)
+     */
+    using PostFunction = std::function<void(SmsJob &job)>;
+
+    /**
+     * @brief Queue or park a windowed job; see ScheduleResult
+     */
+    using ScheduleFunction = std::function<ScheduleResult(SmsJob &job)>;
+
+    /**
+     * @brief Whether the modem is registered
+     */
+    using CheckModemRegisteredFunction = std::function<bool()>;
+
+    /**
+     * @brief Start listening
+     *
+     * @param jobs Job pool Send frames are decoded into
+     * @param postFunc Queues jobs without a window
+     * @param scheduleFunc Queues or parks windowed jobs
+     * @param checkModemRegisteredFunc Registration check for jobs without a window
+     * @param port TCP port
+     */
+    WsServer(JobQueue &jobs, PostFunction postFunc, ScheduleFunction scheduleFunc,
+             CheckModemRegisteredFunction checkModemRegisteredFunc, uint16_t port = WS_PORT);
+
+    /**
+     * @brief Serve the sockets; call from the main loop
+     */
+    void loop();
+
+    /**
+     * @brief Push the outcome of a finished job to its connection
+     *
+     * Hook for SmsDispatcher::onFinish(); jobs from other ingress paths are
+     * ignored.
+     */
+    void jobFinished(const SmsJob &job);
+
+    /**
+     * @brief Push a delivery report to the connection that sent the job
+     *
+     * Hook for JobTracer::onDelivery().
+     */
+    void deliveryReport(uint32_t jobId, uint8_t status);
+
+    /**
+     * @brief Push an incoming SMS to every connection (Modem::onInbound())
+     */
+    void inbound(const char *from, const char *text);
+
+    /**
+     * @brief Write {"clients","accepted","rejected":{"<reason>":n},"framesIn",
+     * "framesOut","wireIn","wireOut","bodyBytes","overheadPerMessage"}
+     */
+    void toJson(JsonObject &dst) const;
+
+private:
+    /**
+     * @brief Per-connection state
+     */
+    struct Client
+    {
+        bool open = false;
+        bool authed = false;
+        uint8_t inflight = 0;                ///< Used entries of jobs
+        uint32_t jobs[WS_WINDOW];            ///< Accepted, not finished
+        uint32_t reported[WS_REPORT_RING];   ///< Finished, awaiting a delivery report
+        uint8_t reportedHead = 0;
+    };
+
+    WebSocketsServer server;
+    JobQueue &jobs;
+    PostFunction post;
+    ScheduleFunction schedule;
+    CheckModemRegisteredFunction checkModemRegistered;
+    Client clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+
+    uint32_t accepted = 0;
+    uint32_t rejected[uint8_t(WsReject::Unauthorized) + 1] = {};
+    uint32_t framesIn = 0;
+    uint32_t framesOut = 0;
+    uint32_t wireIn = 0;    ///< Bytes received incl. WebSocket headers
+    uint32_t wireOut = 0;   ///< Bytes sent incl. WebSocket headers
+    uint32_t bodyBytes = 0; ///< Message bodies of accepted Send frames
+    uint32_t jobWire = 0;   ///< Wire bytes of accepted Send frames and their Accept/Status frames
+
+    void onEvent(uint8_t num, WStype_t type, uint8_t *payload, size_t length);
+    void handleSend(uint8_t num, const uint8_t *frame, size_t len);
+    void handleAuth(uint8_t num, const uint8_t *frame, size_t len);
+    WsReject enqueue(Client &c, SmsJob &job, uint32_t &releaseAt);
+    bool send(uint8_t num, uint8_t *frame, size_t len);
+    bool ownerOf(uint32_t jobId, uint8_t &num, bool finished);
+
+    /** @brief WebSocket header bytes of a frame (client frames are masked) */
+    static size_t headerBytes(size_t len, bool masked) { return (len < 126 ? 2 : 4) + (masked ? 4 : 0); }
+};
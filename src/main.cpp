@@ -16,6 +16,11 @@
  * - LED status indication
  * - Serial debug output
  *
+ * Build profiles (platformio.ini environments) select the feature modules
+ * compiled in: BLE, WiFi, HTTP, WebSocket, serial console API, AT trace, the
+ * history store, provisioning, supervisor, flash wear accounting and duty
+ * cycling (see Features.hpp). Disabled modules are neither linked nor started.
+ *
  * Configuration:
  * - Monitor at 115200 baud
  * - Core Debug Level: None (for production)
@@ -34,11 +39,53 @@
 
 // #include <Arduino.h>
 #include <Ticker.h>
+#include "Features.hpp"
+#include "BuildProfile.hpp"
 #include "GSettings.hpp"
+#if FEATURE_WIFI
 #include "WifiConnection.hpp"
+#endif
+#if FEATURE_BLE
 #include "BTLe.hpp"
+#endif
+#if FEATURE_HTTP
 #include "HTTPServer.hpp"
+#endif
+#if FEATURE_WS
+#include "WsServer.hpp"
+#endif
+#if FEATURE_COAP
+#include "CoapServer.hpp"
+#endif
+#if FEATURE_SMTP
+#include "SmtpServer.hpp"
+#endif
+#if FEATURE_SERIAL
+#include "SerialApi.hpp"
+#endif
 #include "Modem.hpp"
+#include "JobQueue.hpp"
+#include "SmsDispatcher.hpp"
+#include "Profiler.hpp"
+#if FEATURE_DUTY_CYCLE
+#include "DutyCycle.hpp"
+#endif
+#if FEATURE_FLASH_WEAR
+#include "FlashWear.hpp"
+#endif
+#if FEATURE_PROVISIONING
+#include "Provisioner.hpp"
+#endif
+#if FEATURE_SUPERVISOR
+#include "Supervisor.hpp"
+#endif
+#include "RemoteLog.hpp" // LOG_* macros; the syslog client only with FEATURE_SYSLOG
+#if FEATURE_HISTORY
+#include "History.hpp"
+#endif
+#if FEATURE_RULES
+#include "RuleEngine.hpp"
+#endif
 
 #define SD_MISO 2  ///< SD card SPI MISO pin
 #define SD_MOSI 15 ///< SD card SPI MOSI pin
@@ -49,18 +96,55 @@
 #define BLE_MTU 247                       ///< Maximum BLE MTU size
 #define BLE_ADVERTISING_TIMEOUT_MINUTES 5 ///< Minutes to keep BLE advertising active
 
-Modem modem; ///< Global modem object
+Modem modem;   ///< Global modem object
+JobQueue jobs; ///< Preallocated SMS job records
 
 // Global objects
 GSettings settings;                      ///< Global settings manager
+#if FEATURE_WIFI
 WifiConnection wifiConnection(settings); ///< WiFi connection manager
+#endif
+#if FEATURE_DUTY_CYCLE
+DutyCycle dutyCycle(settings);           ///< Deep-sleep policy and power accounting
+#endif
+bool interactive = false;                ///< Full boot: BLE, WiFi and HTTP services running
+
+SmsDispatcher dispatcher(jobs, [](SmsJob &job)
+                         {
+  bool ok = modem.sendSmsSafe(job);
+#if FEATURE_DUTY_CYCLE
+  dutyCycle.noteSend(ok);
+#endif
+#if FEATURE_HISTORY
+  History::instance().record(job, ok, SmsDispatcher::clockNow());
+#endif
+  return ok; }); ///< Queue consumer feeding the modem
 
+#if FEATURE_BLE
 // BLE objects
 NimBLEServer *pServer = nullptr;                                       ///< BLE server instance
 NimBLECharacteristic *notifyCharacteristic = nullptr;                  ///< BLE notification characteristic
-ServerCallbacks serverCallbacks(wifiConnection.getStatus(), settings); ///< BLE server event callbacks
-CharacteristicCallbacks chrCallbacks(settings, wifiConnection);        ///< BLE characteristic callbacks
-HTTPServer *httpServer;                                                ///< HTTP server instance
+ServerCallbacks serverCallbacks(settings);                             ///< BLE server event callbacks
+CharacteristicCallbacks chrCallbacks(settings);                        ///< BLE characteristic callbacks
+ProvisionCallbacks provisionCallbacks;                                 ///< BLE provisioning bundle callbacks
+#endif
+#if FEATURE_HTTP
+HTTPServer *httpServer = nullptr; ///< HTTP server instance (not created on quick wakes)
+#endif
+#if FEATURE_WS
+WsServer *wsServer = nullptr; ///< WebSocket API instance (not created on quick wakes)
+#endif
+#if FEATURE_COAP
+CoapServer *coapServer = nullptr; ///< CoAP API instance (not created on quick wakes)
+#endif
+#if FEATURE_SMTP
+SmtpServer *smtpServer = nullptr; ///< SMTP ingress instance (not created on quick wakes)
+#endif
+#if FEATURE_SERIAL
+SerialApi *serialApi = nullptr; ///< Serial console API instance (not created on quick wakes)
+#endif
+
+#if FEATURE_BLE
 /**
  * @brief Initialize and configure Bluetooth Low Energy (BLE) functionality
  *
@@ -74,6 +158,7 @@ HTTPServer *httpServer;                                                ///< HTTP
  * - Service UUID: 9379d945-8ada-41b7-b028-64a8dda4b1f8
  * - Read/Write Char: c62b53d0-1848-424d-9d05-fd91e83f87a8 (WiFi credentials)
  * - Notify Char: 6cd49c0f-0c41-475b-afc5-5d504afca7dc (Status updates)
+ * - Provision Char: e5a1c3b2-7f40-4d8e-9b61-2c0f8a7d9e53 (Signed bundle chunks)
  *
  * The BLE interface allows remote configuration of WiFi credentials and
  * device settings via mobile apps or BLE clients.
@@ -106,6 +191,12 @@ void bluetoothSetup()
   writeCharacteristic->setValue("Data");
   writeCharacteristic->setCallbacks(&chrCallbacks);
 
+  // Write characteristic for signed provisioning bundles (chunked)
+  NimBLECharacteristic *provisionCharacteristic = pService->createCharacteristic(
+      CHAR_PROVISION_UUID,
+      NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_ENC);
+  provisionCharacteristic->setCallbacks(&provisionCallbacks);
+
   // Notify characteristic for sending status/IP updates
   notifyCharacteristic = pService->createCharacteristic(
       CHAR_NOTIFY_UUID,
@@ -123,6 +214,12 @@ void bluetoothSetup()
   notifyCharacteristic->setValue("Notify");
 
   chrCallbacks.setNotifyCharacteristic(notifyCharacteristic);
+  Provisioner::instance().onNotify([](const String &msg)
+                                   { notifyCharacteristic->notify(msg); });
+#if FEATURE_RULES
+  RuleEngine::instance().onNotify([](const String &msg)
+                                  { notifyCharacteristic->notify(msg); });
+#endif
 
   // Start the service
   pService->start();
@@ -153,21 +250,28 @@ void bluetoothChangeStatus()
 {
   if (settings.getUptime() > BLE_ADVERTISING_TIMEOUT_MINUTES * MINUTE)
   {
-    Serial.println(F("[BLE] Stop advertising"));
+    LOG_INFO("BLE", "Stop advertising");
     pServer->getAdvertising()->stop();
   }
 }
+#endif // FEATURE_BLE
 
 /**
  * @brief Arduino setup function - Initialize all system components
  *
  * Initialization sequence:
  * 1. Start serial communication for debugging (115200 baud)
- * 2. Load persistent settings from NVS storage
+ * 2. Load persistent settings from NVS storage and finish an interrupted
+ *    provisioning bundle
+ *    - Any duty-cycle wake: reattach to the modem kept on through sleep
+ *    - Timer/RI wake: run the wake handler (restore parked jobs, drain the
+ *      queue) and stop here (no BLE, WiFi or HTTP)
  * 3. Initialize BLE system for configuration interface
  * 4. Configure status LED
  * 5. Initialize GSM modem and establish network connection
  * 6. Attempt WiFi connection using stored credentials
+ * 7. Start the HTTP and WebSocket APIs
+ * 8. Record the idle memory budget of the build profile
  *
  * After setup completion, the device is ready to:
  * - Send SMS messages via GSM network
@@ -187,16 +291,65 @@ void setup()
   delay(300);
 
   settings.load();
+  RadioTiming::instance().begin();
+#if FEATURE_SYSLOG
+  RemoteLog::instance().begin(settings.getDeviceName());
+#endif
+#if FEATURE_PROVISIONING
+  Provisioner::instance().begin(settings);
+  modem.setCarrierOverride([](const char *mccmnc, CarrierOverride &out)
+                           { return Provisioner::instance().carrierOverride(mccmnc, out.bearer, out.apn, out.user, out.pass); });
+#endif
+#if FEATURE_DUTY_CYCLE
+  dutyCycle.begin();
+#endif
+#if FEATURE_HISTORY
+  History::instance().begin();
+#endif
+#if FEATURE_SUPERVISOR
+  // From here on a hung bring-up or loop is recovered or restarted
+  Supervisor::instance().configure(Subsystem::Loop, SUPERVISOR_PERIOD_MS);
+  Supervisor::instance().begin();
+#endif
+
+#if FEATURE_DUTY_CYCLE
+  // Quick wakes: send what deep sleep carried over; the loop sleeps again once idle
+  dutyCycle.onWake([](WakeCause)
+                   {
+    jobs.restore();
+    if (SmsDispatcher::clockNow() == 0)
+      modem.syncClock();
+    while (dispatcher.poll())
+      modem.poll(); });
+
+  // The modem stays on through deep sleep: reattach before any re-init
+  bool modemResumed = dutyCycle.wakeCause() != WakeCause::PowerOn && modem.resumeFromSleep();
 
+  if (dutyCycle.isQuickWake())
+  {
+    // Minimal wake path: send pending work and go back to sleep
+    if (!modemResumed)
+      modem.initModemClean();
+    dutyCycle.runWakeHandler();
+    return;
+  }
+#else
+  bool modemResumed = false;
+#endif
+
+#if FEATURE_BLE
   bluetoothSetup();
+#endif
 
   pinMode(LED_PIN, OUTPUT);
   digitalWrite(LED_PIN, HIGH);
 
   Serial.println(F("\n=== T-SIM7000G SMS Sender ==="));
 
-  modem.initModemClean();
+  if (!modemResumed)
+    modem.initModemClean();
 
+#if FEATURE_WIFI
   connect_t result = wifiConnection.connect();
   if (result.isConnected)
   {
@@ -209,25 +362,123 @@ void setup()
     Serial.println("Failed to connect to WiFi!");
   }
 
+  // Wall clock for send windows: SNTP over WiFi, network time as fallback
+  configTime(0, 0, "pool.ntp.org");
+#endif
+  if (SmsDispatcher::clockNow() == 0)
+    modem.syncClock();
+
+#if FEATURE_HTTP
   httpServer = new HTTPServer(
-      settings,
-      wifiConnection,
+      jobs,
       // Use lambdas to wrap member functions
-      [&](const String &number, const String &message)
-      { return modem.sendSmsSafe(number, message); },
+      [&](SmsJob &job)
+      { return dispatcher.runToCompletion(job); },
+      [&](SmsJob &job)
+      { return dispatcher.schedule(job); },
       [&]()
       { return modem.isCsRegistered(); },
       80,
       LED_PIN);
+#endif
+#if FEATURE_WS
+  wsServer = new WsServer(
+      jobs,
+      [&](SmsJob &job)
+      { dispatcher.post(job); },
+      [&](SmsJob &job)
+      { return dispatcher.schedule(job); },
+      [&]()
+      { return modem.isCsRegistered(); });
+  modem.onInbound([](const char *from, const char *text)
+                  { wsServer->inbound(from, text); });
+#endif
+#if FEATURE_COAP
+  coapServer = new CoapServer(
+      jobs,
+      [&](SmsJob &job)
+      { dispatcher.post(job); },
+      [&](SmsJob &job)
+      { return dispatcher.schedule(job); },
+      [&]()
+      { return modem.isCsRegistered(); });
+#endif
+#if FEATURE_SMTP
+  smtpServer = new SmtpServer(
+      jobs,
+      [&](SmsJob &job)
+      { dispatcher.post(job); },
+      [&]()
+      { return modem.isCsRegistered(); });
+#endif
+#if FEATURE_SERIAL
+  serialApi = new SerialApi(
+      Serial,
+      jobs,
+      [&](SmsJob &job)
+      { dispatcher.post(job); },
+      [&](SmsJob &job)
+      { return dispatcher.schedule(job); },
+      [&]()
+      { return modem.isCsRegistered(); });
+#endif
+#if FEATURE_RULES
+  // Alarm rules run in interactive mode only: quick wakes and deep sleep do not watch inputs
+  RuleEngine::instance().begin(
+      jobs,
+      [&](SmsJob &job)
+      { dispatcher.post(job); },
+      [&]()
+      { return modem.isCsRegistered(); },
+      settings.getDeviceName());
+#endif
+#if FEATURE_WS || FEATURE_COAP || FEATURE_SERIAL
+  // Job outcomes fan out to every push API, delivery reports to WS and CoAP
+  dispatcher.onFinish([](const SmsJob &job)
+                      {
+#if FEATURE_WS
+                        wsServer->jobFinished(job);
+#endif
+#if FEATURE_COAP
+                        coapServer->jobFinished(job);
+#endif
+#if FEATURE_SERIAL
+                        serialApi->jobFinished(job);
+#endif
+                      });
+#endif
+#if FEATURE_WS || FEATURE_COAP
+  JobTracer::instance().onDelivery([](uint32_t jobId, uint8_t status)
+                                   {
+#if FEATURE_WS
+                                     wsServer->deliveryReport(jobId, status);
+#endif
+#if FEATURE_COAP
+                                     coapServer->deliveryReport(jobId, status);
+#endif
+                                   });
+#endif
+
+  jobs.restore(); // GPIO wake: parked jobs carried through deep sleep
+
+  interactive = true;
+  BuildProfile::instance().markIdle();
 }
 
 /**
  * @brief Arduino main loop function - Handle ongoing operations
  *
  * Main execution loop that manages:
- * 1. Bluetooth status and advertising based on WiFi connectivity
- * 2. HTTP server client request processing
- * 3. Brief CPU yield to allow other tasks to execute
+ * 1. Bluetooth advertising timeout and WiFi join results for BLE clients
+ * 2. SoftAP/captive-portal DNS and background WiFi reconnects
+ * 3. HTTP server, WebSocket client, CoAP datagram, SMTP session and serial console
+ *    processing, log shipping, alarm rule evaluation
+ * 4. Draining queued jobs and modem URCs (delivery reports)
+ * 5. Applying a received provisioning bundle
+ * 6. Entering deep sleep when duty cycling is enabled and the device is idle
+ * 7. Brief CPU yield to allow other tasks to execute
+ *
+ * Every pass is a Supervisor heartbeat of the loop.
  *
  * The loop operates continuously to:
  * - Monitor and adjust BLE advertising based on WiFi status
@@ -241,7 +492,69 @@ void setup()
  */
 void loop()
 {
-  bluetoothChangeStatus();
-  httpServer->handleClient();
+#if FEATURE_SUPERVISOR
+  Supervisor::instance().beat(Subsystem::Loop);
+#endif
+  if (interactive)
+  {
+#if FEATURE_BLE
+    bluetoothChangeStatus();
+    chrCallbacks.poll();
+#endif
+#if FEATURE_WIFI
+    wifiConnection.setLowLatency(jobs.inUse() > jobs.parked());
+    wifiConnection.poll();
+#endif
+#if FEATURE_HTTP
+    httpServer->handleClient();
+#endif
+#if FEATURE_WS
+    wsServer->loop();
+#endif
+#if FEATURE_COAP
+    coapServer->loop();
+#endif
+#if FEATURE_SMTP
+    smtpServer->loop();
+#endif
+#if FEATURE_SERIAL
+    serialApi->loop();
+#endif
+#if FEATURE_SYSLOG
+    RemoteLog::instance().poll();
+#endif
+#if FEATURE_RULES
+    RuleEngine::instance().poll();
+#endif
+#if FEATURE_PROVISIONING
+    Provisioner::instance().poll();
+#endif
+  }
+  dispatcher.poll();
+  modem.poll();
+#if FEATURE_FLASH_WEAR
+  FlashWear::instance().poll();
+#endif
+#if FEATURE_HISTORY
+  History::instance().poll();
+#endif
+#if FEATURE_PROFILER
+  Profiler::instance().poll();
+#endif
+#if FEATURE_DUTY_CYCLE
+  // Parked jobs wait in RTC memory, unless more are parked than it holds
+  if (dutyCycle.shouldSleep(dispatcher.hasWork() || jobs.parked() > JOB_CARRY_MAX))
+  {
+#if FEATURE_HISTORY
+    History::instance().flush(); // RAM rows do not survive deep sleep
+#endif
+#if FEATURE_FLASH_WEAR
+    FlashWear::instance().save();
+#endif
+    jobs.hibernate();
+    modem.prepareSleep();
+    dutyCycle.sleep(jobs.nextRelease()); // wake when the next parked job is due
+  }
+#endif
   delay(2); // allow the cpu to switch to other tasks
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Static RAM and flash budget of a build profile.
+
+As a PlatformIO post script (see extra_scripts in platformio.ini) it runs
+after every firmware build, prints one summary line and writes budget.json
+next to firmware.elf. Standalone it compares profiles:
+
+    budget_report.py .pio/build/*/firmware.elf [--json]
+
+Heap at idle is only known on the device: see the "[BUDGET]" boot line or
+the "build" probe in GET /metrics.
+"""
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+
+# Section name prefixes per memory region (ESP32 linker script)
+REGIONS = {
+    "dram_data": (".dram0.data",),
+    "dram_bss": (".dram0.bss", ".noinit"),
+    "iram": (".iram0.vectors", ".iram0.text"),
+    "rtc": (".rtc.text", ".rtc.data", ".rtc.bss", ".rtc_noinit", ".rtc.force_fast", ".rtc.force_slow"),
+    "flash_text": (".flash.text",),
+    "flash_rodata": (".flash.rodata", ".flash.appdesc", ".flash.rodata_noload"),
+}
+DRAM_SIZE = 180 * 1024  # DRAM usable for static data and heap on the ESP32 Arduino core
+
+
+def find_size_tool(explicit):
+    for tool in (explicit, "xtensa-esp32-elf-size",
+                 os.path.expanduser("~/.platformio/packages/toolchain-xtensa-esp32/bin/xtensa-esp32-elf-size")):
+        if tool and shutil.which(tool):
+            return tool
+    sys.exit("xtensa-esp32-elf-size not found (use --size or add the PlatformIO toolchain to PATH)")
+
+
+def sections(size_tool, elf):
+    out = subprocess.run([size_tool, "-A", elf], capture_output=True, text=True, check=True).stdout
+    result = {}
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[0].startswith(".") and parts[1].isdigit():
+            result[parts[0]] = int(parts[1])
+    return result
+
+
+def budget(size_tool, elf):
+    secs = sections(size_tool, elf)
+    b = {name: sum(n for s, n in secs.items() if s.startswith(prefixes)) for name, prefixes in REGIONS.items()}
+    b["static_ram"] = b["dram_data"] + b["dram_bss"]
+    b["dram_left"] = DRAM_SIZE - b["static_ram"]
+    b["flash"] = b["flash_text"] + b["flash_rodata"] + b["dram_data"] + b["iram"]
+    image = os.path.join(os.path.dirname(elf), "firmware.bin")
+    if os.path.exists(image):
+        b["image"] = os.path.getsize(image)
+    b["profile"] = os.path.basename(os.path.dirname(os.path.abspath(elf)))
+    return b
+
+
+def line(b):
+    return ("%-16s static RAM %7d (data %6d, bss %6d)  DRAM left %7d  IRAM %6d  RTC %5d  flash %8d"
+            % (b["profile"], b["static_ram"], b["dram_data"], b["dram_bss"], b["dram_left"],
+               b["iram"], b["rtc"], b.get("image", b["flash"])))
+
+
+def post_link(source, target, env):
+    elf = os.path.splitext(str(target[0]))[0] + ".elf"
+    size_tool = shutil.which(env.subst("$SIZETOOL"), path=env["ENV"].get("PATH")) or find_size_tool(None)
+    b = budget(size_tool, elf)
+    b["profile"] = env["PIOENV"]
+    with open(os.path.join(os.path.dirname(elf), "budget.json"), "w") as f:
+        json.dump(b, f, indent=1, sort_keys=True)
+    print("[BUDGET] " + line(b))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("elf", nargs="+")
+    ap.add_argument("--size", help="path to xtensa-esp32-elf-size")
+    ap.add_argument("--json", action="store_true", help="print JSON instead of a table")
+    args = ap.parse_args()
+
+    size_tool = find_size_tool(args.size)
+    budgets = [budget(size_tool, elf) for elf in args.elf]
+    if args.json:
+        print(json.dumps(budgets, indent=1, sort_keys=True))
+        return
+    for b in sorted(budgets, key=lambda b: b["static_ram"]):
+        print(line(b))
+
+
+try:
+    Import("env")  # noqa: F821 (PlatformIO/SCons)
+except NameError:
+    if __name__ == "__main__":
+        main()
+else:
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", post_link)  # noqa: F821
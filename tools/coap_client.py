@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+"""CoAP client stand-in: latency and datagram counts of the CoAP send API.
+
+    coap_client.py 192.168.4.1 --count 20 [--phone +40712345678] [--message "..."]
+                   [--block 64] [--loss 0.2] [--observe] [--key KEY]
+
+Sends the same message COUNT times as a confirmable POST /send with a CBOR
+body, the way a constrained sensor would:
+
+- bodies longer than --block bytes go as Block1 blocks (2.31 Continue
+  between them)
+- lost ACKs are retransmitted with the RFC 7252 back-off (ACK_TIMEOUT 2 s,
+  up to 4 times); --loss drops that share of datagrams in both directions
+  on purpose, so retransmissions and the device's duplicate detection are
+  exercised (a retransmitted POST must not queue a second SMS)
+- --observe registers on the returned jobs/{id} and waits for the final
+  state (failed, delivered or undelivered), acknowledging each notification
+
+and prints datagrams and bytes per message (UDP payload, both directions,
+minus the message body) and the median time to the final response.
+
+Without --phone an invalid number is used: every request is answered 4.00
+by validation, so no SMS is sent and only protocol cost is measured.
+
+Compare with the "coap" probe in GET /metrics (duplicates, overheadPerMessage).
+"""
+import argparse
+import os
+import random
+import socket
+import statistics
+import struct
+import time
+
+CON, NON, ACK, RST = 0, 1, 2, 3
+GET, POST = 0x01, 0x02
+CREATED, CONTENT, CONTINUE = 0x41, 0x45, 0x5F
+OBSERVE, LOCATION_PATH, URI_PATH, CONTENT_FORMAT, URI_QUERY, BLOCK1 = 6, 8, 11, 12, 15, 27
+FORMAT_CBOR = 60
+ACK_TIMEOUT, ACK_RANDOM_FACTOR, MAX_RETRANSMIT = 2.0, 1.5, 4
+STATES = {0: "queued", 1: "sent", 2: "failed", 3: "delivered", 4: "undelivered"}
+INVALID_PHONE = "+0"
+
+
+def cbor_head(major, value):
+    if value < 24:
+        return bytes((major << 5 | value,))
+    if value <= 0xFF:
+        return bytes((major << 5 | 24, value))
+    if value <= 0xFFFF:
+        return bytes((major << 5 | 25,)) + struct.pack(">H", value)
+    return bytes((major << 5 | 26,)) + struct.pack(">I", value)
+
+
+def cbor_text(s):
+    b = s.encode()
+    return cbor_head(3, len(b)) + b
+
+
+def send_body(phone, message):
+    """Request map: 1 phone, 2 message"""
+    return cbor_head(5, 2) + cbor_head(0, 1) + cbor_text(phone) + cbor_head(0, 2) + cbor_text(message)
+
+
+def cbor_uint_map(data):
+    """Decode the device's job map (small uint keys and values only)"""
+    def item(i):
+        major, info = data[i] >> 5, data[i] & 0x1F
+        if info < 24:
+            return major, info, i + 1
+        n = 1 << (info - 24)
+        return major, int.from_bytes(data[i + 1:i + 1 + n], "big"), i + 1 + n
+
+    major, entries, i = item(0)
+    out = {}
+    for _ in range(entries):
+        _, key, i = item(i)
+        _, value, i = item(i)
+        out[key] = value
+    return out
+
+
+def uint_bytes(v):
+    return v.to_bytes((v.bit_length() + 7) // 8, "big") if v else b""
+
+
+def encode(mtype, code, mid, token, options, payload=b""):
+    out = bytes((0x40 | mtype << 4 | len(token), code)) + struct.pack(">H", mid) + token
+    last = 0
+    for number, value in sorted(options, key=lambda o: o[0]):
+        delta, length = number - last, len(value)
+        last = number
+
+        def nibble(v):
+            return (14, struct.pack(">H", v - 269)) if v >= 269 else (13, bytes((v - 13,))) if v >= 13 else (v, b"")
+
+        dn, dx = nibble(delta)
+        ln, lx = nibble(length)
+        out += bytes((dn << 4 | ln,)) + dx + lx + value
+    if payload:
+        out += b"\xff" + payload
+    return out
+
+
+def extended(nibble, data, i):
+    """Option delta or length with its extended bytes; returns it and the next index"""
+    if nibble == 13:
+        return 13 + data[i], i + 1
+    if nibble == 14:
+        return 269 + struct.unpack(">H", data[i:i + 2])[0], i + 2
+    return nibble, i
+
+
+def decode(data):
+    mtype, tkl = (data[0] >> 4) & 3, data[0] & 0x0F
+    code, mid = data[1], struct.unpack(">H", data[2:4])[0]
+    token = data[4:4 + tkl]
+    i, number, options, payload = 4 + tkl, 0, [], b""
+    while i < len(data):
+        if data[i] == 0xFF:
+            payload = data[i + 1:]
+            break
+        head, i = data[i], i + 1
+        delta, i = extended(head >> 4, data, i)
+        length, i = extended(head & 0x0F, data, i)
+        number += delta
+        options.append((number, data[i:i + length]))
+        i += length
+    return mtype, code, mid, token, options, payload
+
+
+def code_text(code):
+    return "%d.%02d" % (code >> 5, code & 0x1F)
+
+
+class Client:
+    def __init__(self, host, port, loss):
+        self.addr = (host, port)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.loss = loss
+        self.mid = random.randrange(0x10000)
+        self.datagrams = self.bytes = self.retransmits = 0
+
+    def _send(self, data):
+        self.datagrams += 1
+        self.bytes += len(data)
+        if random.random() >= self.loss:
+            self.sock.sendto(data, self.addr)
+
+    def _recv(self, deadline):
+        """Next datagram before the deadline (None on timeout); lost ones count but vanish"""
+        while True:
+            left = deadline - time.monotonic()
+            if left <= 0:
+                return None
+            self.sock.settimeout(left)
+            try:
+                data, _ = self.sock.recvfrom(2048)
+            except socket.timeout:
+                return None
+            self.datagrams += 1
+            self.bytes += len(data)
+            if random.random() >= self.loss:
+                return data
+
+    def request(self, code, token, options, payload=b""):
+        """Confirmable request with retransmission; returns the decoded piggybacked response"""
+        self.mid = (self.mid + 1) & 0xFFFF
+        mid = self.mid
+        data = encode(CON, code, mid, token, options, payload)
+        timeout = ACK_TIMEOUT * random.uniform(1, ACK_RANDOM_FACTOR)
+        for attempt in range(MAX_RETRANSMIT + 1):
+            if attempt:
+                self.retransmits += 1
+            self._send(data)
+            deadline = time.monotonic() + timeout
+            while True:
+                raw = self._recv(deadline)
+                if raw is None:
+                    break
+                m = decode(raw)
+                if m[0] == ACK and m[2] == mid:
+                    return m
+                if m[0] == RST and m[2] == mid:
+                    raise SystemExit("request reset by the device")
+            timeout *= 2
+        raise SystemExit("no response after %d retransmissions" % MAX_RETRANSMIT)
+
+    def observe(self, token, path, query, timeout):
+        """Register on the job, acknowledge notifications until a final state; returns it"""
+        options = [(OBSERVE, b"")] + [(URI_PATH, p.encode()) for p in path] + query
+        m = self.request(GET, token, options)
+        state = cbor_uint_map(m[5]).get(2) if m[1] == CONTENT else None
+        deadline = time.monotonic() + timeout
+        while state in (0, 1):
+            raw = self._recv(deadline)
+            if raw is None:
+                return state
+            mtype, code, mid, tok, options, payload = decode(raw)
+            if tok != token:
+                continue
+            if mtype == CON:
+                self._send(encode(ACK, 0, mid, b"", []))
+            state = cbor_uint_map(payload).get(2, state)
+        return state
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host")
+    ap.add_argument("--port", type=int, default=5683)
+    ap.add_argument("--count", type=int, default=20)
+    ap.add_argument("--phone", default=INVALID_PHONE, help="real destination (sends SMS!)")
+    ap.add_argument("--message", default="Sensor reading: 21.4 C")
+    ap.add_argument("--key", help="API key when the device is provisioned with keys")
+    ap.add_argument("--block", type=int, default=64, choices=(16, 32, 64, 128, 256, 512, 1024),
+                    help="Block1 size; longer bodies are split")
+    ap.add_argument("--loss", type=float, default=0.0, help="share of datagrams dropped on purpose (0..1)")
+    ap.add_argument("--observe", action="store_true", help="observe each accepted job until its final state")
+    ap.add_argument("--observe-timeout", type=float, default=120.0)
+    args = ap.parse_args()
+
+    client = Client(args.host, args.port, args.loss)
+    query = [(URI_QUERY, ("key=" + args.key).encode())] if args.key else []
+    body = send_body(args.phone, args.message)
+    szx = args.block.bit_length() - 5
+    body_len = len(args.message.encode())
+    latencies, outcomes = [], {}
+    t0 = time.monotonic()
+    for _ in range(args.count):
+        token = os.urandom(4)
+        started = time.monotonic()
+        base = [(URI_PATH, b"send"), (CONTENT_FORMAT, uint_bytes(FORMAT_CBOR))] + query
+        if len(body) <= args.block:
+            m = client.request(POST, token, base, body)
+        else:
+            blocks = [body[i:i + args.block] for i in range(0, len(body), args.block)]
+            for num, block in enumerate(blocks):
+                more = num < len(blocks) - 1
+                option = (BLOCK1, uint_bytes(num << 4 | more << 3 | szx))
+                m = client.request(POST, token, base + [option], block)
+                if m[1] != CONTINUE:
+                    break
+        latencies.append(time.monotonic() - started)
+        code = code_text(m[1])
+        if m[1] == CREATED and args.observe:
+            path = [v.decode() for n, v in m[4] if n == LOCATION_PATH]
+            state = client.observe(os.urandom(4), path, query, args.observe_timeout)
+            code += " " + STATES.get(state, "no final state")
+        elif m[1] != CREATED and m[5]:
+            code += " " + m[5].decode(errors="replace")
+        outcomes[code] = outcomes.get(code, 0) + 1
+    elapsed = time.monotonic() - t0
+
+    for outcome, n in sorted(outcomes.items()):
+        print("%4d x %s" % (n, outcome))
+    print("%12s %10s %10s %10s %12s %12s" % ("datagrams/msg", "bytes/msg", "overhead", "msg/s", "median ms", "retransmits"))
+    per_msg = client.bytes / args.count
+    print("%13.1f %10.1f %10.1f %10.1f %12.1f %12d" % (client.datagrams / args.count, per_msg, per_msg - body_len,
+                                                      args.count / elapsed, statistics.median(latencies) * 1000,
+                                                      client.retransmits))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,123 @@
+/**
+ * @file decoder_bench.cpp
+ * @brief Host benchmark: SendRequestDecoder against the former JsonDocument path
+ *
+ * Build and run from the repository root:
+ *
+ *     g++ -std=gnu++17 -O2 -Ilib/SendRequestDecoder -Ilib/JobQueue -Ilib/PhoneNumber \
+ *         -Ilib/SendWindow -Ilib/Profiler tools/decoder_bench.cpp \
+ *         lib/SendRequestDecoder/SendRequestDecoder.cpp lib/PhoneNumber/PhoneNumber.cpp \
+ *         lib/SendWindow/SendWindow.cpp -o decoder_bench && ./decoder_bench
+ *
+ * Add `-I<ArduinoJson>/src` (ArduinoJson 7, as in platformio.ini) to also
+ * time the path /send used before: deserializeJson() into a JsonDocument,
+ * then copies of "phone" and "message" into strings. Without it only the
+ * decoder is timed.
+ *
+ * Prints ns per decode (best of 5 runs) for each body, and checks that
+ * both paths agree on which bodies are valid.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "SendRequestDecoder.hpp"
+
+#if __has_include(<ArduinoJson.h>)
+#define BENCH_ARDUINOJSON 1
+#include <ArduinoJson.h>
+#else
+#define BENCH_ARDUINOJSON 0
+#endif
+
+namespace
+{
+    const int ITERATIONS = 200000;
+    const int RUNS = 5;
+
+    struct Body
+    {
+        const char *name;
+        const char *json;
+    };
+
+    const Body BODIES[] = {
+        {"typical", R"({"phone":"+40712345678","message":"Salut! Test SMS de pe T-SIM7000G."})"},
+        {"options", R"({"phone":"+40712345678","message":"Door open","priority":"high","window":"08:00-20:00"})"},
+        {"unknown keys", R"({"id":42,"meta":{"src":"crm","tags":["a","b"]},"phone":"+40712345678","message":"Reminder: appointment tomorrow at 10:00"})"},
+        {"escapes", R"({"phone":"+40712345678","message":"Line 1\nLine 2 \"quoted\" é€"})"},
+        {"160 chars", R"({"phone":"+40712345678","message":"0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789"})"},
+        {"invalid", R"({"phone":"+40712345678","message":"x")"},
+    };
+
+    char slab[JOB_BODY_MAX + 1];
+
+    template <typename F>
+    double nsPerCall(F fn)
+    {
+        double best = 1e30;
+        for (int r = 0; r < RUNS; ++r)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            for (int i = 0; i < ITERATIONS; ++i)
+                fn();
+            auto t1 = std::chrono::steady_clock::now();
+            double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / ITERATIONS;
+            if (ns < best)
+                best = ns;
+        }
+        return best;
+    }
+
+    volatile size_t sink; ///< Keeps results observable to the optimizer
+
+#if BENCH_ARDUINOJSON
+    /** @brief The former handleSend(): DOM, then string copies of the fields */
+    bool documentPath(const char *json, size_t len)
+    {
+        JsonDocument doc;
+        if (deserializeJson(doc, json, len))
+            return false;
+        std::string phone = doc["phone"] | "";
+        std::string message = doc["message"] | "";
+        sink = phone.size() + message.size();
+        return true;
+    }
+#endif
+}
+
+int main()
+{
+    SmsJob job;
+    job.body = slab;
+    int mismatches = 0;
+
+#if BENCH_ARDUINOJSON
+    printf("%-14s %6s %14s %14s\n", "body", "bytes", "decoder ns", "document ns");
+#else
+    printf("%-14s %6s %14s   (ArduinoJson not on the include path)\n", "body", "bytes", "decoder ns");
+#endif
+    for (const Body &b : BODIES)
+    {
+        size_t len = strlen(b.json);
+        DecodeStatus status = SendRequestDecoder::decode(b.json, len, job);
+        double decoder = nsPerCall([&]
+                                   { sink = size_t(SendRequestDecoder::decode(b.json, len, job)); });
+#if BENCH_ARDUINOJSON
+        bool parsed = documentPath(b.json, len);
+        if (parsed != (status != DecodeStatus::InvalidJson))
+        {
+            printf("MISMATCH on %s: decoder status %d, document %s\n", b.name, int(status), parsed ? "ok" : "error");
+            mismatches++;
+        }
+        double document = nsPerCall([&]
+                                    { documentPath(b.json, len); });
+        printf("%-14s %6zu %14.1f %14.1f\n", b.name, len, decoder, document);
+#else
+        (void)status;
+        printf("%-14s %6zu %14.1f\n", b.name, len, decoder);
+#endif
+    }
+    return mismatches ? 1 : 0;
+}
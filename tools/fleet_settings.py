@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Apply one settings patch to many devices in parallel (PATCH /settings).
+
+    fleet_settings.py hosts.txt '{"device":{"sleepInterval":600}}' [--key KEY]
+
+hosts.txt holds one host or host:port per line ('#' starts a comment).
+Each device is read first (GET /settings) and patched with its ETag in
+If-Match, so a device changed by someone else in between answers 412; that
+device is re-read and patched again, up to --retries times.
+
+Prints one line per host (ok, restart, or the error) and exits non-zero if
+any host failed.
+"""
+import argparse
+import concurrent.futures
+import json
+import sys
+import urllib.error
+import urllib.request
+
+
+def request(url, method, key, body=None, etag=None, timeout=10):
+    req = urllib.request.Request(url, data=body, method=method)
+    req.add_header("Content-Type", "application/json")
+    if key:
+        req.add_header("Authorization", "Bearer " + key)
+    if etag:
+        req.add_header("If-Match", etag)
+    try:
+        with urllib.request.urlopen(req, timeout=timeout) as r:
+            return r.status, r.headers, r.read()
+    except urllib.error.HTTPError as e:
+        return e.code, e.headers, e.read()
+
+
+def update(host, patch, key, retries):
+    url = "http://%s/settings" % host
+    try:
+        for _ in range(retries + 1):
+            status, headers, body = request(url, "GET", key)
+            if status != 200:
+                return host, "GET %d %s" % (status, body.decode(errors="replace"))
+            status, headers, body = request(url, "PATCH", key, patch, headers.get("ETag"))
+            if status == 412:
+                continue
+            if status != 200:
+                return host, "PATCH %d %s" % (status, body.decode(errors="replace"))
+            return host, "restart" if headers.get("X-Restart-Required") == "1" else "ok"
+        return host, "gave up after %d conflicts" % (retries + 1)
+    except OSError as e:
+        return host, "unreachable: %s" % e
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("hosts")
+    ap.add_argument("patch", help="JSON merge patch, e.g. '{\"device\":{\"apMode\":\"off\"}}'")
+    ap.add_argument("--key", help="API key (PATCH /settings needs a provisioned key)")
+    ap.add_argument("--parallel", type=int, default=32)
+    ap.add_argument("--retries", type=int, default=3, help="re-reads after a 412")
+    args = ap.parse_args()
+
+    patch = json.dumps(json.loads(args.patch), separators=(",", ":")).encode()
+    with open(args.hosts) as f:
+        hosts = [h.split("#")[0].strip() for h in f]
+    hosts = [h for h in hosts if h]
+
+    failed = 0
+    with concurrent.futures.ThreadPoolExecutor(args.parallel) as pool:
+        for host, result in pool.map(lambda h: update(h, patch, args.key, args.retries), hosts):
+            print("%-24s %s" % (host, result))
+            failed += result not in ("ok", "restart")
+    print("%d/%d updated" % (len(hosts) - failed, len(hosts)))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
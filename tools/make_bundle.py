@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""Build and sign provisioning bundles (see lib/Provisioning).
+
+    make_bundle.py keygen fleet.pem
+        Create a P-256 signing key and print the PROVISION_PUBKEY build flag.
+
+    make_bundle.py build fleet.pem site.json site.bin
+        Turn a JSON description into a signed bundle:
+
+        {
+          "serial": 7,                      # must grow with every bundle
+          "restart": false,
+          "deviceName": "sms-gw-12",
+          "networks": [{"ssid": "site", "password": "..."}],
+          "sleepInterval": 60, "apMode": 0, "apPassword": "...",
+          "wifiPowerSave": 1, "listenInterval": 3,
+          "apiKeys": ["plain key, stored as SHA-256"],
+          "carriers": [{"mccmnc": "22610", "apn": "...", "user": "", "pass": "",
+                        "bearer": "ps-preferred"}],
+          "templates": {"alarm": "Alarm at {site}"}
+        }
+
+    make_bundle.py send site.bin ADDRESS
+        Write the bundle over BLE in chunks (needs the "bleak" package and a
+        bonded device) and print the "P:..." result.
+
+Signing needs the "cryptography" package.
+"""
+import argparse
+import asyncio
+import hashlib
+import json
+import struct
+import sys
+
+MAGIC = 0x42565250
+VERSION = 1
+FLAG_RESTART = 0x01
+SERVICE_UUID = "9379d945-8ada-41b7-b028-64a8dda4b1f8"
+CHAR_PROVISION_UUID = "e5a1c3b2-7f40-4d8e-9b61-2c0f8a7d9e53"
+CHAR_NOTIFY_UUID = "6cd49c0f-0c41-475b-afc5-5d504afca7dc"
+PROVISION_MAX = 2048
+
+REC_DEVICE_NAME = 0x01
+REC_NETWORK = 0x02
+REC_SLEEP_INTERVAL = 0x03
+REC_AP_MODE = 0x04
+REC_AP_PASSWORD = 0x05
+REC_WIFI_POWER_SAVE = 0x06
+REC_LISTEN_INTERVAL = 0x07
+REC_API_KEY_HASH = 0x10
+REC_CARRIER_OVERRIDE = 0x20
+REC_TEMPLATE = 0x30
+
+BEARERS = {"keep": 0xFF, "cs-only": 0, "ps-preferred": 1, "cs-preferred": 2}
+
+
+def record(rtype, value):
+    if len(value) > 255:
+        sys.exit("record 0x%02x longer than 255 bytes" % rtype)
+    return bytes((rtype, len(value))) + value
+
+
+def records(cfg):
+    out = []
+    if "deviceName" in cfg:
+        out.append(record(REC_DEVICE_NAME, cfg["deviceName"].encode()))
+    for net in cfg.get("networks", []):
+        ssid = net["ssid"].encode()
+        out.append(record(REC_NETWORK, bytes((len(ssid),)) + ssid + net.get("password", "").encode()))
+    if "sleepInterval" in cfg:
+        out.append(record(REC_SLEEP_INTERVAL, struct.pack("<I", cfg["sleepInterval"])))
+    if "apMode" in cfg:
+        out.append(record(REC_AP_MODE, bytes((cfg["apMode"],))))
+    if "apPassword" in cfg:
+        out.append(record(REC_AP_PASSWORD, cfg["apPassword"].encode()))
+    if "wifiPowerSave" in cfg:
+        out.append(record(REC_WIFI_POWER_SAVE, bytes((cfg["wifiPowerSave"],))))
+    if "listenInterval" in cfg:
+        out.append(record(REC_LISTEN_INTERVAL, bytes((cfg["listenInterval"],))))
+    for key in cfg.get("apiKeys", []):
+        out.append(record(REC_API_KEY_HASH, hashlib.sha256(key.encode()).digest()))
+    for c in cfg.get("carriers", []):
+        fields = "\0".join((c["mccmnc"], c.get("apn", ""), c.get("user", ""), c.get("pass", "")))
+        out.append(record(REC_CARRIER_OVERRIDE, bytes((BEARERS[c.get("bearer", "keep")],)) + fields.encode()))
+    for name, body in cfg.get("templates", {}).items():
+        out.append(record(REC_TEMPLATE, name.encode() + b"\0" + body.encode()))
+    return out
+
+
+def build(key_path, cfg):
+    from cryptography.hazmat.primitives import hashes, serialization
+    from cryptography.hazmat.primitives.asymmetric import ec
+    from cryptography.hazmat.primitives.asymmetric.utils import decode_dss_signature
+
+    with open(key_path, "rb") as f:
+        key = serialization.load_pem_private_key(f.read(), password=None)
+    recs = records(cfg)
+    payload = b"".join(recs)
+    flags = FLAG_RESTART if cfg.get("restart") else 0
+    header = struct.pack("<IBBHII", MAGIC, VERSION, flags, len(recs), cfg["serial"], len(payload))
+    r, s = decode_dss_signature(key.sign(header + payload, ec.ECDSA(hashes.SHA256())))
+    bundle = header + payload + r.to_bytes(32, "big") + s.to_bytes(32, "big")
+    if len(bundle) > PROVISION_MAX:
+        sys.exit("bundle is %d bytes, PROVISION_MAX is %d" % (len(bundle), PROVISION_MAX))
+    return bundle
+
+
+def keygen(key_path):
+    from cryptography.hazmat.primitives import serialization
+    from cryptography.hazmat.primitives.asymmetric import ec
+
+    key = ec.generate_private_key(ec.SECP256R1())
+    with open(key_path, "wb") as f:
+        f.write(key.private_bytes(serialization.Encoding.PEM, serialization.PrivateFormat.PKCS8,
+                                  serialization.NoEncryption()))
+    point = key.public_key().public_bytes(serialization.Encoding.X962,
+                                          serialization.PublicFormat.UncompressedPoint)
+    print('-DPROVISION_PUBKEY=\\"%s\\"' % point.hex())
+
+
+async def send(bundle, address, chunk):
+    from bleak import BleakClient
+
+    result = asyncio.get_running_loop().create_future()
+
+    def on_notify(_, data):
+        text = data.decode(errors="replace")
+        if text.startswith("P:") and not result.done():
+            result.set_result(text)
+
+    async with BleakClient(address) as client:
+        await client.start_notify(CHAR_NOTIFY_UUID, on_notify)
+        await client.write_gatt_char(CHAR_PROVISION_UUID, b"B" + struct.pack("<I", len(bundle)), response=True)
+        for off in range(0, len(bundle), chunk):
+            frame = b"D" + struct.pack("<H", off) + bundle[off:off + chunk]
+            await client.write_gatt_char(CHAR_PROVISION_UUID, frame, response=True)
+        await client.write_gatt_char(CHAR_PROVISION_UUID, b"E", response=True)
+        print(await asyncio.wait_for(result, 10))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    k = sub.add_parser("keygen")
+    k.add_argument("key")
+    b = sub.add_parser("build")
+    b.add_argument("key")
+    b.add_argument("config")
+    b.add_argument("out")
+    s = sub.add_parser("send")
+    s.add_argument("bundle")
+    s.add_argument("address")
+    s.add_argument("--chunk", type=int, default=240, help="bytes per frame (MTU 247 - 3 ATT - 3 frame header, rounded)")
+    args = ap.parse_args()
+
+    if args.cmd == "keygen":
+        keygen(args.key)
+    elif args.cmd == "build":
+        with open(args.config) as f:
+            bundle = build(args.key, json.load(f))
+        with open(args.out, "wb") as f:
+            f.write(bundle)
+        print("%s: %d bytes" % (args.out, len(bundle)))
+    else:
+        with open(args.bundle, "rb") as f:
+            asyncio.run(send(f.read(), args.address, args.chunk))
+
+
+if __name__ == "__main__":
+    main()
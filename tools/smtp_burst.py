@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""Local MTA stand-in: bursts of mail into the device's SMTP ingress.
+
+    smtp_burst.py 192.168.4.1 --messages 20 --connections 6 [--phone +40712345678]
+                  [--resend] [--size 2000] [--port 25] [--user u --key KEY]
+
+Sends MESSAGES mails spread over CONNECTIONS parallel connections, more
+than the device serves at once (SMTP_SESSIONS), the way a relay flushes its
+queue after an outage:
+
+- MAIL, RCPT and DATA go in one pipelined write when the device
+  advertises PIPELINING
+- --resend sends every message a second time with the same Message-ID,
+  as an MTA does when the reply to "." was lost; the device must answer
+  250 without a second SMS ("duplicate" below)
+- --size pads the body to that many bytes (above SMTP_MESSAGE_MAX: 552)
+
+Prints the outcome per reply to ".", the time to connect and get the
+greeting (long while connections wait in the device's backlog), and the
+median time from the final "." to its reply (long while the device waits
+for job slots).
+
+Without --phone an invalid number is used: RCPT is refused with 550 and
+DATA with 554, so no SMS is sent and only sessions, pipelining and the
+backlog are exercised.
+
+Compare with the "smtp" probe in GET /metrics.
+"""
+import argparse
+import base64
+import socket
+import statistics
+import threading
+import time
+import uuid
+
+INVALID_PHONE = "+0"
+
+
+class Session:
+    def __init__(self, host, port, timeout):
+        started = time.monotonic()
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.buf = b""
+        self.greeting = self.reply()
+        self.connect_s = time.monotonic() - started
+
+    def line(self):
+        while b"\r\n" not in self.buf:
+            data = self.sock.recv(4096)
+            if not data:
+                raise ConnectionError("closed by the device")
+            self.buf += data
+        line, self.buf = self.buf.split(b"\r\n", 1)
+        return line.decode(errors="replace")
+
+    def reply(self):
+        """Multi-line reply: returns (code, [texts])"""
+        texts = []
+        while True:
+            line = self.line()
+            texts.append(line[4:])
+            if line[3:4] != "-":
+                return int(line[:3]), texts
+
+    def send(self, text):
+        self.sock.sendall(text.encode() if isinstance(text, str) else text)
+
+    def command(self, text):
+        self.send(text + "\r\n")
+        return self.reply()
+
+    def close(self):
+        try:
+            self.command("QUIT")
+        except (OSError, ConnectionError):
+            pass
+        self.sock.close()
+
+
+def message(message_id, phone, size):
+    body = "Disk /dev/sda1 at 91%% on nas01\r\nChecked at %s\r\n" % time.strftime("%H:%M:%S")
+    if size > len(body):
+        body += ("x" * 76 + "\r\n") * ((size - len(body)) // 78)
+    lines = ["From: monitor@nas01.lan", "To: <%s@sms>" % phone, "Subject: NAS alert",
+             "Message-ID: <%s@nas01.lan>" % message_id, "Date: " + time.strftime("%a, %d %b %Y %H:%M:%S +0000"),
+             "MIME-Version: 1.0", "Content-Type: text/plain; charset=utf-8", ""]
+    text = "\r\n".join(lines) + "\r\n" + body
+    # Dot-stuffing
+    return "\r\n".join("." + l if l.startswith(".") else l for l in text.split("\r\n"))
+
+
+def classify(code, texts):
+    if code == 250 and texts[0].startswith("2.0.0 Already"):
+        return "duplicate"
+    if code == 250:
+        return "accepted"
+    return "%d %s" % (code, texts[0])
+
+
+def count(results, lock, outcome, n=1):
+    with lock:
+        results["outcomes"][outcome] = results["outcomes"].get(outcome, 0) + n
+
+
+def worker(args, ids, results, lock):
+    try:
+        s = Session(args.host, args.port, args.timeout)
+    except (OSError, ConnectionError) as e:
+        count(results, lock, "connect failed: %s" % e, len(ids))
+        return
+    try:
+        session(s, args, ids, results, lock)
+    except (OSError, ConnectionError) as e:
+        count(results, lock, "session lost: %s" % e)
+    s.close()
+
+
+def session(s, args, ids, results, lock):
+    code, ehlo = s.command("EHLO smtp-burst.lan")
+    pipelining = "PIPELINING" in ehlo
+    if args.key:
+        token = base64.b64encode(("\0%s\0%s" % (args.user, args.key)).encode()).decode()
+        code, texts = s.command("AUTH PLAIN " + token)
+        if code != 235:
+            raise SystemExit("AUTH failed: %d %s" % (code, texts[0]))
+    with lock:
+        results["connect"].append(s.connect_s)
+    for message_id in ids:
+        envelope = ["MAIL FROM:<monitor@nas01.lan> SIZE=%d" % args.size, "RCPT TO:<%s@sms>" % args.phone, "DATA"]
+        if pipelining:
+            s.send("".join(c + "\r\n" for c in envelope))
+            replies = [s.reply() for _ in envelope]
+        else:
+            replies = []
+            for c in envelope:
+                replies.append(s.command(c))
+                if replies[-1][0] >= 400:
+                    break
+        if replies[-1][0] != 354:
+            failed = next(r for r in replies if r[0] >= 400)
+            s.command("RSET")
+            count(results, lock, classify(*failed))
+            continue
+        s.send(message(message_id, args.phone, args.size) + "\r\n")
+        sent = time.monotonic()
+        s.send(".\r\n")
+        code, texts = s.reply()
+        with lock:
+            results["final"].append(time.monotonic() - sent)
+        count(results, lock, classify(code, texts))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host")
+    ap.add_argument("--port", type=int, default=25)
+    ap.add_argument("--messages", type=int, default=20)
+    ap.add_argument("--connections", type=int, default=6)
+    ap.add_argument("--phone", default=INVALID_PHONE, help="real destination (sends SMS!)")
+    ap.add_argument("--size", type=int, default=0, help="pad the body to this many bytes")
+    ap.add_argument("--resend", action="store_true", help="send every message twice with the same Message-ID")
+    ap.add_argument("--user", default="smtp-burst")
+    ap.add_argument("--key", help="API key (AUTH PLAIN password) when the device is provisioned with keys")
+    ap.add_argument("--timeout", type=float, default=120.0)
+    args = ap.parse_args()
+
+    ids = [uuid.uuid4().hex for _ in range(args.messages)]
+    if args.resend:
+        ids += ids
+    results = {"outcomes": {}, "connect": [], "final": []}
+    lock = threading.Lock()
+    batches = [ids[i::args.connections] for i in range(args.connections)]
+    threads = [threading.Thread(target=worker, args=(args, b, results, lock)) for b in batches if b]
+    t0 = time.monotonic()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.monotonic() - t0
+
+    for outcome, n in sorted(results["outcomes"].items()):
+        print("%4d x %s" % (n, outcome))
+    connect = results["connect"]
+    final = results["final"]
+    print("%10s %14s %14s %14s" % ("msg/s", "connect max ms", "'.' median ms", "'.' max ms"))
+    print("%10.1f %14.0f %14.0f %14.0f" % (len(ids) / elapsed, max(connect) * 1000 if connect else 0,
+                                          statistics.median(final) * 1000 if final else 0,
+                                          max(final) * 1000 if final else 0))
+
+
+if __name__ == "__main__":
+    main()
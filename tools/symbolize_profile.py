@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Symbolize a sampling profile downloaded from GET /debug/profile.
+
+Usage:
+    symbolize_profile.py profile.sprf .pio/build/esp-wrover-kit/firmware.elf [--folded] [--top N]
+
+Prints a flat profile (samples per function, per task) or, with --folded,
+"task;function count" lines for flamegraph.pl / speedscope.
+"""
+import argparse
+import collections
+import shutil
+import struct
+import subprocess
+import sys
+
+
+def read_profile(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"SPRF":
+        sys.exit("not an SPRF profile")
+    version, core, hz = struct.unpack_from("<BBH", data, 4)
+    if version != 1:
+        sys.exit("unsupported SPRF version %d" % version)
+    count, dropped, duration_ms = struct.unpack_from("<III", data, 8)
+    off = 20
+    task_count = data[off]
+    off += 1
+    tasks = []
+    for _ in range(task_count):
+        n = data[off]
+        tasks.append(data[off + 1:off + 1 + n].decode("ascii", "replace"))
+        off += 1 + n
+    samples = []
+    for _ in range(count):
+        pc, task = struct.unpack_from("<IB", data, off)
+        off += 5
+        # Windowed ABI: top two bits hold the call increment, restore the region bits
+        samples.append(((pc & 0x3FFFFFFF) | 0x40000000, tasks[task] if task < len(tasks) else "?"))
+    return {"core": core, "hz": hz, "dropped": dropped, "duration_ms": duration_ms, "samples": samples}
+
+
+def find_addr2line(explicit):
+    for tool in (explicit, "xtensa-esp32-elf-addr2line"):
+        if tool and shutil.which(tool):
+            return tool
+    sys.exit("xtensa-esp32-elf-addr2line not found (use --addr2line or add the PlatformIO toolchain to PATH)")
+
+
+def symbolize(addr2line, elf, pcs):
+    pcs = sorted(pcs)
+    out = subprocess.run([addr2line, "-f", "-C", "-e", elf] + ["0x%08x" % pc for pc in pcs],
+                         capture_output=True, text=True, check=True).stdout.splitlines()
+    names = {}
+    for i, pc in enumerate(pcs):
+        func = out[2 * i] if 2 * i < len(out) else "??"
+        names[pc] = func if func != "??" else "0x%08x" % pc
+    return names
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("profile")
+    ap.add_argument("elf")
+    ap.add_argument("--addr2line", help="path to xtensa-esp32-elf-addr2line")
+    ap.add_argument("--folded", action="store_true", help="print folded stacks instead of a flat profile")
+    ap.add_argument("--top", type=int, default=30, help="rows in the flat profile")
+    args = ap.parse_args()
+
+    prof = read_profile(args.profile)
+    samples = prof["samples"]
+    if not samples:
+        sys.exit("profile contains no samples")
+    names = symbolize(find_addr2line(args.addr2line), args.elf, {pc for pc, _ in samples})
+
+    per_func = collections.Counter((task, names[pc]) for pc, task in samples)
+    if args.folded:
+        for (task, func), n in per_func.most_common():
+            print("%s;%s %d" % (task, func, n))
+        return
+
+    total = len(samples)
+    print("core %d, %d Hz, %d samples, %d dropped, %.1f s"
+          % (prof["core"], prof["hz"], total, prof["dropped"], prof["duration_ms"] / 1000.0))
+    print("\nper task:")
+    for task, n in collections.Counter(task for _, task in samples).most_common():
+        print("  %6.2f%%  %7d  %s" % (100.0 * n / total, n, task))
+    print("\ntop functions:")
+    for (task, func), n in per_func.most_common(args.top):
+        print("  %6.2f%%  %7d  %-16s %s" % (100.0 * n / total, n, task, func))
+
+
+if __name__ == "__main__":
+    main()
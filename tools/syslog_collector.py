@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Syslog collector stand-in: receives the device's batched RFC 5424 datagrams.
+
+    syslog_collector.py [--port 5514] [--loss 0.1] [--quiet] [--duration 600]
+
+Point the device at it:
+
+    curl -X PATCH http://<device>/settings -d '{"syslog":{"host":"<this machine>","port":5514}}'
+
+Every datagram is split on LF into RFC 5424 messages. Each one is printed
+("--quiet" only counts) and its [meta sequenceId] is checked per host:
+
+- a gap is records lost on the device (ring overflow, failed send) or on
+  the network
+- sequenceId going back to a small value is a device restart, not loss
+- a repeated or older id counts as duplicate/reordered
+
+--loss drops that share of datagrams on purpose, to check that gaps are
+reported. Ctrl-C (or --duration) prints the totals per host, including the
+datagram and batch sizes, and the records the device reported suppressed
+by its rate limit ("LOG" records).
+"""
+import argparse
+import random
+import re
+import socket
+import time
+
+SEVERITIES = ["emerg", "alert", "crit", "error", "warning", "notice", "info", "debug"]
+MESSAGE = re.compile(r"<(\d{1,3})>1 (\S+) (\S+) (\S+) (\S+) (\S+) ((?:\[[^\]]*\])+|-) ?(.*)", re.S)
+SEQUENCE = re.compile(r'\[meta [^\]]*sequenceId="(\d+)"')
+SUPPRESSED = re.compile(r"^(\d+) \w+ records suppressed")
+
+
+class Host:
+    def __init__(self):
+        self.expected = None
+        self.records = self.lost = self.duplicates = self.restarts = self.suppressed = 0
+        self.datagrams = self.bytes = 0
+        self.severities = {}
+
+    def sequence(self, seq):
+        if self.expected is None or seq == self.expected:
+            pass
+        elif seq > self.expected:
+            self.lost += seq - self.expected
+            print("!! %d record(s) lost before sequenceId %d" % (seq - self.expected, seq))
+        elif seq < 16 and self.expected > seq + 16:
+            self.restarts += 1
+            print("!! device restarted (sequenceId %d after %d)" % (seq, self.expected - 1))
+        else:
+            self.duplicates += 1
+            return
+        self.expected = seq + 1
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--bind", default="0.0.0.0")
+    ap.add_argument("--port", type=int, default=5514, help="514 needs root")
+    ap.add_argument("--loss", type=float, default=0.0, help="share of datagrams dropped on purpose (0..1)")
+    ap.add_argument("--quiet", action="store_true", help="count only, do not print records")
+    ap.add_argument("--duration", type=float, help="stop after this many seconds")
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    sock.settimeout(1.0)
+    hosts = {}
+    dropped = malformed = 0
+    deadline = time.monotonic() + args.duration if args.duration else None
+    print("listening on %s:%d" % (args.bind, args.port))
+    try:
+        while deadline is None or time.monotonic() < deadline:
+            try:
+                data, addr = sock.recvfrom(65535)
+            except socket.timeout:
+                continue
+            if random.random() < args.loss:
+                dropped += 1
+                continue
+            datagram_host = None
+            for line in data.decode("utf-8", "replace").split("\n"):
+                m = MESSAGE.match(line)
+                if not m:
+                    malformed += 1
+                    continue
+                pri, stamp, hostname, app, procid, msgid, sd, text = m.groups()
+                key = "%s (%s)" % (hostname, addr[0])
+                host = datagram_host = hosts.setdefault(key, Host())
+                host.records += 1
+                severity = SEVERITIES[int(pri) % 8]
+                host.severities[severity] = host.severities.get(severity, 0) + 1
+                seq = SEQUENCE.search(sd)
+                if seq:
+                    host.sequence(int(seq.group(1)))
+                suppressed = SUPPRESSED.match(text) if msgid == "LOG" else None
+                if suppressed:
+                    host.suppressed += int(suppressed.group(1))
+                if not args.quiet:
+                    print("%s %-8s %-7s %-6s %s" % (stamp, hostname, severity, msgid, text))
+            if datagram_host:
+                datagram_host.datagrams += 1
+                datagram_host.bytes += len(data)
+    except KeyboardInterrupt:
+        pass
+
+    print()
+    for key, h in hosts.items():
+        per = h.records / h.datagrams if h.datagrams else 0
+        print("%s: %d records in %d datagrams (%.1f per datagram, %.0f bytes avg), lost %d, duplicates %d, "
+              "restarts %d, suppressed on device %d" % (key, h.records, h.datagrams, per,
+                                                       h.bytes / h.datagrams if h.datagrams else 0, h.lost,
+                                                       h.duplicates, h.restarts, h.suppressed))
+        print("  by severity: %s" % ", ".join("%s %d" % kv for kv in sorted(h.severities.items())))
+    if dropped or malformed:
+        print("dropped on purpose %d datagrams, %d malformed lines" % (dropped, malformed))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""Load harness: per-message overhead and throughput of HTTP/1.1 vs WebSocket.
+
+    ws_load.py 192.168.4.1 --count 50 [--phone +40712345678] [--message "..."]
+
+Sends the same message COUNT times with both APIs:
+
+- http:     one POST /send per message, new TCP connection each (WebServer
+            closes after every response)
+- ws:       one connection, Send frames pipelined up to the advertised
+            window, Accept/Status frames read as they arrive
+
+and prints bytes on the wire per message (TCP payload, both directions,
+minus the message body), messages per second and median accept latency.
+
+Without --phone an invalid number is used: every request is rejected by
+validation, so no SMS is sent and only protocol and parsing cost is
+measured. With a real number each message is sent; expect the modem rate
+(about 10 per minute) to dominate the ws throughput then.
+
+Compare with the "ws" probe in GET /metrics (overheadPerMessage).
+"""
+import argparse
+import base64
+import json
+import os
+import socket
+import statistics
+import struct
+import time
+
+SEND, AUTH, HELLO, ACCEPT, REJECT, STATUS, INBOUND, AUTH_RESULT = 0x01, 0x02, 0x80, 0x81, 0x82, 0x83, 0x84, 0x85
+INVALID_PHONE = "+0"
+
+
+def http_send(host, port, body, key):
+    payload = json.dumps(body, separators=(",", ":")).encode()
+    head = "POST /send HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\n" % (host, len(payload))
+    if key:
+        head += "Authorization: Bearer %s\r\n" % key
+    request = (head + "\r\n").encode() + payload
+    t0 = time.monotonic()
+    with socket.create_connection((host, port), timeout=30) as s:
+        s.sendall(request)
+        response = b""
+        while True:
+            chunk = s.recv(4096)
+            if not chunk:
+                break
+            response += chunk
+    return len(request), len(response), time.monotonic() - t0
+
+
+def run_http(args, body):
+    sent = received = 0
+    latencies = []
+    t0 = time.monotonic()
+    for _ in range(args.count):
+        out, inn, dt = http_send(args.host, args.http_port, body, args.key)
+        sent += out
+        received += inn
+        latencies.append(dt)
+    return sent, received, time.monotonic() - t0, latencies
+
+
+class WsClient:
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port), timeout=30)
+        key = base64.b64encode(os.urandom(16)).decode()
+        request = ("GET / HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                   "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n" % (host, port, key)).encode()
+        self.sock.sendall(request)
+        response = b""
+        while b"\r\n\r\n" not in response:
+            response += self.sock.recv(1024)
+        head, self.buf = response.split(b"\r\n\r\n", 1)
+        if b" 101 " not in head.split(b"\r\n")[0]:
+            raise SystemExit("WebSocket upgrade refused: %r" % head[:80])
+        self.handshake = len(request) + len(head) + 4
+        self.sent = self.received = 0
+
+    def send(self, payload):
+        mask = os.urandom(4)
+        n = len(payload)
+        head = bytes((0x82,)) + (bytes((0x80 | n,)) if n < 126 else bytes((0x80 | 126,)) + struct.pack(">H", n))
+        frame = head + mask + bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.sendall(frame)
+        self.sent += len(frame)
+
+    def _read(self, n):
+        while len(self.buf) < n:
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise SystemExit("connection closed")
+            self.buf += chunk
+        data, self.buf = self.buf[:n], self.buf[n:]
+        self.received += n
+        return data
+
+    def recv(self):
+        b0, b1 = self._read(2)
+        n = b1 & 0x7F
+        if n == 126:
+            n = struct.unpack(">H", self._read(2))[0]
+        payload = self._read(n)
+        return b0 & 0x0F, payload
+
+
+def send_frame(corr, phone, message):
+    p = phone.encode()
+    return bytes((SEND,)) + struct.pack("<HBB", corr, 1, len(p)) + p + message.encode()
+
+
+def run_ws(args, phone, message):
+    ws = WsClient(args.host, args.ws_port)
+    opcode, hello = ws.recv()
+    if hello[0] != HELLO:
+        raise SystemExit("no Hello frame")
+    window = hello[2]
+    if hello[5]:
+        ws.send(bytes((AUTH,)) + (args.key or "").encode())
+        if ws.recv()[1] != bytes((AUTH_RESULT, 1)):
+            raise SystemExit("API key refused (--key)")
+    t0 = time.monotonic()
+    sent_at = {}
+    latencies = []
+    next_corr = accepted = rejected = finished = 0
+    open_jobs = set()
+    while accepted + rejected < args.count or open_jobs:
+        while next_corr < args.count and len(sent_at) + len(open_jobs) < window:
+            sent_at[next_corr] = time.monotonic()
+            ws.send(send_frame(next_corr, phone, message))
+            next_corr += 1
+        opcode, frame = ws.recv()
+        if opcode != 2:
+            continue
+        if frame[0] == ACCEPT:
+            corr, job = struct.unpack("<HI", frame[1:7])
+            latencies.append(time.monotonic() - sent_at.pop(corr))
+            open_jobs.add(job)
+            accepted += 1
+        elif frame[0] == REJECT:
+            corr = struct.unpack("<H", frame[1:3])[0]
+            latencies.append(time.monotonic() - sent_at.pop(corr))
+            rejected += 1
+        elif frame[0] == STATUS:
+            job, status = struct.unpack("<IB", frame[1:6])
+            if status in (1, 2) and job in open_jobs:
+                open_jobs.discard(job)
+                finished += 1
+    elapsed = time.monotonic() - t0
+    ws.sock.close()
+    return ws.sent, ws.received, elapsed, latencies, ws.handshake
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host")
+    ap.add_argument("--count", type=int, default=50)
+    ap.add_argument("--phone", default=INVALID_PHONE, help="real destination (sends SMS!)")
+    ap.add_argument("--message", default="Load test message")
+    ap.add_argument("--key", help="API key when the device is provisioned with keys")
+    ap.add_argument("--http-port", type=int, default=80)
+    ap.add_argument("--ws-port", type=int, default=81)
+    args = ap.parse_args()
+
+    body_len = len(args.message.encode())
+    rows = []
+    out, inn, elapsed, lat = run_http(args, {"phone": args.phone, "message": args.message})
+    rows.append(("http/1.1", out, inn, elapsed, lat, 0))
+    out, inn, elapsed, lat, handshake = run_ws(args, args.phone, args.message)
+    rows.append(("websocket", out, inn, elapsed, lat, handshake))
+
+    print("%-10s %12s %10s %10s %12s" % ("api", "bytes/msg", "overhead", "msg/s", "median ms"))
+    for name, out, inn, elapsed, lat, handshake in rows:
+        per_msg = (out + inn) / args.count
+        print("%-10s %12.1f %10.1f %10.1f %12.1f" % (name, per_msg, per_msg - body_len, args.count / elapsed,
+                                                     statistics.median(lat) * 1000))
+        if handshake:
+            print("%-10s upgrade handshake %d bytes, once per connection" % ("", handshake))
+
+
+if __name__ == "__main__":
+    main()